@@ -0,0 +1,273 @@
+#include <string>
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+#include <chrono>
+
+#include "swatdb_exceptions.h"
+#include "heappage.h"
+#include "heappagescanner.h"
+#include "data.h"
+#include "record.h"
+
+/*
+ * Micro-benchmarks for HeapPage operations.
+ *
+ * Each benchmark runs one operation over a set of pages filled to a given
+ * fraction of their capacity with records of a given size, and prints one
+ * JSON object per line:
+ *
+ *   {"op":"deleteRecord","variant":"head","record_size":64,"fill":0.9,
+ *    "ops":..., "ns_per_op":..., "records_per_sec":...}
+ *
+ * Operations that modify the page run on copies of a template page, so
+ * every operation sees the same starting layout. Copying is not timed.
+ */
+
+/* Record sizes and fill factors every benchmark is run with */
+static const std::uint32_t record_sizes[] = {8, 64, 256};
+static const double fill_factors[] = {0.5, 0.9};
+
+/* Number of page copies a modifying benchmark runs over per round */
+static const std::uint32_t NUM_COPIES = 256;
+
+/* Number of rounds per benchmark, set with -r */
+static std::uint32_t rounds = 200;
+
+/* Keeps the compiler from dropping reads that are only timed */
+static volatile std::uint64_t sink = 0;
+
+typedef std::chrono::steady_clock Clock;
+
+/*************************************
+ * Prints one benchmark result as a JSON object.
+ */
+void report(const char *op, const char *variant, std::uint32_t record_size,
+    double fill, std::uint64_t ops, std::uint64_t elapsed_ns){
+  double ns_per_op = (double) elapsed_ns / ops;
+  printf("{\"op\":\"%s\",\"variant\":\"%s\",\"record_size\":%u,"
+      "\"fill\":%.2f,\"ops\":%llu,\"ns_per_op\":%.2f,"
+      "\"records_per_sec\":%.0f}\n",
+      op, variant, record_size, fill, (unsigned long long) ops, ns_per_op,
+      1e9 / ns_per_op);
+}
+
+/*************************************
+ * Returns the number of records of record_size bytes that fill fill of an
+ * empty page (at least 3, so head, middle and tail are different slots).
+ */
+std::uint32_t numRecords(std::uint32_t record_size, double fill){
+  std::uint32_t max_records = (PAGE_SIZE - sizeof(HeapPageHeader))
+    / (record_size + sizeof(SlotInfo));
+  std::uint32_t num = (std::uint32_t) (max_records * fill);
+  return num < 3 ? 3 : num;
+}
+
+/*************************************
+ * Initializes page and inserts num records of record_size bytes.
+ */
+void fillPage(HeapPage *page, Data *record_data, std::uint32_t num,
+    std::uint32_t record_size){
+  page->initializeHeader();
+  for(std::uint32_t i = 0; i < num; i++){
+    memset(record_data->getData(), i % 128, record_size);
+    record_data->setSize(record_size);
+    page->insertRecord(record_data);
+  }
+}
+
+/*************************************
+ * Times inserting num records into an empty page.
+ */
+void benchInsert(std::uint32_t record_size, double fill){
+  HeapPage *page = (HeapPage *) new Page();
+  Data record_data(record_size);
+  std::uint32_t num = numRecords(record_size, fill);
+  std::uint64_t elapsed = 0;
+
+  memset(record_data.getData(), 'i', record_size);
+  record_data.setSize(record_size);
+  for(std::uint32_t r = 0; r < rounds; r++){
+    page->initializeHeader();
+    Clock::time_point start = Clock::now();
+    for(std::uint32_t i = 0; i < num; i++){
+      page->insertRecord(&record_data);
+    }
+    elapsed += std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now() - start).count();
+  }
+  report("insertRecord", "append", record_size, fill,
+      (std::uint64_t) rounds * num, elapsed);
+  delete page;
+}
+
+/*************************************
+ * Times getRecord on every record of a page.
+ */
+void benchGet(std::uint32_t record_size, double fill){
+  HeapPage *page = (HeapPage *) new Page();
+  Data record_data(PAGE_SIZE);
+  std::uint32_t num = numRecords(record_size, fill);
+
+  fillPage(page, &record_data, num, record_size);
+  Clock::time_point start = Clock::now();
+  for(std::uint32_t r = 0; r < rounds; r++){
+    for(SlotId i = 0; i < num; i++){
+      page->getRecord(i, &record_data);
+      sink += record_data.getSize();
+    }
+  }
+  std::uint64_t elapsed = std::chrono::duration_cast<
+    std::chrono::nanoseconds>(Clock::now() - start).count();
+  report("getRecord", "copy", record_size, fill,
+      (std::uint64_t) rounds * num, elapsed);
+  delete page;
+}
+
+/*************************************
+ * Times a full HeapPageScanner pass over a page, reading every record
+ * through a RecordView.
+ */
+void benchScan(std::uint32_t record_size, double fill){
+  HeapPage *page = (HeapPage *) new Page();
+  Data record_data(record_size);
+  std::uint32_t num = numRecords(record_size, fill);
+  RecordView view;
+
+  fillPage(page, &record_data, num, record_size);
+  HeapPageScanner scanner(page);
+  Clock::time_point start = Clock::now();
+  for(std::uint32_t r = 0; r < rounds; r++){
+    scanner.reset(page);
+    while(scanner.getNext(&view) != INVALID_SLOT_ID){
+      sink += view.data[0];
+    }
+  }
+  std::uint64_t elapsed = std::chrono::duration_cast<
+    std::chrono::nanoseconds>(Clock::now() - start).count();
+  report("scan", "view", record_size, fill,
+      (std::uint64_t) rounds * num, elapsed);
+  delete page;
+}
+
+/*************************************
+ * Times one modifying operation applied to NUM_COPIES copies of a filled
+ * page. op is called once per copy with the operation's target slot.
+ */
+template <typename Op>
+void benchModify(const char *op_name, const char *variant,
+    std::uint32_t record_size, double fill, SlotId slot_id, Op op){
+  Page *template_page = new Page();
+  Page *copies = new Page[NUM_COPIES];
+  Data record_data(record_size);
+  std::uint32_t num = numRecords(record_size, fill);
+  std::uint64_t elapsed = 0;
+
+  fillPage((HeapPage *) template_page, &record_data, num, record_size);
+  for(std::uint32_t r = 0; r < rounds; r++){
+    for(std::uint32_t c = 0; c < NUM_COPIES; c++){
+      memcpy(copies[c].getData(), template_page->getData(), PAGE_SIZE);
+    }
+    Clock::time_point start = Clock::now();
+    for(std::uint32_t c = 0; c < NUM_COPIES; c++){
+      op((HeapPage *) &copies[c], slot_id);
+    }
+    elapsed += std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now() - start).count();
+  }
+  report(op_name, variant, record_size, fill,
+      (std::uint64_t) rounds * NUM_COPIES, elapsed);
+  delete[] copies;
+  delete template_page;
+}
+
+/*************************************
+ * Times deleteRecord of the first, middle and last inserted record. The
+ * first one sits at the end of the page, so deleting it moves every other
+ * record; the last one sits at free_space_end and moves nothing.
+ */
+void benchDelete(std::uint32_t record_size, double fill){
+  std::uint32_t num = numRecords(record_size, fill);
+  SlotId positions[3] = {0, num / 2, num - 1};
+  const char *variants[3] = {"head", "middle", "tail"};
+
+  for(int p = 0; p < 3; p++){
+    benchModify("deleteRecord", variants[p], record_size, fill, positions[p],
+        [](HeapPage *page, SlotId slot_id){ page->deleteRecord(slot_id); });
+  }
+}
+
+/*************************************
+ * Times updateRecord of the middle record to a bigger, same-size and
+ * smaller value.
+ */
+void benchUpdate(std::uint32_t record_size, double fill){
+  std::uint32_t num = numRecords(record_size, fill);
+  std::uint32_t new_sizes[3] = {record_size + 8, record_size,
+    record_size / 2};
+  const char *variants[3] = {"grow", "same", "shrink"};
+
+  for(int v = 0; v < 3; v++){
+    Data new_data(new_sizes[v]);
+    memset(new_data.getData(), 'u', new_sizes[v]);
+    new_data.setSize(new_sizes[v]);
+
+    // skip growing updates that do not fit on the filled page
+    HeapPage *page = (HeapPage *) new Page();
+    Data record_data(record_size);
+    fillPage(page, &record_data, num, record_size);
+    bool fits = page->getFreeSpace() + record_size >= new_sizes[v];
+    delete page;
+    if(!fits){
+      continue;
+    }
+
+    benchModify("updateRecord", variants[v], record_size, fill, num / 2,
+        [&new_data](HeapPage *page, SlotId slot_id){
+          page->updateRecord(slot_id, &new_data);
+        });
+  }
+}
+
+/*
+ * Prints usage
+ */
+void usage(){
+  std::cout << "Usage: ./bench -r <rounds> -h help\n";
+  std::cout << "Prints one JSON result per line for insertRecord, "
+      << "getRecord, deleteRecord,\nupdateRecord and scan over record sizes "
+      << "8, 64, 256 and fill factors 0.5, 0.9." << std::endl;
+}
+
+int main(int argc, char** argv){
+  int c;
+
+  while ((c = getopt (argc, argv, "hr:")) != -1){
+    switch(c) {
+      case 'h': usage();
+                exit(1);
+      case 'r': rounds = atoi(optarg);
+                break;
+      default: usage();
+               exit(1);
+    }
+  }
+  if (rounds == 0){
+    usage();
+    exit(1);
+  }
+
+  for(std::uint32_t record_size : record_sizes){
+    for(double fill : fill_factors){
+      benchInsert(record_size, fill);
+      benchGet(record_size, fill);
+      benchDelete(record_size, fill);
+      benchUpdate(record_size, fill);
+      benchScan(record_size, fill);
+    }
+  }
+
+  return 0;
+}
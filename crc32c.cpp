@@ -0,0 +1,103 @@
+#include <cstring>
+
+#include "crc32c.h"
+
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#elif defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+/*
+ * CRC32C polynomial, bit reversed.
+ */
+static const std::uint32_t CRC32C_POLY = 0x82F63B78;
+
+/*
+ * Table of the CRC32C of every byte value.
+ */
+struct Crc32cTable{
+  std::uint32_t entries[256];
+
+  Crc32cTable(){
+    for (std::uint32_t i = 0; i < 256; i++){
+      std::uint32_t crc = i;
+      for (int bit = 0; bit < 8; bit++){
+        crc = (crc >> 1) ^ (CRC32C_POLY & (0 - (crc & 1)));
+      }
+      entries[i] = crc;
+    }
+  }
+};
+
+static const Crc32cTable crc_table;
+
+/**
+ * @brief Same as crc32c, always using the table. For checking the hardware
+ *    versions against.
+ *
+ * @param crc Checksum of the bytes before data, 0 for the first piece.
+ * @param data Bytes to checksum.
+ * @param length Number of bytes.
+ * @return CRC32C of the bytes checksummed so far, including data.
+ */
+std::uint32_t crc32cPortable(std::uint32_t crc, const void* data,
+    std::size_t length){
+  const unsigned char* bytes = (const unsigned char*) data;
+
+  crc = ~crc;
+  for (std::size_t i = 0; i < length; i++){
+    crc = crc_table.entries[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+/**
+ * @brief Computes the CRC32C (Castagnoli) checksum of a buffer.
+ *
+ * Uses the SSE4.2 crc32 instruction when built with -msse4.2 (or any
+ * -march that has it), the ARMv8 CRC32 instructions when built with
+ * __ARM_FEATURE_CRC32, and a table otherwise. All three give the same
+ * result.
+ *
+ * @pre data holds length bytes.
+ * @post None.
+ *
+ * @param crc Checksum of the bytes before data when checksumming a buffer
+ *    in pieces, 0 for the first piece.
+ * @param data Bytes to checksum.
+ * @param length Number of bytes.
+ * @return CRC32C of the bytes checksummed so far, including data.
+ */
+std::uint32_t crc32c(std::uint32_t crc, const void* data, std::size_t length){
+#if defined(__SSE4_2__) || defined(__ARM_FEATURE_CRC32)
+  const unsigned char* bytes = (const unsigned char*) data;
+  std::uint64_t value = ~crc;
+
+  //8 bytes per instruction; memcpy keeps the loads unaligned-safe
+  while (length >= 8){
+    std::uint64_t word;
+    std::memcpy(&word, bytes, sizeof(word));
+#if defined(__SSE4_2__)
+    value = _mm_crc32_u64(value, word);
+#else
+    value = __crc32cd((std::uint32_t) value, word);
+#endif
+    bytes += 8;
+    length -= 8;
+  }
+  std::uint32_t rest = (std::uint32_t) value;
+  while (length > 0){
+#if defined(__SSE4_2__)
+    rest = _mm_crc32_u8(rest, *bytes);
+#else
+    rest = __crc32cb(rest, *bytes);
+#endif
+    bytes++;
+    length--;
+  }
+  return ~rest;
+#else
+  return crc32cPortable(crc, data, length);
+#endif
+}
@@ -0,0 +1,43 @@
+#ifndef  _SWATDB_CRC32C_H_
+#define  _SWATDB_CRC32C_H_
+
+
+/**
+ * \file
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Computes the CRC32C (Castagnoli) checksum of a buffer.
+ *
+ * Uses the SSE4.2 crc32 instruction when built with -msse4.2 (or any
+ * -march that has it), the ARMv8 CRC32 instructions when built with
+ * __ARM_FEATURE_CRC32, and a table otherwise. All three give the same
+ * result.
+ *
+ * @pre data holds length bytes.
+ * @post None.
+ *
+ * @param crc Checksum of the bytes before data when checksumming a buffer
+ *    in pieces, 0 for the first piece.
+ * @param data Bytes to checksum.
+ * @param length Number of bytes.
+ * @return CRC32C of the bytes checksummed so far, including data.
+ */
+std::uint32_t crc32c(std::uint32_t crc, const void* data, std::size_t length);
+
+/**
+ * @brief Same as crc32c, always using the table. For checking the hardware
+ *    versions against.
+ *
+ * @param crc Checksum of the bytes before data, 0 for the first piece.
+ * @param data Bytes to checksum.
+ * @param length Number of bytes.
+ * @return CRC32C of the bytes checksummed so far, including data.
+ */
+std::uint32_t crc32cPortable(std::uint32_t crc, const void* data,
+    std::size_t length);
+
+#endif
@@ -0,0 +1,493 @@
+#ifndef  _SWATDB_FIXEDHEAPPAGE_H_
+#define  _SWATDB_FIXEDHEAPPAGE_H_
+
+
+/**
+ * \file
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "swatdb_types.h"
+#include "swatdb_exceptions.h"
+#include "page.h"
+#include "data.h"
+#include "heappage.h"
+
+/**
+ * Struct for the header metadata of FixedHeapPage object. The validity
+ * bitmap and the record array follow it on the Page.
+ */
+struct FixedHeapPageHeader{
+
+  /**
+   * PageNum of the previous Page in the file.
+   */
+  PageNum prev_page;
+
+  /**
+   * PageNum of the next Page in the file.
+   */
+  PageNum next_page;
+
+  /**
+   * Number of records stored on the Page.
+   */
+  std::uint32_t size;
+
+  /**
+   * RecordSize the Page was initialized with, to tell apart pages of
+   * different record sizes when debugging.
+   */
+  std::uint32_t record_size;
+};
+
+/**
+ * SwatDB FixedHeapPage Class.
+ *
+ * A heap page for records that all have RecordSize bytes. Instead of a
+ * slot directory the Page holds a bitmap with one bit per slot, set if the
+ * slot holds a record, followed by a dense array of capacity() records:
+ * the record of slot i is at a computable offset, deletes only clear a bit
+ * and never move records, and scans stream through the array in order.
+ *
+ * Like HeapPage, a FixedHeapPage pointer is type casted to a Page pointer
+ * returned by the BufferManager. It has no version latch, so concurrent
+ * writers and readers of one Page must be synchronized by the caller.
+ */
+template <std::uint32_t RecordSize>
+class FixedHeapPage : public Page {
+
+  public:
+
+    static_assert(RecordSize > 0, "records must not be empty");
+
+    /**
+     * @brief Number of record slots on a Page.
+     * @return Largest n such that the header, an n bit bitmap rounded up
+     *    to 64 bits and n records fit in PAGE_SIZE.
+     */
+    static constexpr std::uint32_t capacity(){
+      std::uint32_t n = (PAGE_SIZE - sizeof(FixedHeapPageHeader)) * 8
+        / (RecordSize * 8 + 1);
+      while (sizeof(FixedHeapPageHeader) + (n + 63) / 64 * 8
+          + n * RecordSize > PAGE_SIZE){
+        n--;
+      }
+      return n;
+    }
+
+    static_assert(capacity() > 0, "RecordSize does not fit on a page");
+
+    /**
+     * @brief Constructor. Never called, see HeapPage::HeapPage.
+     */
+    FixedHeapPage() = delete;
+
+    /**
+     * Destructor: shouldn't do anything
+     */
+    ~FixedHeapPage() {}
+
+    /**
+     * @brief Initializes header information after the Page is allocated.
+     *
+     * @pre None
+     * @post prev_page and next_page are set to INVALID_PAGE_NUM, size is 0,
+     *    record_size is RecordSize and every slot is invalid.
+     */
+    void initializeHeader();
+
+    /**
+     * @brief Sets next_page to the given PageNum.
+     *
+     * @param page_num PageNum of the next Page.
+     */
+    void setNext(PageNum page_num);
+
+    /**
+     * @brief Sets prev_page to the given PageNum.
+     *
+     * @param page_num PageNum of the previous Page.
+     */
+    void setPrev(PageNum page_num);
+
+    /**
+     * @brief Getter for next_page.
+     * @return PageNum of the next Page.
+     */
+    PageNum getNext();
+
+    /**
+     * @brief Getter for prev_page.
+     * @return PageNum of the previous Page.
+     */
+    PageNum getPrev();
+
+    /**
+     * @brief Getter for the number of records on the Page.
+     * @return Number of valid slots.
+     */
+    std::uint32_t getSize();
+
+    /**
+     * @brief Getter for the amount of free space on the Page.
+     * @return Number of free slots times RecordSize.
+     */
+    std::uint32_t getFreeSpace();
+
+    /**
+     * @brief bool function indicating whether the Page is full.
+     * @return true if every slot holds a record.
+     */
+    bool isFull();
+
+    /**
+     * @brief Inserts a record into the first free slot.
+     *
+     * @pre A valid Data* of RecordSize bytes is provided as input.
+     * @post The record is copied into the first free slot, whose bit is
+     *    set.
+     *
+     * @param record_data Data* of the record to insert.
+     * @return SlotId of the inserted record.
+     *
+     * @throw EmptyDataHeapPage If the record is size 0.
+     * @throw InvalidSizeData If the record is not RecordSize bytes.
+     * @throw InsufficientSpaceHeapPage If every slot holds a record.
+     */
+    SlotId insertRecord(Data* record_data);
+
+    /**
+     * @brief Gets the record identified by its SlotId.
+     *
+     * @pre record_data has a capacity of at least RecordSize.
+     * @post record_data holds a copy of the record and its size is
+     *    RecordSize.
+     *
+     * @param slot_id SlotId of the record to get.
+     * @param record_data Data* to copy the record into.
+     *
+     * @throw InvalidSlotIdHeapPage If slot_id is out of range or the slot
+     *    does not hold a record.
+     * @throw InvalidSizeData If record_data is too small.
+     */
+    void getRecord(SlotId slot_id, Data* record_data);
+
+    /**
+     * @brief Gets a read-only view of the record identified by its SlotId.
+     *
+     * @pre The Page is pinned.
+     * @post The view points at the record in the Page, and stays valid
+     *    until the record is updated or deleted or the Page is unpinned.
+     *
+     * @param slot_id SlotId of the record to view.
+     * @return RecordView of the record.
+     *
+     * @throw InvalidSlotIdHeapPage If slot_id is out of range or the slot
+     *    does not hold a record.
+     */
+    RecordView getRecordView(SlotId slot_id);
+
+    /**
+     * @brief Overwrites the record identified by its SlotId.
+     *
+     * @pre A valid Data* of RecordSize bytes is provided as input.
+     * @post The record in the slot is replaced by record_data.
+     *
+     * @param slot_id SlotId of the record to update.
+     * @param record_data Data* of the new record.
+     *
+     * @throw InvalidSlotIdHeapPage If slot_id is out of range or the slot
+     *    does not hold a record.
+     * @throw EmptyDataHeapPage If the record is size 0.
+     * @throw InvalidSizeData If the record is not RecordSize bytes.
+     */
+    void updateRecord(SlotId slot_id, Data* record_data);
+
+    /**
+     * @brief Deletes the record identified by its SlotId. No record moves.
+     *
+     * @pre None.
+     * @post The bit of the slot is cleared and the slot can be reused.
+     *
+     * @param slot_id SlotId of the record to delete.
+     *
+     * @throw InvalidSlotIdHeapPage If slot_id is out of range or the slot
+     *    does not hold a record.
+     */
+    void deleteRecord(SlotId slot_id);
+
+    /**
+     * @brief Finds the first valid slot at or after slot_id, testing 64
+     *    slots of the bitmap at a time.
+     *
+     * @pre None.
+     * @post None.
+     *
+     * @param slot_id First SlotId to consider.
+     * @return SlotId of the next valid slot, INVALID_SLOT_ID if there is
+     *    none.
+     */
+    SlotId getNextValid(SlotId slot_id);
+
+  private:
+
+    /**
+     * Number of 64 bit words in the validity bitmap.
+     */
+    static const std::uint32_t BITMAP_WORDS = (capacity() + 63) / 64;
+
+    /**
+     * Offset of the first record from the beginning of the Page.
+     */
+    static const std::uint32_t RECORDS_OFFSET = sizeof(FixedHeapPageHeader)
+      + BITMAP_WORDS * 8;
+
+    /**
+     * @brief Getter for the Page header.
+     */
+    FixedHeapPageHeader* _getPageHeader();
+
+    /**
+     * @brief Getter for the validity bitmap.
+     */
+    std::uint64_t* _getBitmap();
+
+    /**
+     * @brief Returns true if slot_id is in range and holds a record.
+     */
+    bool _isValid(SlotId slot_id);
+
+    /**
+     * @brief Throws InvalidSizeData or EmptyDataHeapPage unless record_data
+     *    is RecordSize bytes.
+     */
+    void _checkRecordSize(Data* record_data);
+};
+
+/**
+ * @brief Initializes header information after the Page is allocated.
+ */
+template <std::uint32_t RecordSize>
+void FixedHeapPage<RecordSize>::initializeHeader(){
+  FixedHeapPageHeader* header = this->_getPageHeader();
+
+  header->prev_page = INVALID_PAGE_NUM;
+  header->next_page = INVALID_PAGE_NUM;
+  header->size = 0;
+  header->record_size = RecordSize;
+  std::memset(this->_getBitmap(), 0, BITMAP_WORDS * 8);
+}
+
+/**
+ * @brief Sets next_page to the given PageNum.
+ */
+template <std::uint32_t RecordSize>
+void FixedHeapPage<RecordSize>::setNext(PageNum page_num){
+  this->_getPageHeader()->next_page = page_num;
+}
+
+/**
+ * @brief Sets prev_page to the given PageNum.
+ */
+template <std::uint32_t RecordSize>
+void FixedHeapPage<RecordSize>::setPrev(PageNum page_num){
+  this->_getPageHeader()->prev_page = page_num;
+}
+
+/**
+ * @brief Getter for next_page.
+ */
+template <std::uint32_t RecordSize>
+PageNum FixedHeapPage<RecordSize>::getNext(){
+  return this->_getPageHeader()->next_page;
+}
+
+/**
+ * @brief Getter for prev_page.
+ */
+template <std::uint32_t RecordSize>
+PageNum FixedHeapPage<RecordSize>::getPrev(){
+  return this->_getPageHeader()->prev_page;
+}
+
+/**
+ * @brief Getter for the number of records on the Page.
+ */
+template <std::uint32_t RecordSize>
+std::uint32_t FixedHeapPage<RecordSize>::getSize(){
+  return this->_getPageHeader()->size;
+}
+
+/**
+ * @brief Getter for the amount of free space on the Page.
+ */
+template <std::uint32_t RecordSize>
+std::uint32_t FixedHeapPage<RecordSize>::getFreeSpace(){
+  return (capacity() - this->_getPageHeader()->size) * RecordSize;
+}
+
+/**
+ * @brief bool function indicating whether the Page is full.
+ */
+template <std::uint32_t RecordSize>
+bool FixedHeapPage<RecordSize>::isFull(){
+  return this->_getPageHeader()->size == capacity();
+}
+
+/**
+ * @brief Inserts a record into the first free slot.
+ */
+template <std::uint32_t RecordSize>
+SlotId FixedHeapPage<RecordSize>::insertRecord(Data* record_data){
+  FixedHeapPageHeader* header = this->_getPageHeader();
+  std::uint64_t* bitmap = this->_getBitmap();
+
+  //throw exceptions
+  this->_checkRecordSize(record_data);
+  if (header->size == capacity()){
+    throw InsufficientSpaceHeapPage();
+  }
+
+  //first clear bit; some slot in range is free, so it is in range
+  std::uint32_t word = 0;
+  while (bitmap[word] == UINT64_MAX){
+    word++;
+  }
+  SlotId slot_id = word * 64 + __builtin_ctzll(~bitmap[word]);
+
+  bitmap[word] |= (std::uint64_t) 1 << (slot_id % 64);
+  std::memcpy(this->data + RECORDS_OFFSET + slot_id * RecordSize,
+      record_data->getData(), RecordSize);
+  header->size++;
+  return slot_id;
+}
+
+/**
+ * @brief Gets the record identified by its SlotId.
+ */
+template <std::uint32_t RecordSize>
+void FixedHeapPage<RecordSize>::getRecord(SlotId slot_id, Data* record_data){
+  //throw exceptions
+  if (!this->_isValid(slot_id)){
+    throw InvalidSlotIdHeapPage(slot_id);
+  }
+  if (record_data->getCapacity() < RecordSize){
+    throw InvalidSizeData();
+  }
+
+  std::memcpy(record_data->getData(),
+      this->data + RECORDS_OFFSET + slot_id * RecordSize, RecordSize);
+  record_data->setSize(RecordSize);
+}
+
+/**
+ * @brief Gets a read-only view of the record identified by its SlotId.
+ */
+template <std::uint32_t RecordSize>
+RecordView FixedHeapPage<RecordSize>::getRecordView(SlotId slot_id){
+  if (!this->_isValid(slot_id)){
+    throw InvalidSlotIdHeapPage(slot_id);
+  }
+
+  RecordView view;
+  view.data = this->data + RECORDS_OFFSET + slot_id * RecordSize;
+  view.length = RecordSize;
+  return view;
+}
+
+/**
+ * @brief Overwrites the record identified by its SlotId.
+ */
+template <std::uint32_t RecordSize>
+void FixedHeapPage<RecordSize>::updateRecord(SlotId slot_id,
+    Data* record_data){
+  //throw exceptions
+  if (!this->_isValid(slot_id)){
+    throw InvalidSlotIdHeapPage(slot_id);
+  }
+  this->_checkRecordSize(record_data);
+
+  std::memcpy(this->data + RECORDS_OFFSET + slot_id * RecordSize,
+      record_data->getData(), RecordSize);
+}
+
+/**
+ * @brief Deletes the record identified by its SlotId. No record moves.
+ */
+template <std::uint32_t RecordSize>
+void FixedHeapPage<RecordSize>::deleteRecord(SlotId slot_id){
+  //throw exceptions
+  if (!this->_isValid(slot_id)){
+    throw InvalidSlotIdHeapPage(slot_id);
+  }
+
+  this->_getBitmap()[slot_id / 64] &= ~((std::uint64_t) 1 << (slot_id % 64));
+  this->_getPageHeader()->size--;
+}
+
+/**
+ * @brief Finds the first valid slot at or after slot_id.
+ */
+template <std::uint32_t RecordSize>
+SlotId FixedHeapPage<RecordSize>::getNextValid(SlotId slot_id){
+  std::uint64_t* bitmap = this->_getBitmap();
+
+  if (slot_id >= capacity()){
+    return INVALID_SLOT_ID;
+  }
+  std::uint32_t word = slot_id / 64;
+  //ignore the slots before slot_id in its word
+  std::uint64_t bits = bitmap[word] & (UINT64_MAX << (slot_id % 64));
+  while (bits == 0){
+    word++;
+    if (word == BITMAP_WORDS){
+      return INVALID_SLOT_ID;
+    }
+    bits = bitmap[word];
+  }
+  return word * 64 + __builtin_ctzll(bits);
+}
+
+/**
+ * @brief Getter for the Page header.
+ */
+template <std::uint32_t RecordSize>
+FixedHeapPageHeader* FixedHeapPage<RecordSize>::_getPageHeader(){
+  return (FixedHeapPageHeader*) this->data;
+}
+
+/**
+ * @brief Getter for the validity bitmap.
+ */
+template <std::uint32_t RecordSize>
+std::uint64_t* FixedHeapPage<RecordSize>::_getBitmap(){
+  return (std::uint64_t*) (this->data + sizeof(FixedHeapPageHeader));
+}
+
+/**
+ * @brief Returns true if slot_id is in range and holds a record.
+ */
+template <std::uint32_t RecordSize>
+bool FixedHeapPage<RecordSize>::_isValid(SlotId slot_id){
+  return slot_id < capacity() &&
+    (this->_getBitmap()[slot_id / 64] >> (slot_id % 64) & 1);
+}
+
+/**
+ * @brief Throws InvalidSizeData or EmptyDataHeapPage unless record_data is
+ *    RecordSize bytes.
+ */
+template <std::uint32_t RecordSize>
+void FixedHeapPage<RecordSize>::_checkRecordSize(Data* record_data){
+  if (record_data->getSize() == 0){
+    throw EmptyDataHeapPage();
+  }
+  if (record_data->getSize() != RecordSize){
+    throw InvalidSizeData();
+  }
+}
+
+#endif
@@ -0,0 +1,201 @@
+#include <iostream>
+#include <algorithm>
+
+#include "swatdb_exceptions.h"
+#include "heappage.h"
+#include "freespacemap.h"
+#include "page.h"
+
+/**
+ * @brief Constructor.
+ *
+ * @pre None.
+ * @post FreeSpaceMap is constructed with no pages. It is told about writes
+ *    to the pages attached to it.
+ */
+FreeSpaceMap::FreeSpaceMap(){ }
+
+/**
+ * @brief Destructor. Detaches the pages still attached.
+ *
+ * @pre No attached page is being modified.
+ */
+FreeSpaceMap::~FreeSpaceMap(){
+  for (auto& entry : this->attached){
+    HeapPage::setFreeSpaceListener(entry.first, nullptr);
+  }
+}
+
+/**
+ * @brief Attaches a pinned HeapPage to its PageNum, so that writes to the
+ *    page update the map.
+ *
+ * @pre page is pinned and is the HeapPage of page_num. page_num is not
+ *    INVALID_PAGE_NUM.
+ * @post The free space class of page_num is set to the current class of
+ *    page, and later writes to page update it. The map is the listener of
+ *    page.
+ *
+ * @param page_num PageNum of page.
+ * @param page HeapPage to attach.
+ */
+void FreeSpaceMap::attach(PageNum page_num, HeapPage* page){
+  std::lock_guard<std::mutex> guard(this->latch);
+
+  this->attached[page] = page_num;
+  this->_setClass(page_num, page->getFreeSpaceClass());
+  HeapPage::setFreeSpaceListener(page, this);
+}
+
+/**
+ * @brief Detaches a HeapPage before it is unpinned.
+ *
+ * @pre page was attached, and no writer is modifying it.
+ * @post Writes to page no longer update the map. The last free space class
+ *    of its PageNum is kept.
+ *
+ * @param page HeapPage to detach.
+ */
+void FreeSpaceMap::detach(HeapPage* page){
+  std::lock_guard<std::mutex> guard(this->latch);
+
+  if (this->attached.erase(page) != 0){
+    HeapPage::setFreeSpaceListener(page, nullptr);
+  }
+}
+
+/**
+ * @brief Sets the free space class of page_num to the current class of
+ *    page, for pages that are not attached.
+ *
+ * @pre page is pinned and is the HeapPage of page_num. page_num is not
+ *    INVALID_PAGE_NUM.
+ * @post The free space class of page_num is updated.
+ *
+ * @param page_num PageNum of page.
+ * @param page HeapPage to read the free space class of.
+ */
+void FreeSpaceMap::update(PageNum page_num, HeapPage* page){
+  std::lock_guard<std::mutex> guard(this->latch);
+
+  this->_setClass(page_num, page->getFreeSpaceClass());
+}
+
+/**
+ * @brief Removes a page from the map, for example when it is deallocated.
+ *
+ * @pre None.
+ * @post The free space class of page_num is 0, so findPage does not return
+ *    it.
+ *
+ * @param page_num PageNum to remove.
+ */
+void FreeSpaceMap::remove(PageNum page_num){
+  std::lock_guard<std::mutex> guard(this->latch);
+
+  if (page_num < this->classes.size()){
+    this->_setClass(page_num, 0);
+  }
+}
+
+/**
+ * @brief Getter for the free space class of page_num.
+ *
+ * @pre None.
+ * @post None.
+ *
+ * @param page_num PageNum to look up.
+ * @return Last known free space class of page_num, 0 if it is unknown.
+ */
+std::uint8_t FreeSpaceMap::getFreeSpaceClass(PageNum page_num){
+  std::lock_guard<std::mutex> guard(this->latch);
+
+  if (page_num >= this->classes.size()){
+    return 0;
+  }
+  return this->classes[page_num];
+}
+
+/**
+ * @brief Finds a page with room for a record of num_bytes bytes.
+ *
+ * Groups whose maximum class is too small are skipped without looking at
+ * their pages.
+ *
+ * @pre None.
+ * @post None.
+ *
+ * @param num_bytes Size of the record to insert.
+ * @return PageNum of the first page whose free space class guarantees
+ *    num_bytes of free space, or INVALID_PAGE_NUM if there is none.
+ */
+PageNum FreeSpaceMap::findPage(std::uint32_t num_bytes){
+  //smallest class c with c * FREE_SPACE_CLASS_BYTES >= num_bytes
+  std::uint32_t needed = (num_bytes + FREE_SPACE_CLASS_BYTES - 1)
+    / FREE_SPACE_CLASS_BYTES;
+  needed = std::max(needed, (std::uint32_t) 1);
+  if (needed > UINT8_MAX){
+    return INVALID_PAGE_NUM;
+  }
+
+  std::lock_guard<std::mutex> guard(this->latch);
+  for (std::uint32_t group = 0; group < this->group_max.size(); group++){
+    if (this->group_max[group] < needed){
+      continue;
+    }
+    std::uint32_t end = std::min((group + 1) * FREE_SPACE_MAP_GROUP,
+        (std::uint32_t) this->classes.size());
+    for (std::uint32_t i = group * FREE_SPACE_MAP_GROUP; i < end; i++){
+      if (this->classes[i] >= needed){
+        return i;
+      }
+    }
+  }
+  return INVALID_PAGE_NUM;
+}
+
+/**
+ * @brief Updates the free space class of an attached page. Called by
+ *    HeapPage writers; pages that are not attached are ignored.
+ *
+ * @param page HeapPage that was modified.
+ * @param free_space_class New free space class of page.
+ */
+void FreeSpaceMap::freeSpaceChanged(HeapPage* page,
+    std::uint8_t free_space_class){
+  std::lock_guard<std::mutex> guard(this->latch);
+
+  std::unordered_map<HeapPage*, PageNum>::iterator it =
+    this->attached.find(page);
+  if (it != this->attached.end()){
+    this->_setClass(it->second, free_space_class);
+  }
+}
+
+/**
+ * @brief Sets the free space class of page_num and the maximum of its
+ *    group.
+ *
+ * @pre latch is held.
+ */
+void FreeSpaceMap::_setClass(PageNum page_num,
+    std::uint8_t free_space_class){
+  if (page_num >= this->classes.size()){
+    this->classes.resize(page_num + 1, 0);
+    this->group_max.resize(page_num / FREE_SPACE_MAP_GROUP + 1, 0);
+  }
+  std::uint8_t old_class = this->classes[page_num];
+  this->classes[page_num] = free_space_class;
+
+  std::uint8_t& group = this->group_max[page_num / FREE_SPACE_MAP_GROUP];
+  if (free_space_class >= group){
+    group = free_space_class;
+  }else if (old_class == group){
+    //the page may have been the maximum of its group
+    std::uint32_t begin = page_num - page_num % FREE_SPACE_MAP_GROUP;
+    std::uint32_t end = std::min(begin + FREE_SPACE_MAP_GROUP,
+        (std::uint32_t) this->classes.size());
+    group = *std::max_element(this->classes.begin() + begin,
+        this->classes.begin() + end);
+  }
+}
@@ -0,0 +1,174 @@
+#ifndef  _SWATDB_FREESPACEMAP_H_
+#define  _SWATDB_FREESPACEMAP_H_
+
+
+/**
+ * \file 
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include <unordered_map>
+#include "swatdb_types.h"
+#include "heappage.h"
+
+/**
+ * Number of consecutive pages summarized by one entry of
+ * FreeSpaceMap::group_max.
+ */
+const std::uint32_t FREE_SPACE_MAP_GROUP = 64;
+
+/**
+ * File-level summary of the free space of HeapPages.
+ *
+ * FreeSpaceMap keeps one free space class byte (see
+ * HeapPage::getFreeSpaceClass) per PageNum of a file, and the maximum class
+ * of every FREE_SPACE_MAP_GROUP consecutive pages, so an insert can find a
+ * page with enough room without pinning the pages that have none. While a
+ * page is attached, the map is updated by the page itself through the
+ * FreeSpaceListener interface on every write that changes its class; its
+ * last class is kept after it is detached (unpinned). attach registers the
+ * map as the listener of that page only (HeapPage::setFreeSpaceListener
+ * with a page), so every file can have its own map, and writes to pages
+ * of other files never take this map's mutex.
+ */
+class FreeSpaceMap : public FreeSpaceListener {
+
+  public:
+
+    /**
+     * @brief Constructor.
+     *
+     * @pre None.
+     * @post FreeSpaceMap is constructed with no pages. It is told about
+     *    writes to the pages attached to it.
+     */
+    FreeSpaceMap();
+
+    /**
+     * @brief Destructor. Detaches the pages still attached.
+     *
+     * @pre No attached page is being modified.
+     */
+    ~FreeSpaceMap();
+
+    /**
+     * @brief Attaches a pinned HeapPage to its PageNum, so that writes to
+     *    the page update the map.
+     *
+     * @pre page is pinned and is the HeapPage of page_num. page_num is not
+     *    INVALID_PAGE_NUM.
+     * @post The free space class of page_num is set to the current class
+     *    of page, and later writes to page update it. The map is the
+     *    listener of page.
+     *
+     * @param page_num PageNum of page.
+     * @param page HeapPage to attach.
+     */
+    void attach(PageNum page_num, HeapPage* page);
+
+    /**
+     * @brief Detaches a HeapPage before it is unpinned.
+     *
+     * @pre page was attached, and no writer is modifying it.
+     * @post Writes to page no longer update the map. The last free space
+     *    class of its PageNum is kept.
+     *
+     * @param page HeapPage to detach.
+     */
+    void detach(HeapPage* page);
+
+    /**
+     * @brief Sets the free space class of page_num to the current class of
+     *    page, for pages that are not attached.
+     *
+     * @pre page is pinned and is the HeapPage of page_num. page_num is not
+     *    INVALID_PAGE_NUM.
+     * @post The free space class of page_num is updated.
+     *
+     * @param page_num PageNum of page.
+     * @param page HeapPage to read the free space class of.
+     */
+    void update(PageNum page_num, HeapPage* page);
+
+    /**
+     * @brief Removes a page from the map, for example when it is
+     *    deallocated.
+     *
+     * @pre None.
+     * @post The free space class of page_num is 0, so findPage does not
+     *    return it.
+     *
+     * @param page_num PageNum to remove.
+     */
+    void remove(PageNum page_num);
+
+    /**
+     * @brief Getter for the free space class of page_num.
+     *
+     * @pre None.
+     * @post None.
+     *
+     * @param page_num PageNum to look up.
+     * @return Last known free space class of page_num, 0 if it is unknown.
+     */
+    std::uint8_t getFreeSpaceClass(PageNum page_num);
+
+    /**
+     * @brief Finds a page with room for a record of num_bytes bytes.
+     *
+     * @pre None.
+     * @post None.
+     *
+     * @param num_bytes Size of the record to insert.
+     * @return PageNum of the first page whose free space class guarantees
+     *    num_bytes of free space, or INVALID_PAGE_NUM if there is none.
+     */
+    PageNum findPage(std::uint32_t num_bytes);
+
+    /**
+     * @brief Updates the free space class of an attached page. Called by
+     *    HeapPage writers; pages that are not attached are ignored.
+     *
+     * @param page HeapPage that was modified.
+     * @param free_space_class New free space class of page.
+     */
+    void freeSpaceChanged(HeapPage* page,
+        std::uint8_t free_space_class) override;
+
+  private:
+
+    /**
+     * @brief Sets the free space class of page_num and the maximum of its
+     *    group.
+     *
+     * @pre latch is held.
+     */
+    void _setClass(PageNum page_num, std::uint8_t free_space_class);
+
+    /**
+     * Protects the data members, since pages of a file are written by
+     * several threads.
+     */
+    std::mutex latch;
+
+    /**
+     * Free space class of every PageNum, indexed by PageNum.
+     */
+    std::vector<std::uint8_t> classes;
+
+    /**
+     * Maximum free space class of every group of FREE_SPACE_MAP_GROUP
+     * pages, indexed by PageNum / FREE_SPACE_MAP_GROUP.
+     */
+    std::vector<std::uint8_t> group_max;
+
+    /**
+     * PageNum of every attached HeapPage.
+     */
+    std::unordered_map<HeapPage*, PageNum> attached;
+};
+
+#endif
@@ -0,0 +1,163 @@
+#include <stdexcept>
+
+#include "heapfilescanner.h"
+#include "heappage.h"
+#include "heappagescanner.h"
+
+/**
+ * @brief Constructor.
+ *
+ * @pre source gives access to a file whose pages are linked through
+ *    next_page starting at first_page. window_size is at least 1.
+ * @post The scanner is before the first record of first_page. The
+ *    first pages of the window are pinned and the next one is
+ *    prefetched.
+ *
+ * @param source HeapPageSource of the file.
+ * @param first_page PageNum of the first page, or INVALID_PAGE_NUM for
+ *    an empty file.
+ * @param window_size Number of pages to keep pinned.
+ * @param predicate If not NULL, pages whose synopsis rules out
+ *    *predicate are skipped (see HeapPageScanner::resetFiltered).
+ *    Must outlive the scanner.
+ *
+ * @throw std::invalid_argument If window_size is 0.
+ */
+HeapFileScanner::HeapFileScanner(HeapPageSource* source, PageNum first_page,
+    std::uint32_t window_size, const SynopsisPredicate* predicate)
+  : page_scanner(nullptr){
+  if (window_size == 0){
+    throw std::invalid_argument("HeapFileScanner: window size of 0");
+  }
+  this->source = source;
+  this->window_size = window_size;
+  this->predicate = predicate;
+  this->next_unpinned = INVALID_PAGE_NUM;
+  this->reset(first_page);
+}
+
+/**
+ * @brief Destructor. Unpins the pages of the window.
+ */
+HeapFileScanner::~HeapFileScanner(){
+  this->_releaseWindow();
+}
+
+/**
+ * @brief Returns SlotId of the next valid slot of the file.
+ *
+ * @pre None.
+ * @post If a slot is returned, page_num is set to its page, which stays
+ *    pinned until the next call. Pages that were finished are unpinned
+ *    and the window is moved forward.
+ *
+ * @param page_num Set to the PageNum of the returned slot.
+ * @return Next valid SlotId. INVALID_SLOT_ID if the end of the file is
+ *    reached; page_num is not modified then.
+ */
+SlotId HeapFileScanner::getNext(PageNum* page_num){
+  while (!this->window.empty()){
+    SlotId slot_id = this->page_scanner.getNext();
+    if (slot_id != INVALID_SLOT_ID){
+      *page_num = this->window.front().page_num;
+      return slot_id;
+    }
+    this->_advance();
+  }
+  return INVALID_SLOT_ID;
+}
+
+/**
+ * @brief Getter for the page of the last returned slot.
+ *
+ * @pre getNext returned a valid slot since the last reset.
+ * @return The pinned HeapPage being scanned, or NULL at the end of the
+ *    file.
+ */
+HeapPage* HeapFileScanner::getCurrentPage(){
+  if (this->window.empty()){
+    return nullptr;
+  }
+  return this->window.front().page;
+}
+
+/**
+ * @brief Unpins the pages of the window and restarts the scan.
+ *
+ * @pre Same as the constructor.
+ * @post Same as the constructor.
+ *
+ * @param first_page PageNum of the first page, or INVALID_PAGE_NUM.
+ */
+void HeapFileScanner::reset(PageNum first_page){
+  this->_releaseWindow();
+  this->next_unpinned = first_page;
+  this->_fillWindow();
+  this->_startPage();
+}
+
+/**
+ * @brief Pins pages following the chain until the window is full or the
+ *    chain ends, then prefetches the page after the window.
+ */
+void HeapFileScanner::_fillWindow(){
+  bool pinned = false;
+
+  while (this->window.size() < this->window_size &&
+      this->next_unpinned != INVALID_PAGE_NUM){
+    WindowPage entry;
+    entry.page_num = this->next_unpinned;
+    entry.page = this->source->pinPage(entry.page_num);
+    this->window.push_back(entry);
+    this->next_unpinned = entry.page->getNext();
+    pinned = true;
+  }
+
+  //the page after the window is only known once its predecessor is
+  //pinned, so it is prefetched once per page added
+  if (pinned && this->next_unpinned != INVALID_PAGE_NUM){
+    this->source->prefetchPage(this->next_unpinned);
+  }
+}
+
+/**
+ * @brief Unpins the page being scanned, refills the window and points
+ *    page_scanner at the next page that is not ruled out.
+ */
+void HeapFileScanner::_advance(){
+  this->source->unpinPage(this->window.front().page_num);
+  this->window.pop_front();
+  this->_fillWindow();
+  this->_startPage();
+}
+
+/**
+ * @brief Points page_scanner at the first page of the window that is not
+ *    ruled out, unpinning the pages that are.
+ */
+void HeapFileScanner::_startPage(){
+  while (!this->window.empty()){
+    HeapPage* page = this->window.front().page;
+    if (this->predicate == nullptr){
+      this->page_scanner.reset(page);
+      return;
+    }
+    if (this->page_scanner.resetFiltered(page, *this->predicate)){
+      return;
+    }
+    this->source->unpinPage(this->window.front().page_num);
+    this->window.pop_front();
+    this->_fillWindow();
+  }
+}
+
+/**
+ * @brief Unpins every page of the window.
+ */
+void HeapFileScanner::_releaseWindow(){
+  while (!this->window.empty()){
+    this->source->unpinPage(this->window.front().page_num);
+    this->window.pop_front();
+  }
+  this->next_unpinned = INVALID_PAGE_NUM;
+}
@@ -0,0 +1,213 @@
+#ifndef  _SWATDB_HEAPFILESCANNER_H_
+#define  _SWATDB_HEAPFILESCANNER_H_
+
+
+/**
+ * \file
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include "swatdb_types.h"
+#include "heappage.h"
+#include "heappagescanner.h"
+
+/**
+ * Default number of pages HeapFileScanner keeps pinned ahead of the scan.
+ */
+const std::uint32_t HEAP_FILE_SCAN_WINDOW = 4;
+
+/**
+ * Interface HeapFileScanner gets the pages of a file through. It is
+ * implemented on top of the buffer manager of the file: pinPage and
+ * unpinPage pin and unpin a page in the buffer pool, and prefetchPage
+ * starts reading a page into the buffer pool without waiting for it.
+ */
+class HeapPageSource {
+
+  public:
+
+    /**
+     * @brief Destructor.
+     */
+    virtual ~HeapPageSource() {}
+
+    /**
+     * @brief Pins a page, reading it in if it is not in the buffer pool.
+     *
+     * @pre page_num is a page of the file.
+     * @post The page is pinned until unpinPage is called for it.
+     *
+     * @param page_num PageNum of the page to pin.
+     * @return The pinned page.
+     */
+    virtual HeapPage* pinPage(PageNum page_num) = 0;
+
+    /**
+     * @brief Unpins a page pinned by pinPage.
+     *
+     * @pre page_num is pinned by pinPage.
+     * @post The pin taken by pinPage is released.
+     *
+     * @param page_num PageNum of the page to unpin.
+     */
+    virtual void unpinPage(PageNum page_num) = 0;
+
+    /**
+     * @brief Starts reading a page in the background, so that a later
+     *    pinPage of it does not wait for I/O. Does nothing by default.
+     *
+     * @pre page_num is a page of the file.
+     * @post None. The page is not pinned.
+     *
+     * @param page_num PageNum of the page to read ahead.
+     */
+    virtual void prefetchPage(PageNum page_num) { (void) page_num; }
+};
+
+/**
+ * Scanner class for scanning every record of a heap file, following the
+ * next_page links of its HeapPages.
+ *
+ * The scanner keeps a window of up to window_size pinned pages: the page
+ * being scanned and the pages after it in the chain. Whenever the page
+ * being scanned is finished, it is unpinned, the next page of the chain
+ * past the window is pinned, and the page after that is prefetched. A page
+ * is prefetched window_size pages before it is scanned, so its read
+ * overlaps with the scanning of the pages in between.
+ */
+class HeapFileScanner {
+
+  public:
+
+    /**
+     * @brief Constructor.
+     *
+     * @pre source gives access to a file whose pages are linked through
+     *    next_page starting at first_page. window_size is at least 1.
+     * @post The scanner is before the first record of first_page. The
+     *    first pages of the window are pinned and the next one is
+     *    prefetched.
+     *
+     * @param source HeapPageSource of the file.
+     * @param first_page PageNum of the first page, or INVALID_PAGE_NUM for
+     *    an empty file.
+     * @param window_size Number of pages to keep pinned.
+     * @param predicate If not NULL, pages whose synopsis rules out
+     *    *predicate are skipped (see HeapPageScanner::resetFiltered).
+     *    Must outlive the scanner.
+     *
+     * @throw std::invalid_argument If window_size is 0.
+     */
+    HeapFileScanner(HeapPageSource* source, PageNum first_page,
+        std::uint32_t window_size = HEAP_FILE_SCAN_WINDOW,
+        const SynopsisPredicate* predicate = nullptr);
+
+    /**
+     * @brief Destructor. Unpins the pages of the window.
+     */
+    ~HeapFileScanner();
+
+    HeapFileScanner(const HeapFileScanner&) = delete;
+    HeapFileScanner& operator=(const HeapFileScanner&) = delete;
+
+    /**
+     * @brief Returns SlotId of the next valid slot of the file.
+     *
+     * @pre None.
+     * @post If a slot is returned, page_num is set to its page, which stays
+     *    pinned until the next call. Pages that were finished are unpinned
+     *    and the window is moved forward.
+     *
+     * @param page_num Set to the PageNum of the returned slot.
+     * @return Next valid SlotId. INVALID_SLOT_ID if the end of the file is
+     *    reached; page_num is not modified then.
+     */
+    SlotId getNext(PageNum* page_num);
+
+    /**
+     * @brief Getter for the page of the last returned slot.
+     *
+     * @pre getNext returned a valid slot since the last reset.
+     * @return The pinned HeapPage being scanned, or NULL at the end of the
+     *    file.
+     */
+    HeapPage* getCurrentPage();
+
+    /**
+     * @brief Unpins the pages of the window and restarts the scan.
+     *
+     * @pre Same as the constructor.
+     * @post Same as the constructor.
+     *
+     * @param first_page PageNum of the first page, or INVALID_PAGE_NUM.
+     */
+    void reset(PageNum first_page);
+
+  private:
+
+    /**
+     * A pinned page of the window.
+     */
+    struct WindowPage{
+      PageNum page_num;
+      HeapPage* page;
+    };
+
+    /**
+     * @brief Pins pages following the chain until the window is full or
+     *    the chain ends, then prefetches the page after the window.
+     */
+    void _fillWindow();
+
+    /**
+     * @brief Unpins the page being scanned, refills the window and points
+     *    page_scanner at the next page that is not ruled out.
+     */
+    void _advance();
+
+    /**
+     * @brief Points page_scanner at the first page of the window that is
+     *    not ruled out, unpinning the pages that are.
+     */
+    void _startPage();
+
+    /**
+     * @brief Unpins every page of the window.
+     */
+    void _releaseWindow();
+
+    /**
+     * Source of the pages of the file.
+     */
+    HeapPageSource* source;
+
+    /**
+     * Number of pages to keep pinned.
+     */
+    std::uint32_t window_size;
+
+    /**
+     * Predicate pages are filtered with, or NULL.
+     */
+    const SynopsisPredicate* predicate;
+
+    /**
+     * Pinned pages, the one being scanned first.
+     */
+    std::deque<WindowPage> window;
+
+    /**
+     * PageNum of the page after the last page of the window, or
+     * INVALID_PAGE_NUM if the window reaches the end of the chain.
+     */
+    PageNum next_unpinned;
+
+    /**
+     * Scanner of the first page of the window.
+     */
+    HeapPageScanner page_scanner;
+};
+
+#endif
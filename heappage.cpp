@@ -1,5 +1,12 @@
 #include <iostream>
 #include <cstring>
+#include <algorithm>
+#include <vector>
+#include <stdexcept>
+#include <atomic>
+#include <string>
+#include <mutex>
+#include <unordered_map>
 
 #include "swatdb_exceptions.h"
 #include "heappage.h"
@@ -7,6 +14,200 @@
 #include "file.h"
 #include "data.h"
 #include "record.h"
+#include "recordcodec.h"
+#include "heappagestats.h"
+#include "crc32c.h"
+#include "recordarena.h"
+
+/*
+ * Every public method validates the SlotIds it is passed once, so the
+ * private helpers trust theirs. Build with -DHEAPPAGE_CHECK_INTERNAL to
+ * make the helpers validate them again while debugging.
+ */
+#ifdef HEAPPAGE_CHECK_INTERNAL
+#define HEAPPAGE_INTERNAL_CHECK_SLOT(slot_id) _checkSlotId(slot_id)
+#define HEAPPAGE_INTERNAL_CHECK_VALID_SLOT(slot_id) _checkValidSlotId(slot_id)
+#else
+#define HEAPPAGE_INTERNAL_CHECK_SLOT(slot_id) ((void) 0)
+#define HEAPPAGE_INTERNAL_CHECK_VALID_SLOT(slot_id) ((void) 0)
+#endif
+
+/*
+ * Throws InvalidSlotIdHeapPage. Kept out of line so the hot paths that
+ * validate SlotIds do not carry the exception setup code.
+ */
+[[noreturn]] __attribute__((noinline, cold))
+static void throwInvalidSlotId(SlotId slot_id){
+  throw InvalidSlotIdHeapPage(slot_id);
+}
+
+/*
+ * Throws std::runtime_error for a Page whose slots or records make no
+ * sense although no writer changed it during the read.
+ */
+[[noreturn]] __attribute__((noinline, cold))
+static void throwCorruptPage(SlotId slot_id){
+  throw std::runtime_error("HeapPage is corrupt at slot "
+      + std::to_string(slot_id));
+}
+
+/*
+ * Tells the CPU it is spinning on the version word of a latched Page.
+ */
+static inline void cpuRelax(){
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#endif
+}
+
+FreeSpaceListener* HeapPage::free_space_listener = nullptr;
+
+/*
+ * Listeners of single pages (see HeapPage::setFreeSpaceListener), spread
+ * over shards so that writers of different pages rarely share a mutex.
+ */
+static const std::uint32_t LISTENER_SHARDS = 64;
+
+struct FreeSpaceListenerShard{
+  std::mutex latch;
+  std::unordered_map<HeapPage*, FreeSpaceListener*> listeners;
+};
+
+static FreeSpaceListenerShard listener_shards[LISTENER_SHARDS];
+
+/*
+ * Number of pages with a listener of their own, so writes skip the shards
+ * while there are none.
+ */
+static std::atomic<std::uint32_t> num_page_listeners(0);
+
+static FreeSpaceListenerShard& listenerShard(HeapPage* page){
+  //pages are at least PAGE_SIZE bytes apart
+  return listener_shards[((std::uintptr_t) page / PAGE_SIZE)
+    % LISTENER_SHARDS];
+}
+
+HeapPageLogSink* HeapPage::log_sink = nullptr;
+
+/*
+ * Record being applied by HeapPage::redo on this thread, or NULL. The
+ * writers redo calls see it and only take its LSN instead of logging.
+ */
+static thread_local const HeapPageLogRecord* redo_record = nullptr;
+
+/*
+ * Write clock of HEAP_PAGE_MVCC Pages: timestamp of the latest write.
+ */
+static std::atomic<std::uint64_t> write_clock(0);
+
+/*
+ * Records on a compressed Page start with one of these bytes. A raw record
+ * is followed by its bytes; a compressed one by its length as 2 bytes,
+ * little endian, and the codec output.
+ */
+static const char STORED_RAW = 0;
+static const char STORED_COMPRESSED = 1;
+
+/*
+ * Number of bytes in front of the codec output of a compressed record.
+ */
+static const std::uint32_t COMPRESSED_HEADER = 3;
+
+/*
+ * Encodes a record of length bytes for a compressed Page into buffer, which
+ * holds PAGE_SIZE bytes. Returns the stored length. If that is more than
+ * PAGE_SIZE nothing is written, since the record cannot fit anyway.
+ */
+static std::uint32_t encodeStoredRecord(const char* record,
+    std::uint32_t length, char* buffer){
+  if (length <= UINT16_MAX){
+    std::uint32_t compressed = codecCompress(record, length,
+        buffer + COMPRESSED_HEADER, PAGE_SIZE - COMPRESSED_HEADER);
+    if (compressed != 0 && compressed + COMPRESSED_HEADER < length + 1){
+      buffer[0] = STORED_COMPRESSED;
+      buffer[1] = (char) (length & 0xFF);
+      buffer[2] = (char) (length >> 8);
+      return compressed + COMPRESSED_HEADER;
+    }
+  }
+  if (length + 1 <= PAGE_SIZE){
+    buffer[0] = STORED_RAW;
+    std::memcpy(buffer + 1, record, length);
+  }
+  return length + 1;
+}
+
+/*
+ * Returns the length of a record stored on a compressed Page as length
+ * bytes at stored, or UINT32_MAX if the stored bytes are malformed.
+ */
+static std::uint32_t decodedLength(const char* stored, std::uint32_t length){
+  if (length >= 1 && stored[0] == STORED_RAW){
+    return length - 1;
+  }
+  if (length > COMPRESSED_HEADER && stored[0] == STORED_COMPRESSED){
+    return (unsigned char) stored[1]
+      | ((std::uint32_t) (unsigned char) stored[2] << 8);
+  }
+  return UINT32_MAX;
+}
+
+/*
+ * Decodes a record stored on a compressed Page into dst, which holds
+ * decodedLength() bytes. Returns false if the stored bytes are malformed.
+ */
+static bool decodeStoredRecord(const char* stored, std::uint32_t length,
+    char* dst, std::uint32_t dst_length){
+  if (stored[0] == STORED_RAW){
+    std::memcpy(dst, stored + 1, dst_length);
+    return true;
+  }
+  return codecDecompress(stored + COMPRESSED_HEADER,
+      length - COMPRESSED_HEADER, dst, dst_length);
+}
+
+/*
+ * Returns the number of bytes of the optional regions that the header
+ * flags put between the header and the slot directory.
+ */
+static inline std::uint32_t extensionSize(std::uint16_t flags){
+  std::uint32_t size = 0;
+  if (flags & HEAP_PAGE_SYNOPSIS){
+    size += sizeof(PageSynopsis);
+  }
+  if (flags & HEAP_PAGE_CHECKSUM){
+    size += sizeof(PageChecksum);
+  }
+  if (flags & HEAP_PAGE_LSN){
+    size += sizeof(PageLsn);
+  }
+  return size;
+}
+
+/*
+ * Copies the first key_length bytes of a record of the given length into
+ * key, which holds SYNOPSIS_KEY_BYTES bytes, and zero pads the rest.
+ */
+static inline void synopsisKey(const char* record, std::uint32_t length,
+    std::uint32_t key_length, unsigned char* key){
+  std::memset(key, 0, SYNOPSIS_KEY_BYTES);
+  std::memcpy(key, record, length < key_length ? length : key_length);
+}
+
+/*
+ * Returns the bloom filter bit number i of a synopsis key, from one 64 bit
+ * FNV-1a hash split into two (double hashing).
+ */
+static inline std::uint32_t synopsisBloomBit(const unsigned char* key,
+    std::uint32_t i){
+  std::uint64_t hash = 14695981039346656037ULL;
+  for (std::uint32_t b = 0; b < SYNOPSIS_KEY_BYTES; b++){
+    hash = (hash ^ key[b]) * 1099511628211ULL;
+  }
+  std::uint32_t h1 = (std::uint32_t) hash;
+  std::uint32_t h2 = (std::uint32_t) (hash >> 32) | 1;
+  return (h1 + i * h2) % SYNOPSIS_BLOOM_BITS;
+}
 
 /**
  * @brief Initializes header information after the Page is allocated.
@@ -18,15 +219,59 @@
  *    and capacity are set to 0.
  */
 void HeapPage::initializeHeader(){
+  this->initializeHeader(0);
+}
+
+/**
+ * @brief Initializes header information with the given flags.
+ *
+ * @pre flags is a combination of HEAP_PAGE_DEFERRED_COMPACTION,
+ *    HEAP_PAGE_COMPRESSION, HEAP_PAGE_COMPACT_SLOTS, HEAP_PAGE_SYNOPSIS,
+ *    HEAP_PAGE_CHECKSUM, HEAP_PAGE_LSN and HEAP_PAGE_MVCC.
+ * @post Same as initializeHeader(), and the header flags are set to flags.
+ *    HEAP_PAGE_COMPACT_SLOTS, HEAP_PAGE_SYNOPSIS, HEAP_PAGE_CHECKSUM,
+ *    HEAP_PAGE_LSN and HEAP_PAGE_MVCC can only be chosen here. With
+ *    HEAP_PAGE_SYNOPSIS free_space_begin is past the PageSynopsis, whose
+ *    key length is SYNOPSIS_KEY_BYTES. With HEAP_PAGE_CHECKSUM it is past
+ *    the PageChecksum, which matches the new Page, and with HEAP_PAGE_LSN
+ *    past the PageLsn.
+ *
+ * @param flags HeapPageHeader::flags of the new Page.
+ *
+ * @throw std::invalid_argument If flags has both HEAP_PAGE_MVCC and
+ *    HEAP_PAGE_COMPRESSION.
+ */
+void HeapPage::initializeHeader(std::uint16_t flags){
   struct HeapPageHeader *tmp = this->_getPageHeader(); 
 
+  if ((flags & HEAP_PAGE_MVCC) && (flags & HEAP_PAGE_COMPRESSION)){
+    throw std::invalid_argument("HEAP_PAGE_MVCC pages cannot be compressed");
+  }
+
   tmp->prev_page = INVALID_PAGE_NUM;
   tmp->next_page = INVALID_PAGE_NUM;
-  tmp->free_space_begin = sizeof(HeapPageHeader);
+  tmp->free_space_begin = sizeof(HeapPageHeader) + extensionSize(flags);
   tmp->free_space_end = PAGE_SIZE;
   tmp->size = 0;
   tmp->capacity = 0;
-
+  tmp->fragmented_bytes = 0;
+  tmp->flags = flags;
+  tmp->free_slot_head = FREE_SLOT_LIST_END;
+  tmp->version = 0;
+
+  if (flags & HEAP_PAGE_SYNOPSIS){
+    std::memset(this->_getSynopsis(), 0, sizeof(PageSynopsis));
+    this->_getSynopsis()->key_length = SYNOPSIS_KEY_BYTES;
+  }
+  if (flags & HEAP_PAGE_LSN){
+    this->_getLsn()->lsn = 0;
+  }
+  _logChange(HEAP_PAGE_LOG_INIT, INVALID_SLOT_ID, 0, flags, nullptr, 0);
+  //last, so the checksum covers the LSN
+  if (flags & HEAP_PAGE_CHECKSUM){
+    this->_getChecksum()->reserved = 0;
+    this->_getChecksum()->crc = _computeChecksum();
+  }
 }
 
 /**
@@ -38,10 +283,11 @@ void HeapPage::initializeHeader(){
  * @param page_num PageNum of the next Page.
  */
 void HeapPage::setNext(PageNum page_num){
+  WriteLatch latch(this);
   struct HeapPageHeader *tmp = this->_getPageHeader(); 
 
   tmp->next_page = page_num;
-
+  _logChange(HEAP_PAGE_LOG_SET_NEXT, INVALID_SLOT_ID, 0, page_num, nullptr, 0);
 }
 
 /**
@@ -53,11 +299,11 @@ void HeapPage::setNext(PageNum page_num){
  * @param page_num PageNum of the previous Page.
  */
 void HeapPage::setPrev(PageNum page_num){
-  
+  WriteLatch latch(this);
   struct HeapPageHeader *tmp = this->_getPageHeader(); 
 
   tmp->prev_page = page_num;
-
+  _logChange(HEAP_PAGE_LOG_SET_PREV, INVALID_SLOT_ID, 0, page_num, nullptr, 0);
 }
 
 /**
@@ -103,17 +349,19 @@ PageNum HeapPage::getPrev(){
  * @return Amount of free space in bytes on the Page that is
  *         available for storing record data.  Returns 0 if there
  *         is not enough space to allocate a new slot entry when
- *         there are no currently free slots.
+ *         there are no currently free slots.  Fragmented bytes left
+ *         by deferred compaction count as free space.
  */
 std::uint32_t HeapPage::getFreeSpace(){
   //calculate the amount of free space
   struct HeapPageHeader *tmp = this->_getPageHeader();
-  std::uint32_t size = tmp->free_space_end - tmp->free_space_begin;
+  std::uint32_t size = tmp->free_space_end - tmp->free_space_begin
+    + tmp->fragmented_bytes;
   //if there is no available free slot
   if (tmp->size == tmp->capacity){
-    if (size >= sizeof(SlotInfo)){
+    if (size >= this->_getSlotSize()){
       //add a new slot to store another record
-      size -= sizeof(SlotInfo);
+      size -= this->_getSlotSize();
     }else{
       //if there is no available free slot and 
       //if there is not enough free space to add a new slot
@@ -182,41 +430,222 @@ bool HeapPage::isEmpty(){
  * @throw EmptyDataHeapPage. If the passed record data is size 0.
  */
 SlotId HeapPage::insertRecord(Data* record_data){
-  
-  std::uint32_t size_necessary = record_data->getSize();
+  return _insertBytes(record_data->getData(), record_data->getSize());
+}
+
+/**
+ * @brief Inserts record bytes. Body of insertRecord.
+ *
+ * @param record_bytes bytes of the record, not compressed.
+ * @param length number of bytes.
+ * @return SlotId of the inserted record.
+ */
+SlotId HeapPage::_insertBytes(const char* record_bytes, std::uint32_t length){
+  WriteLatch latch(this);
+  std::uint32_t size_necessary = length;
+  const char* record = record_bytes;
+  char encoded[PAGE_SIZE];
 
   //throw exceptions
   if( size_necessary == 0 ){
     throw EmptyDataHeapPage();
   }
+  std::uint16_t flags = this->_getPageHeader()->flags;
+  std::uint64_t timestamp = 0;
+  if( flags & HEAP_PAGE_MVCC ){
+    timestamp = _writeTimestamp();
+  }
+  if( flags & ( HEAP_PAGE_COMPRESSION | HEAP_PAGE_MVCC ) ){
+    size_necessary = _encodeRecord( record, size_necessary, encoded,
+        timestamp );
+    record = encoded;
+  }
   if( getFreeSpace() < size_necessary ){
+    HEAPPAGE_STAT( HEAP_PAGE_STAT_INSUFFICIENT_SPACE, 1 );
     throw InsufficientSpaceHeapPage();
   }
 
+  _addSynopsisKey( record_bytes, length );
+  SlotId slot_id = _insertStored( record, size_necessary );
+  _logChange( HEAP_PAGE_LOG_INSERT, slot_id, _getSlotOffset( slot_id ), 0,
+      record_bytes, length, timestamp );
+  return slot_id;
+}
+
+/**
+ * @brief Stores record bytes in a free slot, or in a new slot if there is
+ *    none, compacting first if the contiguous free space is short.
+ *
+ * @pre getFreeSpace() is at least length.
+ * @post The record is stored and the slot directory is grown if needed.
+ *
+ * @param record bytes to store.
+ * @param length number of bytes to store.
+ * @return SlotId of the stored record.
+ */
+SlotId HeapPage::_insertStored(const char* record, std::uint32_t length){
+  std::uint32_t size_necessary = length;
   struct HeapPageHeader *page_header = this->_getPageHeader(); 
-  SlotId free_slot_id = INVALID_SLOT_OFFSET;
 
   //find a place for insert
-  for( SlotId i = 0; i < page_header->capacity; i++ ){
-    SlotInfo *s = this->_getSlotInfo(i);
-    if( s->offset == INVALID_SLOT_OFFSET ){
-      free_slot_id = i;
-      break;
-    }
+  SlotId free_slot_id = _popFreeSlot();
+
+  //reclaim fragmented bytes if the contiguous free space is too small
+  std::uint32_t contiguous_necessary = size_necessary;
+  if( free_slot_id == INVALID_SLOT_ID ){
+    contiguous_necessary += _getSlotSize();
+  }
+  if( _getContiguousSpace() < contiguous_necessary ){
+    _compact();
   }
 
-  if( free_slot_id == INVALID_SLOT_OFFSET ){
+  if( free_slot_id == INVALID_SLOT_ID ){
     free_slot_id = page_header->capacity;
     page_header->capacity++;
-    page_header->free_space_begin += sizeof( SlotInfo );
+    page_header->free_space_begin += _getSlotSize();
+    HEAPPAGE_STAT( HEAP_PAGE_STAT_INSERT_SLOT_APPENDED, 1 );
+  } else {
+    HEAPPAGE_STAT( HEAP_PAGE_STAT_INSERT_SLOT_REUSED, 1 );
   }
 
   //insert the record into slots in its slot directory
-  _insertRecord( free_slot_id, record_data );
+  _insertRecord( free_slot_id, record, length );
 
   return free_slot_id;
 }
 
+/**
+ * @brief Inserts as many of the given records as fit on the Page, in order,
+ *    in a single pass.
+ *
+ * The free space is checked once for the whole batch, the slot directory
+ * grows at most once, and the records are copied into one contiguous
+ * region. The Page ends up in the same state as after calling insertRecord
+ * on each accepted record in turn.
+ *
+ * @pre records and slot_ids hold at least num_records entries.
+ * @post The first n records (n is the return value) are inserted, and
+ *    slot_ids[i] is the SlotId of records[i] for i < n. Records from index
+ *    n on did not fit and were not inserted.
+ *
+ * @param records array of pointers to the Data of the records.
+ * @param num_records number of records in the array.
+ * @param slot_ids array to fill in with the SlotIds of inserted records.
+ *
+ * @return Number of records inserted. 0 if the first record does not fit.
+ *
+ * @throw EmptyDataHeapPage If any of the records is size 0. No record is
+ *    inserted in that case.
+ */
+std::uint32_t HeapPage::insertRecords(Data** records,
+    std::uint32_t num_records, SlotId* slot_ids){
+  WriteLatch latch(this);
+
+  //throw exceptions
+  for( std::uint32_t i = 0; i < num_records; i++ ){
+    if( records[i]->getSize() == 0 ){
+      throw EmptyDataHeapPage();
+    }
+  }
+
+  //compressed and versioned records are only known after encoding, so
+  //store them one at a time
+  std::uint16_t flags = this->_getPageHeader()->flags;
+  if( flags & ( HEAP_PAGE_COMPRESSION | HEAP_PAGE_MVCC ) ){
+    char encoded[PAGE_SIZE];
+    std::uint64_t timestamp = 0;
+    if( flags & HEAP_PAGE_MVCC ){
+      timestamp = _writeTimestamp();
+    }
+    std::uint32_t accepted = 0;
+    for( ; accepted < num_records; accepted++ ){
+      std::uint32_t length = _encodeRecord( records[accepted]->getData(),
+          records[accepted]->getSize(), encoded, timestamp );
+      if( getFreeSpace() < length ){
+        break;
+      }
+      _addSynopsisKey( records[accepted]->getData(),
+          records[accepted]->getSize() );
+      slot_ids[accepted] = _insertStored( encoded, length );
+      _logChange( HEAP_PAGE_LOG_INSERT, slot_ids[accepted],
+          _getSlotOffset( slot_ids[accepted] ), 0,
+          records[accepted]->getData(), records[accepted]->getSize(),
+          timestamp );
+    }
+    return accepted;
+  }
+
+  //find how many records fit, reusing free slots before growing the
+  //slot directory like insertRecord does
+  HeapPageHeader* page_header = this->_getPageHeader();
+  std::uint32_t available = _getContiguousSpace()
+    + page_header->fragmented_bytes;
+  std::uint32_t free_slots = page_header->capacity - page_header->size;
+  std::uint32_t slot_size = _getSlotSize();
+  std::uint32_t new_slots = 0;
+  std::uint32_t record_bytes = 0;
+  std::uint32_t used = 0;
+  std::uint32_t accepted = 0;
+
+  for( ; accepted < num_records; accepted++ ){
+    std::uint32_t record_length = records[accepted]->getSize();
+    std::uint32_t slot_bytes = ( free_slots == 0 ) ? slot_size : 0;
+    if( used + record_length + slot_bytes > available ){
+      break;
+    }
+    used += record_length + slot_bytes;
+    record_bytes += record_length;
+    if( free_slots == 0 ){
+      new_slots++;
+    } else {
+      free_slots--;
+    }
+  }
+  if( accepted == 0 ){
+    return 0;
+  }
+
+  //logged, since inserting the records one at a time would compact later
+  if( _getContiguousSpace() < used ){
+    _compact();
+    _logChange( HEAP_PAGE_LOG_COMPACT, INVALID_SLOT_ID, 0, 0, nullptr, 0 );
+  }
+
+  //grow the slot directory once
+  SlotId next_new_slot = page_header->capacity;
+  page_header->capacity += new_slots;
+  page_header->free_space_begin += new_slots*slot_size;
+  HEAPPAGE_STAT( HEAP_PAGE_STAT_INSERT_SLOT_APPENDED, new_slots );
+  HEAPPAGE_STAT( HEAP_PAGE_STAT_INSERT_SLOT_REUSED, accepted - new_slots );
+
+  //copy the records into one region, first record at the highest offset
+  std::uint32_t record_offset = page_header->free_space_end;
+  for( std::uint32_t i = 0; i < accepted; i++ ){
+    std::uint32_t record_length = records[i]->getSize();
+    record_offset -= record_length;
+    std::memcpy( this->data + record_offset, records[i]->getData(),
+        record_length );
+    _addSynopsisKey( records[i]->getData(), record_length );
+
+    SlotId slot_id = _popFreeSlot();
+    if( slot_id == INVALID_SLOT_ID ){
+      slot_id = next_new_slot++;
+    }
+    _setSlotOffset( slot_id, record_offset );
+    _setSlotLength( slot_id, record_length );
+    slot_ids[i] = slot_id;
+  }
+  page_header->free_space_end = record_offset;
+  page_header->size += accepted;
+
+  for( std::uint32_t i = 0; i < accepted; i++ ){
+    _logChange( HEAP_PAGE_LOG_INSERT, slot_ids[i],
+        _getSlotOffset( slot_ids[i] ), 0, records[i]->getData(),
+        records[i]->getSize() );
+  }
+  return accepted;
+}
+
 /**
  * @brief Gets the record identified by SlotId
  *
@@ -226,7 +655,8 @@ SlotId HeapPage::insertRecord(Data* record_data){
  * @post The data field of record_data contains a copy of the
  *     requsted record data stored in the Page, and the size
  *     the size of Data object is set to the number of bytes of the
- *     record.
+ *     record. The copy is retried until no writer modified the Page while
+ *     it was made.
  *
  * @param slot_id SlotId of the Record to be retrieved
  *
@@ -234,24 +664,448 @@ SlotId HeapPage::insertRecord(Data* record_data){
  *        SlotInfo of the given SlotId has INVALID_SLOT_OFFSET.
  * @throw InvalidSizeData if the size of the record_data is not
  *        large enough (thrown by Data class)
+ * @throw std::runtime_error If the slot points outside the Page or the
+ *        record cannot be decoded while no writer changes the Page.
  */
 void HeapPage::getRecord(SlotId slot_id, Data* record_data){
-  struct HeapPageHeader *tmp = this->_getPageHeader(); 
-  //throw the exceptions
-  if (slot_id >= tmp->capacity){
-    throw InvalidSlotIdHeapPage(slot_id);
+  HeapPageHeader* header = this->_getPageHeader();
+
+  // read without the latch, retrying if a writer changed the page meanwhile
+  while (true){
+    std::uint16_t version = readBegin();
+    if (slot_id >= header->capacity ||
+        _getSlotOffset(slot_id) == INVALID_SLOT_OFFSET){
+      //throw the exceptions
+      if (readValidate(version)){
+        throwInvalidSlotId(slot_id);
+      }
+      continue;
+    }
+    std::uint32_t offset = _getSlotOffset(slot_id);
+    std::uint32_t length = _getSlotLength(slot_id);
+    // a torn read of the slot can point outside the page; if no writer
+    // ran, the Page itself is bad and retrying would spin forever
+    if (offset > PAGE_SIZE || length > PAGE_SIZE - offset){
+      if (readValidate(version)){
+        throwCorruptPage(slot_id);
+      }
+      continue;
+    }
+    //only the current version of a record that was not deleted is read
+    if (header->flags & HEAP_PAGE_MVCC){
+      RecordVersion current;
+      if (length < sizeof(current)){
+        if (readValidate(version)){
+          throwCorruptPage(slot_id);
+        }
+        continue;
+      }
+      std::memcpy(&current, this->data + offset, sizeof(current));
+      if ((current.flags & RECORD_VERSION_OLD) ||
+          current.xmax != MVCC_TIMESTAMP_INFINITY){
+        if (readValidate(version)){
+          throwInvalidSlotId(slot_id);
+        }
+        continue;
+      }
+      offset += sizeof(current);
+      length -= sizeof(current);
+    }
+    bool compressed = (header->flags & HEAP_PAGE_COMPRESSION) != 0;
+    std::uint32_t record_length = length;
+    if (compressed){
+      record_length = decodedLength(this->data + offset, length);
+      if (record_length == UINT32_MAX){
+        if (readValidate(version)){
+          throwCorruptPage(slot_id);
+        }
+        continue;
+      }
+    }
+    if (record_data->getCapacity() < record_length){
+      if (readValidate(version)){
+        throw InvalidSizeData();
+      }
+      continue;
+    }
+    //copy the data into record_data and store the size of the Data subject
+    if (compressed){
+      if (!decodeStoredRecord(this->data + offset, length,
+            record_data->getData(), record_length)){
+        if (readValidate(version)){
+          throwCorruptPage(slot_id);
+        }
+        continue;
+      }
+    } else {
+      std::copy((char*)this->data + offset, (char*)this->data + offset +
+          length, record_data->getData());
+    }
+    if (readValidate(version)){
+      record_data->setSize(record_length);
+      return;
+    }
+  }
+}
+
+/**
+ * @brief Gets the version of a record visible to a snapshot.
+ *
+ * @pre The Page has HEAP_PAGE_MVCC set, a valid Data with capacity that is
+ *    greater than maximum size of any record stored in the Page is passed,
+ *    and snapshot is not older than the horizon of the last prune.
+ * @post If a version of the record in slot_id is visible to snapshot,
+ *    record_data holds a copy of it. Like getRecord, the copy is retried
+ *    until no writer modified the Page while it was made; no latch is
+ *    taken.
+ *
+ * @param slot_id SlotId of the record, as returned by insertRecord.
+ * @param record_data Data to copy the version into.
+ * @param snapshot Snapshot to read as of, from takeSnapshot.
+ * @return false if no version of the record is visible to snapshot.
+ *
+ * @throw std::logic_error If the Page has no HEAP_PAGE_MVCC.
+ * @throw InvalidSizeData if the size of record_data is not large enough
+ * @throw std::runtime_error If the visible version's slot points outside
+ *        the Page while no writer changes the Page.
+ */
+bool HeapPage::getRecord(SlotId slot_id, Data* record_data,
+    std::uint64_t snapshot){
+  if (!(this->_getPageHeader()->flags & HEAP_PAGE_MVCC)){
+    throw std::logic_error("HeapPage keeps no record versions");
+  }
+
+  while (true){
+    std::uint16_t version = readBegin();
+    SlotId visible = _visibleVersion(slot_id, snapshot);
+    if (visible == INVALID_SLOT_ID){
+      if (readValidate(version)){
+        return false;
+      }
+      continue;
+    }
+    std::uint32_t offset = _getSlotOffset(visible);
+    std::uint32_t length = _getSlotLength(visible);
+    // a torn read of the slot can point outside the page
+    if (offset > PAGE_SIZE || length > PAGE_SIZE - offset ||
+        length < sizeof(RecordVersion)){
+      if (readValidate(version)){
+        throwCorruptPage(visible);
+      }
+      continue;
+    }
+    offset += sizeof(RecordVersion);
+    length -= sizeof(RecordVersion);
+    if (record_data->getCapacity() < length){
+      if (readValidate(version)){
+        throw InvalidSizeData();
+      }
+      continue;
+    }
+    std::memcpy(record_data->getData(), this->data + offset, length);
+    if (readValidate(version)){
+      record_data->setSize(length);
+      return true;
+    }
+  }
+}
+
+/**
+ * @brief Copies a batch of records into an arena.
+ *
+ * Same as calling getRecord for each slot, but the copies go to one
+ * RecordArena instead of one Data per record, and the whole batch is read
+ * in one seqlock read: the copy is retried, after rewinding the arena,
+ * until no writer modified the Page while it was made.
+ *
+ * @pre The Page is pinned. slot_ids and records hold num_slots entries.
+ * @post records[i] points at a copy in arena of the record in slot_ids[i],
+ *    decompressed on a compressed Page, and stays valid until arena is
+ *    reset. If an exception is thrown the arena is back where it was
+ *    before the call.
+ *
+ * @param slot_ids SlotIds of the records to copy.
+ * @param num_slots Number of records.
+ * @param arena RecordArena to copy the records into.
+ * @param records Filled in with the copy of each record.
+ *
+ * @throw InvalidSlotIdHeapPage If any of slot_ids is out of range or has
+ *        INVALID_SLOT_OFFSET. On a HEAP_PAGE_MVCC Page, also if its record
+ *        was deleted.
+ * @throw std::runtime_error If a slot points outside the Page or a record
+ *        cannot be decoded while no writer changes the Page.
+ */
+void HeapPage::getRecords(const SlotId* slot_ids, std::uint32_t num_slots,
+    RecordArena* arena, RecordView* records){
+  HeapPageHeader* header = this->_getPageHeader();
+  RecordArena::Mark mark = arena->getMark();
+
+  // read without the latch, retrying the whole batch if a writer changed
+  // the page meanwhile
+  while (true){
+    arena->rewind(mark);
+    std::uint16_t version = readBegin();
+    std::uint16_t flags = header->flags;
+    bool torn = false;
+    SlotId torn_slot = INVALID_SLOT_ID;
+    for (std::uint32_t i = 0; i < num_slots; i++){
+      SlotId slot_id = slot_ids[i];
+      torn_slot = slot_id;
+      bool valid = slot_id < header->capacity &&
+        _getSlotOffset(slot_id) != INVALID_SLOT_OFFSET;
+      std::uint32_t offset = valid ? _getSlotOffset(slot_id) : 0;
+      std::uint32_t length = valid ? _getSlotLength(slot_id) : 0;
+      if (valid && (flags & HEAP_PAGE_MVCC)){
+        RecordVersion current;
+        // a torn read of the slot can point outside the page, or hold a
+        // free list index instead of a length
+        if (offset > PAGE_SIZE || length > PAGE_SIZE - offset ||
+            length < sizeof(current)){
+          torn = true;
+          break;
+        }
+        std::memcpy(&current, this->data + offset, sizeof(current));
+        valid = !(current.flags & RECORD_VERSION_OLD) &&
+          current.xmax == MVCC_TIMESTAMP_INFINITY;
+        offset += sizeof(current);
+        length -= sizeof(current);
+      }
+      if (!valid){
+        arena->rewind(mark);
+        if (readValidate(version)){
+          throwInvalidSlotId(slot_id);
+        }
+        torn = true;
+        break;
+      }
+      // a torn read of the slot can point outside the page
+      if (offset > PAGE_SIZE || length > PAGE_SIZE - offset){
+        torn = true;
+        break;
+      }
+
+      std::uint32_t record_length = length;
+      if (flags & HEAP_PAGE_COMPRESSION){
+        record_length = decodedLength(this->data + offset, length);
+        if (record_length == UINT32_MAX){
+          torn = true;
+          break;
+        }
+      }
+      char* copy = arena->allocate(record_length);
+      if (flags & HEAP_PAGE_COMPRESSION){
+        if (!decodeStoredRecord(this->data + offset, length, copy,
+              record_length)){
+          torn = true;
+          break;
+        }
+      } else {
+        std::memcpy(copy, this->data + offset, length);
+      }
+      records[i].data = copy;
+      records[i].length = record_length;
+    }
+    if (!torn){
+      if (readValidate(version)){
+        return;
+      }
+      continue;
+    }
+    //a torn read of a Page no writer changed is a corrupt Page
+    if (readValidate(version)){
+      arena->rewind(mark);
+      throwCorruptPage(torn_slot);
+    }
+  }
+}
+
+/**
+ * @brief Takes a snapshot for reading HEAP_PAGE_MVCC Pages.
+ *
+ * @pre None.
+ * @post None.
+ *
+ * @return Timestamp of the latest write to any HeapPage, so the snapshot
+ *    sees exactly the writes that finished before the call.
+ */
+std::uint64_t HeapPage::takeSnapshot(){
+  //a write that has its timestamp but has not finished holds the latch of
+  //its Page, so readers of the Page wait for it
+  return write_clock.load(std::memory_order_acquire);
+}
+
+/**
+ * @brief Reclaims the versions no snapshot at or after horizon can see:
+ *    versions replaced or deleted at or before horizon.
+ *
+ * @pre No reader will use a snapshot older than horizon.
+ * @post The reclaimed versions are removed as by deleteRecords, so the
+ *    remaining records are compacted unless the Page is in deferred
+ *    compaction mode, and records whose current version was deleted lose
+ *    their slot. Does nothing if the Page has no HEAP_PAGE_MVCC.
+ *
+ * @param horizon Oldest snapshot still in use.
+ * @return Number of versions reclaimed.
+ */
+std::uint32_t HeapPage::prune(std::uint64_t horizon){
+  WriteLatch latch(this);
+  HeapPageHeader* header = _getPageHeader();
+
+  if (!(header->flags & HEAP_PAGE_MVCC)){
+    return 0;
+  }
+
+  std::vector<SlotId> dead;
+  for (SlotId i = 0; i < header->capacity; i++){
+    RecordVersion version;
+    if (!_readVersion(i, &version) || (version.flags & RECORD_VERSION_OLD)){
+      continue;
+    }
+    //versions get older along the chain, so once one is invisible to the
+    //horizon every older one is too
+    SlotId newer = INVALID_SLOT_ID;
+    SlotId cur = i;
+    while (cur != INVALID_SLOT_ID && version.xmax > horizon){
+      newer = cur;
+      cur = version.prev_slot;
+      if (cur == FREE_SLOT_LIST_END){
+        cur = INVALID_SLOT_ID;
+      } else {
+        _readVersion(cur, &version);
+      }
+    }
+    if (cur == INVALID_SLOT_ID){
+      continue;
+    }
+    if (newer != INVALID_SLOT_ID){
+      RecordVersion kept;
+      _readVersion(newer, &kept);
+      kept.prev_slot = FREE_SLOT_LIST_END;
+      _writeVersion(newer, kept);
+    }
+    while (cur != FREE_SLOT_LIST_END){
+      dead.push_back(cur);
+      _readVersion(cur, &version);
+      cur = version.prev_slot;
+    }
+  }
+
+  if (dead.empty()){
+    return 0;
+  }
+  _removeSlots(dead.data(), dead.size());
+  _logChange(HEAP_PAGE_LOG_PRUNE, INVALID_SLOT_ID, 0, 0, nullptr, 0, horizon);
+  return dead.size();
+}
+
+/**
+ * @brief Moves records from the end of the slot directory into its holes,
+ *    so the directory shrinks to exactly one slot per record. Records keep
+ *    their bytes; only their slot entries move.
+ *
+ * @pre The caller can renumber the records moved: no one uses their old
+ *    SlotIds after the call.
+ * @post Slots 0 to size - 1 are valid and capacity is size. On a
+ *    HEAP_PAGE_MVCC Page the prev_slot chains follow the move, and moves of
+ *    old versions are not reported, since their SlotIds are not known
+ *    outside the Page.
+ *
+ * @return The records that changed SlotId.
+ */
+std::vector<SlotMove> HeapPage::packSlotDirectory(){
+  WriteLatch latch(this);
+  HeapPageHeader* header = _getPageHeader();
+  std::vector<SlotMove> moves;
+
+  if (header->capacity == header->size){
+    return moves;
   }
-  SlotInfo* slot = this->_getSlotInfo(slot_id);
-  if (slot->offset == INVALID_SLOT_OFFSET){
-    throw InvalidSlotIdHeapPage(slot_id);
+
+  //fill the lowest hole with the highest record until they meet
+  bool versioned = (header->flags & HEAP_PAGE_MVCC) != 0;
+  SlotId hole = 0;
+  SlotId end = header->capacity;
+  while (true){
+    while (hole < end && _getSlotOffset(hole) != INVALID_SLOT_OFFSET){
+      hole++;
+    }
+    while (end > hole && _getSlotOffset(end - 1) == INVALID_SLOT_OFFSET){
+      end--;
+    }
+    if (hole >= end){
+      break;
+    }
+    SlotId from = end - 1;
+    _setSlotOffset(hole, _getSlotOffset(from));
+    _setSlotLength(hole, _getSlotLength(from));
+    _setSlotOffset(from, INVALID_SLOT_OFFSET);
+
+    RecordVersion version;
+    bool report = true;
+    if (versioned){
+      report = !_readVersion(hole, &version) ||
+        !(version.flags & RECORD_VERSION_OLD);
+      //an old version is pointed at by the version that replaced it
+      for (SlotId i = 0; !report && i < header->capacity; i++){
+        RecordVersion newer;
+        if (_readVersion(i, &newer) && newer.prev_slot == from){
+          newer.prev_slot = hole;
+          _writeVersion(i, newer);
+        }
+      }
+    }
+    if (report){
+      moves.push_back(SlotMove{from, hole});
+    }
+    end = from;
+  }
+
+  HEAPPAGE_STAT(HEAP_PAGE_STAT_DIRECTORY_SHRINKS, 1);
+  HEAPPAGE_STAT(HEAP_PAGE_STAT_DIRECTORY_SLOTS_REMOVED,
+      header->capacity - header->size);
+  header->free_space_begin -= (header->capacity - header->size)
+    * _getSlotSize();
+  header->capacity = header->size;
+  header->free_slot_head = FREE_SLOT_LIST_END;
+  _logChange(HEAP_PAGE_LOG_PACK_SLOTS, INVALID_SLOT_ID, 0, 0, nullptr, 0);
+  return moves;
+}
+
+/**
+ * @brief Gets a read-only view of the record identified by its SlotId,
+ *    without copying it.
+ *
+ * @pre A valid SlotId is provided as input. The Page is pinned.
+ * @post The returned view points at the record bytes in the Page. It stays
+ *    valid until the Page is modified or unpinned. Unlike getRecord, the
+ *    read is not validated against concurrent writers; callers sharing the
+ *    Page with writers bracket it and their reads of the view with
+ *    readBegin and readValidate.
+ *
+ * @param slot_id SlotId of the Record to be viewed.
+ * @return RecordView of the record.
+ *
+ * @throw InvalidSlotIdHeapPage If SlotId is out of range or
+ *        SlotInfo of the given SlotId has INVALID_SLOT_OFFSET. On a
+ *        HEAP_PAGE_MVCC Page, also if the record was deleted.
+ * @throw std::logic_error If the Page is compressed, since its records can
+ *        only be read through getRecord.
+ */
+RecordView HeapPage::getRecordView(SlotId slot_id){
+  this->_checkValidSlotId(slot_id);
+  if (this->isCompressed()){
+    throw std::logic_error("records of a compressed HeapPage have no view");
   }
-  if(record_data->getCapacity() < slot->length){
-    throw InvalidSizeData();
+
+  RecordView view;
+  view.data = this->data + this->_getSlotOffset(slot_id);
+  view.length = this->_getSlotLength(slot_id);
+  if (this->_getPageHeader()->flags & HEAP_PAGE_MVCC){
+    this->_checkLiveVersion(slot_id);
+    view.data += sizeof(RecordVersion);
+    view.length -= sizeof(RecordVersion);
   }
-  //copy the data into record_data and store the size of the Data subject
-  std::copy((char*)this->data + slot->offset, (char*)this->data + 
-  slot->offset + slot->length, record_data->getData());
-  record_data->setSize(slot->length);
+  return view;
 }
 
 /**
@@ -273,39 +1127,124 @@ void HeapPage::getRecord(SlotId slot_id, Data* record_data){
  *        range or SlotInfo of the given SlotId has INVALID_SLOT_OFFSET).
  */
 void HeapPage::deleteRecord(SlotId slot_id){
+  WriteLatch latch(this);
   // in scenario where the end of the slot is emptied, check whether the slots 
   // can be shrunk
-  HeapPageHeader* header = _getPageHeader();
-  SlotInfo* slot = _getSlotInfo(slot_id);
-
   //throw exceptions
-  if (slot->offset == INVALID_SLOT_OFFSET || slot_id >= header->capacity){
-    throw InvalidSlotIdHeapPage(slot_id); 
+  _checkValidSlotId(slot_id);
+  std::uint32_t offset = _getSlotOffset(slot_id);
+
+  //keep the version for older snapshots until prune
+  if (_getPageHeader()->flags & HEAP_PAGE_MVCC){
+    _checkLiveVersion(slot_id);
+    std::uint64_t timestamp = _writeTimestamp();
+    RecordVersion version;
+    _readVersion(slot_id, &version);
+    version.xmax = timestamp;
+    _writeVersion(slot_id, version);
+    _logChange(HEAP_PAGE_LOG_DELETE, slot_id, offset, 0, nullptr, 0,
+        timestamp);
+    return;
   }
 
   _deleteRecord(slot_id);
+  _pushFreeSlot(slot_id);
 
   //shrink the slot directory
-  SlotInfo* slot_directory = _getSlotDirectory();
-  std::uint32_t capacity = header->capacity;
+  _shrinkSlotDirectory();
+  _logChange(HEAP_PAGE_LOG_DELETE, slot_id, offset, 0, nullptr, 0);
+}
 
-  while (capacity> 0){
-    if (slot_directory[capacity - 1].offset != INVALID_SLOT_OFFSET){
-      break;
+/**
+ * @brief Deletes all records identified by the given SlotIds.
+ *
+ * All slots are invalidated first, then the remaining records are compacted
+ * in a single pass (unless the Page is in deferred compaction mode) and the
+ * slot directory is shrunk once.
+ *
+ * @pre slot_ids holds num_slots distinct, valid SlotIds.
+ * @post The records in those slots are removed from the page, and their
+ *       slot directory entries are marked invalid. The Page is in the same
+ *       state as after deleting them one at a time, except that the order
+ *       in which freed slots are reused may differ.
+ *
+ * @param slot_ids array of SlotIds of the Records to be deleted.
+ * @param num_slots number of SlotIds in the array.
+ *
+ * @throw InvalidSlotIdHeapPage If any SlotId is invalid (out of range,
+ *       INVALID_SLOT_OFFSET, or repeated in slot_ids). No record is deleted
+ *       in that case.
+ */
+void HeapPage::deleteRecords(const SlotId* slot_ids, std::uint32_t num_slots){
+  WriteLatch latch(this);
+  HeapPageHeader* header = _getPageHeader();
+
+  //throw exceptions
+  std::vector<bool> seen(header->capacity, false);
+  for (std::uint32_t i = 0; i < num_slots; i++){
+    SlotId slot_id = slot_ids[i];
+    if (slot_id >= header->capacity || seen[slot_id] ||
+        _getSlotOffset(slot_id) == INVALID_SLOT_OFFSET){
+      throwInvalidSlotId(slot_id);
     }
-    capacity--;
+    seen[slot_id] = true;
+    if (header->flags & HEAP_PAGE_MVCC){
+      _checkLiveVersion(slot_id);
+    }
+  }
+
+  std::uint64_t timestamp = 0;
+  if (header->flags & HEAP_PAGE_MVCC){
+    timestamp = _writeTimestamp();
+    for (std::uint32_t i = 0; i < num_slots; i++){
+      RecordVersion version;
+      _readVersion(slot_ids[i], &version);
+      version.xmax = timestamp;
+      _writeVersion(slot_ids[i], version);
+    }
+  } else {
+    _removeSlots(slot_ids, num_slots);
+  }
+  _logChange(HEAP_PAGE_LOG_DELETE_MANY, INVALID_SLOT_ID, 0, 0,
+      (const char*) slot_ids, num_slots * sizeof(SlotId), timestamp);
+}
+
+/**
+ * @brief Physically removes records. Shared by deleteRecords and prune.
+ *
+ * @pre slot_ids holds num_slots distinct, valid SlotIds.
+ * @post The slots are invalid and on the free slot list, the Page is
+ *    compacted unless in deferred compaction mode, and the slot directory
+ *    is shrunk.
+ *
+ * @param slot_ids array of SlotIds of the records.
+ * @param num_slots number of SlotIds in the array.
+ */
+void HeapPage::_removeSlots(const SlotId* slot_ids, std::uint32_t num_slots){
+  HeapPageHeader* header = _getPageHeader();
+
+  //invalidate every slot, leaving the holes for one compaction pass
+  for (std::uint32_t i = 0; i < num_slots; i++){
+    header->fragmented_bytes += _getSlotLength(slot_ids[i]);
+    _setSlotOffset(slot_ids[i], INVALID_SLOT_OFFSET);
+    header->size--;
+    _pushFreeSlot(slot_ids[i]);
   }
 
-  if (capacity < header->capacity){
-    std::uint32_t size = (header->capacity - capacity) * sizeof(SlotInfo);
-    header->capacity = capacity;
-    header->free_space_begin -= size;
+  if (!(header->flags & HEAP_PAGE_DEFERRED_COMPACTION)){
+    _compact();
   }
+  _shrinkSlotDirectory();
 }
 
 /**
  * @brief Updates Record identified by SlotId
  *
+ * A record that keeps its size is overwritten in place. A record that
+ * shrinks is overwritten in place and the freed bytes are reclaimed by
+ * sliding only the records in front of it. A record that grows is moved to
+ * the free space.
+ *
  * @pre A valid SlotId is provided as input and there is enough space in the
  *    Page for the updated Record. Valid Data* is provided as input.
  * @post The record stored in the slot identified by the given SlotId is
@@ -324,30 +1263,857 @@ void HeapPage::deleteRecord(SlotId slot_id){
  * @throw EmptyDataHeapPage. If the passed record_data is size 0.
  */
 void HeapPage::updateRecord(SlotId slot_id, Data* record_data){
+  _updateBytes(slot_id, record_data->getData(), record_data->getSize());
+}
 
+/**
+ * @brief Updates a record to the given bytes. Body of updateRecord.
+ *
+ * @param slot_id SlotId of the record to update.
+ * @param record_bytes bytes of the record, not compressed.
+ * @param length number of bytes.
+ */
+void HeapPage::_updateBytes(SlotId slot_id, const char* record_bytes,
+    std::uint32_t length){
+  WriteLatch latch(this);
   HeapPageHeader* header = _getPageHeader();
-  SlotInfo* slot = _getSlotInfo(slot_id);
 
   //throw exceptions
-  if (slot->offset == INVALID_SLOT_OFFSET || slot_id >= header->capacity){
-    throw InvalidSlotIdHeapPage(slot_id); 
-  }
-  if (record_data->getSize() == 0){
+  _checkValidSlotId(slot_id);
+  if (length == 0){
     throw EmptyDataHeapPage();
   }
-  if (this->getFreeSpace() + slot->length < record_data->getSize()){
+  bool versioned = (header->flags & HEAP_PAGE_MVCC) != 0;
+  if (versioned){
+    _checkLiveVersion(slot_id);
+  }
+
+  const char* record = record_bytes;
+  std::uint32_t old_length = _getSlotLength(slot_id);
+  std::uint32_t new_length = length;
+  char encoded[PAGE_SIZE];
+  std::uint64_t timestamp = 0;
+  if (versioned){
+    timestamp = _writeTimestamp();
+    //the old version keeps its bytes
+    old_length = 0;
+  }
+  if (header->flags & (HEAP_PAGE_COMPRESSION | HEAP_PAGE_MVCC)){
+    new_length = _encodeRecord(record, new_length, encoded, timestamp);
+    record = encoded;
+  }
+  if (this->getFreeSpace() + old_length < new_length){
+    HEAPPAGE_STAT(HEAP_PAGE_STAT_INSUFFICIENT_SPACE, 1);
     throw InsufficientSpaceHeapPage();
   }
+  _addSynopsisKey(record_bytes, length);
 
-  //update the page
-  _deleteRecord(slot_id);
-  _insertRecord(slot_id, record_data);
+  if (versioned){
+    _pushVersion(slot_id, record, new_length, timestamp);
+  } else {
+    _replaceStored(slot_id, record, new_length);
+  }
+  _logChange(HEAP_PAGE_LOG_UPDATE, slot_id, _getSlotOffset(slot_id), 0,
+      record_bytes, length, timestamp);
 }
 
 /**
- * @brief Returns the amount of records in the page
+ * @brief Makes new stored bytes the current version of a record on a
+ *    HEAP_PAGE_MVCC Page. The current version keeps its bytes and moves to
+ *    a slot of its own, marked old and chained from the new version.
+ *
+ * @pre slot_id holds the current version of a record that was not
+ *    deleted, and getFreeSpace() is at least length.
+ * @post slot_id holds the new version; its prev_slot is the old version.
+ *
+ * @param slot_id SlotId of the record.
+ * @param record stored bytes of the new version, RecordVersion included.
+ * @param length number of stored bytes.
+ * @param timestamp write timestamp of the update.
  */
-std::uint32_t HeapPage::getNumRecs(){
+void HeapPage::_pushVersion(SlotId slot_id, const char* record,
+    std::uint32_t length, std::uint64_t timestamp){
+  HeapPageHeader* header = _getPageHeader();
+
+  RecordVersion old_version;
+  _readVersion(slot_id, &old_version);
+  old_version.xmax = timestamp;
+  old_version.flags |= RECORD_VERSION_OLD;
+  _writeVersion(slot_id, old_version);
+
+  SlotId old_slot = _popFreeSlot();
+  std::uint32_t contiguous_necessary = length;
+  if (old_slot == INVALID_SLOT_ID){
+    contiguous_necessary += _getSlotSize();
+  }
+  if (_getContiguousSpace() < contiguous_necessary){
+    _compact();
+  }
+  if (old_slot == INVALID_SLOT_ID){
+    old_slot = header->capacity;
+    header->capacity++;
+    header->free_space_begin += _getSlotSize();
+  }
+  _setSlotOffset(old_slot, _getSlotOffset(slot_id));
+  _setSlotLength(old_slot, _getSlotLength(slot_id));
+
+  //counts the old version in size
+  _insertRecord(slot_id, record, length);
+  RecordVersion new_version;
+  _readVersion(slot_id, &new_version);
+  new_version.prev_slot = old_slot;
+  _writeVersion(slot_id, new_version);
+}
+
+/**
+ * @brief Replaces the stored bytes of a valid record, in place or by moving
+ *    it to the free space.
+ *
+ * @pre getFreeSpace() plus the current length of the record is at least
+ *    new_length.
+ * @post The slot holds the new bytes.
+ *
+ * @param slot_id SlotId of the record.
+ * @param record bytes to store, already compressed on a compressed Page.
+ * @param new_length number of bytes to store.
+ */
+void HeapPage::_replaceStored(SlotId slot_id, const char* record,
+    std::uint32_t new_length){
+  HeapPageHeader* header = _getPageHeader();
+  std::uint32_t old_length = _getSlotLength(slot_id);
+
+  //same size: overwrite the record in place
+  if (new_length == old_length){
+    std::memcpy(this->data + _getSlotOffset(slot_id), record, new_length);
+    HEAPPAGE_STAT(HEAP_PAGE_STAT_UPDATE_IN_PLACE, 1);
+    return;
+  }
+
+  //smaller: overwrite in place and give back the leftover bytes
+  if (new_length < old_length){
+    std::uint32_t offset = _getSlotOffset(slot_id);
+    std::uint32_t diff = old_length - new_length;
+    if (header->flags & HEAP_PAGE_DEFERRED_COMPACTION){
+      std::memcpy(this->data + offset, record, new_length);
+      header->fragmented_bytes += diff;
+    } else {
+      //keep the end of the record where it is, so only the records in
+      //front of it have to slide over the freed bytes
+      std::memcpy(this->data + offset + diff, record, new_length);
+      _closeGap(offset, diff);
+      _setSlotOffset(slot_id, offset + diff);
+    }
+    _setSlotLength(slot_id, new_length);
+    HEAPPAGE_STAT(HEAP_PAGE_STAT_UPDATE_IN_PLACE, 1);
+    return;
+  }
+
+  //bigger: move the record to the free space
+  HEAPPAGE_STAT(HEAP_PAGE_STAT_UPDATE_RELOCATED, 1);
+  _deleteRecord(slot_id);
+  if (_getContiguousSpace() < new_length){
+    _compact();
+  }
+  _insertRecord(slot_id, record, new_length);
+}
+
+/**
+ * @brief Turns deferred compaction on or off for this Page.
+ *
+ * @pre None.
+ * @post If enable is true, HEAP_PAGE_DEFERRED_COMPACTION is set and later
+ *    deletes leave holes that are counted in fragmented_bytes. If enable is
+ *    false, the Page is compacted and the flag is cleared, so every later
+ *    delete compacts right away.
+ *
+ * @param enable true to defer compaction, false to compact eagerly.
+ */
+void HeapPage::setDeferredCompaction(bool enable){
+  WriteLatch latch(this);
+  HeapPageHeader* header = _getPageHeader();
+
+  if (enable){
+    header->flags |= HEAP_PAGE_DEFERRED_COMPACTION;
+  } else {
+    _compact();
+    header->flags &= ~HEAP_PAGE_DEFERRED_COMPACTION;
+  }
+  _logChange(HEAP_PAGE_LOG_SET_DEFERRED, INVALID_SLOT_ID, 0, enable, nullptr,
+      0);
+}
+
+/**
+ * @brief bool function indicating whether deletes defer compaction.
+ *
+ * @return true if HEAP_PAGE_DEFERRED_COMPACTION is set on the Page.
+ */
+bool HeapPage::isDeferredCompaction(){
+  HeapPageHeader* header = _getPageHeader();
+
+  return (header->flags & HEAP_PAGE_DEFERRED_COMPACTION) != 0;
+}
+
+/**
+ * @brief Turns record compression on or off for this Page.
+ *
+ * @pre The Page holds no records.
+ * @post If enable is true, HEAP_PAGE_COMPRESSION is set and later inserted
+ *    and updated records are stored compressed (or with a one byte header,
+ *    if they do not compress). If enable is false, the flag is cleared.
+ *
+ * @param enable true to compress records, false to store them raw.
+ *
+ * @throw std::logic_error If the Page holds records.
+ */
+void HeapPage::setCompression(bool enable){
+  WriteLatch latch(this);
+  HeapPageHeader* header = _getPageHeader();
+
+  //stored records are only readable in the mode they were written in
+  if (header->size != 0){
+    throw std::logic_error("compression can only change on an empty page");
+  }
+  if (enable && (header->flags & HEAP_PAGE_MVCC)){
+    throw std::logic_error("HEAP_PAGE_MVCC pages cannot be compressed");
+  }
+  if (enable){
+    header->flags |= HEAP_PAGE_COMPRESSION;
+  } else {
+    header->flags &= ~HEAP_PAGE_COMPRESSION;
+  }
+  _logChange(HEAP_PAGE_LOG_SET_COMPRESSION, INVALID_SLOT_ID, 0, enable,
+      nullptr, 0);
+}
+
+/**
+ * @brief Getter for the compression mode of the Page.
+ *
+ * @pre None.
+ * @post None.
+ *
+ * @return true if HEAP_PAGE_COMPRESSION is set on the Page.
+ */
+bool HeapPage::isCompressed(){
+  HeapPageHeader* header = _getPageHeader();
+
+  return (header->flags & HEAP_PAGE_COMPRESSION) != 0;
+}
+
+/**
+ * @brief Sets how many leading record bytes form the key summarized by
+ *    the synopsis.
+ *
+ * @pre The Page was initialized with HEAP_PAGE_SYNOPSIS and holds no
+ *    records.
+ * @post PageSynopsis::key_length is key_length and the synopsis is
+ *    cleared.
+ *
+ * @param key_length Key length in bytes, at most SYNOPSIS_KEY_BYTES.
+ *
+ * @throw std::logic_error If the Page has no synopsis or holds records.
+ * @throw std::invalid_argument If key_length is 0 or more than
+ *    SYNOPSIS_KEY_BYTES.
+ */
+void HeapPage::setSynopsisKeyLength(std::uint32_t key_length){
+  WriteLatch latch(this);
+  HeapPageHeader* header = _getPageHeader();
+
+  //throw exceptions
+  if (!(header->flags & HEAP_PAGE_SYNOPSIS)){
+    throw std::logic_error("HeapPage has no synopsis");
+  }
+  if (header->size != 0){
+    throw std::logic_error("synopsis key can only change on an empty page");
+  }
+  if (key_length == 0 || key_length > SYNOPSIS_KEY_BYTES){
+    throw std::invalid_argument("bad synopsis key length");
+  }
+
+  PageSynopsis* synopsis = _getSynopsis();
+  std::memset(synopsis, 0, sizeof(PageSynopsis));
+  synopsis->key_length = key_length;
+  _logChange(HEAP_PAGE_LOG_SET_KEY_LENGTH, INVALID_SLOT_ID, 0, key_length,
+      nullptr, 0);
+}
+
+/**
+ * @brief bool function indicating whether the Page keeps a synopsis.
+ *
+ * @return true if HEAP_PAGE_SYNOPSIS is set on the Page.
+ */
+bool HeapPage::hasSynopsis(){
+  HeapPageHeader* header = _getPageHeader();
+
+  return (header->flags & HEAP_PAGE_SYNOPSIS) != 0;
+}
+
+/**
+ * @brief Checks a predicate against the synopsis of the Page.
+ *
+ * @pre None.
+ * @post None. Reads the synopsis without the latch, like getRecord.
+ *
+ * @param predicate Predicate on record keys.
+ * @return false if no record on the Page can match predicate. true if
+ *    some record may match, or if the Page has no synopsis.
+ */
+bool HeapPage::synopsisMayMatch(const SynopsisPredicate& predicate){
+  if (!this->hasSynopsis()){
+    return true;
+  }
+
+  // copy the synopsis without the latch, retrying if a writer changed it
+  PageSynopsis synopsis;
+  while (true){
+    std::uint16_t version = readBegin();
+    std::memcpy(&synopsis, _getSynopsis(), sizeof(PageSynopsis));
+    if (readValidate(version)){
+      break;
+    }
+  }
+
+  if (!synopsis.has_keys){
+    return false;
+  }
+  unsigned char low[SYNOPSIS_KEY_BYTES];
+  unsigned char high[SYNOPSIS_KEY_BYTES];
+  if (predicate.low != nullptr){
+    synopsisKey(predicate.low, predicate.low_length, synopsis.key_length,
+        low);
+    if (std::memcmp(low, synopsis.max_key, SYNOPSIS_KEY_BYTES) > 0){
+      return false;
+    }
+  }
+
+  if (predicate.kind == SYNOPSIS_KEY_EQUAL){
+    if (predicate.low == nullptr){
+      return true;
+    }
+    if (std::memcmp(low, synopsis.min_key, SYNOPSIS_KEY_BYTES) < 0){
+      return false;
+    }
+    for (std::uint32_t i = 0; i < SYNOPSIS_BLOOM_HASHES; i++){
+      std::uint32_t bit = synopsisBloomBit(low, i);
+      if (!(synopsis.bloom[bit / 64] >> (bit % 64) & 1)){
+        return false;
+      }
+    }
+    return true;
+  }
+
+  if (predicate.high != nullptr){
+    synopsisKey(predicate.high, predicate.high_length, synopsis.key_length,
+        high);
+    if (std::memcmp(high, synopsis.min_key, SYNOPSIS_KEY_BYTES) < 0){
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Recomputes the synopsis from the records on the Page, dropping
+ *    the keys of deleted and overwritten records.
+ *
+ * @pre None.
+ * @post The synopsis covers exactly the keys of the current records.
+ *    Does nothing if the Page has no synopsis.
+ */
+void HeapPage::rebuildSynopsis(){
+  WriteLatch latch(this);
+  HeapPageHeader* header = _getPageHeader();
+
+  if (!(header->flags & HEAP_PAGE_SYNOPSIS)){
+    return;
+  }
+
+  PageSynopsis* synopsis = _getSynopsis();
+  std::uint16_t key_length = synopsis->key_length;
+  std::memset(synopsis, 0, sizeof(PageSynopsis));
+  synopsis->key_length = key_length;
+
+  char decoded[PAGE_SIZE];
+  for (SlotId i = 0; i < header->capacity; i++){
+    std::uint32_t offset = _getSlotOffset(i);
+    if (offset == INVALID_SLOT_OFFSET){
+      continue;
+    }
+    const char* record = this->data + offset;
+    std::uint32_t length = _getSlotLength(i);
+    if (header->flags & HEAP_PAGE_MVCC){
+      record += sizeof(RecordVersion);
+      length -= sizeof(RecordVersion);
+    }
+    if (header->flags & HEAP_PAGE_COMPRESSION){
+      std::uint32_t decoded_length = decodedLength(record, length);
+      if (decoded_length > PAGE_SIZE ||
+          !decodeStoredRecord(record, length, decoded, decoded_length)){
+        throw std::runtime_error("corrupt compressed record");
+      }
+      record = decoded;
+      length = decoded_length;
+    }
+    _addSynopsisKey(record, length);
+  }
+  _logChange(HEAP_PAGE_LOG_REBUILD_SYNOPSIS, INVALID_SLOT_ID, 0, 0, nullptr,
+      0);
+}
+
+/**
+ * @brief bool function indicating whether the Page keeps a checksum.
+ *
+ * @return true if HEAP_PAGE_CHECKSUM is set on the Page.
+ */
+bool HeapPage::hasChecksum(){
+  HeapPageHeader* header = _getPageHeader();
+  return (header->flags & HEAP_PAGE_CHECKSUM) != 0;
+}
+
+/**
+ * @brief Recomputes the checksum of the Page. Meant to be called by the
+ *    buffer manager before the Page is written out, so inserts, deletes
+ *    and updates do not pay for it.
+ *
+ * @pre None.
+ * @post PageChecksum::crc matches the current contents of the Page. Does
+ *    nothing if the Page has no checksum.
+ */
+void HeapPage::updateChecksum(){
+  if (!this->hasChecksum()){
+    return;
+  }
+  //the version is left out of the checksum, so taking the latch here does
+  //not invalidate it
+  WriteLatch latch(this);
+  _getChecksum()->crc = _computeChecksum();
+}
+
+/**
+ * @brief Checks the Page contents against its checksum. Meant to be
+ *    called by the buffer manager after the Page is read in.
+ *
+ * Whether the Page should have a checksum comes from the caller (the
+ * file or table settings), not from the Page: HEAP_PAGE_CHECKSUM is
+ * itself in the bytes being checked, and a flipped flag must not turn
+ * the check off.
+ *
+ * @pre No writer is modifying the Page.
+ * @post None.
+ *
+ * @param expected true if Pages of this file carry a checksum.
+ * @return false if hasChecksum() is not expected, or if the Page has a
+ *    checksum that does not match its contents; true otherwise.
+ */
+bool HeapPage::verifyChecksum(bool expected){
+  if (this->hasChecksum() != expected){
+    return false;
+  }
+  if (!expected){
+    return true;
+  }
+  return _getChecksum()->crc == _computeChecksum();
+}
+
+/**
+ * @brief Compacts all records at the end of the Page.
+ *
+ * @pre None.
+ * @post All valid records are packed against the end of the Page, their
+ *    slot entries are moved along with them, free_space_end is raised and
+ *    fragmented_bytes is 0. SlotIds do not change. Does nothing if the Page
+ *    has no fragmented bytes.
+ */
+void HeapPage::compact(){
+  WriteLatch latch(this);
+  _compact();
+  _logChange(HEAP_PAGE_LOG_COMPACT, INVALID_SLOT_ID, 0, 0, nullptr, 0);
+}
+
+/**
+ * @brief Compacts all records at the end of the Page. Same as compact()
+ *    without taking the write latch, for writers that already hold it.
+ */
+void HeapPage::_compact(){
+  HeapPageHeader* header = _getPageHeader();
+
+  if (header->fragmented_bytes == 0){
+    return;
+  }
+
+  std::vector<SlotId> order;
+  order.reserve(header->size);
+  for (SlotId i = 0; i < header->capacity; i++){
+    if (_getSlotOffset(i) != INVALID_SLOT_OFFSET){
+      order.push_back(i);
+    }
+  }
+
+  //slide the records to the end of the page, highest offset first, so a
+  //record only ever moves into space that has already been vacated
+  std::sort(order.begin(), order.end(), [this](SlotId a, SlotId b){
+      return _getSlotOffset(a) > _getSlotOffset(b);
+  });
+
+  std::uint32_t end = PAGE_SIZE;
+  for (SlotId i : order){
+    std::uint32_t offset = _getSlotOffset(i);
+    std::uint32_t length = _getSlotLength(i);
+    end -= length;
+    if (offset != end){
+      memmove(this->data + end, this->data + offset, length);
+      _setSlotOffset(i, end);
+      HEAPPAGE_STAT(HEAP_PAGE_STAT_COMPACTION_BYTES, length);
+    }
+  }
+  HEAPPAGE_STAT(HEAP_PAGE_STAT_COMPACTIONS, 1);
+  HEAPPAGE_STAT(HEAP_PAGE_STAT_SLOT_SCAN_LENGTH, header->capacity);
+
+  header->free_space_end = end;
+  header->fragmented_bytes = 0;
+}
+
+/**
+ * @brief Starts an optimistic read of the Page.
+ *
+ * Writers take an exclusive latch on the Page, readers take none. A reader
+ * calls readBegin, reads the Page and then calls readValidate; if that
+ * returns false a writer modified the Page in between and the read must be
+ * retried.
+ *
+ * @pre None.
+ * @post Waits until no writer holds the latch.
+ *
+ * @return The version to pass to readValidate.
+ */
+std::uint16_t HeapPage::readBegin(){
+  std::uint16_t* version = &(this->_getPageHeader()->version);
+
+  std::uint16_t current = __atomic_load_n(version, __ATOMIC_ACQUIRE);
+  while (current & 1){
+    cpuRelax();
+    current = __atomic_load_n(version, __ATOMIC_ACQUIRE);
+  }
+  return current;
+}
+
+/**
+ * @brief Checks whether the Page was modified since readBegin.
+ *
+ * @pre version was returned by readBegin on this Page.
+ * @post None.
+ *
+ * @param version The version returned by readBegin.
+ * @return true if no writer modified the Page since readBegin.
+ */
+bool HeapPage::readValidate(std::uint16_t version){
+  // order the reads of the page before the second read of the version
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  return __atomic_load_n(&(this->_getPageHeader()->version),
+      __ATOMIC_RELAXED) == version;
+}
+
+/**
+ * @brief Releases a write latch left in the bytes of a Page read from
+ *    disk.
+ *
+ * The latch bit is part of the Page, so a Page flushed while a writer
+ * held it is read back latched, and every reader and writer of it would
+ * wait forever. The buffer manager (or whatever else fills a Page from
+ * storage) must call resetLatch after reading a Page in, before the Page
+ * is shared.
+ *
+ * @pre No thread uses the Page.
+ * @post The version of the Page is even.
+ */
+void HeapPage::resetLatch(){
+  std::uint16_t* version = &(this->_getPageHeader()->version);
+  std::uint16_t current = __atomic_load_n(version, __ATOMIC_RELAXED);
+  if (current & 1){
+    //as if the writer had released it
+    __atomic_store_n(version, (std::uint16_t) (current + 1),
+        __ATOMIC_RELEASE);
+  }
+}
+
+/**
+ * @brief Acquires the write latch of page, waiting for any other writer to
+ *    release it. The latch is the low bit of HeapPageHeader::version.
+ */
+HeapPage::WriteLatch::WriteLatch(HeapPage* page){
+  this->page = page;
+  this->free_space_class = 0;
+  std::uint16_t* version = &(page->_getPageHeader()->version);
+
+  std::uint16_t current = __atomic_load_n(version, __ATOMIC_RELAXED);
+  std::uint64_t spins = 0;
+  while ((current & 1) || !__atomic_compare_exchange_n(version, &current,
+        (std::uint16_t) (current + 1), true, __ATOMIC_ACQUIRE,
+        __ATOMIC_RELAXED)){
+    spins++;
+    if (current & 1){
+      cpuRelax();
+      current = __atomic_load_n(version, __ATOMIC_RELAXED);
+    }
+  }
+  HEAPPAGE_STAT(HEAP_PAGE_STAT_LATCH_ACQUIRES, 1);
+  HEAPPAGE_STAT(HEAP_PAGE_STAT_LATCH_CONTENDED, spins != 0);
+  HEAPPAGE_STAT(HEAP_PAGE_STAT_LATCH_SPINS, spins);
+  (void) spins;
+  // make the odd version visible before any write to the page
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  this->listener = _getFreeSpaceListener(page);
+  if (this->listener != nullptr){
+    this->free_space_class = page->getFreeSpaceClass();
+  }
+}
+
+/**
+ * @brief Releases the write latch and publishes a new version. Tells the
+ *    free space listener if the write changed the free space class.
+ */
+HeapPage::WriteLatch::~WriteLatch(){
+  FreeSpaceListener* listener = this->listener;
+  std::uint8_t old_class = this->free_space_class;
+  std::uint8_t new_class = 0;
+  if (listener != nullptr){
+    new_class = this->page->getFreeSpaceClass();
+  }
+
+  __atomic_fetch_add(&(this->page->_getPageHeader()->version), 1,
+      __ATOMIC_RELEASE);
+
+  if (listener != nullptr && new_class != old_class){
+    listener->freeSpaceChanged(this->page, new_class);
+  }
+}
+
+/**
+ * @brief Getter for the free space class of the Page.
+ *
+ * @pre None.
+ * @post The free space class of the Page is returned. A record of up to
+ *    free space class * FREE_SPACE_CLASS_BYTES bytes can be inserted into
+ *    the Page.
+ *
+ * @return getFreeSpace() / FREE_SPACE_CLASS_BYTES.
+ */
+std::uint8_t HeapPage::getFreeSpaceClass(){
+  return this->getFreeSpace() / FREE_SPACE_CLASS_BYTES;
+}
+
+/**
+ * @brief Sets the listener told when the free space class of any HeapPage
+ *    without a listener of its own changes.
+ *
+ * There is one such listener per process, so it only suits a process with
+ * a single file; with several files, give each page the listener of its
+ * own file with setFreeSpaceListener(page, listener), as
+ * FreeSpaceMap::attach does.
+ *
+ * @pre No HeapPage is being modified.
+ * @post listener (or no listener, if it is NULL) is called by every later
+ *    write that changes the free space class of a HeapPage that has no
+ *    listener of its own.
+ *
+ * @param listener FreeSpaceListener to call, or NULL for none.
+ */
+void HeapPage::setFreeSpaceListener(FreeSpaceListener* listener){
+  free_space_listener = listener;
+}
+
+/**
+ * @brief Sets the listener told when the free space class of page
+ *    changes, in place of the process-wide one.
+ *
+ * Pages are spread over sharded tables, so writers of different pages and
+ * listeners of different files rarely share a mutex, and writes cost no
+ * lookup while no page has a listener.
+ *
+ * @pre No writer is modifying page.
+ * @post listener is called by every later write that changes the free
+ *    space class of page. If listener is NULL, page goes back to the
+ *    process-wide listener.
+ *
+ * @param page HeapPage to listen to.
+ * @param listener FreeSpaceListener to call, or NULL to remove it.
+ */
+void HeapPage::setFreeSpaceListener(HeapPage* page,
+    FreeSpaceListener* listener){
+  FreeSpaceListenerShard& shard = listenerShard(page);
+  std::lock_guard<std::mutex> guard(shard.latch);
+
+  if (listener == nullptr){
+    num_page_listeners.fetch_sub(shard.listeners.erase(page),
+        std::memory_order_relaxed);
+  } else if (shard.listeners.emplace(page, listener).second){
+    num_page_listeners.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    shard.listeners[page] = listener;
+  }
+}
+
+/**
+ * @brief Finds the listener of page: its own one if it has one, the
+ *    process-wide one otherwise.
+ */
+FreeSpaceListener* HeapPage::_getFreeSpaceListener(HeapPage* page){
+  if (num_page_listeners.load(std::memory_order_relaxed) != 0){
+    FreeSpaceListenerShard& shard = listenerShard(page);
+    std::lock_guard<std::mutex> guard(shard.latch);
+    auto found = shard.listeners.find(page);
+    if (found != shard.listeners.end()){
+      return found->second;
+    }
+  }
+  return free_space_listener;
+}
+
+/**
+ * @brief Sets the log that every later change to any HeapPage is written
+ *    to.
+ *
+ * @pre No HeapPage is being modified.
+ * @post Every HeapPage change (initializeHeader, setNext, setPrev, inserts,
+ *    deletes, updates, compact and the mode setters) is sent to sink as a
+ *    HeapPageLogRecord, or to no log if sink is NULL. Changes made by redo
+ *    are not sent.
+ *
+ * @param sink HeapPageLogSink to write to, or NULL for none.
+ */
+void HeapPage::setLogSink(HeapPageLogSink* sink){
+  log_sink = sink;
+}
+
+/**
+ * @brief Getter for the LSN of the Page.
+ *
+ * @return LSN of the last log record applied to the Page, or 0 if the Page
+ *    has no HEAP_PAGE_LSN region.
+ */
+std::uint64_t HeapPage::getPageLsn(){
+  if (!(this->_getPageHeader()->flags & HEAP_PAGE_LSN)){
+    return 0;
+  }
+  return this->_getLsn()->lsn;
+}
+
+/*
+ * Sets redo_record for the lifetime of the object.
+ */
+struct RedoScope{
+  RedoScope(const HeapPageLogRecord* record){
+    redo_record = record;
+  }
+  ~RedoScope(){
+    redo_record = nullptr;
+  }
+};
+
+/**
+ * @brief Applies a redo record to the Page, for recovery.
+ *
+ * @pre The Page is in the state it was in when record was logged, or a
+ *    later one, and no other thread modifies it.
+ * @post The change of record is applied and the LSN of the Page is
+ *    record.lsn, unless the Page has HEAP_PAGE_LSN and already has an LSN
+ *    of at least record.lsn. HEAP_PAGE_LOG_INIT is always applied.
+ *
+ * @param record Redo record, as given to HeapPageLogSink::logRecord with
+ *    its lsn filled in.
+ * @return true if the record was applied, false if it was skipped.
+ *
+ * @throw std::runtime_error If the Page does not end up as logged (record
+ *    applied to the wrong state of the Page).
+ * @throw std::invalid_argument If record.type is unknown.
+ * @throw Whatever the change itself throws on this Page.
+ */
+bool HeapPage::redo(const HeapPageLogRecord& record){
+  //a Page read in before its initialization was flushed holds garbage, so
+  //its LSN means nothing
+  if (record.type != HEAP_PAGE_LOG_INIT &&
+      (this->_getPageHeader()->flags & HEAP_PAGE_LSN) &&
+      this->_getLsn()->lsn >= record.lsn){
+    return false;
+  }
+
+  RedoScope scope(&record);
+  SlotId slot_id = record.slot_id;
+  switch (record.type){
+    case HEAP_PAGE_LOG_INIT:
+      this->initializeHeader(record.value);
+      return true;
+    case HEAP_PAGE_LOG_SET_NEXT:
+      this->setNext(record.value);
+      return true;
+    case HEAP_PAGE_LOG_SET_PREV:
+      this->setPrev(record.value);
+      return true;
+    case HEAP_PAGE_LOG_INSERT:
+      slot_id = this->_insertBytes(record.bytes, record.length);
+      break;
+    case HEAP_PAGE_LOG_DELETE:
+      this->deleteRecord(record.slot_id);
+      return true;
+    case HEAP_PAGE_LOG_DELETE_MANY: {
+      //the log may not keep the SlotIds aligned
+      std::vector<SlotId> slot_ids(record.length / sizeof(SlotId));
+      std::memcpy(slot_ids.data(), record.bytes, record.length);
+      this->deleteRecords(slot_ids.data(), slot_ids.size());
+      return true;
+    }
+    case HEAP_PAGE_LOG_UPDATE:
+      this->_updateBytes(record.slot_id, record.bytes, record.length);
+      break;
+    case HEAP_PAGE_LOG_COMPACT:
+      this->compact();
+      return true;
+    case HEAP_PAGE_LOG_SET_DEFERRED:
+      this->setDeferredCompaction(record.value != 0);
+      return true;
+    case HEAP_PAGE_LOG_SET_COMPRESSION:
+      this->setCompression(record.value != 0);
+      return true;
+    case HEAP_PAGE_LOG_SET_KEY_LENGTH:
+      this->setSynopsisKeyLength(record.value);
+      return true;
+    case HEAP_PAGE_LOG_REBUILD_SYNOPSIS:
+      this->rebuildSynopsis();
+      return true;
+    case HEAP_PAGE_LOG_PRUNE:
+      this->prune(record.timestamp);
+      return true;
+    case HEAP_PAGE_LOG_PACK_SLOTS:
+      this->packSlotDirectory();
+      return true;
+    default:
+      throw std::invalid_argument("unknown HeapPage log record type");
+  }
+
+  //inserts and updates land where they did when they were logged
+  if (slot_id != record.slot_id ||
+      this->_getSlotOffset(slot_id) != record.offset){
+    throw std::runtime_error("redo record does not match the HeapPage");
+  }
+  return true;
+}
+
+/**
+ * @brief Getter for the number of slots of the slot directory, valid or
+ *    not. A single read of the header, unlike getPageState; readers racing
+ *    with writers validate it with readBegin and readValidate.
+ *
+ * @return Capacity of the slot directory.
+ */
+std::uint32_t HeapPage::getCapacity(){
+  return __atomic_load_n(&(this->_getPageHeader()->capacity),
+      __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Returns the amount of records in the page
+ */
+std::uint32_t HeapPage::getNumRecs(){
   struct HeapPageHeader *tmp = this->_getPageHeader();
 
   return tmp->size;
@@ -371,8 +2137,11 @@ HeapPageHeader HeapPage::getHeader(){
  */
 SlotInfo HeapPage::getSlotInfo(SlotId slot_id){
 
-  SlotInfo* slot_info = this->_getSlotInfo(slot_id);
-  return *slot_info;
+  this->_checkSlotId(slot_id);
+  SlotInfo slot_info;
+  slot_info.offset = this->_getSlotOffset(slot_id);
+  slot_info.length = this->_getSlotLength(slot_id);
+  return slot_info;
 }
 
 /**
@@ -384,32 +2153,79 @@ std::uint32_t HeapPage::getInvalidNum(){
   struct HeapPageHeader *tmp = this->_getPageHeader(); 
 
   for (std::uint32_t i = 0; i < tmp->capacity; i++){
-    SlotInfo* slot = this->_getSlotInfo(i);
-    if (slot->offset == INVALID_SLOT_OFFSET){
+    if (this->_getSlotOffset(i) == INVALID_SLOT_OFFSET){
       invalid++;
     }
   }
   return invalid;
 }
 
+/**
+ * @brief Returns a consistent snapshot of the layout of the Page.
+ *
+ * @pre None.
+ * @post None. Reads the Page without the latch, like getRecord.
+ *
+ * @return HeapPageState of the Page.
+ *
+ * @throw std::runtime_error If the slot directory reaches past the Page
+ *        while no writer changes the Page.
+ */
+HeapPageState HeapPage::getPageState(){
+  HeapPageHeader* page_header = this->_getPageHeader();
+  HeapPageState state;
+
+  // read without the latch, retrying if a writer changed the page meanwhile
+  while (true){
+    std::uint16_t version = readBegin();
+    state.capacity = page_header->capacity;
+    // a torn read of capacity can reach past the page; if no writer ran,
+    // the Page itself is bad and retrying would spin forever
+    if (sizeof(HeapPageHeader) + _getExtensionSize()
+        + state.capacity * _getSlotSize() > PAGE_SIZE){
+      if (readValidate(version)){
+        throwCorruptPage(state.capacity);
+      }
+      continue;
+    }
+    state.size = page_header->size;
+    //count over the checked capacity, not a second read of the header
+    state.invalid_slots = 0;
+    for (std::uint32_t i = 0; i < state.capacity; i++){
+      if (this->_getSlotOffset(i) == INVALID_SLOT_OFFSET){
+        state.invalid_slots++;
+      }
+    }
+    state.free_space_begin = page_header->free_space_begin;
+    state.free_space_end = page_header->free_space_end;
+    state.free_space = this->getFreeSpace();
+    state.fragmented_bytes = page_header->fragmented_bytes;
+    state.flags = page_header->flags;
+    state.version = version;
+    if (readValidate(version)){
+      return state;
+    }
+  }
+}
+
 /**
  * @brief THIS METHOD IS FOR DEBUGGING ONLY.
- *    Prints the current state of the HeapPage.
+ *    Prints the current state of the HeapPage, as returned by
+ *    getPageState.
  */
 void HeapPage::printHeapPageState(){
+  HeapPageState state = this->getPageState();
 
-  HeapPageHeader* page_header = this->_getPageHeader();
-  std::uint32_t invalid = this->getInvalidNum();
-
-  // NOTE:  already implemented for you, but wrong
-  // NOTE:  values until you implement other features
-  std::cout << "Total number of slots: " << page_header->capacity << std::endl;
-  std::cout << "Number of valid slots: " <<  page_header->size << std::endl;
-  std::cout << "Number of invalid slots: " <<  invalid << std::endl;
-  std::cout << "Where free space begins: " << page_header->free_space_begin
+  std::cout << "Total number of slots: " << state.capacity << std::endl;
+  std::cout << "Number of valid slots: " << state.size << std::endl;
+  std::cout << "Number of invalid slots: " << state.invalid_slots
+      << std::endl;
+  std::cout << "Where free space begins: " << state.free_space_begin
       << std::endl;
-  std::cout << "Where free space ends: " << page_header->free_space_end
+  std::cout << "Where free space ends: " << state.free_space_end
       << std::endl;
+  std::cout << "Free space: " << state.free_space << std::endl;
+  std::cout << "Fragmented bytes: " << state.fragmented_bytes << std::endl;
 }
 
 /**
@@ -422,43 +2238,499 @@ HeapPageHeader* HeapPage::_getPageHeader(){
   return (HeapPageHeader*) this->data;
 }
 
+/**
+ * @brief Getter for the contiguous free space between the slot directory
+ *    and the records, not counting fragmented bytes.
+ * @return Number of bytes between free_space_begin and free_space_end.
+ */
+std::uint32_t HeapPage::_getContiguousSpace(){
+  HeapPageHeader* page_header = this->_getPageHeader();
+
+  return page_header->free_space_end - page_header->free_space_begin;
+}
+
 /**
  * @brief Return pointer to the where slot directory begins (first SlotInfo)
  *
  * @pre None
- * @post Pointer to first SlotInfo is returned.
+ * @post Pointer to first SlotInfo is returned. On a Page with
+ *    HEAP_PAGE_COMPACT_SLOTS it points at CompactSlotInfo entries.
  *
  * @param slot_id SlotId of SlotInfo* that is returned.
  * @return Pointer to the first SlotInfo in slot directory.
  */
 SlotInfo* HeapPage::_getSlotDirectory(){
 
-  return (SlotInfo*) (this->data + sizeof(HeapPageHeader));
+  return (SlotInfo*) (this->data + sizeof(HeapPageHeader)
+      + this->_getExtensionSize());
+}
+
+
+
+/**
+ * @brief Getter for the size of the optional regions between the header
+ *    and the slot directory.
+ * @return Number of bytes of the regions chosen by the header flags.
+ */
+std::uint32_t HeapPage::_getExtensionSize(){
+  return extensionSize(this->_getPageHeader()->flags);
+}
+
+/**
+ * @brief Getter for the synopsis region.
+ *
+ * @pre The Page has HEAP_PAGE_SYNOPSIS set.
+ * @return Pointer to the PageSynopsis of the Page.
+ */
+PageSynopsis* HeapPage::_getSynopsis(){
+  return (PageSynopsis*) (this->data + sizeof(HeapPageHeader));
+}
+
+/**
+ * @brief Getter for the LSN region.
+ *
+ * @pre The Page has HEAP_PAGE_LSN set.
+ * @return Pointer to the PageLsn of the Page.
+ */
+PageLsn* HeapPage::_getLsn(){
+  std::uint16_t before = HEAP_PAGE_SYNOPSIS | HEAP_PAGE_CHECKSUM;
+  return (PageLsn*) (this->data + sizeof(HeapPageHeader)
+      + extensionSize(this->_getPageHeader()->flags & before));
 }
 
+/**
+ * @brief Turns record bytes into the bytes stored on the Page: compressed
+ *    on a compressed Page, behind a RecordVersion created at timestamp on a
+ *    HEAP_PAGE_MVCC Page.
+ *
+ * @pre One of the two flags is set. encoded holds PAGE_SIZE bytes.
+ *
+ * @param record bytes of the record.
+ * @param length number of bytes.
+ * @param encoded buffer for the stored bytes.
+ * @param timestamp write timestamp, used on HEAP_PAGE_MVCC Pages.
+ * @return Number of stored bytes.
+ */
+std::uint32_t HeapPage::_encodeRecord(const char* record,
+    std::uint32_t length, char* encoded, std::uint64_t timestamp){
+  if (this->_getPageHeader()->flags & HEAP_PAGE_COMPRESSION){
+    return encodeStoredRecord(record, length, encoded);
+  }
 
+  //a record that cannot fit is rejected by the free space check
+  RecordVersion version;
+  version.xmin = timestamp;
+  version.xmax = MVCC_TIMESTAMP_INFINITY;
+  version.prev_slot = FREE_SLOT_LIST_END;
+  version.flags = 0;
+  version.reserved = 0;
+  std::uint32_t copied = std::min<std::uint32_t>(length,
+      PAGE_SIZE - sizeof(version));
+  std::memcpy(encoded, &version, sizeof(version));
+  std::memcpy(encoded + sizeof(version), record, copied);
+  return length + sizeof(version);
+}
 
 /**
- * @brief Returns pointer to SlotInfo of given SlotId
+ * @brief Takes the timestamp of a write to a HEAP_PAGE_MVCC Page, from the
+ *    write clock or during redo from the record being redone.
+ * @return Write timestamp.
+ */
+std::uint64_t HeapPage::_writeTimestamp(){
+  if (redo_record == nullptr){
+    return write_clock.fetch_add(1, std::memory_order_acq_rel) + 1;
+  }
+
+  //writes after recovery must be newer than every redone one
+  std::uint64_t timestamp = redo_record->timestamp;
+  std::uint64_t current = write_clock.load(std::memory_order_relaxed);
+  while (current < timestamp && !write_clock.compare_exchange_weak(current,
+        timestamp, std::memory_order_acq_rel)){
+  }
+  return timestamp;
+}
+
+/**
+ * @brief Reads the RecordVersion of a slot on a HEAP_PAGE_MVCC Page.
  *
- * @pre Valid SlotId (less than capacity) is provided as input.
- * @post Pointer to appropriate SlotInfo in the memory space of the Page is
- *    returned
+ * @param slot_id SlotId of the version.
+ * @param version Set to the RecordVersion of the slot.
+ * @return false if the slot holds no version (also on torn reads by
+ *    readers without the latch).
+ */
+bool HeapPage::_readVersion(SlotId slot_id, RecordVersion* version){
+  if (slot_id >= this->_getPageHeader()->capacity){
+    return false;
+  }
+  std::uint32_t offset = _getSlotOffset(slot_id);
+  if (offset == INVALID_SLOT_OFFSET || _getSlotLength(slot_id) <
+      sizeof(RecordVersion) || offset + sizeof(RecordVersion) > PAGE_SIZE){
+    return false;
+  }
+  std::memcpy(version, this->data + offset, sizeof(RecordVersion));
+  return true;
+}
+
+/**
+ * @brief Overwrites the RecordVersion of a valid slot.
  *
- * @param slot_id SlotId of SlotInfo* that is returned.
- * @return Pointer to the SlotInfo of given SlotId.
+ * @param slot_id SlotId of the version.
+ * @param version New RecordVersion.
+ */
+void HeapPage::_writeVersion(SlotId slot_id, const RecordVersion& version){
+  std::memcpy(this->data + _getSlotOffset(slot_id), &version,
+      sizeof(RecordVersion));
+}
+
+/**
+ * @brief Finds the version of a record visible to a snapshot.
+ *
+ * @param slot_id SlotId of the record.
+ * @param snapshot Snapshot to read as of.
+ * @return SlotId of the visible version, or INVALID_SLOT_ID if slot_id
+ *    holds an old version or no version is visible.
+ */
+SlotId HeapPage::_visibleVersion(SlotId slot_id, std::uint64_t snapshot){
+  RecordVersion version;
+  if (!_readVersion(slot_id, &version) ||
+      (version.flags & RECORD_VERSION_OLD)){
+    return INVALID_SLOT_ID;
+  }
+
+  //bounded, since a torn read may see a cycle
+  std::uint32_t capacity = this->_getPageHeader()->capacity;
+  for (std::uint32_t steps = 0; steps <= capacity; steps++){
+    if (version.xmin <= snapshot && snapshot < version.xmax){
+      return slot_id;
+    }
+    slot_id = version.prev_slot;
+    if (!_readVersion(slot_id, &version)){
+      return INVALID_SLOT_ID;
+    }
+  }
+  return INVALID_SLOT_ID;
+}
+
+/**
+ * @brief Checks that a slot holds the latest version of a record that has
+ *    not been deleted.
+ *
+ * @throw InvalidSlotIdHeapPage If it does not.
+ */
+void HeapPage::_checkLiveVersion(SlotId slot_id){
+  RecordVersion version;
+  if (!_readVersion(slot_id, &version) ||
+      (version.flags & RECORD_VERSION_OLD) ||
+      version.xmax != MVCC_TIMESTAMP_INFINITY){
+    throwInvalidSlotId(slot_id);
+  }
+}
+
+/**
+ * @brief Sends a change to the log sink and sets the LSN of the Page, or
+ *    during redo only sets the LSN. Called by every writer with the write
+ *    latch held, after the change.
+ *
+ * @param type Kind of change.
+ * @param slot_id SlotId of the record changed, if any.
+ * @param offset Offset of the record changed, if any.
+ * @param value Argument of a header change.
+ * @param bytes Record bytes or SlotIds, or NULL.
+ * @param length Number of bytes.
+ * @param timestamp Write timestamp on a HEAP_PAGE_MVCC Page.
+ */
+void HeapPage::_logChange(HeapPageLogType type, SlotId slot_id,
+    std::uint32_t offset, std::uint32_t value, const char* bytes,
+    std::uint32_t length, std::uint64_t timestamp){
+  HeapPageLogSink* sink = log_sink;
+  if (sink == nullptr && redo_record == nullptr){
+    return;
+  }
+
+  std::uint64_t lsn;
+  if (redo_record != nullptr){
+    lsn = redo_record->lsn;
+  } else {
+    HeapPageLogRecord record;
+    record.type = type;
+    record.slot_id = slot_id;
+    record.offset = offset;
+    record.value = value;
+    record.bytes = bytes;
+    record.length = length;
+    record.lsn = 0;
+    record.timestamp = timestamp;
+    lsn = sink->logRecord(this, record);
+  }
+  if (this->_getPageHeader()->flags & HEAP_PAGE_LSN){
+    this->_getLsn()->lsn = lsn;
+  }
+}
+
+/**
+ * @brief Getter for the checksum region.
+ *
+ * @pre The Page has HEAP_PAGE_CHECKSUM set.
+ * @return Pointer to the PageChecksum of the Page.
+ */
+PageChecksum* HeapPage::_getChecksum(){
+  return (PageChecksum*) (this->data + sizeof(HeapPageHeader)
+      + extensionSize(this->_getPageHeader()->flags & HEAP_PAGE_SYNOPSIS));
+}
+
+/**
+ * @brief Computes the CRC32C of the Page, taking PageChecksum::crc and
+ *    HeapPageHeader::version as 0.
+ *
+ * @pre The Page has HEAP_PAGE_CHECKSUM set.
+ * @return Checksum of the Page contents.
+ */
+std::uint32_t HeapPage::_computeChecksum(){
+  HeapPageHeader header = *_getPageHeader();
+  header.version = 0;
+  std::uint32_t crc = crc32c(0, &header, sizeof(header));
+
+  const char* field = (const char*) &_getChecksum()->crc;
+  const std::uint32_t zero = 0;
+  crc = crc32c(crc, this->data + sizeof(HeapPageHeader),
+      field - (this->data + sizeof(HeapPageHeader)));
+  crc = crc32c(crc, &zero, sizeof(zero));
+  const char* rest = field + sizeof(zero);
+  return crc32c(crc, rest, (this->data + PAGE_SIZE) - rest);
+}
+
+/**
+ * @brief Widens the synopsis to cover the key of a record. Does nothing if
+ *    the Page has no synopsis.
+ *
+ * @param record Bytes of the record, not compressed.
+ * @param length Length of the record.
+ */
+void HeapPage::_addSynopsisKey(const char* record, std::uint32_t length){
+  if (!(this->_getPageHeader()->flags & HEAP_PAGE_SYNOPSIS)){
+    return;
+  }
+
+  PageSynopsis* synopsis = _getSynopsis();
+  unsigned char key[SYNOPSIS_KEY_BYTES];
+  synopsisKey(record, length, synopsis->key_length, key);
+
+  if (!synopsis->has_keys){
+    std::memcpy(synopsis->min_key, key, SYNOPSIS_KEY_BYTES);
+    std::memcpy(synopsis->max_key, key, SYNOPSIS_KEY_BYTES);
+    synopsis->has_keys = 1;
+  } else if (std::memcmp(key, synopsis->min_key, SYNOPSIS_KEY_BYTES) < 0){
+    std::memcpy(synopsis->min_key, key, SYNOPSIS_KEY_BYTES);
+  } else if (std::memcmp(key, synopsis->max_key, SYNOPSIS_KEY_BYTES) > 0){
+    std::memcpy(synopsis->max_key, key, SYNOPSIS_KEY_BYTES);
+  }
+  for (std::uint32_t i = 0; i < SYNOPSIS_BLOOM_HASHES; i++){
+    std::uint32_t bit = synopsisBloomBit(key, i);
+    synopsis->bloom[bit / 64] |= (std::uint64_t) 1 << (bit % 64);
+  }
+}
+
+/**
+ * @brief Checks that a SlotId is in the slot directory.
+ *
+ * @pre None.
+ * @post None.
+ *
+ * @param slot_id SlotId to check.
  *
  * @throw InvalidSlotIdHeapPage If slot_id is greter than or equal
  *    to capacity.
  */
-SlotInfo* HeapPage::_getSlotInfo(SlotId slot_id){
+void HeapPage::_checkSlotId(SlotId slot_id){
 
   HeapPageHeader* page_header = this->_getPageHeader();
 
   if (slot_id >= page_header->capacity){
-    throw InvalidSlotIdHeapPage(slot_id);
+    throwInvalidSlotId(slot_id);
+  }
+}
+
+/**
+ * @brief Checks that a SlotId is in the slot directory and holds a record.
+ *    Used to validate SlotIds once at the top of the public methods.
+ *
+ * @pre None.
+ * @post None.
+ *
+ * @param slot_id SlotId to check.
+ *
+ * @throw InvalidSlotIdHeapPage If slot_id is greater than or equal to
+ *    capacity, or the slot has INVALID_SLOT_OFFSET.
+ */
+void HeapPage::_checkValidSlotId(SlotId slot_id){
+
+  HeapPageHeader* page_header = this->_getPageHeader();
+
+  if (__builtin_expect(slot_id >= page_header->capacity ||
+        this->_getSlotOffset(slot_id) == INVALID_SLOT_OFFSET, 0)){
+    throwInvalidSlotId(slot_id);
+  }
+}
+
+/**
+ * @brief Getter for the size of one slot directory entry.
+ * @return sizeof(CompactSlotInfo) if the Page has compact slots,
+ *    sizeof(SlotInfo) otherwise.
+ */
+std::uint32_t HeapPage::_getSlotSize(){
+  if (this->_getPageHeader()->flags & HEAP_PAGE_COMPACT_SLOTS){
+    return sizeof(CompactSlotInfo);
+  }
+  return sizeof(SlotInfo);
+}
+
+/**
+ * @brief Getter for the offset of a slot, in either slot format.
+ *
+ * @pre slot_id is less than capacity.
+ * @return Offset of the record, INVALID_SLOT_OFFSET if the slot does not
+ *    hold one.
+ */
+std::uint32_t HeapPage::_getSlotOffset(SlotId slot_id){
+  if (this->_getPageHeader()->flags & HEAP_PAGE_COMPACT_SLOTS){
+    CompactSlotInfo* slot_directory =
+      (CompactSlotInfo*) this->_getSlotDirectory();
+    std::uint16_t offset = slot_directory[slot_id].offset;
+    return offset == COMPACT_INVALID_SLOT_OFFSET ? INVALID_SLOT_OFFSET
+      : offset;
+  }
+  return this->_getSlotDirectory()[slot_id].offset;
+}
+
+/**
+ * @brief Getter for the length field of a slot, in either slot format.
+ *
+ * @pre slot_id is less than capacity.
+ * @return Length of the record, or the next free slot if the slot is not
+ *    valid.
+ */
+std::uint32_t HeapPage::_getSlotLength(SlotId slot_id){
+  if (this->_getPageHeader()->flags & HEAP_PAGE_COMPACT_SLOTS){
+    return ((CompactSlotInfo*) this->_getSlotDirectory())[slot_id].length;
+  }
+  return this->_getSlotDirectory()[slot_id].length;
+}
+
+/**
+ * @brief Sets the offset of a slot, in either slot format.
+ *
+ * @pre slot_id is less than capacity.
+ *
+ * @param slot_id SlotId of the slot to change.
+ * @param offset New offset, or INVALID_SLOT_OFFSET.
+ */
+void HeapPage::_setSlotOffset(SlotId slot_id, std::uint32_t offset){
+  if (this->_getPageHeader()->flags & HEAP_PAGE_COMPACT_SLOTS){
+    ((CompactSlotInfo*) this->_getSlotDirectory())[slot_id].offset =
+      offset == INVALID_SLOT_OFFSET ? COMPACT_INVALID_SLOT_OFFSET : offset;
+    return;
+  }
+  this->_getSlotDirectory()[slot_id].offset = offset;
+}
+
+/**
+ * @brief Sets the length field of a slot, in either slot format.
+ *
+ * @pre slot_id is less than capacity.
+ *
+ * @param slot_id SlotId of the slot to change.
+ * @param length New length, or the next free slot.
+ */
+void HeapPage::_setSlotLength(SlotId slot_id, std::uint32_t length){
+  if (this->_getPageHeader()->flags & HEAP_PAGE_COMPACT_SLOTS){
+    ((CompactSlotInfo*) this->_getSlotDirectory())[slot_id].length = length;
+    return;
+  }
+  this->_getSlotDirectory()[slot_id].length = length;
+}
+
+/**
+ * @brief Pushes an invalid slot on the front of the free slot list.
+ *
+ * @pre slot_id is less than capacity and its offset is INVALID_SLOT_OFFSET.
+ *    It is not already in the list.
+ * @post slot_id is the head of the free slot list.
+ *
+ * @param slot_id SlotId of the slot to add to the list.
+ */
+void HeapPage::_pushFreeSlot(SlotId slot_id){
+  HeapPageHeader* header = _getPageHeader();
+
+  _setSlotLength(slot_id, header->free_slot_head);
+  header->free_slot_head = slot_id;
+}
+
+/**
+ * @brief Removes the head of the free slot list.
+ *
+ * @pre None.
+ * @post The returned slot is no longer in the free slot list.
+ *
+ * @return SlotId of an invalid slot that can be reused, or INVALID_SLOT_ID
+ *    if the list is empty.
+ */
+SlotId HeapPage::_popFreeSlot(){
+  HeapPageHeader* header = _getPageHeader();
+
+  if (header->free_slot_head == FREE_SLOT_LIST_END){
+    return INVALID_SLOT_ID;
+  }
+  SlotId slot_id = header->free_slot_head;
+  header->free_slot_head = _getSlotLength(slot_id);
+  return slot_id;
+}
+
+/**
+ * @brief Shrinks the slot directory past all trailing invalid slots.
+ *
+ * @pre None.
+ * @post capacity and free_space_begin are reduced so that the last slot in
+ *    the directory is valid (or the directory is empty), and any removed
+ *    slots are unlinked from the free slot list.
+ */
+void HeapPage::_shrinkSlotDirectory(){
+  HeapPageHeader* header = _getPageHeader();
+  std::uint32_t capacity = header->capacity;
+
+  while (capacity> 0){
+    if (_getSlotOffset(capacity - 1) != INVALID_SLOT_OFFSET){
+      break;
+    }
+    capacity--;
+  }
+
+  if (capacity == header->capacity){
+    return;
+  }
+
+  HEAPPAGE_STAT(HEAP_PAGE_STAT_DIRECTORY_SHRINKS, 1);
+  HEAPPAGE_STAT(HEAP_PAGE_STAT_DIRECTORY_SLOTS_REMOVED,
+      header->capacity - capacity);
+  std::uint32_t size = (header->capacity - capacity) * _getSlotSize();
+  header->capacity = capacity;
+  header->free_space_begin -= size;
+
+  //unlink the removed slots; their entries are still intact past
+  //free_space_begin until the next insert
+  SlotId prev = INVALID_SLOT_ID;
+  SlotId cur = header->free_slot_head;
+  while (cur != FREE_SLOT_LIST_END){
+    HEAPPAGE_STAT(HEAP_PAGE_STAT_SLOT_SCAN_LENGTH, 1);
+    SlotId next = _getSlotLength(cur);
+    if (cur < capacity){
+      prev = cur;
+    } else if (prev == INVALID_SLOT_ID){
+      header->free_slot_head = next;
+    } else {
+      _setSlotLength(prev, next);
+    }
+    cur = next;
   }
-  return &(this->_getSlotDirectory()[slot_id]);
 }
 
 /** @brief helper method for insertRecord and updateRecord 
@@ -466,7 +2738,8 @@ SlotInfo* HeapPage::_getSlotInfo(SlotId slot_id){
  * except for finding the inserted record's slot id, which is passed to it.
  *
  * @param slot_id SlotId of where the record is to be inserted.  @param
- * record_data: a pointer to the record Data to insert in the page
+ * record: the bytes to store in the page, already compressed on a
+ * compressed page.  @param length: the number of bytes to store
  *
  * @pre the caller ensures that the passed slot_id can be used to insert
  * the record, and that there is enough space on the page to insert the
@@ -476,28 +2749,24 @@ SlotInfo* HeapPage::_getSlotInfo(SlotId slot_id){
  * slot directory (it is passed a valid slot_id to use for the inserted
  * record).
  *
- * @throw InvalidSlotIdHeapPage If SlotId is out of range.
+ * @throw InvalidSlotIdHeapPage If SlotId is out of range. Only checked
+ *    when built with HEAPPAGE_CHECK_INTERNAL.
  */
-void HeapPage::_insertRecord(SlotId slot_id, Data* record_data){
+void HeapPage::_insertRecord(SlotId slot_id, const char* record,
+    std::uint32_t length){
   HeapPageHeader* page_header = this->_getPageHeader();
 
-  //throw exceptions
-  if( slot_id >= page_header->capacity ){
-    throw InvalidSlotIdHeapPage(slot_id);
-  }
-
   // insert the record into the Page and change the slot entry
-  SlotInfo* slot_info = this->_getSlotInfo( slot_id );
+  HEAPPAGE_INTERNAL_CHECK_SLOT( slot_id );
 
-  std::uint32_t record_length = record_data->getSize();
+  std::uint32_t record_length = length;
   page_header->free_space_end  -= record_length;
   std::uint32_t record_offset = page_header->free_space_end;
 
-  std::memcpy( ((char*)this->data + record_offset), 
-  record_data->getData(), record_length );
+  std::memcpy( ((char*)this->data + record_offset), record, record_length );
 
-  slot_info->offset = record_offset;
-  slot_info->length = record_length;
+  _setSlotOffset( slot_id, record_offset );
+  _setSlotLength( slot_id, record_length );
   page_header->size++;
 }
 
@@ -512,50 +2781,76 @@ void HeapPage::_insertRecord(SlotId slot_id, Data* record_data){
  *
  * @pre the caller ensures that the passed slot_id is valid
  * @post the record is deleted from the Page, and remaining records
- *       are compacted on the page.  The deleted record's
+ *       are compacted on the page (in deferred compaction mode the freed
+ *       bytes are added to fragmented_bytes instead).  The deleted record's
  *       offest in the slot directory is set to INVALID_SLOT_OFFSET.
  *       The Page's free space is updated to reflect the deletion.
  *       THIS method DOES NOT shrink the slot directory.
  *
  * @throw InvalidSlotIdHeapPage If SlotId is invalid (SlotId is
  *    out of range or SlotInfo of the given SlotId has INVALID_SLOT_OFFSET).
+ *    Only checked when built with HEAPPAGE_CHECK_INTERNAL.
  */
 void HeapPage::_deleteRecord(SlotId slot_id){
   HeapPageHeader* header = _getPageHeader();
-  SlotInfo* slot = _getSlotInfo(slot_id);
+  HEAPPAGE_INTERNAL_CHECK_VALID_SLOT(slot_id);
 
-  //throw exceptions
-  if (slot->offset == INVALID_SLOT_OFFSET || slot_id >= header->capacity) {
-    throw InvalidSlotIdHeapPage(slot_id); 
-  }
-
-  std::uint32_t offset = slot->offset;
-  std::uint32_t length = slot->length;
+  std::uint32_t offset = _getSlotOffset(slot_id);
+  std::uint32_t length = _getSlotLength(slot_id);
 
   //delete the record from the Page
-  slot->offset = INVALID_SLOT_OFFSET;
-  slot->length = 0;
+  _setSlotOffset(slot_id, INVALID_SLOT_OFFSET);
+  _setSlotLength(slot_id, 0);
   header->size--;
 
   //do not compact the pages
-  if (offset + length == header->free_space_end){
+  if (offset == header->free_space_end){
     header->free_space_end += length;
     return;
   }
 
+  //leave the hole for a later compaction
+  if (header->flags & HEAP_PAGE_DEFERRED_COMPACTION){
+    header->fragmented_bytes += length;
+    return;
+  }
+
   //compact the other pages
-  std::uint32_t size = offset - header->free_space_end; 
-  memmove(this->data + header->free_space_end + length, 
-    this->data + header->free_space_end, size);
+  _closeGap(offset, length);
+}
 
-  SlotInfo* slot_directory = _getSlotDirectory();
-  for (std::uint32_t i = 0; i < header->capacity; i++){
-    SlotInfo& tmp = slot_directory[i];
-    if (tmp.offset != INVALID_SLOT_OFFSET && tmp.offset < offset){
-      tmp.offset += length;
+/**
+ * @brief helper method for _deleteRecord and updateRecord
+ *
+ * Slides every record stored below a gap of unused bytes up by the size of
+ * the gap, so that the records stay compacted at the end of the page.
+ *
+ * @param offset offset of the first byte of the gap.
+ * @param length number of bytes in the gap.
+ *
+ * @pre No valid slot points into [offset, offset + length), and every
+ *      record in front of the gap is between free_space_end and offset.
+ * @post The records in front of the gap are moved up by length bytes,
+ *       their slot entries are updated and free_space_end is raised by
+ *       length.
+ */
+void HeapPage::_closeGap(std::uint32_t offset, std::uint32_t length){
+  HeapPageHeader* header = _getPageHeader();
+
+  if (offset != header->free_space_end){
+    std::uint32_t size = offset - header->free_space_end; 
+    memmove(this->data + header->free_space_end + length, 
+      this->data + header->free_space_end, size);
+    HEAPPAGE_STAT(HEAP_PAGE_STAT_COMPACTION_BYTES, size);
+    HEAPPAGE_STAT(HEAP_PAGE_STAT_SLOT_SCAN_LENGTH, header->capacity);
+
+    for (std::uint32_t i = 0; i < header->capacity; i++){
+      std::uint32_t slot_offset = _getSlotOffset(i);
+      if (slot_offset != INVALID_SLOT_OFFSET && slot_offset < offset){
+        _setSlotOffset(i, slot_offset + length);
+      }
     }
   }
 
   header->free_space_end += length;
-
 }
\ No newline at end of file
@@ -7,21 +7,135 @@
  */
 
 #include <cstddef>
+#include <cstdint>
 #include <mutex>
+#include <vector>
 #include "swatdb_types.h"
 #include "page.h"
 
 class Data;
+class RecordArena;
 
 /**
  * HeapPage class.
  */
 class HeapPage;
 
+/**
+ * HeapPageHeader::flags bit: deleteRecord and updateRecord only mark the
+ * freed bytes as fragmented instead of compacting the page right away.
+ * Compaction is deferred until an insert or update needs contiguous space,
+ * or until compact() is called.
+ */
+const std::uint16_t HEAP_PAGE_DEFERRED_COMPACTION = 0x0001;
+
+/**
+ * HeapPageHeader::flags bit: records are compressed when they are inserted
+ * or updated and decompressed by getRecord. Slot lengths, free space and
+ * compaction all work on the compressed (stored) bytes, so more records
+ * fit on the Page. Pages with and without the flag can be mixed in a file.
+ */
+const std::uint16_t HEAP_PAGE_COMPRESSION = 0x0002;
+
+/**
+ * HeapPageHeader::flags bit: the slot directory holds 4-byte
+ * CompactSlotInfo entries instead of SlotInfo. Chosen when the Page is
+ * initialized (see HeapPage::initializeHeader) and never changed after.
+ */
+const std::uint16_t HEAP_PAGE_COMPACT_SLOTS = 0x0004;
+
+/**
+ * HeapPageHeader::flags bit: the Page keeps a PageSynopsis of the keys of
+ * its records (see HeapPage::synopsisMayMatch). Chosen when the Page is
+ * initialized and never changed after.
+ */
+const std::uint16_t HEAP_PAGE_SYNOPSIS = 0x0008;
+
+/**
+ * HeapPageHeader::flags bit: the Page keeps a CRC32C of its contents in a
+ * PageChecksum (see HeapPage::updateChecksum and HeapPage::verifyChecksum).
+ * Chosen when the Page is initialized and never changed after.
+ */
+const std::uint16_t HEAP_PAGE_CHECKSUM = 0x0010;
+
+/**
+ * HeapPageHeader::flags bit: the Page keeps the LSN of the last log record
+ * applied to it in a PageLsn (see HeapPage::setLogSink and HeapPage::redo).
+ * Chosen when the Page is initialized and never changed after.
+ */
+const std::uint16_t HEAP_PAGE_LSN = 0x0020;
+
+/**
+ * HeapPageHeader::flags bit: every stored record starts with a
+ * RecordVersion, deletes and updates keep the versions they replace for
+ * snapshot reads (see HeapPage::getRecord with a snapshot), and space is
+ * only reclaimed by HeapPage::prune. Old versions occupy slots of their
+ * own, which count in the size (getNumRecs) of the Page. Chosen when the
+ * Page is initialized and never changed after; cannot be combined with
+ * HEAP_PAGE_COMPRESSION.
+ */
+const std::uint16_t HEAP_PAGE_MVCC = 0x0040;
+
+/**
+ * RecordVersion::xmax of a version that has not been deleted or replaced.
+ */
+const std::uint64_t MVCC_TIMESTAMP_INFINITY = UINT64_MAX;
+
+/**
+ * Snapshot that sees the latest version of every record, the default of
+ * HeapPageScanner.
+ */
+const std::uint64_t MVCC_LATEST_SNAPSHOT = UINT64_MAX - 1;
+
+/**
+ * RecordVersion::flags bit: the version was replaced by an update and is
+ * only reachable through the prev_slot chain of the current version.
+ */
+const std::uint16_t RECORD_VERSION_OLD = 0x0001;
+
+/**
+ * Longest key prefix, in bytes, a PageSynopsis summarizes.
+ */
+const std::uint32_t SYNOPSIS_KEY_BYTES = 8;
+
+/**
+ * Number of bits of the bloom filter of a PageSynopsis.
+ */
+const std::uint32_t SYNOPSIS_BLOOM_BITS = 256;
+
+/**
+ * Number of bloom filter bits set per key.
+ */
+const std::uint32_t SYNOPSIS_BLOOM_HASHES = 3;
+
+/**
+ * CompactSlotInfo::offset of a slot that does not hold a record.
+ */
+const std::uint16_t COMPACT_INVALID_SLOT_OFFSET = UINT16_MAX;
+
+/**
+ * Terminator of the free slot list (HeapPageHeader::free_slot_head and the
+ * length field of invalid SlotInfo entries).
+ */
+const std::uint16_t FREE_SLOT_LIST_END = UINT16_MAX;
+
+/**
+ * Number of bytes of free space per free space class. A HeapPage of free
+ * space class c has at least c * FREE_SPACE_CLASS_BYTES bytes of free space
+ * (see HeapPage::getFreeSpaceClass), so a class fits in one byte.
+ */
+const std::uint32_t FREE_SPACE_CLASS_BYTES = PAGE_SIZE / 256;
+
+static_assert(PAGE_SIZE % 256 == 0,
+    "free space classes need PAGE_SIZE to be a multiple of 256");
+
 /**
  * Struct for the header metadata of HeapPage object. The header is type
  * cast * on top of the Page data array, from the beginning of the array. 
  * Must follow 64bit alignment.
+ *
+ * Offsets and counters are bounded by PAGE_SIZE, so they are stored in 16
+ * bits. This keeps the header at 24 bytes, which MAX_RECORD_SIZE assumes.
  */
 struct HeapPageHeader{
 
@@ -38,24 +152,55 @@ struct HeapPageHeader{
   /**
    * Offset where free space begins in the Page.
    */
-  std::uint32_t free_space_begin;
+  std::uint16_t free_space_begin;
 
   /**
    * Offset where free space ends in the Page.
    */
-  std::uint32_t free_space_end;
+  std::uint16_t free_space_end;
 
   /**
    * Number of valid/used slots.
    */
-  std::uint32_t size;
+  std::uint16_t size;
 
  /**
   * Number of allocated slots (size of the slot directory).
   */
-  std::uint32_t capacity;
+  std::uint16_t capacity;
+
+  /**
+   * Number of bytes of deleted records below free_space_end that have not
+   * been reclaimed by compaction yet. Always 0 unless
+   * HEAP_PAGE_DEFERRED_COMPACTION is set.
+   */
+  std::uint16_t fragmented_bytes;
+
+  /**
+   * HEAP_PAGE_* mode bits.
+   */
+  std::uint16_t flags;
+
+  /**
+   * SlotId of the first invalid slot in the free slot list, or
+   * FREE_SLOT_LIST_END if every slot in the directory is used.
+   */
+  std::uint16_t free_slot_head;
+
+  /**
+   * Seqlock version of the Page. Odd while a writer holds the write latch,
+   * and advanced by two by every insert, delete or update. Readers that
+   * see the same even version before and after reading got a consistent
+   * view of the Page. The version is stored with the Page and is not
+   * covered by the checksum, so a Page written out while latched comes
+   * back latched: whoever reads a Page in calls HeapPage::resetLatch.
+   */
+  std::uint16_t version;
 };
 
+static_assert(PAGE_SIZE <= UINT16_MAX,
+    "HeapPageHeader stores page offsets in 16 bits");
+
 /**
  * Struct for storing metadata of each slot in a Page. An array of SlotInfo
  * forms the slot directory of the Page. 
@@ -70,11 +215,486 @@ struct SlotInfo{
   uint32_t offset;
 
   /**
-   * Length of the record in the slot described by the SlotInfo
+   * Length of the record in the slot described by the SlotInfo. If the
+   * slot is not valid, SlotId of the next slot in the free slot list
+   * (FREE_SLOT_LIST_END for the last one).
    */
   uint32_t length;
 };
 
+/**
+ * Slot directory entry of a HeapPage initialized with
+ * HEAP_PAGE_COMPACT_SLOTS. Offsets and lengths within a Page fit in 16 bits,
+ * so it holds the same information as SlotInfo in half the space, which
+ * matters on pages of small records.
+ */
+struct CompactSlotInfo{
+
+  /**
+   * Offset of the record, or COMPACT_INVALID_SLOT_OFFSET if the slot does
+   * not hold a record.
+   */
+  std::uint16_t offset;
+
+  /**
+   * Length of the record, or the next slot in the free slot list if the
+   * slot is not valid (like SlotInfo::length).
+   */
+  std::uint16_t length;
+};
+
+/**
+ * Summary of the keys on a Page initialized with HEAP_PAGE_SYNOPSIS. The
+ * key of a record is its first key_length bytes, zero padded to
+ * SYNOPSIS_KEY_BYTES if the record is shorter, compared as unsigned bytes.
+ *
+ * Optional regions like this one sit between the HeapPageHeader and the
+ * slot directory, in the order of their flag bits. Every region is a
+ * multiple of 8 bytes, so the slot directory stays aligned.
+ *
+ * Inserts and updates widen the synopsis; deletes leave it as it is, so it
+ * may cover keys that are no longer on the Page until
+ * HeapPage::rebuildSynopsis is called.
+ */
+struct PageSynopsis{
+
+  /**
+   * Number of leading record bytes that form the key.
+   */
+  std::uint16_t key_length;
+
+  /**
+   * 1 if min_key and max_key hold a key, 0 if no key was added since the
+   * synopsis was last cleared.
+   */
+  std::uint16_t has_keys;
+
+  /**
+   * Unused, keeps the keys 8 byte aligned.
+   */
+  std::uint32_t reserved;
+
+  /**
+   * Smallest key added.
+   */
+  unsigned char min_key[SYNOPSIS_KEY_BYTES];
+
+  /**
+   * Largest key added.
+   */
+  unsigned char max_key[SYNOPSIS_KEY_BYTES];
+
+  /**
+   * Bloom filter of the keys added.
+   */
+  std::uint64_t bloom[SYNOPSIS_BLOOM_BITS / 64];
+};
+
+static_assert(sizeof(PageSynopsis) % 8 == 0,
+    "optional page regions keep the slot directory 8 byte aligned");
+
+/**
+ * Checksum region of a Page initialized with HEAP_PAGE_CHECKSUM. It follows
+ * the PageSynopsis, if any.
+ */
+struct PageChecksum{
+
+  /**
+   * CRC32C of the Page as of the last HeapPage::updateChecksum, computed
+   * with this field and HeapPageHeader::version taken as 0.
+   */
+  std::uint32_t crc;
+
+  /**
+   * Unused, keeps the slot directory 8 byte aligned.
+   */
+  std::uint32_t reserved;
+};
+
+static_assert(sizeof(PageChecksum) % 8 == 0,
+    "optional page regions keep the slot directory 8 byte aligned");
+
+/**
+ * LSN region of a Page initialized with HEAP_PAGE_LSN. It follows the
+ * PageChecksum, if any.
+ */
+struct PageLsn{
+
+  /**
+   * LSN of the last log record applied to the Page, 0 if none.
+   */
+  std::uint64_t lsn;
+};
+
+static_assert(sizeof(PageLsn) % 8 == 0,
+    "optional page regions keep the slot directory 8 byte aligned");
+
+/**
+ * Kind of a SynopsisPredicate.
+ */
+enum SynopsisPredicateKind{
+
+  /**
+   * Matches records whose key equals low.
+   */
+  SYNOPSIS_KEY_EQUAL,
+
+  /**
+   * Matches records whose key is between low and high, inclusive.
+   */
+  SYNOPSIS_KEY_RANGE
+};
+
+/**
+ * Predicate on record keys that a PageSynopsis can rule a Page out for.
+ * Keys are taken like PageSynopsis takes them from records: the first
+ * key_length bytes of the Page, zero padded.
+ */
+struct SynopsisPredicate{
+
+  /**
+   * SYNOPSIS_KEY_EQUAL or SYNOPSIS_KEY_RANGE.
+   */
+  SynopsisPredicateKind kind;
+
+  /**
+   * Key to compare against, or the lower bound of a range. NULL for a
+   * range with no lower bound.
+   */
+  const char* low;
+
+  /**
+   * Length in bytes of low.
+   */
+  std::uint32_t low_length;
+
+  /**
+   * Upper bound of a range, NULL for none. Unused by SYNOPSIS_KEY_EQUAL.
+   */
+  const char* high;
+
+  /**
+   * Length in bytes of high.
+   */
+  std::uint32_t high_length;
+};
+
+/**
+ * Read-only view of a record stored on a HeapPage. The view points into the
+ * Page data array, so it is only valid while the Page stays pinned and the
+ * record is not modified (any insert, delete or update on the Page may move
+ * records).
+ */
+struct RecordView{
+
+  /**
+   * Address of the first byte of the record in the Page.
+   */
+  const char* data;
+
+  /**
+   * Length of the record in bytes.
+   */
+  std::uint32_t length;
+};
+
+/**
+ * Snapshot of the layout of one HeapPage, returned by
+ * HeapPage::getPageState for exporting per-page metrics. Process-wide
+ * counters of HeapPage operations are in heappagestats.h.
+ */
+struct HeapPageState{
+
+  /**
+   * Number of slots in the slot directory.
+   */
+  std::uint32_t capacity;
+
+  /**
+   * Number of valid slots.
+   */
+  std::uint32_t size;
+
+  /**
+   * Number of invalid slots in the slot directory.
+   */
+  std::uint32_t invalid_slots;
+
+  /**
+   * Offset where free space begins.
+   */
+  std::uint32_t free_space_begin;
+
+  /**
+   * Offset where free space ends.
+   */
+  std::uint32_t free_space_end;
+
+  /**
+   * Free space as returned by HeapPage::getFreeSpace.
+   */
+  std::uint32_t free_space;
+
+  /**
+   * Bytes of deleted records not reclaimed yet.
+   */
+  std::uint32_t fragmented_bytes;
+
+  /**
+   * HEAP_PAGE_* mode bits of the Page.
+   */
+  std::uint16_t flags;
+
+  /**
+   * Seqlock version of the Page.
+   */
+  std::uint16_t version;
+};
+
+/**
+ * Interface for being told when the free space class of a HeapPage
+ * changes. FreeSpaceMap implements it to keep a file-level summary of the
+ * free space of its pages up to date.
+ */
+class FreeSpaceListener {
+
+  public:
+
+    /**
+     * @brief Destructor.
+     */
+    virtual ~FreeSpaceListener() {}
+
+    /**
+     * @brief Called after an insert, delete, update or compaction changed
+     *    the free space class of page.
+     *
+     * @pre The write latch of page has been released.
+     * @post None.
+     *
+     * @param page HeapPage that was modified.
+     * @param free_space_class New free space class of page.
+     */
+    virtual void freeSpaceChanged(HeapPage* page,
+        std::uint8_t free_space_class) = 0;
+};
+
+/**
+ * Version header in front of every record on a Page initialized with
+ * HEAP_PAGE_MVCC. Timestamps come from the process-wide write clock (see
+ * HeapPage::takeSnapshot); a version is visible to snapshot s if
+ * xmin <= s < xmax. Records are not aligned, so it is copied in and out.
+ */
+struct RecordVersion{
+
+  /**
+   * Timestamp of the write that created the version.
+   */
+  std::uint64_t xmin;
+
+  /**
+   * Timestamp of the write that deleted or replaced the version, or
+   * MVCC_TIMESTAMP_INFINITY.
+   */
+  std::uint64_t xmax;
+
+  /**
+   * SlotId of the version this one replaced, or FREE_SLOT_LIST_END.
+   */
+  std::uint16_t prev_slot;
+
+  /**
+   * RECORD_VERSION_* bits.
+   */
+  std::uint16_t flags;
+
+  /**
+   * Unused.
+   */
+  std::uint32_t reserved;
+};
+
+/**
+ * A record moved to another slot by HeapPage::packSlotDirectory.
+ */
+struct SlotMove{
+
+  /**
+   * SlotId the record had.
+   */
+  SlotId from;
+
+  /**
+   * SlotId the record has now.
+   */
+  SlotId to;
+};
+
+/**
+ * Kind of change described by a HeapPageLogRecord. The underlying type is
+ * fixed so that a record read back from a log with an unknown type still
+ * holds a valid value, which redo rejects.
+ */
+enum HeapPageLogType : std::uint32_t{
+
+  /**
+   * initializeHeader; value holds the flags.
+   */
+  HEAP_PAGE_LOG_INIT,
+
+  /**
+   * setNext; value holds the PageNum.
+   */
+  HEAP_PAGE_LOG_SET_NEXT,
+
+  /**
+   * setPrev; value holds the PageNum.
+   */
+  HEAP_PAGE_LOG_SET_PREV,
+
+  /**
+   * Insert of the record bytes into slot_id, stored at offset.
+   */
+  HEAP_PAGE_LOG_INSERT,
+
+  /**
+   * Delete of the record in slot_id, which was stored at offset.
+   */
+  HEAP_PAGE_LOG_DELETE,
+
+  /**
+   * deleteRecords; bytes holds the array of SlotIds.
+   */
+  HEAP_PAGE_LOG_DELETE_MANY,
+
+  /**
+   * Update of the record in slot_id to the record bytes, stored at offset
+   * afterwards.
+   */
+  HEAP_PAGE_LOG_UPDATE,
+
+  /**
+   * compact.
+   */
+  HEAP_PAGE_LOG_COMPACT,
+
+  /**
+   * setDeferredCompaction; value is 1 to enable, 0 to disable.
+   */
+  HEAP_PAGE_LOG_SET_DEFERRED,
+
+  /**
+   * setCompression; value is 1 to enable, 0 to disable.
+   */
+  HEAP_PAGE_LOG_SET_COMPRESSION,
+
+  /**
+   * setSynopsisKeyLength; value holds the key length.
+   */
+  HEAP_PAGE_LOG_SET_KEY_LENGTH,
+
+  /**
+   * rebuildSynopsis.
+   */
+  HEAP_PAGE_LOG_REBUILD_SYNOPSIS,
+
+  /**
+   * prune; timestamp holds the horizon.
+   */
+  HEAP_PAGE_LOG_PRUNE,
+
+  /**
+   * packSlotDirectory.
+   */
+  HEAP_PAGE_LOG_PACK_SLOTS
+};
+
+/**
+ * Redo record of one change to a HeapPage. Records are physiological: they
+ * name the slot and the record bytes rather than every byte the change
+ * moved, and HeapPage::redo repeats the change, which moves records the
+ * same way because a Page is only ever redone from the state it was logged
+ * in. offset is only used to check that.
+ */
+struct HeapPageLogRecord{
+
+  /**
+   * Kind of change.
+   */
+  HeapPageLogType type;
+
+  /**
+   * SlotId of the record inserted, deleted or updated.
+   */
+  SlotId slot_id;
+
+  /**
+   * Offset of the record after an insert or update, or before a delete.
+   */
+  std::uint32_t offset;
+
+  /**
+   * Argument of header changes (see HeapPageLogType).
+   */
+  std::uint32_t value;
+
+  /**
+   * Record bytes of an insert or update as given to the HeapPage, before
+   * compression, or the SlotIds of HEAP_PAGE_LOG_DELETE_MANY. NULL for
+   * other changes. Only valid during HeapPageLogSink::logRecord.
+   */
+  const char* bytes;
+
+  /**
+   * Number of bytes.
+   */
+  std::uint32_t length;
+
+  /**
+   * LSN of the record. 0 when given to HeapPageLogSink::logRecord, which
+   * assigns it.
+   */
+  std::uint64_t lsn;
+
+  /**
+   * Write timestamp of the change on a HEAP_PAGE_MVCC Page (the horizon of
+   * HEAP_PAGE_LOG_PRUNE), 0 on other Pages.
+   */
+  std::uint64_t timestamp;
+};
+
+/**
+ * Interface of the log that HeapPage changes are written to (see
+ * HeapPage::setLogSink).
+ */
+class HeapPageLogSink {
+
+  public:
+
+    /**
+     * @brief Destructor.
+     */
+    virtual ~HeapPageLogSink() {}
+
+    /**
+     * @brief Called after a change was applied to page, while the write
+     *    latch of page is still held, so the records of one Page reach the
+     *    sink in the order they were applied.
+     *
+     * @pre None.
+     * @post The sink copied what it needs from record; it must not access
+     *    page.
+     *
+     * @param page HeapPage that was modified.
+     * @param record Redo record of the change.
+     * @return LSN assigned to record. It becomes the LSN of page, so the
+     *    buffer manager can flush the log up to HeapPage::getPageLsn before
+     *    writing the Page out.
+     */
+    virtual std::uint64_t logRecord(HeapPage* page,
+        const HeapPageLogRecord& record) = 0;
+};
+
 /**
  * SwatDB HeapPage Class.
  * HeapPage inherits from base Page class and instantiates heap page, 
@@ -112,6 +732,29 @@ class HeapPage : public Page {
      */
     void initializeHeader();
 
+    /**
+     * @brief Initializes header information with the given flags.
+     *
+     * @pre flags is a combination of HEAP_PAGE_DEFERRED_COMPACTION,
+     *    HEAP_PAGE_COMPRESSION, HEAP_PAGE_COMPACT_SLOTS,
+     *    HEAP_PAGE_SYNOPSIS, HEAP_PAGE_CHECKSUM, HEAP_PAGE_LSN and
+     *    HEAP_PAGE_MVCC.
+     * @post Same as initializeHeader(), and the header flags are set to
+     *    flags. HEAP_PAGE_COMPACT_SLOTS, HEAP_PAGE_SYNOPSIS,
+     *    HEAP_PAGE_CHECKSUM, HEAP_PAGE_LSN and HEAP_PAGE_MVCC can only be
+     *    chosen here.
+     *    With HEAP_PAGE_SYNOPSIS free_space_begin is past the
+     *    PageSynopsis, whose key length is SYNOPSIS_KEY_BYTES. With
+     *    HEAP_PAGE_CHECKSUM it is past the PageChecksum, which matches the
+     *    new Page, and with HEAP_PAGE_LSN past the PageLsn.
+     *
+     * @param flags HeapPageHeader::flags of the new Page.
+     *
+     * @throw std::invalid_argument If flags has both HEAP_PAGE_MVCC and
+     *    HEAP_PAGE_COMPRESSION.
+     */
+    void initializeHeader(std::uint16_t flags);
+
     /**
      * @brief Sets next_page to the given PageNum.
      *
@@ -143,140 +786,590 @@ class HeapPage : public Page {
     PageNum getNext();
 
     /**
-     * @brief Getter for prev_page.
+     * @brief Getter for prev_page.
+     *
+     * @pre None.
+     * @post prev_page of the Page header is returned.
+     *
+     * @return PageNum of the previous Page.
+     */
+    PageNum getPrev();
+
+
+    /**
+     * @brief Getter for the amount of free space on the Page
+     * that is available to insert a new record.
+     *
+     * @pre None.
+     * @post The amount of free space, in number of bytes, that is
+     *    available for inserting a record on the page is returned.
+     *    If there are no free slot, then sizeof(SlotInfo) is subtracted 
+     *    from the free space returned (accounting for the extra space 
+     *    needed when a new slot is allocated).
+     *    If the amount of available free space is less than sizeof(SlotInfo),
+     *    then 0 is returned. Fragmented bytes left by deferred compaction
+     *    are counted as free, since an insert compacts them on demand.
+     *
+     * @return Amount of free space in bytes on the Page.
+     */
+    std::uint32_t getFreeSpace();
+
+
+    /**
+     * @brief bool function indicating whether the Page is full.
+     *
+     * @pre None.
+     * @post return true if the page is full: no record of any positive
+     *         size could be added. false, otherwise.
+     *
+     * @return bool indicating whether the Page is full.
+     */
+    bool isFull();
+
+    /**
+     * @brief bool function indicating whether the Page is empty.
+     *
+     * @pre None.
+     * @post true is returned if size is 0. Else false is returned.
+     *
+     * @return bool indicating whether the Page is empty.
+     */
+    bool isEmpty();
+
+    /**
+     * @brief Inserts given record data to the Page.
+     *
+     * If there is enough free space on the Page, and valid record data
+     * is passed (the Data value has non-zero length), then the
+     * data are inserted into the page.
+     *
+     * @pre: the slot directory has m used slots in its slot directory
+     *       and all m records are compacted at the bottom of the page.
+     * @post: after a successful insert, it has m+1 used slots in its
+     *        solt directory (possibly increasing the slot directory
+     *        size by one entry), and all m+1 records are compacted at
+     *        the bottom of the page.
+     *
+     * @param record_data (a pointer to a Data of a record) to be inserted.
+     *
+     * @return SlotId value of the slot the record is inserted to.
+     *
+     * @throw InsufficientSpaceHeapPage If there is not enough space to insert
+     *   the record  on the page.
+     * @throw EmptyDataHeapPage. If the passed record data is size 0.
+     */
+    SlotId insertRecord(Data *record_data);
+
+    /**
+     * @brief Inserts as many of the given records as fit on the Page, in
+     *    order, in a single pass.
+     *
+     * The free space is checked once for the whole batch, the slot
+     * directory grows at most once, and the records are copied into one
+     * contiguous region. The Page ends up in the same state as after
+     * calling insertRecord on each accepted record in turn.
+     *
+     * @pre records and slot_ids hold at least num_records entries.
+     * @post The first n records (n is the return value) are inserted, and
+     *    slot_ids[i] is the SlotId of records[i] for i < n. Records from
+     *    index n on did not fit and were not inserted (records[n] does not
+     *    fit; a later smaller record might).
+     *
+     * @param records array of pointers to the Data of the records.
+     * @param num_records number of records in the array.
+     * @param slot_ids array to fill in with the SlotIds of inserted records.
+     *
+     * @return Number of records inserted. 0 if the first record does not
+     *    fit on the Page.
+     *
+     * @throw EmptyDataHeapPage If any of the records is size 0. No record
+     *    is inserted in that case.
+     */
+    std::uint32_t insertRecords(Data **records, std::uint32_t num_records,
+        SlotId *slot_ids);
+
+    /** 
+     * * @brief Gets the record identified by its SlotId
+     *
+     * @pre A valid SlotId is provided as input and a valid Data with capacity
+     *    that is greater than maximum size of any record stored in the Page
+     *    is passed.
+     * @post The data field of record_data contains a copy of the
+     *     requsted record data stored in the Page, and the size
+     *     the size of Data object is set to the number of bytes of the
+     *     record. The copy is retried until no writer modified the Page
+     *     while it was made.
+     *
+     * @param slot_id SlotId value of the record to be retrieved
+     *
+     * @throw InvalidSlotIdHeapPage If slot_id is out of range or
+     *        SlotInfo of the given SlotId has INVALID_SLOT_OFFSET.
+     * @throw InvalidSizeData if the size of data is not large enough
+     * @throw std::runtime_error If the slot points outside the Page or the
+     *        record cannot be decoded while no writer changes the Page.
+     */
+    void getRecord(SlotId slot_id, Data *data);
+
+    /**
+     * @brief Gets the version of a record visible to a snapshot.
+     *
+     * @pre The Page has HEAP_PAGE_MVCC set, a valid Data with capacity that
+     *    is greater than maximum size of any record stored in the Page is
+     *    passed, and snapshot is not older than the horizon of the last
+     *    prune.
+     * @post If a version of the record in slot_id is visible to snapshot,
+     *    record_data holds a copy of it. Like getRecord, the copy is
+     *    retried until no writer modified the Page while it was made; no
+     *    latch is taken.
+     *
+     * @param slot_id SlotId of the record, as returned by insertRecord.
+     * @param record_data Data to copy the version into.
+     * @param snapshot Snapshot to read as of, from takeSnapshot.
+     * @return false if no version of the record is visible to snapshot.
+     *
+     * @throw std::logic_error If the Page has no HEAP_PAGE_MVCC.
+     * @throw InvalidSizeData if the size of record_data is not large enough
+     * @throw std::runtime_error If the visible version's slot points outside
+     *        the Page while no writer changes the Page.
+     */
+    bool getRecord(SlotId slot_id, Data *record_data, std::uint64_t snapshot);
+
+    /**
+     * @brief Copies a batch of records into an arena.
+     *
+     * Same as calling getRecord for each slot, but the copies go to one
+     * RecordArena instead of one Data per record, and the whole batch is
+     * read in one seqlock read: the copy is retried, after rewinding the
+     * arena, until no writer modified the Page while it was made.
+     *
+     * @pre The Page is pinned. slot_ids and records hold num_slots entries.
+     * @post records[i] points at a copy in arena of the record in
+     *    slot_ids[i], decompressed on a compressed Page, and stays valid
+     *    until arena is reset. If an exception is thrown the arena is back
+     *    where it was before the call.
+     *
+     * @param slot_ids SlotIds of the records to copy.
+     * @param num_slots Number of records.
+     * @param arena RecordArena to copy the records into.
+     * @param records Filled in with the copy of each record.
+     *
+     * @throw InvalidSlotIdHeapPage If any of slot_ids is out of range or
+     *        has INVALID_SLOT_OFFSET. On a HEAP_PAGE_MVCC Page, also if
+     *        its record was deleted.
+     * @throw std::runtime_error If a slot points outside the Page or a
+     *        record cannot be decoded while no writer changes the Page.
+     */
+    void getRecords(const SlotId *slot_ids, std::uint32_t num_slots,
+        RecordArena *arena, RecordView *records);
+
+    /**
+     * @brief Takes a snapshot for reading HEAP_PAGE_MVCC Pages.
+     *
+     * @pre None.
+     * @post None.
+     *
+     * @return Timestamp of the latest write to any HeapPage, so the
+     *    snapshot sees exactly the writes that finished before the call.
+     */
+    static std::uint64_t takeSnapshot();
+
+    /**
+     * @brief Reclaims the versions no snapshot at or after horizon can see:
+     *    versions replaced or deleted at or before horizon.
+     *
+     * @pre No reader will use a snapshot older than horizon.
+     * @post The reclaimed versions are removed as by deleteRecords, so the
+     *    remaining records are compacted unless the Page is in deferred
+     *    compaction mode, and records whose current version was deleted
+     *    lose their slot. Does nothing if the Page has no HEAP_PAGE_MVCC.
+     *
+     * @param horizon Oldest snapshot still in use.
+     * @return Number of versions reclaimed.
+     */
+    std::uint32_t prune(std::uint64_t horizon);
+
+    /**
+     * @brief Moves records from the end of the slot directory into its
+     *    holes, so the directory shrinks to exactly one slot per record.
+     *    Records keep their bytes; only their slot entries move.
+     *
+     * @pre The caller can renumber the records moved: no one uses their
+     *    old SlotIds after the call.
+     * @post Slots 0 to size - 1 are valid and capacity is size. On a
+     *    HEAP_PAGE_MVCC Page the prev_slot chains follow the move, and
+     *    moves of old versions are not reported, since their SlotIds are
+     *    not known outside the Page.
+     *
+     * @return The records that changed SlotId.
+     */
+    std::vector<SlotMove> packSlotDirectory();
+
+    /**
+     * @brief Gets a read-only view of the record identified by its SlotId,
+     *    without copying it.
+     *
+     * @pre A valid SlotId is provided as input. The Page is pinned.
+     * @post The returned view points at the record bytes in the Page. It
+     *    stays valid until the Page is modified or unpinned. Unlike
+     *    getRecord, the read is not validated against concurrent writers;
+     *    callers sharing the Page with writers bracket it and their reads of
+     *    the view with readBegin and readValidate.
+     *
+     * @param slot_id SlotId value of the record to be viewed.
+     * @return RecordView of the record.
+     *
+     * @throw InvalidSlotIdHeapPage If slot_id is out of range or
+     *        SlotInfo of the given SlotId has INVALID_SLOT_OFFSET. On a
+     *        HEAP_PAGE_MVCC Page, also if the record was deleted.
+     * @throw std::logic_error If the Page is compressed, since its records
+     *        can only be read through getRecord.
+     */
+    RecordView getRecordView(SlotId slot_id);
+
+    /**
+     * @brief Deletes record identified by SlotId.
+     *
+     * @pre A valid SlotId is provided as input
+     * @post The record in that slot is removed from the page, and its
+     *       slot directory entry is marked invalid.  The remaining records 
+     *       on the page are compacted at the end of the page, unless the
+     *       Page is in deferred compaction mode.
+     *       Page meta data and slot directory entries are
+     *       updated to reflect the deletion this record.  The total
+     *       amount of freespace on the page increases.  The slot directory
+     *       may shrink by one or more SlotInfo entries as a result of
+     *       this call.
+     *
+     * @param slot_id SlotId value of the record to be deleted.
+     *
+     * @throw InvalidSlotIdHeapPage If slot_id is invalid (SlotId is out of
+     *       range or SlotInfo of the given SlotId has INVALID_SLOT_OFFSET).
+     */
+    void deleteRecord(SlotId slot_id);
+
+    /**
+     * @brief Deletes all records identified by the given SlotIds.
+     *
+     * All slots are invalidated first, then the remaining records are
+     * compacted in a single pass (unless the Page is in deferred compaction
+     * mode) and the slot directory is shrunk once.
+     *
+     * @pre slot_ids holds num_slots distinct, valid SlotIds.
+     * @post The records in those slots are removed from the page, and
+     *       their slot directory entries are marked invalid. The Page is
+     *       in the same state as after deleting them one at a time, except
+     *       that the order in which freed slots are reused may differ.
+     *
+     * @param slot_ids array of SlotIds of the records to be deleted.
+     * @param num_slots number of SlotIds in the array.
+     *
+     * @throw InvalidSlotIdHeapPage If any SlotId is invalid (out of range,
+     *       INVALID_SLOT_OFFSET, or repeated in slot_ids). No record is
+     *       deleted in that case.
+     */
+    void deleteRecords(const SlotId *slot_ids, std::uint32_t num_slots);
+
+    /**
+     * @brief Updates record identified by SlotId
+     *
+     * A record that keeps its size is overwritten in place. A record that
+     * shrinks is overwritten in place and the freed bytes are reclaimed by
+     * sliding only the records in front of it. A record that grows is
+     * moved to the free space.
+     *
+     * @pre A valid SlotId is provided as input and there is enough space in
+     *    the Page for the updated record. Valid Data * is provided as input.
+     *
+     * @post The record stored in the slot identified by the given SlotId is
+     *    updated to the passed record_data value. The record's slotId does
+     *    not change as a result of a successful update.
+     *    The orginal record data on the page should not be modified if
+     *    there is not space on the page to update the record to its new value.
+     *
+     * @param slot_id SlotId value of the record to be updated.
+     * @param record_data Data* of the updated record.
+     *
+     * @throw InsufficientSpaceHeapPage If there is not enough space
+     *    for updated record.
+     * @throw InvalidSlotIdHeapPage If SlotId is invalid (SlotId is
+     *    out of range or SlotInfo of the given SlotId has INVALID_SLOT_OFFSET).
+     * @throw EmptyDataHeapPage. If the passed record data is size 0.
+     */
+    void updateRecord(SlotId slot_id, Data  *record_data);
+
+    /**
+     * @brief Turns deferred compaction on or off for this Page.
+     *
+     * @pre None.
+     * @post If enable is true, HEAP_PAGE_DEFERRED_COMPACTION is set and
+     *    later deletes leave holes that are counted in fragmented_bytes.
+     *    If enable is false, the Page is compacted and the flag is cleared,
+     *    so every later delete compacts right away.
+     *
+     * @param enable true to defer compaction, false to compact eagerly.
+     */
+    void setDeferredCompaction(bool enable);
+
+    /**
+     * @brief bool function indicating whether deletes defer compaction.
+     *
+     * @return true if HEAP_PAGE_DEFERRED_COMPACTION is set on the Page.
+     */
+    bool isDeferredCompaction();
+
+    /**
+     * @brief Turns record compression on or off for this Page.
+     *
+     * @pre The Page holds no records.
+     * @post If enable is true, HEAP_PAGE_COMPRESSION is set and later
+     *    inserted and updated records are stored compressed (or with a
+     *    one byte header, if they do not compress). If enable is false,
+     *    the flag is cleared.
+     *
+     * @param enable true to compress records, false to store them raw.
+     *
+     * @throw std::logic_error If the Page holds records.
+     */
+    void setCompression(bool enable);
+
+    /**
+     * @brief Getter for the compression mode of the Page.
+     *
+     * @pre None.
+     * @post None.
+     *
+     * @return true if HEAP_PAGE_COMPRESSION is set on the Page.
+     */
+    bool isCompressed();
+
+    /**
+     * @brief Sets how many leading record bytes form the key summarized by
+     *    the synopsis.
+     *
+     * @pre The Page was initialized with HEAP_PAGE_SYNOPSIS and holds no
+     *    records.
+     * @post PageSynopsis::key_length is key_length and the synopsis is
+     *    cleared.
+     *
+     * @param key_length Key length in bytes, at most SYNOPSIS_KEY_BYTES.
+     *
+     * @throw std::logic_error If the Page has no synopsis or holds records.
+     * @throw std::invalid_argument If key_length is 0 or more than
+     *    SYNOPSIS_KEY_BYTES.
+     */
+    void setSynopsisKeyLength(std::uint32_t key_length);
+
+    /**
+     * @brief bool function indicating whether the Page keeps a synopsis.
+     *
+     * @return true if HEAP_PAGE_SYNOPSIS is set on the Page.
+     */
+    bool hasSynopsis();
+
+    /**
+     * @brief Checks a predicate against the synopsis of the Page.
+     *
+     * @pre None.
+     * @post None. Reads the synopsis without the latch, like getRecord.
+     *
+     * @param predicate Predicate on record keys.
+     * @return false if no record on the Page can match predicate. true if
+     *    some record may match, or if the Page has no synopsis.
+     */
+    bool synopsisMayMatch(const SynopsisPredicate& predicate);
+
+    /**
+     * @brief Recomputes the synopsis from the records on the Page, dropping
+     *    the keys of deleted and overwritten records.
+     *
+     * @pre None.
+     * @post The synopsis covers exactly the keys of the current records.
+     *    Does nothing if the Page has no synopsis.
+     */
+    void rebuildSynopsis();
+
+    /**
+     * @brief bool function indicating whether the Page keeps a checksum.
+     *
+     * @return true if HEAP_PAGE_CHECKSUM is set on the Page.
+     */
+    bool hasChecksum();
+
+    /**
+     * @brief Recomputes the checksum of the Page. Meant to be called by the
+     *    buffer manager before the Page is written out, so inserts,
+     *    deletes and updates do not pay for it.
+     *
+     * @pre None.
+     * @post PageChecksum::crc matches the current contents of the Page.
+     *    Does nothing if the Page has no checksum.
+     */
+    void updateChecksum();
+
+    /**
+     * @brief Checks the Page contents against its checksum. Meant to be
+     *    called by the buffer manager after the Page is read in.
+     *
+     * Whether the Page should have a checksum comes from the caller (the
+     * file or table settings), not from the Page: HEAP_PAGE_CHECKSUM is
+     * itself in the bytes being checked, and a flipped flag must not turn
+     * the check off.
+     *
+     * @pre No writer is modifying the Page.
+     * @post None.
+     *
+     * @param expected true if Pages of this file carry a checksum.
+     * @return false if hasChecksum() is not expected, or if the Page has a
+     *    checksum that does not match its contents; true otherwise.
+     */
+    bool verifyChecksum(bool expected);
+
+    /**
+     * @brief Compacts all records at the end of the Page.
+     *
+     * @pre None.
+     * @post All valid records are packed against the end of the Page, their
+     *    slot entries are moved along with them, free_space_end is raised
+     *    and fragmented_bytes is 0. SlotIds do not change. Does nothing if
+     *    the Page has no fragmented bytes.
+     */
+    void compact();
+
+    /**
+     * @brief Starts an optimistic read of the Page.
+     *
+     * Writers (insert, delete, update, compact, setNext, setPrev) take an
+     * exclusive latch on the Page, so they run one at a time, but readers
+     * take no latch. A reader calls readBegin,
+     * reads the Page and then calls readValidate; if that returns false a
+     * writer modified the Page in between and the read must be retried.
+     * getRecord and HeapPageScanner already do this internally. Callers of
+     * getRecordView and of scanner views use these calls to validate their
+     * reads of the viewed bytes.
      *
      * @pre None.
-     * @post prev_page of the Page header is returned.
+     * @post Waits until no writer holds the latch.
      *
-     * @return PageNum of the previous Page.
+     * @return The version to pass to readValidate.
      */
-    PageNum getPrev();
-
+    std::uint16_t readBegin();
 
     /**
-     * @brief Getter for the amount of free space on the Page
-     * that is available to insert a new record.
+     * @brief Checks whether the Page was modified since readBegin.
      *
-     * @pre None.
-     * @post The amount of free space, in number of bytes, that is
-     *    available for inserting a record on the page is returned.
-     *    If there are no free slot, then sizeof(SlotInfo) is subtracted 
-     *    from the free space returned (accounting for the extra space 
-     *    needed when a new slot is allocated).
-     *    If the amount of available free space is less than sizeof(SlotInfo),
-     *    then 0 is returned.
+     * @pre version was returned by readBegin on this Page.
+     * @post None.
      *
-     * @return Amount of free space in bytes on the Page.
+     * @param version The version returned by readBegin.
+     * @return true if no writer modified the Page since readBegin.
      */
-    std::uint32_t getFreeSpace();
-
+    bool readValidate(std::uint16_t version);
 
     /**
-     * @brief bool function indicating whether the Page is full.
+     * @brief Releases a write latch left in the bytes of a Page read from
+     *    disk.
      *
-     * @pre None.
-     * @post return true if the page is full: no record of any positive
-     *         size could be added. false, otherwise.
+     * The latch bit is part of the Page, so a Page flushed while a writer
+     * held it is read back latched, and every reader and writer of it
+     * would wait forever. The buffer manager (or whatever else fills a
+     * Page from storage) must call resetLatch after reading a Page in,
+     * before the Page is shared.
      *
-     * @return bool indicating whether the Page is full.
+     * @pre No thread uses the Page.
+     * @post The version of the Page is even.
      */
-    bool isFull();
+    void resetLatch();
 
     /**
-     * @brief bool function indicating whether the Page is empty.
+     * @brief Getter for the free space class of the Page.
      *
      * @pre None.
-     * @post true is returned if size is 0. Else false is returned.
+     * @post The free space class of the Page is returned. A record of up to
+     *    free space class * FREE_SPACE_CLASS_BYTES bytes can be
+     *    inserted into the Page.
      *
-     * @return bool indicating whether the Page is empty.
+     * @return getFreeSpace() / FREE_SPACE_CLASS_BYTES.
      */
-    bool isEmpty();
+    std::uint8_t getFreeSpaceClass();
 
     /**
-     * @brief Inserts given record data to the Page.
-     *
-     * If there is enough free space on the Page, and valid record data
-     * is passed (the Data value has non-zero length), then the
-     * data are inserted into the page.
-     *
-     * @pre: the slot directory has m used slots in its slot directory
-     *       and all m records are compacted at the bottom of the page.
-     * @post: after a successful insert, it has m+1 used slots in its
-     *        solt directory (possibly increasing the slot directory
-     *        size by one entry), and all m+1 records are compacted at
-     *        the bottom of the page.
+     * @brief Sets the listener told when the free space class of any
+     *    HeapPage without a listener of its own changes.
      *
-     * @param record_data (a pointer to a Data of a record) to be inserted.
+     * There is one such listener per process, so it only suits a process
+     * with a single file; with several files, give each page the listener
+     * of its own file with setFreeSpaceListener(page, listener), as
+     * FreeSpaceMap::attach does.
      *
-     * @return SlotId value of the slot the record is inserted to.
+     * @pre No HeapPage is being modified.
+     * @post listener (or no listener, if it is NULL) is called by every
+     *    later write that changes the free space class of a HeapPage that
+     *    has no listener of its own.
      *
-     * @throw InsufficientSpaceHeapPage If there is not enough space to insert
-     *   the record  on the page.
-     * @throw EmptyDataHeapPage. If the passed record data is size 0.
+     * @param listener FreeSpaceListener to call, or NULL for none.
      */
-    SlotId insertRecord(Data *record_data);
+    static void setFreeSpaceListener(FreeSpaceListener* listener);
 
-    /** 
-     * * @brief Gets the record identified by its SlotId
+    /**
+     * @brief Sets the listener told when the free space class of page
+     *    changes, in place of the process-wide one.
      *
-     * @pre A valid SlotId is provided as input and a valid Data with capacity
-     *    that is greater than maximum size of any record stored in the Page
-     *    is passed.
-     * @post The data field of record_data contains a copy of the
-     *     requsted record data stored in the Page, and the size
-     *     the size of Data object is set to the number of bytes of the
-     *     record.
+     * Pages are spread over sharded tables, so writers of different pages
+     * and listeners of different files rarely share a mutex, and writes
+     * cost no lookup while no page has a listener.
      *
-     * @param slot_id SlotId value of the record to be retrieved
+     * @pre No writer is modifying page.
+     * @post listener is called by every later write that changes the free
+     *    space class of page. If listener is NULL, page goes back to the
+     *    process-wide listener.
      *
-     * @throw InvalidSlotIdHeapPage If slot_id is out of range or
-     *        SlotInfo of the given SlotId has INVALID_SLOT_OFFSET.
-     * @throw InvalidSizeData if the size of data is not large enough
+     * @param page HeapPage to listen to.
+     * @param listener FreeSpaceListener to call, or NULL to remove it.
      */
-    void getRecord(SlotId slot_id, Data *data);
+    static void setFreeSpaceListener(HeapPage* page,
+        FreeSpaceListener* listener);
 
     /**
-     * @brief Deletes record identified by SlotId.
-     *
-     * @pre A valid SlotId is provided as input
-     * @post The record in that slot is removed from the page, and its
-     *       slot directory entry is marked invalid.  The remaining records 
-     *       on the page are compacted at the end of the page.
-     *       Page meta data and slot directory entries are
-     *       updated to reflect the deletion this record.  The total
-     *       amount of freespace on the page increases.  The slot directory
-     *       may shrink by one or more SlotInfo entries as a result of
-     *       this call.
+     * @brief Sets the log that every later change to any HeapPage is
+     *    written to.
      *
-     * @param slot_id SlotId value of the record to be deleted.
+     * @pre No HeapPage is being modified.
+     * @post Every HeapPage change (initializeHeader, setNext, setPrev,
+     *    inserts, deletes, updates, compact and the mode setters) is sent
+     *    to sink as a HeapPageLogRecord, or to no log if sink is NULL.
+     *    Changes made by redo are not sent.
      *
-     * @throw InvalidSlotIdHeapPage If slot_id is invalid (SlotId is out of
-     *       range or SlotInfo of the given SlotId has INVALID_SLOT_OFFSET).
+     * @param sink HeapPageLogSink to write to, or NULL for none.
      */
-    void deleteRecord(SlotId slot_id);
+    static void setLogSink(HeapPageLogSink* sink);
 
     /**
-     * @brief Updates record identified by SlotId
+     * @brief Getter for the LSN of the Page.
      *
-     * @pre A valid SlotId is provided as input and there is enough space in
-     *    the Page for the updated record. Valid Data * is provided as input.
+     * @return LSN of the last log record applied to the Page, or 0 if the
+     *    Page has no HEAP_PAGE_LSN region.
+     */
+    std::uint64_t getPageLsn();
+
+    /**
+     * @brief Applies a redo record to the Page, for recovery.
      *
-     * @post The record stored in the slot identified by the given SlotId is
-     *    updated to the passed record_data value. The record's slotId does
-     *    not change as a result of a successful update.
-     *    The orginal record data on the page should not be modified if
-     *    there is not space on the page to update the record to its new value.
+     * @pre The Page is in the state it was in when record was logged, or a
+     *    later one, and no other thread modifies it.
+     * @post The change of record is applied and the LSN of the Page is
+     *    record.lsn, unless the Page has HEAP_PAGE_LSN and already has an
+     *    LSN of at least record.lsn. HEAP_PAGE_LOG_INIT is always applied.
      *
-     * @param slot_id SlotId value of the record to be updated.
-     * @param record_data Data* of the updated record.
+     * @param record Redo record, as given to HeapPageLogSink::logRecord
+     *    with its lsn filled in.
+     * @return true if the record was applied, false if it was skipped.
      *
-     * @throw InsufficientSpaceHeapPage If there is not enough space
-     *    for updated record.
-     * @throw InvalidSlotIdHeapPage If SlotId is invalid (SlotId is
-     *    out of range or SlotInfo of the given SlotId has INVALID_SLOT_OFFSET).
-     * @throw EmptyDataHeapPage. If the passed record data is size 0.
+     * @throw std::runtime_error If the Page does not end up as logged
+     *    (record applied to the wrong state of the Page).
+     * @throw std::invalid_argument If record.type is unknown.
+     * @throw Whatever the change itself throws on this Page.
      */
-    void updateRecord(SlotId slot_id, Data  *record_data);
+    bool redo(const HeapPageLogRecord& record);
 
     /**
      * @brief THIS METHOD IS FOR DEBUGGING ONLY.
@@ -299,9 +1392,23 @@ class HeapPage : public Page {
      */
     std::uint32_t getInvalidNum();
 
+    /**
+     * @brief Returns a consistent snapshot of the layout of the Page.
+     *
+     * @pre None.
+     * @post None. Reads the Page without the latch, like getRecord.
+     *
+     * @return HeapPageState of the Page.
+     *
+     * @throw std::runtime_error If the slot directory reaches past the Page
+     *        while no writer changes the Page.
+     */
+    HeapPageState getPageState();
+
     /**
      * @brief THIS METHOD IS FOR DEBUGGING ONLY.
-     *    Prints the current state of the HeapPage.
+     *    Prints the current state of the HeapPage, as returned by
+     *    getPageState.
      */
     void printHeapPageState();
 
@@ -311,8 +1418,213 @@ class HeapPage : public Page {
      */
     std::uint32_t getNumRecs();
 
+    /**
+     * @brief Getter for the number of slots of the slot directory, valid
+     *    or not. A single read of the header, unlike getPageState; readers
+     *    racing with writers validate it with readBegin and readValidate.
+     *
+     * @return Capacity of the slot directory.
+     */
+    std::uint32_t getCapacity();
+
   private:
 
+    /**
+     * Holds the exclusive write latch of a Page for the lifetime of the
+     * object, so the latch is released when a writer throws.
+     */
+    class WriteLatch{
+      public:
+        /**
+         * @brief Acquires the write latch of page, waiting for any other
+         *    writer to release it.
+         */
+        WriteLatch(HeapPage* page);
+
+        /**
+         * @brief Releases the write latch and publishes a new version.
+         */
+        ~WriteLatch();
+
+      private:
+        HeapPage* page;
+
+        /**
+         * Free space class of the Page when the latch was acquired.
+         */
+        std::uint8_t free_space_class;
+
+        /**
+         * Listener of the Page when the latch was acquired, or NULL.
+         */
+        FreeSpaceListener* listener;
+    };
+
+    /**
+     * @brief Finds the listener of page: its own one if it has one, the
+     *    process-wide one otherwise.
+     */
+    static FreeSpaceListener* _getFreeSpaceListener(HeapPage* page);
+
+    /**
+     * Listener told about free space class changes of pages without a
+     * listener of their own, or NULL.
+     */
+    static FreeSpaceListener* free_space_listener;
+
+    /**
+     * Log that changes are written to, or NULL.
+     */
+    static HeapPageLogSink* log_sink;
+
+    /**
+     * @brief Sends a change to the log sink and sets the LSN of the Page,
+     *    or during redo only sets the LSN. Called by every writer with the
+     *    write latch held, after the change.
+     *
+     * @param type Kind of change.
+     * @param slot_id SlotId of the record changed, if any.
+     * @param offset Offset of the record changed, if any.
+     * @param value Argument of a header change.
+     * @param bytes Record bytes or SlotIds, or NULL.
+     * @param length Number of bytes.
+     * @param timestamp Write timestamp on a HEAP_PAGE_MVCC Page.
+     */
+    void _logChange(HeapPageLogType type, SlotId slot_id,
+        std::uint32_t offset, std::uint32_t value, const char* bytes,
+        std::uint32_t length, std::uint64_t timestamp = 0);
+
+    /**
+     * @brief Inserts record bytes. Body of insertRecord.
+     *
+     * @param record_bytes bytes of the record, not compressed.
+     * @param length number of bytes.
+     * @return SlotId of the inserted record.
+     */
+    SlotId _insertBytes(const char* record_bytes, std::uint32_t length);
+
+    /**
+     * @brief Updates a record to the given bytes. Body of updateRecord.
+     *
+     * @param slot_id SlotId of the record to update.
+     * @param record_bytes bytes of the record, not compressed.
+     * @param length number of bytes.
+     */
+    void _updateBytes(SlotId slot_id, const char* record_bytes,
+        std::uint32_t length);
+
+    /**
+     * @brief Replaces the stored bytes of a valid record, in place or by
+     *    moving it to the free space.
+     *
+     * @pre getFreeSpace() plus the current length of the record is at least
+     *    new_length.
+     * @post The slot holds the new bytes.
+     *
+     * @param slot_id SlotId of the record.
+     * @param record bytes to store, already compressed on a compressed Page.
+     * @param new_length number of bytes to store.
+     */
+    void _replaceStored(SlotId slot_id, const char* record,
+        std::uint32_t new_length);
+
+    /**
+     * @brief Turns record bytes into the bytes stored on the Page:
+     *    compressed on a compressed Page, behind a RecordVersion created at
+     *    timestamp on a HEAP_PAGE_MVCC Page.
+     *
+     * @pre One of the two flags is set. encoded holds PAGE_SIZE bytes.
+     *
+     * @param record bytes of the record.
+     * @param length number of bytes.
+     * @param encoded buffer for the stored bytes.
+     * @param timestamp write timestamp, used on HEAP_PAGE_MVCC Pages.
+     * @return Number of stored bytes.
+     */
+    std::uint32_t _encodeRecord(const char* record, std::uint32_t length,
+        char* encoded, std::uint64_t timestamp);
+
+    /**
+     * @brief Takes the timestamp of a write to a HEAP_PAGE_MVCC Page, from
+     *    the write clock or during redo from the record being redone.
+     * @return Write timestamp.
+     */
+    std::uint64_t _writeTimestamp();
+
+    /**
+     * @brief Reads the RecordVersion of a slot on a HEAP_PAGE_MVCC Page.
+     *
+     * @param slot_id SlotId of the version.
+     * @param version Set to the RecordVersion of the slot.
+     * @return false if the slot holds no version (also on torn reads by
+     *    readers without the latch).
+     */
+    bool _readVersion(SlotId slot_id, RecordVersion* version);
+
+    /**
+     * @brief Overwrites the RecordVersion of a valid slot.
+     *
+     * @param slot_id SlotId of the version.
+     * @param version New RecordVersion.
+     */
+    void _writeVersion(SlotId slot_id, const RecordVersion& version);
+
+    /**
+     * @brief Finds the version of a record visible to a snapshot.
+     *
+     * @param slot_id SlotId of the record.
+     * @param snapshot Snapshot to read as of.
+     * @return SlotId of the visible version, or INVALID_SLOT_ID if slot_id
+     *    holds an old version or no version is visible.
+     */
+    SlotId _visibleVersion(SlotId slot_id, std::uint64_t snapshot);
+
+    /**
+     * @brief Checks that a slot holds the latest version of a record that
+     *    has not been deleted.
+     *
+     * @throw InvalidSlotIdHeapPage If it does not.
+     */
+    void _checkLiveVersion(SlotId slot_id);
+
+    /**
+     * @brief Physically removes records. Shared by deleteRecords and prune.
+     *
+     * @pre slot_ids holds num_slots distinct, valid SlotIds.
+     * @post The slots are invalid and on the free slot list, the Page is
+     *    compacted unless in deferred compaction mode, and the slot
+     *    directory is shrunk.
+     *
+     * @param slot_ids array of SlotIds of the records.
+     * @param num_slots number of SlotIds in the array.
+     */
+    void _removeSlots(const SlotId* slot_ids, std::uint32_t num_slots);
+
+    /**
+     * @brief Makes new stored bytes the current version of a record on a
+     *    HEAP_PAGE_MVCC Page. The current version keeps its bytes and moves
+     *    to a slot of its own, marked old and chained from the new version.
+     *
+     * @pre slot_id holds the current version of a record that was not
+     *    deleted, and getFreeSpace() is at least length.
+     * @post slot_id holds the new version; its prev_slot is the old
+     *    version.
+     *
+     * @param slot_id SlotId of the record.
+     * @param record stored bytes of the new version, RecordVersion
+     *    included.
+     * @param length number of stored bytes.
+     * @param timestamp write timestamp of the update.
+     */
+    void _pushVersion(SlotId slot_id, const char* record,
+        std::uint32_t length, std::uint64_t timestamp);
+
+    /**
+     * @brief Compacts all records at the end of the Page. Same as compact()
+     *    without taking the write latch, for writers that already hold it.
+     */
+    void _compact();
+
     /**
      * @brief Getter for the Page header.
      * @return Pointer to the HeapPageHeader of the Page (beginning of data
@@ -320,11 +1632,68 @@ class HeapPage : public Page {
      */
     HeapPageHeader* _getPageHeader();
 
+    /**
+     * @brief Getter for the size of the optional regions between the
+     *    header and the slot directory.
+     * @return Number of bytes of the regions chosen by the header flags.
+     */
+    std::uint32_t _getExtensionSize();
+
+    /**
+     * @brief Getter for the synopsis region.
+     *
+     * @pre The Page has HEAP_PAGE_SYNOPSIS set.
+     * @return Pointer to the PageSynopsis of the Page.
+     */
+    PageSynopsis* _getSynopsis();
+
+    /**
+     * @brief Getter for the checksum region.
+     *
+     * @pre The Page has HEAP_PAGE_CHECKSUM set.
+     * @return Pointer to the PageChecksum of the Page.
+     */
+    PageChecksum* _getChecksum();
+
+    /**
+     * @brief Computes the CRC32C of the Page, taking PageChecksum::crc and
+     *    HeapPageHeader::version as 0.
+     *
+     * @pre The Page has HEAP_PAGE_CHECKSUM set.
+     * @return Checksum of the Page contents.
+     */
+    std::uint32_t _computeChecksum();
+
+    /**
+     * @brief Getter for the LSN region.
+     *
+     * @pre The Page has HEAP_PAGE_LSN set.
+     * @return Pointer to the PageLsn of the Page.
+     */
+    PageLsn* _getLsn();
+
+    /**
+     * @brief Widens the synopsis to cover the key of a record. Does nothing
+     *    if the Page has no synopsis.
+     *
+     * @param record Bytes of the record, not compressed.
+     * @param length Length of the record.
+     */
+    void _addSynopsisKey(const char* record, std::uint32_t length);
+
+    /**
+     * @brief Getter for the contiguous free space between the slot
+     *    directory and the records, not counting fragmented bytes.
+     * @return Number of bytes between free_space_begin and free_space_end.
+     */
+    std::uint32_t _getContiguousSpace();
+
     /**
      * @brief Return pointer to the where slot directory begins (first SlotInfo)
      *
      * @pre None
-     * @post Pointer to first SlotInfo is returned.
+     * @post Pointer to first SlotInfo is returned. On a Page with
+     *    HEAP_PAGE_COMPACT_SLOTS it points at CompactSlotInfo entries.
      *
      * @param slot_id SlotId of SlotInfo* that is returned.
      * @return Pointer to the first SlotInfo in slot directory.
@@ -334,21 +1703,111 @@ class HeapPage : public Page {
 
     /*!\cond PRIVATE */
     /**
-     * @brief Returns pointer to SlotInfo of given SlotId
+     * @brief Checks that a SlotId is in the slot directory.
      *
-     * @pre Valid SlotId (less than capacity) is provided as input.
-     * @post Pointer to appropriate SlotInfo in the memory space of the Page is
-     *    returned
+     * @pre None.
+     * @post None.
      *
-     * @param slot_id SlotId of SlotInfo* that is returned.
-     * @return Pointer to the SlotInfo of given SlotId.
+     * @param slot_id SlotId to check.
      *
      * @throw InvalidSlotIdHeapPage If slot_id is greter than or equal
      *    to capacity.
      */
-    SlotInfo* _getSlotInfo(SlotId slot_id);
+    void _checkSlotId(SlotId slot_id);
+
+    /**
+     * @brief Checks that a SlotId is in the slot directory and holds a
+     *    record. Used to validate SlotIds once at the top of the public
+     *    methods.
+     *
+     * @pre None.
+     * @post None.
+     *
+     * @param slot_id SlotId to check.
+     *
+     * @throw InvalidSlotIdHeapPage If slot_id is greater than or equal to
+     *    capacity, or the slot has INVALID_SLOT_OFFSET.
+     */
+    void _checkValidSlotId(SlotId slot_id);
+
+    /**
+     * @brief Getter for the size of one slot directory entry.
+     * @return sizeof(CompactSlotInfo) if the Page has compact slots,
+     *    sizeof(SlotInfo) otherwise.
+     */
+    std::uint32_t _getSlotSize();
+
+    /**
+     * @brief Getter for the offset of a slot, in either slot format.
+     *
+     * @pre slot_id is less than capacity.
+     * @return Offset of the record, INVALID_SLOT_OFFSET if the slot does
+     *    not hold one.
+     */
+    std::uint32_t _getSlotOffset(SlotId slot_id);
+
+    /**
+     * @brief Getter for the length field of a slot, in either slot format.
+     *
+     * @pre slot_id is less than capacity.
+     * @return Length of the record, or the next free slot if the slot is
+     *    not valid.
+     */
+    std::uint32_t _getSlotLength(SlotId slot_id);
+
+    /**
+     * @brief Sets the offset of a slot, in either slot format.
+     *
+     * @pre slot_id is less than capacity.
+     *
+     * @param slot_id SlotId of the slot to change.
+     * @param offset New offset, or INVALID_SLOT_OFFSET.
+     */
+    void _setSlotOffset(SlotId slot_id, std::uint32_t offset);
+
+    /**
+     * @brief Sets the length field of a slot, in either slot format.
+     *
+     * @pre slot_id is less than capacity.
+     *
+     * @param slot_id SlotId of the slot to change.
+     * @param length New length, or the next free slot.
+     */
+    void _setSlotLength(SlotId slot_id, std::uint32_t length);
     /*!\endcond*/
 
+    /**
+     * @brief Pushes an invalid slot on the front of the free slot list.
+     *
+     * @pre slot_id is less than capacity and its offset is
+     *    INVALID_SLOT_OFFSET. It is not already in the list.
+     * @post slot_id is the head of the free slot list.
+     *
+     * @param slot_id SlotId of the slot to add to the list.
+     */
+    void _pushFreeSlot(SlotId slot_id);
+
+    /**
+     * @brief Removes the head of the free slot list.
+     *
+     * @pre None.
+     * @post The returned slot is no longer in the free slot list.
+     *
+     * @return SlotId of an invalid slot that can be reused, or
+     *    INVALID_SLOT_ID if the list is empty.
+     */
+    SlotId _popFreeSlot();
+
+    /**
+     * @brief Shrinks the slot directory past all trailing invalid slots.
+     *
+     * @pre None.
+     * @post capacity and free_space_begin are reduced so that the last slot
+     *    in the directory is valid (or the directory is empty), and any
+     *    removed slots are unlinked from the free slot list.
+     */
+    void _shrinkSlotDirectory();
+
     /**
      * @brief Inserts given record data to slot identified by Slot Id in the
      *    Page. Heler function for inserting records.
@@ -368,11 +1827,28 @@ class HeapPage : public Page {
      *       passed a valid slot_id to use for the inserted record).
      * 
      * @param slot_id SlotId of where the record is to be inserted.
-     * @param record_data a pointer to the record Data to insert.
+     * @param record bytes to store, already compressed on a compressed
+     *    Page.
+     * @param length number of bytes to store.
+     *
+     * @throw InvalidSlotIdHeapPage If SlotId is out of range. Only checked
+     *    when built with HEAPPAGE_CHECK_INTERNAL.
+     */
+    void _insertRecord(SlotId slot_id, const char* record,
+        std::uint32_t length);
+
+    /**
+     * @brief Stores record bytes in a free slot, or in a new slot if there
+     *    is none, compacting first if the contiguous free space is short.
      *
-     * @throw InvalidSlotIdHeapPage If SlotId is out of range.
+     * @pre getFreeSpace() is at least length.
+     * @post The record is stored and the slot directory is grown if needed.
+     *
+     * @param record bytes to store.
+     * @param length number of bytes to store.
+     * @return SlotId of the stored record.
      */
-    void _insertRecord(SlotId slot_id, Data* record_data);
+    SlotId _insertStored(const char* record, std::uint32_t length);
 
     /**
      * @brief Deletes record identified by SlotId. Helper function for deleting
@@ -380,8 +1856,10 @@ class HeapPage : public Page {
      *
      * @pre A valid SlotId is provided as input
      * @post the record is deleted from the Page, and remaining records
-     *       are compacted on the page.  The deleted record's
-     *       offest in the slot directory is set to INVALID_SLOT_OFFSET.
+     *       are compacted on the page (in deferred compaction mode the
+     *       freed bytes are added to fragmented_bytes instead).  The
+     *       deleted record's offest in the slot directory is set to
+     *       INVALID_SLOT_OFFSET.
      *       The Page's free space is updated to reflect the deletion.
      *       THIS method DOES NOT shrink the slot directory.
      *
@@ -389,9 +1867,26 @@ class HeapPage : public Page {
      *
      * @throw InvalidSlotIdHeapPage If SlotId is invalid (SlotId is
      *    out of range or SlotInfo of the given SlotId has INVALID_SLOT_OFFSET).
+     *    Only checked when built with HEAPPAGE_CHECK_INTERNAL.
      */
     void _deleteRecord(SlotId slot_id);
 
+    /**
+     * @brief Slides every record stored below a gap of unused bytes up by
+     *    the size of the gap. Helper function for _deleteRecord and
+     *    updateRecord.
+     *
+     * @pre No valid slot points into [offset, offset + length), and every
+     *      record in front of the gap is between free_space_end and offset.
+     * @post The records in front of the gap are moved up by length bytes,
+     *       their slot entries are updated and free_space_end is raised by
+     *       length.
+     *
+     * @param offset offset of the first byte of the gap.
+     * @param length number of bytes in the gap.
+     */
+    void _closeGap(std::uint32_t offset, std::uint32_t length);
+
 };
 
 #endif
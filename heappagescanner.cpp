@@ -1,14 +1,185 @@
 #include <iostream>
 #include <cstring>
+#include <stdexcept>
 
 #include "swatdb_exceptions.h"
 #include "heappage.h"
 #include "heappagescanner.h"
+#include "recordarena.h"
 #include "page.h"
 #include "file.h"
 #include "data.h"
 #include "record.h"
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*
+ * Number of SlotInfo entries tested at once by validSlotMask.
+ */
+static const std::uint32_t SLOT_BLOCK = 8;
+
+/*
+ * Returns a bitmask with bit i set if slots[i] is valid (its offset is not
+ * INVALID_SLOT_OFFSET), for the SLOT_BLOCK slots starting at slots.
+ */
+static inline std::uint32_t validSlotMask(const SlotInfo* slots){
+#if defined(__AVX2__)
+  const __m256i invalid = _mm256_set1_epi32(INVALID_SLOT_OFFSET);
+  __m256 lo = _mm256_loadu_ps((const float*) slots);
+  __m256 hi = _mm256_loadu_ps((const float*) (slots + 4));
+  // gather the offsets (even 32 bit lanes); lanes come out as slots
+  // 0,1,4,5,2,3,6,7 and are put back in order by the permute
+  __m256i offsets = _mm256_castps_si256(
+      _mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(2,0,2,0)));
+  offsets = _mm256_permute4x64_epi64(offsets, _MM_SHUFFLE(3,1,2,0));
+  __m256i eq = _mm256_cmpeq_epi32(offsets, invalid);
+  return ~_mm256_movemask_ps(_mm256_castsi256_ps(eq)) & 0xFF;
+#elif defined(__SSE2__)
+  const __m128i invalid = _mm_set1_epi32(INVALID_SLOT_OFFSET);
+  std::uint32_t invalid_mask = 0;
+  for(std::uint32_t i = 0; i < SLOT_BLOCK; i += 4){
+    __m128 lo = _mm_loadu_ps((const float*) (slots + i));
+    __m128 hi = _mm_loadu_ps((const float*) (slots + i + 2));
+    __m128i offsets = _mm_castps_si128(
+        _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2,0,2,0)));
+    __m128i eq = _mm_cmpeq_epi32(offsets, invalid);
+    invalid_mask |= _mm_movemask_ps(_mm_castsi128_ps(eq)) << i;
+  }
+  return ~invalid_mask & 0xFF;
+#else
+  std::uint32_t mask = 0;
+  for(std::uint32_t i = 0; i < SLOT_BLOCK; i++){
+    if(slots[i].offset != INVALID_SLOT_OFFSET){
+      mask |= 1u << i;
+    }
+  }
+  return mask;
+#endif
+}
+
+/*
+ * Same as validSlotMask, for the SLOT_BLOCK compact slots starting at
+ * slots.
+ */
+static inline std::uint32_t validSlotMask(const CompactSlotInfo* slots){
+#if defined(__AVX2__)
+  // each 32 bit lane is one slot with its offset in the low 16 bits
+  const __m256i offset_bits = _mm256_set1_epi32(0xFFFF);
+  __m256i lanes = _mm256_loadu_si256((const __m256i*) slots);
+  __m256i eq = _mm256_cmpeq_epi32(_mm256_and_si256(lanes, offset_bits),
+      offset_bits);
+  return ~_mm256_movemask_ps(_mm256_castsi256_ps(eq)) & 0xFF;
+#elif defined(__SSE2__)
+  const __m128i offset_bits = _mm_set1_epi32(0xFFFF);
+  __m128i lo = _mm_loadu_si128((const __m128i*) slots);
+  __m128i hi = _mm_loadu_si128((const __m128i*) (slots + 4));
+  __m128i eq_lo = _mm_cmpeq_epi32(_mm_and_si128(lo, offset_bits),
+      offset_bits);
+  __m128i eq_hi = _mm_cmpeq_epi32(_mm_and_si128(hi, offset_bits),
+      offset_bits);
+  std::uint32_t invalid_mask = _mm_movemask_ps(_mm_castsi128_ps(eq_lo))
+    | (_mm_movemask_ps(_mm_castsi128_ps(eq_hi)) << 4);
+  return ~invalid_mask & 0xFF;
+#else
+  std::uint32_t mask = 0;
+  for(std::uint32_t i = 0; i < SLOT_BLOCK; i++){
+    if(slots[i].offset != COMPACT_INVALID_SLOT_OFFSET){
+      mask |= 1u << i;
+    }
+  }
+  return mask;
+#endif
+}
+
+/*
+ * Returns true if slot holds a record.
+ */
+static inline bool isValidSlot(const SlotInfo& slot){
+  return slot.offset != INVALID_SLOT_OFFSET;
+}
+
+static inline bool isValidSlot(const CompactSlotInfo& slot){
+  return slot.offset != COMPACT_INVALID_SLOT_OFFSET;
+}
+
+/*
+ * Body of HeapPageScanner::_getNext for either slot format: returns the
+ * next valid slot of the capacity slots of slot_directory from cur_slot on,
+ * and advances cur_slot past it.
+ */
+template <typename Slot>
+static SlotId scanNext(const Slot* slot_directory, std::uint32_t capacity,
+    SlotId& cur_slot){
+  // test whole blocks of slots, then the remaining tail one at a time
+  while(cur_slot + SLOT_BLOCK <= capacity){
+    std::uint32_t mask = validSlotMask(slot_directory + cur_slot);
+    if(mask != 0){
+      SlotId to_return = cur_slot + __builtin_ctz(mask);
+      cur_slot = to_return + 1;
+      return to_return;
+    }
+    cur_slot += SLOT_BLOCK;
+  }
+
+  while(cur_slot < capacity){
+    SlotId to_return = cur_slot++;
+    if(isValidSlot(slot_directory[to_return])){
+      return to_return;
+    }
+  }
+
+  return INVALID_SLOT_ID;
+}
+
+/*
+ * Body of HeapPageScanner::_getNextBatch for either slot format.
+ */
+template <typename Slot>
+static std::uint32_t scanBatch(const Slot* slot_directory,
+    std::uint32_t capacity, SlotId& cur_slot, const char* page_data,
+    SlotId* slot_ids, std::uint32_t max_slots, RecordView* views){
+  std::uint32_t num = 0;
+
+  while(num < max_slots && cur_slot + SLOT_BLOCK <= capacity){
+    std::uint32_t mask = validSlotMask(slot_directory + cur_slot);
+    SlotId slot_id = cur_slot;
+    while(mask != 0 && num < max_slots){
+      slot_id = cur_slot + __builtin_ctz(mask);
+      mask &= mask - 1;
+      slot_ids[num] = slot_id;
+      if(views != nullptr){
+        views[num].data = page_data + slot_directory[slot_id].offset;
+        views[num].length = slot_directory[slot_id].length;
+      }
+      num++;
+    }
+    if(mask != 0){
+      // buffer is full in the middle of a block
+      cur_slot = slot_id + 1;
+      return num;
+    }
+    cur_slot += SLOT_BLOCK;
+  }
+
+  while(num < max_slots && cur_slot < capacity){
+    SlotId slot_id = cur_slot++;
+    if(isValidSlot(slot_directory[slot_id])){
+      slot_ids[num] = slot_id;
+      if(views != nullptr){
+        views[num].data = page_data + slot_directory[slot_id].offset;
+        views[num].length = slot_directory[slot_id].length;
+      }
+      num++;
+    }
+  }
+
+  return num;
+}
+
 /**
  * @brief Constructor.
  *
@@ -21,6 +192,7 @@
 HeapPageScanner::HeapPageScanner(HeapPage* page){
   this->page = page;
   this->cur_slot = 0;
+  this->snapshot = MVCC_LATEST_SNAPSHOT;
 }
 
 /**
@@ -41,19 +213,181 @@ HeapPageScanner::~HeapPageScanner(){ }
  *    reached. page is still pinned.
  */
 SlotId HeapPageScanner::getNext(){
-  HeapPageHeader* page_header = this->page->_getPageHeader();
-  SlotId to_return = INVALID_SLOT_ID;
-  bool found = false;
+  SlotId start = this->cur_slot;
+
+  // retry the scan if a writer modified the page while it was read
+  while(true){
+    std::uint16_t version = this->page->readBegin();
+    SlotId slot_id = this->_getNext();
+    if(this->page->readValidate(version)){
+      return slot_id;
+    }
+    this->cur_slot = start;
+  }
+}
+
+/**
+ * @brief Returns SlotId of the next valid slot and a view of its record.
+ *
+ * @pre page is pinned. view is not NULL.
+ * @post Same as getNext(). If a valid slot is found, view points at its
+ *    record bytes in the Page (see RecordView for how long it stays valid).
+ *    Otherwise view is not modified. The record bytes are not copied, so a
+ *    caller reading them while other threads may write the Page validates
+ *    its reads with HeapPage::readBegin and HeapPage::readValidate.
+ *
+ * @param view RecordView to fill in with the record of the next slot.
+ * @return Next valid SlotId. INVALID_SLOT_ID if the end of the Page is
+ *    reached. page is still pinned.
+ *
+ * @throw std::logic_error If the Page is compressed.
+ */
+SlotId HeapPageScanner::getNext(RecordView* view){
+  SlotId start = this->cur_slot;
+
+  if(this->page->isCompressed()){
+    throw std::logic_error("records of a compressed HeapPage have no view");
+  }
+
+  while(true){
+    std::uint16_t version = this->page->readBegin();
+    RecordView next = {nullptr, 0};
+    SlotId slot_id;
+    if(this->page->_getPageHeader()->flags & HEAP_PAGE_MVCC){
+      slot_id = this->_getNextVisible(&next);
+    } else {
+      slot_id = this->_getNext();
+      if(slot_id != INVALID_SLOT_ID){
+        next.data = this->page->data + this->page->_getSlotOffset(slot_id);
+        next.length = this->page->_getSlotLength(slot_id);
+      }
+    }
+    if(this->page->readValidate(version)){
+      if(slot_id != INVALID_SLOT_ID){
+        *view = next;
+      }
+      return slot_id;
+    }
+    this->cur_slot = start;
+  }
+}
+
+/**
+ * @brief Fills a buffer with the SlotIds of the next valid slots.
+ *
+ * Equivalent to calling getNext() up to max_slots times, in one loop.
+ *
+ * @pre page is pinned. slot_ids (and views, if not NULL) hold at least
+ *    max_slots entries.
+ * @post The first n entries of slot_ids (n is the return value) hold the
+ *    next valid SlotIds in order, and if views is not NULL, views[i] is the
+ *    RecordView of slot_ids[i]. Current slot field is set past the last
+ *    returned slot. page is still pinned.
+ *
+ * @param slot_ids buffer to fill in with SlotIds.
+ * @param max_slots maximum number of SlotIds to return.
+ * @param views optional buffer to fill in with the record of each slot.
+ *
+ * @return Number of SlotIds written. Less than max_slots only if the end of
+ *    the Page is reached.
+ *
+ * @throw std::logic_error If views is not NULL and the Page is compressed.
+ */
+std::uint32_t HeapPageScanner::getNextBatch(SlotId* slot_ids,
+    std::uint32_t max_slots, RecordView* views){
+  SlotId start = this->cur_slot;
+
+  if(views != nullptr && this->page->isCompressed()){
+    throw std::logic_error("records of a compressed HeapPage have no view");
+  }
 
-  while((!found) && this->cur_slot < page_header->capacity){
-    if((this->page)->_getSlotInfo(cur_slot)->offset != INVALID_SLOT_OFFSET){
-      to_return = this->cur_slot;
-      found = true;
+  while(true){
+    std::uint16_t version = this->page->readBegin();
+    std::uint32_t num = this->_getNextBatch(slot_ids, max_slots, views);
+    if(this->page->readValidate(version)){
+      return num;
     }
-    this->cur_slot++;
+    this->cur_slot = start;
   }
+}
 
-  return to_return;
+/**
+ * @brief Copies the next valid records into an arena.
+ *
+ * Same as getNextBatch() followed by HeapPage::getRecords on the slots
+ * found, so it also works on compressed Pages, and one arena reset per
+ * batch replaces a Data per record.
+ *
+ * @pre page is pinned. slot_ids and records hold at least max_slots
+ *    entries. No other thread deletes records of the Page during the call.
+ * @post The first n entries of slot_ids (n is the return value) hold the
+ *    next valid SlotIds in order, and records[i] points at a copy in arena
+ *    of the record of slot_ids[i]. Current slot field is set past the last
+ *    returned slot.
+ *
+ * @param slot_ids buffer to fill in with SlotIds.
+ * @param max_slots maximum number of records to return.
+ * @param arena RecordArena to copy the records into.
+ * @param records buffer to fill in with the copy of each record.
+ *
+ * @return Number of records copied. Less than max_slots only if the end of
+ *    the Page is reached.
+ */
+std::uint32_t HeapPageScanner::getNextRecords(SlotId* slot_ids,
+    std::uint32_t max_slots, RecordArena* arena, RecordView* records){
+  std::uint32_t num = this->getNextBatch(slot_ids, max_slots);
+  this->page->getRecords(slot_ids, num, arena, records);
+  return num;
+}
+
+/**
+ * @brief Same as getNext(), without validating the read against concurrent
+ *    writers of the Page.
+ */
+SlotId HeapPageScanner::_getNext(){
+  HeapPageHeader* page_header = this->page->_getPageHeader();
+  SlotInfo* slot_directory = this->page->_getSlotDirectory();
+  std::uint32_t capacity = page_header->capacity;
+
+  if(page_header->flags & HEAP_PAGE_MVCC){
+    return this->_getNextVisible(nullptr);
+  }
+  if(page_header->flags & HEAP_PAGE_COMPACT_SLOTS){
+    return scanNext((CompactSlotInfo*) slot_directory, capacity,
+        this->cur_slot);
+  }
+  return scanNext(slot_directory, capacity, this->cur_slot);
+}
+
+/**
+ * @brief Same as getNextBatch(), without validating the read against
+ *    concurrent writers of the Page.
+ */
+std::uint32_t HeapPageScanner::_getNextBatch(SlotId* slot_ids,
+    std::uint32_t max_slots, RecordView* views){
+  HeapPageHeader* page_header = this->page->_getPageHeader();
+  SlotInfo* slot_directory = this->page->_getSlotDirectory();
+  std::uint32_t capacity = page_header->capacity;
+
+  //visibility is decided record by record
+  if(page_header->flags & HEAP_PAGE_MVCC){
+    std::uint32_t num = 0;
+    while(num < max_slots){
+      SlotId slot_id = this->_getNextVisible(views == nullptr ? nullptr
+          : views + num);
+      if(slot_id == INVALID_SLOT_ID){
+        break;
+      }
+      slot_ids[num++] = slot_id;
+    }
+    return num;
+  }
+  if(page_header->flags & HEAP_PAGE_COMPACT_SLOTS){
+    return scanBatch((CompactSlotInfo*) slot_directory, capacity,
+        this->cur_slot, this->page->data, slot_ids, max_slots, views);
+  }
+  return scanBatch(slot_directory, capacity, this->cur_slot,
+      this->page->data, slot_ids, max_slots, views);
 }
 
 /**
@@ -68,4 +402,83 @@ SlotId HeapPageScanner::getNext(){
 void HeapPageScanner::reset(HeapPage* page){
   this->page = page;
   this->cur_slot = 0;
+}
+
+/**
+ * @brief Resets the scanner to a Page, unless the synopsis of the Page
+ *    rules out every record for a predicate.
+ *
+ * @pre The new Page is pinned.
+ * @post page is set to the provided HeapPage*. If some record may match
+ *    predicate, current slot is reset to 0 as by reset(). Otherwise
+ *    current slot is set past the slot directory, so getNext returns
+ *    INVALID_SLOT_ID right away. Pages without a synopsis are never
+ *    ruled out. The new Page is still pinned.
+ *
+ * @param page HeapPage object to reset to.
+ * @param predicate Predicate on record keys the caller will apply.
+ * @return false if the Page was ruled out and need not be scanned.
+ */
+bool HeapPageScanner::resetFiltered(HeapPage* page,
+    const SynopsisPredicate& predicate){
+  this->page = page;
+  this->cur_slot = 0;
+  if(page->synopsisMayMatch(predicate)){
+    return true;
+  }
+  this->cur_slot = page->_getPageHeader()->capacity;
+  return false;
+}
+
+/**
+ * @brief Sets the snapshot the scanner reads HEAP_PAGE_MVCC Pages as of.
+ *
+ * @pre None.
+ * @post On HEAP_PAGE_MVCC Pages, getNext and getNextBatch only return
+ *    records with a version visible to snapshot, and views point at that
+ *    version. Old versions are never returned by their own slot. The
+ *    snapshot is kept across reset. Other Pages are not affected.
+ *
+ * @param snapshot Snapshot from HeapPage::takeSnapshot, or
+ *    MVCC_LATEST_SNAPSHOT (the default) for the latest version of every
+ *    record that was not deleted.
+ */
+void HeapPageScanner::setSnapshot(std::uint64_t snapshot){
+  this->snapshot = snapshot;
+}
+
+/**
+ * @brief Same as _getNext() on a HEAP_PAGE_MVCC Page, skipping records with
+ *    no version visible to the snapshot.
+ *
+ * @param view If not NULL, set to the visible version of the record.
+ */
+SlotId HeapPageScanner::_getNextVisible(RecordView* view){
+  HeapPageHeader* page_header = this->page->_getPageHeader();
+  SlotInfo* slot_directory = this->page->_getSlotDirectory();
+  std::uint32_t capacity = page_header->capacity;
+
+  while(true){
+    SlotId slot_id;
+    if(page_header->flags & HEAP_PAGE_COMPACT_SLOTS){
+      slot_id = scanNext((CompactSlotInfo*) slot_directory, capacity,
+          this->cur_slot);
+    } else {
+      slot_id = scanNext(slot_directory, capacity, this->cur_slot);
+    }
+    if(slot_id == INVALID_SLOT_ID){
+      return slot_id;
+    }
+    SlotId visible = this->page->_visibleVersion(slot_id, this->snapshot);
+    if(visible == INVALID_SLOT_ID){
+      continue;
+    }
+    if(view != nullptr){
+      view->data = this->page->data + this->page->_getSlotOffset(visible)
+        + sizeof(RecordVersion);
+      view->length = this->page->_getSlotLength(visible)
+        - sizeof(RecordVersion);
+    }
+    return slot_id;
+  }
 }
\ No newline at end of file
@@ -7,11 +7,15 @@
  */
 
 #include <cstddef>
+#include <cstdint>
 #include <mutex>
 #include "swatdb_types.h"
 #include "page.h"
 
 class Data;
+class RecordArena;
+struct RecordView;
+struct SynopsisPredicate;
 
 /**
  * HeapPage class.
@@ -55,6 +59,76 @@ class HeapPageScanner {
      */
     SlotId getNext();
 
+    /**
+     * @brief Returns SlotId of the next valid slot and a view of its record.
+     *
+     * @pre page is pinned. view is not NULL.
+     * @post Same as getNext(). If a valid slot is found, view points at its
+     *    record bytes in the Page (see RecordView for how long it stays
+     *    valid). Otherwise view is not modified. The record bytes are not
+     *    copied, so a caller reading them while other threads may write
+     *    the Page validates its reads with HeapPage::readBegin and
+     *    HeapPage::readValidate.
+     *
+     * @param view RecordView to fill in with the record of the next slot.
+     * @return Next valid SlotId. INVALID_SLOT_ID if the end of the Page is
+     *    reached. page is still pinned.
+     *
+     * @throw std::logic_error If the Page is compressed.
+     */
+    SlotId getNext(RecordView* view);
+
+    /**
+     * @brief Fills a buffer with the SlotIds of the next valid slots.
+     *
+     * Equivalent to calling getNext() up to max_slots times, in one loop.
+     *
+     * @pre page is pinned. slot_ids (and views, if not NULL) hold at least
+     *    max_slots entries.
+     * @post The first n entries of slot_ids (n is the return value) hold
+     *    the next valid SlotIds in order, and if views is not NULL, views[i]
+     *    is the RecordView of slot_ids[i]. Current slot field is set past
+     *    the last returned slot. page is still pinned.
+     *
+     * @param slot_ids buffer to fill in with SlotIds.
+     * @param max_slots maximum number of SlotIds to return.
+     * @param views optional buffer to fill in with the record of each slot.
+     *
+     * @return Number of SlotIds written. Less than max_slots only if the
+     *    end of the Page is reached.
+     *
+     * @throw std::logic_error If views is not NULL and the Page is
+     *    compressed.
+     */
+    std::uint32_t getNextBatch(SlotId* slot_ids, std::uint32_t max_slots,
+        RecordView* views = nullptr);
+
+    /**
+     * @brief Copies the next valid records into an arena.
+     *
+     * Same as getNextBatch() followed by HeapPage::getRecords on the slots
+     * found, so it also works on compressed Pages, and one arena reset per
+     * batch replaces a Data per record.
+     *
+     * @pre page is pinned. slot_ids and records hold at least max_slots
+     *    entries. No other thread deletes records of the Page during the
+     *    call.
+     * @post The first n entries of slot_ids (n is the return value) hold
+     *    the next valid SlotIds in order, and records[i] points at a copy
+     *    in arena of the record of slot_ids[i]. Current slot field is set
+     *    past the last returned slot.
+     *
+     * @param slot_ids buffer to fill in with SlotIds.
+     * @param max_slots maximum number of records to return.
+     * @param arena RecordArena to copy the records into.
+     * @param records buffer to fill in with the copy of each record.
+     *
+     * @return Number of records copied. Less than max_slots only if the
+     *    end of the Page is reached.
+     */
+    std::uint32_t getNextRecords(SlotId* slot_ids, std::uint32_t max_slots,
+        RecordArena* arena, RecordView* records);
+
     /**
      * @brief Resets the scanner, so it could be used for another Page.
      *
@@ -66,8 +140,62 @@ class HeapPageScanner {
      */
     void reset(HeapPage* page);
 
+    /**
+     * @brief Resets the scanner to a Page, unless the synopsis of the Page
+     *    rules out every record for a predicate.
+     *
+     * @pre The new Page is pinned.
+     * @post page is set to the provided HeapPage*. If some record may match
+     *    predicate, current slot is reset to 0 as by reset(). Otherwise
+     *    current slot is set past the slot directory, so getNext returns
+     *    INVALID_SLOT_ID right away. Pages without a synopsis are never
+     *    ruled out. The new Page is still pinned.
+     *
+     * @param page HeapPage object to reset to.
+     * @param predicate Predicate on record keys the caller will apply.
+     * @return false if the Page was ruled out and need not be scanned.
+     */
+    bool resetFiltered(HeapPage* page, const SynopsisPredicate& predicate);
+
+    /**
+     * @brief Sets the snapshot the scanner reads HEAP_PAGE_MVCC Pages as
+     *    of.
+     *
+     * @pre None.
+     * @post On HEAP_PAGE_MVCC Pages, getNext and getNextBatch only return
+     *    records with a version visible to snapshot, and views point at
+     *    that version. Old versions are never returned by their own slot.
+     *    The snapshot is kept across reset. Other Pages are not affected.
+     *
+     * @param snapshot Snapshot from HeapPage::takeSnapshot, or
+     *    MVCC_LATEST_SNAPSHOT (the default) for the latest version of
+     *    every record that was not deleted.
+     */
+    void setSnapshot(std::uint64_t snapshot);
+
   private:
 
+    /**
+     * @brief Same as getNext(), without validating the read against
+     *    concurrent writers of the Page.
+     */
+    SlotId _getNext();
+
+    /**
+     * @brief Same as getNextBatch(), without validating the read against
+     *    concurrent writers of the Page.
+     */
+    std::uint32_t _getNextBatch(SlotId* slot_ids, std::uint32_t max_slots,
+        RecordView* views);
+
+    /**
+     * @brief Same as _getNext() on a HEAP_PAGE_MVCC Page, skipping records
+     *    with no version visible to the snapshot.
+     *
+     * @param view If not NULL, set to the visible version of the record.
+     */
+    SlotId _getNextVisible(RecordView* view);
+
     /**
      * @brief Page to be scanned. The Page is pinned outside the scope of the
      *    scanner.
@@ -79,6 +207,11 @@ class HeapPageScanner {
      */
     SlotId cur_slot;
 
+    /**
+     * @brief Snapshot HEAP_PAGE_MVCC Pages are read as of.
+     */
+    std::uint64_t snapshot;
+
 };
 
 #endif
@@ -0,0 +1,106 @@
+#include <mutex>
+#include <vector>
+#include <algorithm>
+
+#include "heappagestats.h"
+
+/*
+ * Names of the counters, indexed by HeapPageStat.
+ */
+static const char* const stat_names[HEAP_PAGE_NUM_STATS] = {
+  "compaction_bytes",
+  "compactions",
+  "slot_scan_length",
+  "insert_slot_reused",
+  "insert_slot_appended",
+  "directory_shrinks",
+  "directory_slots_removed",
+  "update_in_place",
+  "update_relocated",
+  "insufficient_space",
+  "latch_acquires",
+  "latch_contended",
+  "latch_spins"
+};
+
+/*
+ * Registry of the blocks of live threads and the totals of exited ones.
+ * Constructed on first use, since stat blocks of threads started before
+ * main may register before this file's statics are initialized.
+ */
+struct StatRegistry{
+  std::mutex lock;
+  std::vector<HeapPageStatBlock*> blocks;
+  std::uint64_t retired[HEAP_PAGE_NUM_STATS] = {};
+};
+
+static StatRegistry& registry(){
+  static StatRegistry* instance = new StatRegistry();
+  return *instance;
+}
+
+thread_local HeapPageStatBlock heap_page_stat_block;
+
+/**
+ * @brief Constructor. Registers the block so getHeapPageStats sees it.
+ */
+HeapPageStatBlock::HeapPageStatBlock(){
+  for (std::uint32_t i = 0; i < HEAP_PAGE_NUM_STATS; i++){
+    this->counters[i].store(0, std::memory_order_relaxed);
+  }
+  StatRegistry& stats = registry();
+  std::lock_guard<std::mutex> guard(stats.lock);
+  stats.blocks.push_back(this);
+}
+
+/**
+ * @brief Destructor. Folds the counters into the totals of exited threads
+ *    and unregisters the block.
+ */
+HeapPageStatBlock::~HeapPageStatBlock(){
+  StatRegistry& stats = registry();
+  std::lock_guard<std::mutex> guard(stats.lock);
+  for (std::uint32_t i = 0; i < HEAP_PAGE_NUM_STATS; i++){
+    stats.retired[i] += this->counters[i].load(std::memory_order_relaxed);
+  }
+  stats.blocks.erase(std::find(stats.blocks.begin(), stats.blocks.end(),
+        this));
+}
+
+/**
+ * @brief Returns the counters summed over every thread, including the
+ *    threads that exited.
+ *
+ * @pre None.
+ * @post None. Counters only grow, so rates are taken from the difference
+ *    of two snapshots.
+ *
+ * @return Current value of every counter.
+ */
+HeapPageStats getHeapPageStats(){
+  HeapPageStats result;
+  StatRegistry& stats = registry();
+  std::lock_guard<std::mutex> guard(stats.lock);
+
+  for (std::uint32_t i = 0; i < HEAP_PAGE_NUM_STATS; i++){
+    result.counters[i] = stats.retired[i];
+  }
+  for (HeapPageStatBlock* block : stats.blocks){
+    for (std::uint32_t i = 0; i < HEAP_PAGE_NUM_STATS; i++){
+      result.counters[i] += block->counters[i].load(
+          std::memory_order_relaxed);
+    }
+  }
+  return result;
+}
+
+/**
+ * @brief Returns the name of a counter, for exporting the counters.
+ *
+ * @param stat Counter to name.
+ * @return Name of stat in lower case with underscores, e.g.
+ *    "compaction_bytes".
+ */
+const char* heapPageStatName(HeapPageStat stat){
+  return stat_names[stat];
+}
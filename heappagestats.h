@@ -0,0 +1,175 @@
+#ifndef  _SWATDB_HEAPPAGESTATS_H_
+#define  _SWATDB_HEAPPAGESTATS_H_
+
+
+/**
+ * \file
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+
+/**
+ * Counters of HeapPage internals. They are only maintained when the
+ * HeapPage sources are built with -DHEAPPAGE_STATS; otherwise the
+ * HEAPPAGE_STAT calls compile to nothing and getHeapPageStats returns
+ * zeros.
+ */
+enum HeapPageStat{
+
+  /**
+   * Record bytes moved by compaction (closing the gap of a deleted or
+   * shrunk record, and full compactions).
+   */
+  HEAP_PAGE_STAT_COMPACTION_BYTES,
+
+  /**
+   * Full compactions that had fragmented bytes to reclaim.
+   */
+  HEAP_PAGE_STAT_COMPACTIONS,
+
+  /**
+   * Slot directory entries visited by directory scans (offset fixups
+   * after a gap is closed, full compactions and free slot list walks).
+   */
+  HEAP_PAGE_STAT_SLOT_SCAN_LENGTH,
+
+  /**
+   * Inserts that reused a free slot.
+   */
+  HEAP_PAGE_STAT_INSERT_SLOT_REUSED,
+
+  /**
+   * Inserts that grew the slot directory.
+   */
+  HEAP_PAGE_STAT_INSERT_SLOT_APPENDED,
+
+  /**
+   * Deletes that shrank the slot directory.
+   */
+  HEAP_PAGE_STAT_DIRECTORY_SHRINKS,
+
+  /**
+   * Slot directory entries removed by those shrinks.
+   */
+  HEAP_PAGE_STAT_DIRECTORY_SLOTS_REMOVED,
+
+  /**
+   * Updates that kept the record where it was (same size or smaller).
+   */
+  HEAP_PAGE_STAT_UPDATE_IN_PLACE,
+
+  /**
+   * Updates that moved a grown record to the free space.
+   */
+  HEAP_PAGE_STAT_UPDATE_RELOCATED,
+
+  /**
+   * InsufficientSpaceHeapPage exceptions thrown.
+   */
+  HEAP_PAGE_STAT_INSUFFICIENT_SPACE,
+
+  /**
+   * Write latches acquired.
+   */
+  HEAP_PAGE_STAT_LATCH_ACQUIRES,
+
+  /**
+   * Write latch acquisitions that found the latch held by another writer
+   * or lost the race for it, so had to wait.
+   */
+  HEAP_PAGE_STAT_LATCH_CONTENDED,
+
+  /**
+   * Times those acquisitions went around their wait loop (failed
+   * compare-and-swaps and spins on a held latch).
+   */
+  HEAP_PAGE_STAT_LATCH_SPINS,
+
+  /**
+   * Number of counters.
+   */
+  HEAP_PAGE_NUM_STATS
+};
+
+/**
+ * Values of every HeapPageStat, summed over all threads.
+ */
+struct HeapPageStats{
+
+  /**
+   * Value of every counter, indexed by HeapPageStat.
+   */
+  std::uint64_t counters[HEAP_PAGE_NUM_STATS];
+};
+
+/**
+ * Counters of one thread. Only the owning thread writes them, so an
+ * increment is a relaxed load and store instead of an atomic
+ * read-modify-write; readers in other threads load them relaxed.
+ */
+struct HeapPageStatBlock{
+
+  /**
+   * @brief Constructor. Registers the block so getHeapPageStats sees it.
+   */
+  HeapPageStatBlock();
+
+  /**
+   * @brief Destructor. Folds the counters into the totals of exited
+   *    threads and unregisters the block.
+   */
+  ~HeapPageStatBlock();
+
+  /**
+   * Value of every counter of the thread, indexed by HeapPageStat.
+   */
+  std::atomic<std::uint64_t> counters[HEAP_PAGE_NUM_STATS];
+};
+
+/**
+ * Counters of the calling thread.
+ */
+extern thread_local HeapPageStatBlock heap_page_stat_block;
+
+/**
+ * @brief Adds n to a counter of the calling thread.
+ *
+ * @param stat Counter to add to.
+ * @param n Amount to add.
+ */
+inline void heapPageStatAdd(HeapPageStat stat, std::uint64_t n){
+  std::atomic<std::uint64_t>& counter = heap_page_stat_block.counters[stat];
+  counter.store(counter.load(std::memory_order_relaxed) + n,
+      std::memory_order_relaxed);
+}
+
+#ifdef HEAPPAGE_STATS
+#define HEAPPAGE_STAT(stat, n) heapPageStatAdd(stat, n)
+#else
+#define HEAPPAGE_STAT(stat, n) ((void) 0)
+#endif
+
+/**
+ * @brief Returns the counters summed over every thread, including the
+ *    threads that exited.
+ *
+ * @pre None.
+ * @post None. Counters only grow, so rates are taken from the difference
+ *    of two snapshots.
+ *
+ * @return Current value of every counter.
+ */
+HeapPageStats getHeapPageStats();
+
+/**
+ * @brief Returns the name of a counter, for exporting the counters.
+ *
+ * @param stat Counter to name.
+ * @return Name of stat in lower case with underscores, e.g.
+ *    "compaction_bytes".
+ */
+const char* heapPageStatName(HeapPageStat stat);
+
+#endif
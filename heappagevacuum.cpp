@@ -0,0 +1,285 @@
+#include <stdexcept>
+
+#include "heappagevacuum.h"
+#include "heappage.h"
+#include "heapfilescanner.h"
+
+/**
+ * @brief Constructor.
+ *
+ * @pre None.
+ * @post The vacuum has no pages, the default thresholds, no slot move
+ *    listener and no horizon source.
+ *
+ * @param source HeapPageSource of the pages.
+ * @param sample_pages Number of pages looked at by each round.
+ *
+ * @throw std::invalid_argument If sample_pages is 0.
+ */
+HeapPageVacuum::HeapPageVacuum(HeapPageSource* source,
+    std::uint32_t sample_pages)
+  : cursor(0), min_fragmented_bytes(VACUUM_MIN_FRAGMENTED_BYTES),
+    min_invalid_slots(VACUUM_MIN_INVALID_SLOTS), stats(), stopping(false){
+  if (sample_pages == 0){
+    throw std::invalid_argument("HeapPageVacuum: no pages to sample");
+  }
+  this->source = source;
+  this->sample_pages = sample_pages;
+}
+
+/**
+ * @brief Destructor. Stops the background thread.
+ */
+HeapPageVacuum::~HeapPageVacuum(){
+  try {
+    this->stop();
+  } catch (...){
+    //nothing to report the error to
+  }
+}
+
+/**
+ * @brief Setter for the pages to maintain.
+ *
+ * @pre None.
+ * @post The next round starts at the first of pages.
+ *
+ * @param pages PageNums of the pages.
+ */
+void HeapPageVacuum::setPages(const std::vector<PageNum>& pages){
+  std::lock_guard<std::mutex> guard(this->lock);
+  this->pages = pages;
+  this->cursor = 0;
+}
+
+/**
+ * @brief Setter for the thresholds at which a page is worked on.
+ *
+ * @pre None.
+ * @post Later rounds use the new thresholds.
+ *
+ * @param min_fragmented_bytes Fragmented bytes at which a page is
+ *    compacted.
+ * @param min_invalid_slots Invalid slots at which the slot directory is
+ *    packed.
+ */
+void HeapPageVacuum::setThresholds(std::uint32_t min_fragmented_bytes,
+    std::uint32_t min_invalid_slots){
+  std::lock_guard<std::mutex> guard(this->lock);
+  this->min_fragmented_bytes = min_fragmented_bytes;
+  this->min_invalid_slots = min_invalid_slots;
+}
+
+/**
+ * @brief Setter for the slot move listener. Packing slot directories is
+ *    only done while a listener is set.
+ *
+ * @pre listener can be called from the background thread.
+ * @post Later rounds pack slot directories and report the moves to
+ *    listener, or stop packing if listener is empty.
+ *
+ * @param listener Listener of the moves, or an empty function.
+ */
+void HeapPageVacuum::setSlotMoveListener(const SlotMoveListener& listener){
+  std::lock_guard<std::mutex> guard(this->lock);
+  this->slot_move_listener = listener;
+}
+
+/**
+ * @brief Setter for the horizon source. HEAP_PAGE_MVCC pages are only
+ *    pruned while a horizon source is set.
+ *
+ * @pre horizon can be called from the background thread.
+ * @post Later rounds prune HEAP_PAGE_MVCC pages up to the horizon it
+ *    returns, or stop pruning if horizon is empty.
+ *
+ * @param horizon Source of the horizon, or an empty function.
+ */
+void HeapPageVacuum::setHorizonSource(const HorizonSource& horizon){
+  std::lock_guard<std::mutex> guard(this->lock);
+  this->horizon_source = horizon;
+}
+
+/**
+ * @brief Looks at the next sample_pages pages and vacuums the ones that
+ *    need it.
+ *
+ * @pre None.
+ * @post Every page looked at is unpinned.
+ *
+ * @return Number of pages changed.
+ *
+ * @throw Rethrows exceptions of the page source and the listeners.
+ */
+std::uint32_t HeapPageVacuum::runOnce(){
+  std::vector<PageNum> sample;
+  {
+    std::lock_guard<std::mutex> guard(this->lock);
+    std::size_t num_pages = this->pages.size();
+    for (std::uint32_t i = 0; i < this->sample_pages && i < num_pages; i++){
+      sample.push_back(this->pages[this->cursor]);
+      this->cursor = (this->cursor + 1) % num_pages;
+    }
+  }
+
+  std::uint32_t vacuumed = 0;
+  for (PageNum page_num : sample){
+    if (this->vacuumPage(page_num)){
+      vacuumed++;
+    }
+  }
+  return vacuumed;
+}
+
+/**
+ * @brief Vacuums one page if it needs it.
+ *
+ * @pre page_num is a page of the source.
+ * @post The page is unpinned.
+ *
+ * @param page_num PageNum of the page.
+ * @return true if the page was changed.
+ *
+ * @throw Rethrows exceptions of the page source and the listeners.
+ */
+bool HeapPageVacuum::vacuumPage(PageNum page_num){
+  std::uint32_t min_fragmented_bytes;
+  std::uint32_t min_invalid_slots;
+  SlotMoveListener listener;
+  HorizonSource horizon;
+  {
+    //copied so that listeners and the page work run without the lock
+    std::lock_guard<std::mutex> guard(this->lock);
+    min_fragmented_bytes = this->min_fragmented_bytes;
+    min_invalid_slots = this->min_invalid_slots;
+    listener = this->slot_move_listener;
+    horizon = this->horizon_source;
+  }
+
+  HeapPageVacuumStats delta = HeapPageVacuumStats();
+  delta.sampled_pages = 1;
+  bool packed = false;
+  HeapPage* page = this->source->pinPage(page_num);
+  try {
+    HeapPageState state = page->getPageState();
+
+    //pruning first: the versions it removes add to the fragmented bytes
+    //and the invalid slots looked at next
+    if ((state.flags & HEAP_PAGE_MVCC) && horizon){
+      std::uint32_t pruned = page->prune(horizon());
+      if (pruned > 0){
+        delta.pruned_versions += pruned;
+        state = page->getPageState();
+      }
+    }
+    if (state.fragmented_bytes > 0
+        && state.fragmented_bytes >= min_fragmented_bytes){
+      page->compact();
+      delta.compactions++;
+    }
+    if (listener && state.invalid_slots > 0
+        && state.invalid_slots >= min_invalid_slots){
+      std::vector<SlotMove> moves = page->packSlotDirectory();
+      packed = true;
+      delta.moved_slots += moves.size();
+      if (!moves.empty()){
+        listener(page_num, moves.data(), moves.size());
+      }
+    }
+  } catch (...){
+    this->source->unpinPage(page_num);
+    throw;
+  }
+  this->source->unpinPage(page_num);
+
+  //packing a directory with only trailing holes moves nothing but still
+  //shrinks it, so a page counts as changed whenever it was worked on
+  bool changed = delta.pruned_versions > 0 || delta.compactions > 0
+    || packed;
+  std::lock_guard<std::mutex> guard(this->lock);
+  this->stats.sampled_pages += delta.sampled_pages;
+  this->stats.vacuumed_pages += changed ? 1 : 0;
+  this->stats.compactions += delta.compactions;
+  this->stats.pruned_versions += delta.pruned_versions;
+  this->stats.moved_slots += delta.moved_slots;
+  return changed;
+}
+
+/**
+ * @brief Starts a thread that runs a round every interval.
+ *
+ * @pre The thread is not running.
+ * @post The thread runs until stop is called.
+ *
+ * @param interval Time between the end of a round and the next one.
+ *
+ * @throw std::logic_error If the thread is already running.
+ */
+void HeapPageVacuum::start(std::chrono::milliseconds interval){
+  std::lock_guard<std::mutex> guard(this->lock);
+  if (this->thread.joinable()){
+    throw std::logic_error("HeapPageVacuum: already started");
+  }
+  this->stopping = false;
+  this->error = nullptr;
+  this->thread = std::thread(&HeapPageVacuum::_run, this, interval);
+}
+
+/**
+ * @brief Stops the thread started by start, waiting for the current
+ *    round to finish. Does nothing if it is not running.
+ *
+ * @pre None.
+ * @post The thread is not running.
+ *
+ * @throw Rethrows the exception that stopped the thread, if any.
+ */
+void HeapPageVacuum::stop(){
+  {
+    std::lock_guard<std::mutex> guard(this->lock);
+    if (!this->thread.joinable()){
+      return;
+    }
+    this->stopping = true;
+  }
+  this->wakeup.notify_all();
+  this->thread.join();
+
+  std::exception_ptr error;
+  {
+    std::lock_guard<std::mutex> guard(this->lock);
+    error = this->error;
+    this->error = nullptr;
+  }
+  if (error){
+    std::rethrow_exception(error);
+  }
+}
+
+/**
+ * @brief Getter for the counters of the work done.
+ * @return Counters of every round since construction.
+ */
+HeapPageVacuumStats HeapPageVacuum::getStats(){
+  std::lock_guard<std::mutex> guard(this->lock);
+  return this->stats;
+}
+
+/**
+ * @brief Body of the background thread.
+ */
+void HeapPageVacuum::_run(std::chrono::milliseconds interval){
+  std::unique_lock<std::mutex> guard(this->lock);
+  while (!this->stopping){
+    guard.unlock();
+    try {
+      this->runOnce();
+    } catch (...){
+      guard.lock();
+      this->error = std::current_exception();
+      return;
+    }
+    guard.lock();
+    this->wakeup.wait_for(guard, interval, [this]{ return this->stopping; });
+  }
+}
@@ -0,0 +1,308 @@
+#ifndef  _SWATDB_HEAPPAGEVACUUM_H_
+#define  _SWATDB_HEAPPAGEVACUUM_H_
+
+
+/**
+ * \file
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "swatdb_types.h"
+#include "heappage.h"
+#include "heapfilescanner.h"
+
+/**
+ * Default number of pages HeapPageVacuum::runOnce looks at.
+ */
+const std::uint32_t VACUUM_SAMPLE_PAGES = 8;
+
+/**
+ * Default number of fragmented bytes at which a page is compacted.
+ */
+const std::uint32_t VACUUM_MIN_FRAGMENTED_BYTES = PAGE_SIZE / 8;
+
+/**
+ * Default number of invalid slots at which the slot directory of a page is
+ * packed.
+ */
+const std::uint32_t VACUUM_MIN_INVALID_SLOTS = 8;
+
+/**
+ * Counters of the work done by a HeapPageVacuum.
+ */
+struct HeapPageVacuumStats{
+
+  /**
+   * Number of pages looked at.
+   */
+  std::uint64_t sampled_pages;
+
+  /**
+   * Number of pages changed.
+   */
+  std::uint64_t vacuumed_pages;
+
+  /**
+   * Number of pages compacted.
+   */
+  std::uint64_t compactions;
+
+  /**
+   * Number of record versions reclaimed by HeapPage::prune.
+   */
+  std::uint64_t pruned_versions;
+
+  /**
+   * Number of records moved to another slot by
+   * HeapPage::packSlotDirectory.
+   */
+  std::uint64_t moved_slots;
+};
+
+/**
+ * Background maintenance of a set of HeapPages.
+ *
+ * Every round looks at the next sample_pages pages of the page list, round
+ * robin, and uses HeapPage::getPageState to decide what each needs:
+ * - on a HEAP_PAGE_MVCC page, versions older than the horizon are pruned,
+ *   if a horizon source is set;
+ * - a page with at least min_fragmented_bytes of deleted records is
+ *   compacted, so pages in deferred compaction mode get their space back
+ *   without a foreground insert paying for it;
+ * - a page with at least min_invalid_slots holes in its slot directory has
+ *   the directory packed, only if a slot move listener is set. Packing
+ *   changes SlotIds, so the listener is where the caller renumbers its
+ *   references; without one SlotIds are never changed and holes are left
+ *   for inserts to reuse.
+ *
+ * Rounds run either on demand with runOnce or on a background thread
+ * started with start. The page source must be thread safe when the
+ * background thread is used alongside other users of the pages; the
+ * HeapPage write latch keeps each page consistent.
+ */
+class HeapPageVacuum {
+
+  public:
+
+    /**
+     * Called with the records packSlotDirectory moved on page_num. The
+     * page is pinned and no longer latched during the call.
+     */
+    typedef std::function<void(PageNum page_num, const SlotMove* moves,
+        std::uint32_t num_moves)> SlotMoveListener;
+
+    /**
+     * Returns the oldest snapshot still in use, for HeapPage::prune.
+     */
+    typedef std::function<std::uint64_t()> HorizonSource;
+
+    /**
+     * @brief Constructor.
+     *
+     * @pre None.
+     * @post The vacuum has no pages, the default thresholds, no slot move
+     *    listener and no horizon source.
+     *
+     * @param source HeapPageSource of the pages.
+     * @param sample_pages Number of pages looked at by each round.
+     *
+     * @throw std::invalid_argument If sample_pages is 0.
+     */
+    HeapPageVacuum(HeapPageSource* source,
+        std::uint32_t sample_pages = VACUUM_SAMPLE_PAGES);
+
+    /**
+     * @brief Destructor. Stops the background thread.
+     */
+    ~HeapPageVacuum();
+
+    /**
+     * @brief Setter for the pages to maintain.
+     *
+     * @pre None.
+     * @post The next round starts at the first of pages.
+     *
+     * @param pages PageNums of the pages.
+     */
+    void setPages(const std::vector<PageNum>& pages);
+
+    /**
+     * @brief Setter for the thresholds at which a page is worked on.
+     *
+     * @pre None.
+     * @post Later rounds use the new thresholds.
+     *
+     * @param min_fragmented_bytes Fragmented bytes at which a page is
+     *    compacted.
+     * @param min_invalid_slots Invalid slots at which the slot directory is
+     *    packed.
+     */
+    void setThresholds(std::uint32_t min_fragmented_bytes,
+        std::uint32_t min_invalid_slots);
+
+    /**
+     * @brief Setter for the slot move listener. Packing slot directories is
+     *    only done while a listener is set.
+     *
+     * @pre listener can be called from the background thread.
+     * @post Later rounds pack slot directories and report the moves to
+     *    listener, or stop packing if listener is empty.
+     *
+     * @param listener Listener of the moves, or an empty function.
+     */
+    void setSlotMoveListener(const SlotMoveListener& listener);
+
+    /**
+     * @brief Setter for the horizon source. HEAP_PAGE_MVCC pages are only
+     *    pruned while a horizon source is set.
+     *
+     * @pre horizon can be called from the background thread.
+     * @post Later rounds prune HEAP_PAGE_MVCC pages up to the horizon it
+     *    returns, or stop pruning if horizon is empty.
+     *
+     * @param horizon Source of the horizon, or an empty function.
+     */
+    void setHorizonSource(const HorizonSource& horizon);
+
+    /**
+     * @brief Looks at the next sample_pages pages and vacuums the ones that
+     *    need it.
+     *
+     * @pre None.
+     * @post Every page looked at is unpinned.
+     *
+     * @return Number of pages changed.
+     *
+     * @throw Rethrows exceptions of the page source and the listeners.
+     */
+    std::uint32_t runOnce();
+
+    /**
+     * @brief Vacuums one page if it needs it.
+     *
+     * @pre page_num is a page of the source.
+     * @post The page is unpinned.
+     *
+     * @param page_num PageNum of the page.
+     * @return true if the page was changed.
+     *
+     * @throw Rethrows exceptions of the page source and the listeners.
+     */
+    bool vacuumPage(PageNum page_num);
+
+    /**
+     * @brief Starts a thread that runs a round every interval.
+     *
+     * @pre The thread is not running.
+     * @post The thread runs until stop is called.
+     *
+     * @param interval Time between the end of a round and the next one.
+     *
+     * @throw std::logic_error If the thread is already running.
+     */
+    void start(std::chrono::milliseconds interval);
+
+    /**
+     * @brief Stops the thread started by start, waiting for the current
+     *    round to finish. Does nothing if it is not running.
+     *
+     * @pre None.
+     * @post The thread is not running.
+     *
+     * @throw Rethrows the exception that stopped the thread, if any.
+     */
+    void stop();
+
+    /**
+     * @brief Getter for the counters of the work done.
+     * @return Counters of every round since construction.
+     */
+    HeapPageVacuumStats getStats();
+
+  private:
+
+    /**
+     * @brief Body of the background thread.
+     */
+    void _run(std::chrono::milliseconds interval);
+
+    /**
+     * Source of the pages.
+     */
+    HeapPageSource* source;
+
+    /**
+     * Number of pages looked at by each round.
+     */
+    std::uint32_t sample_pages;
+
+    /**
+     * Protects every member below.
+     */
+    std::mutex lock;
+
+    /**
+     * Pages to maintain.
+     */
+    std::vector<PageNum> pages;
+
+    /**
+     * Index in pages of the first page of the next round.
+     */
+    std::size_t cursor;
+
+    /**
+     * Fragmented bytes at which a page is compacted.
+     */
+    std::uint32_t min_fragmented_bytes;
+
+    /**
+     * Invalid slots at which the slot directory is packed.
+     */
+    std::uint32_t min_invalid_slots;
+
+    /**
+     * Listener of slot moves; packing is off when empty.
+     */
+    SlotMoveListener slot_move_listener;
+
+    /**
+     * Source of the prune horizon; pruning is off when empty.
+     */
+    HorizonSource horizon_source;
+
+    /**
+     * Counters of the work done.
+     */
+    HeapPageVacuumStats stats;
+
+    /**
+     * Wakes the background thread up when stop is called.
+     */
+    std::condition_variable wakeup;
+
+    /**
+     * Set by stop to tell the background thread to return.
+     */
+    bool stopping;
+
+    /**
+     * Background thread, if running.
+     */
+    std::thread thread;
+
+    /**
+     * Exception that stopped the background thread, or NULL.
+     */
+    std::exception_ptr error;
+};
+
+#endif
@@ -0,0 +1,188 @@
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mappedheapfile.h"
+#include "heappage.h"
+#include "page.h"
+
+//pinPage hands out file bytes as Pages, which is only right while a Page is
+//nothing but its PAGE_SIZE data array: no vtable and no other members
+static_assert(sizeof(Page) == PAGE_SIZE && std::is_standard_layout<Page>::value,
+    "MappedHeapFile needs Page to be exactly its data array");
+
+/*
+ * Returns the madvise advice of an access pattern.
+ */
+static int madviseAdvice(MappedAccess access){
+  switch (access){
+    case MAPPED_ACCESS_SEQUENTIAL:
+      return MADV_SEQUENTIAL;
+    case MAPPED_ACCESS_RANDOM:
+      return MADV_RANDOM;
+    default:
+      return MADV_NORMAL;
+  }
+}
+
+/*
+ * Throws a std::runtime_error naming what failed and errno.
+ */
+static void throwErrno(const std::string& what, const std::string& path){
+  throw std::runtime_error("MappedHeapFile: " + what + " " + path + ": "
+      + std::strerror(errno));
+}
+
+/**
+ * @brief Constructor. Maps the file.
+ *
+ * @pre path is a heap file of whole pages.
+ * @post The file is mapped and advised with access.
+ *
+ * @param path Path of the file.
+ * @param access Initial access pattern hint.
+ *
+ * @throw std::runtime_error If the file cannot be opened or mapped, or its
+ *    size is not a multiple of PAGE_SIZE.
+ */
+MappedHeapFile::MappedHeapFile(const std::string& path, MappedAccess access)
+  : base(nullptr), length(0), num_pages(0){
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0){
+    throwErrno("cannot open", path);
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0){
+    int error = errno;
+    close(fd);
+    errno = error;
+    throwErrno("cannot stat", path);
+  }
+  if (info.st_size % PAGE_SIZE != 0){
+    close(fd);
+    throw std::runtime_error("MappedHeapFile: " + path
+        + " is not a whole number of pages");
+  }
+
+  this->length = info.st_size;
+  this->num_pages = this->length / PAGE_SIZE;
+  if (this->length > 0){
+    void* mapping = mmap(nullptr, this->length, PROT_READ, MAP_SHARED, fd,
+        0);
+    if (mapping == MAP_FAILED){
+      int error = errno;
+      close(fd);
+      errno = error;
+      throwErrno("cannot map", path);
+    }
+    this->base = (char*) mapping;
+  }
+  //the mapping keeps the file open
+  close(fd);
+
+  try {
+    this->advise(access);
+  } catch (...){
+    munmap(this->base, this->length);
+    throw;
+  }
+}
+
+/**
+ * @brief Destructor. Unmaps the file.
+ *
+ * @pre No page returned by pinPage is used after the call.
+ */
+MappedHeapFile::~MappedHeapFile(){
+  if (this->base != nullptr){
+    munmap(this->base, this->length);
+  }
+}
+
+/**
+ * @brief Returns a page of the file, in place in the mapping.
+ *
+ * @pre None.
+ * @post None. The page stays valid until the file is unmapped.
+ *
+ * @param page_num PageNum of the page.
+ * @return The page. Only its read methods may be called.
+ *
+ * @throw std::out_of_range If page_num is not a page of the file.
+ * @throw std::runtime_error If the page was written while latched: the
+ *    mapping is read only, so the latch could never be reset and every
+ *    reader of the page would wait forever.
+ */
+HeapPage* MappedHeapFile::pinPage(PageNum page_num){
+  if (page_num >= this->num_pages){
+    throw std::out_of_range("MappedHeapFile: page past the end of the file");
+  }
+  char* page = this->base + (std::size_t) page_num * PAGE_SIZE;
+  //an odd version is a latch left by a writer when the page was flushed
+  if (((const HeapPageHeader*) page)->version & 1){
+    throw std::runtime_error("MappedHeapFile: page "
+        + std::to_string(page_num) + " was written while latched");
+  }
+  return (HeapPage*) page;
+}
+
+/**
+ * @brief Does nothing: pages of a mapped file are never evicted by the
+ *    caller.
+ *
+ * @param page_num PageNum of the page.
+ */
+void MappedHeapFile::unpinPage(PageNum page_num){
+  (void) page_num;
+}
+
+/**
+ * @brief Asks the kernel to read a page in (MADV_WILLNEED).
+ *
+ * @pre None.
+ * @post None. Out of range pages are ignored.
+ *
+ * @param page_num PageNum of the page.
+ */
+void MappedHeapFile::prefetchPage(PageNum page_num){
+  if (page_num >= this->num_pages){
+    return;
+  }
+  //only a hint: a failure just means the page is read on first access
+  madvise(this->base + (std::size_t) page_num * PAGE_SIZE, PAGE_SIZE,
+      MADV_WILLNEED);
+}
+
+/**
+ * @brief Sets the access pattern hint of the whole mapping.
+ *
+ * @pre None.
+ * @post The kernel reads the file ahead according to access.
+ *
+ * @param access Access pattern of the coming reads.
+ *
+ * @throw std::runtime_error If madvise fails.
+ */
+void MappedHeapFile::advise(MappedAccess access){
+  if (this->base == nullptr){
+    return;
+  }
+  if (madvise(this->base, this->length, madviseAdvice(access)) != 0){
+    throwErrno("cannot advise", "mapping");
+  }
+}
+
+/**
+ * @brief Getter for the number of pages of the file.
+ * @return Size of the file divided by PAGE_SIZE.
+ */
+std::uint32_t MappedHeapFile::getNumPages(){
+  return this->num_pages;
+}
@@ -0,0 +1,157 @@
+#ifndef  _SWATDB_MAPPEDHEAPFILE_H_
+#define  _SWATDB_MAPPEDHEAPFILE_H_
+
+
+/**
+ * \file
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "swatdb_types.h"
+#include "heappage.h"
+#include "heapfilescanner.h"
+
+/**
+ * Access pattern hints for MappedHeapFile::advise, passed to madvise.
+ */
+enum MappedAccess{
+
+  /**
+   * No hint (MADV_NORMAL).
+   */
+  MAPPED_ACCESS_NORMAL,
+
+  /**
+   * Pages are read in order, once (MADV_SEQUENTIAL): the kernel reads
+   * ahead aggressively and drops pages soon after they are read.
+   */
+  MAPPED_ACCESS_SEQUENTIAL,
+
+  /**
+   * Pages are read in no particular order (MADV_RANDOM): no read ahead.
+   */
+  MAPPED_ACCESS_RANDOM
+};
+
+/**
+ * Read-only HeapPageSource over a heap file mapped in memory.
+ *
+ * The file is a sequence of PAGE_SIZE pages in the HeapPage layout, page
+ * p at offset p * PAGE_SIZE, as written by the buffer pool. It is mapped
+ * with mmap and pinPage returns a HeapPage pointer straight into the
+ * mapping, so reading pages costs no copy into a buffer pool frame, and
+ * the pages are shared with the page cache instead of duplicated. Pinning
+ * is free and unpinPage does nothing; prefetchPage asks the kernel to read
+ * the page in, and advise sets the read ahead policy of the whole file.
+ * Together with HeapFileScanner, HeapPageScanner and RecordViews this
+ * gives zero-copy scans of the file.
+ *
+ * The mapping is read only: only the read methods of the HeapPages may be
+ * called (getRecord, getRecordView, scanners, getNext, getPageState and
+ * the like); a write faults. For the same reason the latch of a page
+ * flushed mid-write cannot be reset (HeapPage::resetLatch), so pinPage
+ * rejects such pages. The file must not be written while it is mapped.
+ * MappedHeapFile is thread safe.
+ */
+class MappedHeapFile : public HeapPageSource {
+
+  public:
+
+    /**
+     * @brief Constructor. Maps the file.
+     *
+     * @pre path is a heap file of whole pages.
+     * @post The file is mapped and advised with access.
+     *
+     * @param path Path of the file.
+     * @param access Initial access pattern hint.
+     *
+     * @throw std::runtime_error If the file cannot be opened or mapped, or
+     *    its size is not a multiple of PAGE_SIZE.
+     */
+    MappedHeapFile(const std::string& path,
+        MappedAccess access = MAPPED_ACCESS_SEQUENTIAL);
+
+    /**
+     * @brief Destructor. Unmaps the file.
+     *
+     * @pre No page returned by pinPage is used after the call.
+     */
+    ~MappedHeapFile();
+
+    MappedHeapFile(const MappedHeapFile&) = delete;
+    MappedHeapFile& operator=(const MappedHeapFile&) = delete;
+
+    /**
+     * @brief Returns a page of the file, in place in the mapping.
+     *
+     * @pre None.
+     * @post None. The page stays valid until the file is unmapped.
+     *
+     * @param page_num PageNum of the page.
+     * @return The page. Only its read methods may be called.
+     *
+     * @throw std::out_of_range If page_num is not a page of the file.
+     * @throw std::runtime_error If the page was written while latched: the
+     *    mapping is read only, so the latch could never be reset and every
+     *    reader of the page would wait forever.
+     */
+    HeapPage* pinPage(PageNum page_num);
+
+    /**
+     * @brief Does nothing: pages of a mapped file are never evicted by the
+     *    caller.
+     *
+     * @param page_num PageNum of the page.
+     */
+    void unpinPage(PageNum page_num);
+
+    /**
+     * @brief Asks the kernel to read a page in (MADV_WILLNEED).
+     *
+     * @pre None.
+     * @post None. Out of range pages are ignored.
+     *
+     * @param page_num PageNum of the page.
+     */
+    void prefetchPage(PageNum page_num);
+
+    /**
+     * @brief Sets the access pattern hint of the whole mapping.
+     *
+     * @pre None.
+     * @post The kernel reads the file ahead according to access.
+     *
+     * @param access Access pattern of the coming reads.
+     *
+     * @throw std::runtime_error If madvise fails.
+     */
+    void advise(MappedAccess access);
+
+    /**
+     * @brief Getter for the number of pages of the file.
+     * @return Size of the file divided by PAGE_SIZE.
+     */
+    std::uint32_t getNumPages();
+
+  private:
+
+    /**
+     * First byte of the mapping, or NULL for an empty file.
+     */
+    char* base;
+
+    /**
+     * Size of the mapping in bytes.
+     */
+    std::size_t length;
+
+    /**
+     * Number of pages of the file.
+     */
+    std::uint32_t num_pages;
+};
+
+#endif
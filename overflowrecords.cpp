@@ -0,0 +1,348 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "overflowrecords.h"
+#include "heappage.h"
+
+/**
+ * @brief Constructor.
+ *
+ * @pre None.
+ * @post None.
+ *
+ * @param source Allocates, pins and frees the overflow pages.
+ * @param inline_length Length of the prefix of a large record kept on its
+ *    HeapPage.
+ * @param max_inline Length above which a record is moved to overflow
+ *    pages.
+ *
+ * @throw std::invalid_argument If inline_length is larger than max_inline.
+ */
+OverflowRecords::OverflowRecords(OverflowPageSource* source,
+    std::uint32_t inline_length, std::uint32_t max_inline){
+  if (inline_length > max_inline){
+    throw std::invalid_argument("OverflowRecords: prefix longer than limit");
+  }
+  this->source = source;
+  this->inline_length = inline_length;
+  this->max_inline = max_inline;
+}
+
+/**
+ * @brief Inserts a record of any length on page.
+ *
+ * @pre page is pinned.
+ * @post The record is stored on page, with the bytes past the inline
+ *    prefix on new overflow pages if it is longer than max_inline. If an
+ *    exception is thrown no overflow page is left allocated.
+ *
+ * @param page HeapPage to insert the record on.
+ * @param record Bytes of the record.
+ * @param length Length of the record.
+ * @return SlotId of the record on page.
+ *
+ * @throw EmptyDataHeapPage If length is 0.
+ * @throw InsufficientSpaceHeapPage If page has no room for the inline part.
+ */
+SlotId OverflowRecords::insertRecord(HeapPage* page, const char* record,
+    std::uint32_t length){
+  if (length == 0){
+    throw EmptyDataHeapPage();
+  }
+
+  OverflowRecordHeader header;
+  header.length = length;
+  header.first_page = INVALID_PAGE_NUM;
+  std::uint32_t stored = length;
+  if (length > this->max_inline){
+    stored = this->inline_length;
+    //check the inline part fits before writing any overflow page
+    if (sizeof(header) + stored > page->getFreeSpace()){
+      throw InsufficientSpaceHeapPage();
+    }
+    header.first_page = this->_writeChain(record + stored, length - stored);
+  }
+
+  Data inline_data(sizeof(header) + stored);
+  std::memcpy(inline_data.getData(), &header, sizeof(header));
+  std::memcpy(inline_data.getData() + sizeof(header), record, stored);
+  inline_data.setSize(sizeof(header) + stored);
+  try {
+    return page->insertRecord(&inline_data);
+  } catch (...){
+    this->_freeChain(header.first_page);
+    throw;
+  }
+}
+
+/**
+ * @brief Deletes a record and frees its overflow pages.
+ *
+ * @pre page is pinned and slot_id is a record written by insertRecord.
+ * @post The slot and every overflow page of the record are freed.
+ *
+ * @param page HeapPage of the record.
+ * @param slot_id SlotId of the record.
+ *
+ * @throw InvalidSlotIdHeapPage If slot_id is not a valid slot.
+ */
+void OverflowRecords::deleteRecord(HeapPage* page, SlotId slot_id){
+  OverflowRecordHeader header = this->getHeader(page, slot_id);
+  page->deleteRecord(slot_id);
+  this->_freeChain(header.first_page);
+}
+
+/**
+ * @brief Copies a whole record, reading its overflow pages.
+ *
+ * @pre page is pinned and slot_id is a record written by insertRecord.
+ * @post record_data holds the record.
+ *
+ * @param page HeapPage of the record.
+ * @param slot_id SlotId of the record.
+ * @param record_data Data to copy the record into.
+ *
+ * @throw InvalidSlotIdHeapPage If slot_id is not a valid slot.
+ * @throw InvalidSizeData If record_data is too small for the record.
+ */
+void OverflowRecords::getRecord(HeapPage* page, SlotId slot_id,
+    Data* record_data){
+  OverflowReader reader(this, page, slot_id);
+  std::uint32_t length = reader.getLength();
+  if (record_data->getCapacity() < length){
+    throw InvalidSizeData();
+  }
+
+  std::uint32_t copied = 0;
+  while (copied < length){
+    copied += reader.read(record_data->getData() + copied, length - copied);
+  }
+  record_data->setSize(length);
+}
+
+/**
+ * @brief Gets a view of the inline part of a record, without touching its
+ *    overflow pages.
+ *
+ * @pre Same as getRecord.
+ * @post Same as HeapPage::getRecordView.
+ *
+ * @param page HeapPage of the record.
+ * @param slot_id SlotId of the record.
+ * @return View of the whole record if it is inline, or of its prefix.
+ *
+ * @throw InvalidSlotIdHeapPage If slot_id is not a valid slot.
+ */
+RecordView OverflowRecords::getInline(HeapPage* page, SlotId slot_id){
+  RecordView view = page->getRecordView(slot_id);
+  view.data += sizeof(OverflowRecordHeader);
+  view.length -= sizeof(OverflowRecordHeader);
+  return view;
+}
+
+/**
+ * @brief Getter for the header of a record.
+ *
+ * @pre Same as getRecord.
+ *
+ * @param page HeapPage of the record.
+ * @param slot_id SlotId of the record.
+ * @return The OverflowRecordHeader of the record.
+ *
+ * @throw InvalidSlotIdHeapPage If slot_id is not a valid slot.
+ */
+OverflowRecordHeader OverflowRecords::getHeader(HeapPage* page,
+    SlotId slot_id){
+  RecordView view = page->getRecordView(slot_id);
+  if (view.length < sizeof(OverflowRecordHeader)){
+    throw std::runtime_error("record has no OverflowRecordHeader");
+  }
+  OverflowRecordHeader header;
+  std::memcpy(&header, view.data, sizeof(header));
+  return header;
+}
+
+/**
+ * @brief Getter for the page source.
+ * @return source given to the constructor.
+ */
+OverflowPageSource* OverflowRecords::getSource(){
+  return this->source;
+}
+
+/**
+ * @brief Writes bytes to a chain of new overflow pages.
+ *
+ * @post If an exception is thrown every page allocated is freed.
+ *
+ * @param bytes Bytes to write.
+ * @param length Number of bytes, more than 0.
+ * @return PageNum of the first page of the chain.
+ */
+PageNum OverflowRecords::_writeChain(const char* bytes, std::uint32_t length){
+  PageNum first_page = INVALID_PAGE_NUM;
+  PageNum prev_num = INVALID_PAGE_NUM;
+  HeapPage* prev = nullptr;
+  std::uint32_t written = 0;
+
+  try {
+    while (written < length){
+      PageNum page_num;
+      HeapPage* page = this->source->allocatePage(&page_num);
+      page->initializeHeader();
+      if (prev == nullptr){
+        first_page = page_num;
+      }else{
+        //link from the previous page, then drop its pin: at most two
+        //pages are pinned at a time
+        prev->setNext(page_num);
+        this->source->unpinPage(prev_num);
+      }
+      prev = page;
+      prev_num = page_num;
+
+      std::uint32_t chunk = std::min(length - written, page->getFreeSpace());
+      Data chunk_data(chunk);
+      std::memcpy(chunk_data.getData(), bytes + written, chunk);
+      chunk_data.setSize(chunk);
+      page->insertRecord(&chunk_data);
+      written += chunk;
+    }
+  } catch (...){
+    if (prev != nullptr){
+      if (first_page == prev_num){
+        first_page = INVALID_PAGE_NUM;
+      }
+      this->source->unpinPage(prev_num);
+      this->source->freePage(prev_num);
+    }
+    //every earlier page links to the next, ending at prev_num
+    PageNum page_num = first_page;
+    while (page_num != INVALID_PAGE_NUM && page_num != prev_num){
+      HeapPage* page = this->source->pinPage(page_num);
+      PageNum next = page->getNext();
+      this->source->unpinPage(page_num);
+      this->source->freePage(page_num);
+      page_num = next;
+    }
+    throw;
+  }
+  this->source->unpinPage(prev_num);
+  return first_page;
+}
+
+/**
+ * @brief Frees a chain of overflow pages.
+ *
+ * @param first_page First page of the chain, or INVALID_PAGE_NUM.
+ */
+void OverflowRecords::_freeChain(PageNum first_page){
+  PageNum page_num = first_page;
+  while (page_num != INVALID_PAGE_NUM){
+    HeapPage* page = this->source->pinPage(page_num);
+    PageNum next = page->getNext();
+    this->source->unpinPage(page_num);
+    this->source->freePage(page_num);
+    page_num = next;
+  }
+}
+
+/**
+ * @brief Constructor.
+ *
+ * @pre page is pinned, slot_id is a record written by records, and the
+ *    record is not changed or deleted while it is read.
+ * @post The reader is at the first byte of the record.
+ *
+ * @param records OverflowRecords that wrote the record.
+ * @param page HeapPage of the record.
+ * @param slot_id SlotId of the record.
+ *
+ * @throw InvalidSlotIdHeapPage If slot_id is not a valid slot.
+ */
+OverflowReader::OverflowReader(OverflowRecords* records, HeapPage* page,
+    SlotId slot_id){
+  OverflowRecordHeader header = records->getHeader(page, slot_id);
+  this->source = records->getSource();
+  this->current_page = INVALID_PAGE_NUM;
+  this->next_page = header.first_page;
+  this->piece = records->getInline(page, slot_id);
+  this->piece_offset = 0;
+  this->length = header.length;
+  this->remaining = header.length;
+}
+
+/**
+ * @brief Destructor. Unpins the overflow page being read, if any.
+ */
+OverflowReader::~OverflowReader(){
+  if (this->current_page != INVALID_PAGE_NUM){
+    this->source->unpinPage(this->current_page);
+  }
+}
+
+/**
+ * @brief Copies the next bytes of the record.
+ *
+ * @pre buffer holds max_length bytes.
+ * @post The reader is past the bytes copied.
+ *
+ * @param buffer Buffer to copy to.
+ * @param max_length Most bytes to copy.
+ * @return Number of bytes copied: max_length, or fewer at the end of the
+ *    record, 0 once it is all read.
+ */
+std::uint32_t OverflowReader::read(char* buffer, std::uint32_t max_length){
+  std::uint32_t copied = 0;
+
+  while (copied < max_length && this->remaining > 0){
+    if (this->piece_offset == this->piece.length){
+      this->_nextPage();
+    }
+    std::uint32_t count = std::min(max_length - copied,
+        this->piece.length - this->piece_offset);
+    std::memcpy(buffer + copied, this->piece.data + this->piece_offset,
+        count);
+    this->piece_offset += count;
+    this->remaining -= count;
+    copied += count;
+  }
+  return copied;
+}
+
+/**
+ * @brief Getter for the length of the record.
+ * @return Length of the whole record in bytes.
+ */
+std::uint32_t OverflowReader::getLength(){
+  return this->length;
+}
+
+/**
+ * @brief Getter for the number of bytes not read yet.
+ * @return Length minus the bytes returned by read so far.
+ */
+std::uint32_t OverflowReader::getRemaining(){
+  return this->remaining;
+}
+
+/**
+ * @brief Moves to the next overflow page of the chain, unpinning the
+ *    current one.
+ */
+void OverflowReader::_nextPage(){
+  if (this->next_page == INVALID_PAGE_NUM){
+    throw std::runtime_error("overflow chain shorter than its record");
+  }
+  if (this->current_page != INVALID_PAGE_NUM){
+    this->source->unpinPage(this->current_page);
+    this->current_page = INVALID_PAGE_NUM;
+  }
+
+  HeapPage* page = this->source->pinPage(this->next_page);
+  this->current_page = this->next_page;
+  this->next_page = page->getNext();
+  this->piece = page->getRecordView(0);
+  this->piece_offset = 0;
+}
@@ -0,0 +1,339 @@
+#ifndef  _SWATDB_OVERFLOWRECORDS_H_
+#define  _SWATDB_OVERFLOWRECORDS_H_
+
+
+/**
+ * \file
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include "swatdb_types.h"
+#include "data.h"
+#include "heappage.h"
+#include "heapfilescanner.h"
+
+/**
+ * Default length of the prefix of a large record kept on its HeapPage.
+ */
+const std::uint32_t OVERFLOW_INLINE_LENGTH = 64;
+
+/**
+ * Default length above which a record is moved to overflow pages.
+ */
+const std::uint32_t OVERFLOW_MAX_INLINE = PAGE_SIZE / 4;
+
+/**
+ * Stored in front of every record written by OverflowRecords, followed by
+ * the inline bytes of the record.
+ */
+struct OverflowRecordHeader{
+
+  /**
+   * Length of the whole record in bytes.
+   */
+  std::uint32_t length;
+
+  /**
+   * PageNum of the first overflow page of the record, or INVALID_PAGE_NUM
+   * if the whole record is inline.
+   */
+  PageNum first_page;
+};
+
+/**
+ * HeapPageSource that can also allocate and free pages, for the overflow
+ * pages of large records.
+ */
+class OverflowPageSource : public HeapPageSource {
+
+  public:
+
+    /**
+     * @brief Destructor.
+     */
+    virtual ~OverflowPageSource() {}
+
+    /**
+     * @brief Allocates a new page and pins it.
+     *
+     * @pre None.
+     * @post The page is pinned until unpinPage is called for it. Its
+     *    content is undefined.
+     *
+     * @param page_num Set to the PageNum of the new page.
+     * @return The pinned page.
+     */
+    virtual HeapPage* allocatePage(PageNum* page_num) = 0;
+
+    /**
+     * @brief Frees a page allocated by allocatePage.
+     *
+     * @pre page_num is not pinned.
+     * @post page_num can be returned by a later allocatePage.
+     *
+     * @param page_num PageNum of the page to free.
+     */
+    virtual void freePage(PageNum page_num) = 0;
+};
+
+/**
+ * Stores records of any length on HeapPages.
+ *
+ * A record of at most max_inline bytes is stored whole on its HeapPage. A
+ * longer record keeps only its first inline_length bytes there; the rest
+ * is split into chunks, one per overflow page. An overflow page is a
+ * HeapPage holding one record, the chunk, and its next PageNum links the
+ * chain. Every record is stored behind an OverflowRecordHeader with its
+ * length and the first page of its chain, so a scan of the HeapPage (for
+ * example with HeapPageScanner, after skipping the header) only touches
+ * the inline part and never pins an overflow page. OverflowReader streams
+ * the whole record, one page at a time.
+ *
+ * The HeapPages given to OverflowRecords must only hold records written
+ * by it, and must not be compressed: records are read through
+ * HeapPage::getRecordView.
+ */
+class OverflowRecords {
+
+  public:
+
+    /**
+     * @brief Constructor.
+     *
+     * @pre None.
+     * @post None.
+     *
+     * @param source Allocates, pins and frees the overflow pages.
+     * @param inline_length Length of the prefix of a large record kept on
+     *    its HeapPage.
+     * @param max_inline Length above which a record is moved to overflow
+     *    pages.
+     *
+     * @throw std::invalid_argument If inline_length is larger than
+     *    max_inline.
+     */
+    OverflowRecords(OverflowPageSource* source,
+        std::uint32_t inline_length = OVERFLOW_INLINE_LENGTH,
+        std::uint32_t max_inline = OVERFLOW_MAX_INLINE);
+
+    /**
+     * @brief Inserts a record of any length on page.
+     *
+     * @pre page is pinned.
+     * @post The record is stored on page, with the bytes past the inline
+     *    prefix on new overflow pages if it is longer than max_inline. If
+     *    an exception is thrown no overflow page is left allocated.
+     *
+     * @param page HeapPage to insert the record on.
+     * @param record Bytes of the record.
+     * @param length Length of the record.
+     * @return SlotId of the record on page.
+     *
+     * @throw EmptyDataHeapPage If length is 0.
+     * @throw InsufficientSpaceHeapPage If page has no room for the inline
+     *    part.
+     */
+    SlotId insertRecord(HeapPage* page, const char* record,
+        std::uint32_t length);
+
+    /**
+     * @brief Deletes a record and frees its overflow pages.
+     *
+     * @pre page is pinned and slot_id is a record written by insertRecord.
+     * @post The slot and every overflow page of the record are freed.
+     *
+     * @param page HeapPage of the record.
+     * @param slot_id SlotId of the record.
+     *
+     * @throw InvalidSlotIdHeapPage If slot_id is not a valid slot.
+     */
+    void deleteRecord(HeapPage* page, SlotId slot_id);
+
+    /**
+     * @brief Copies a whole record, reading its overflow pages.
+     *
+     * @pre page is pinned and slot_id is a record written by insertRecord.
+     * @post record_data holds the record.
+     *
+     * @param page HeapPage of the record.
+     * @param slot_id SlotId of the record.
+     * @param record_data Data to copy the record into.
+     *
+     * @throw InvalidSlotIdHeapPage If slot_id is not a valid slot.
+     * @throw InvalidSizeData If record_data is too small for the record.
+     */
+    void getRecord(HeapPage* page, SlotId slot_id, Data* record_data);
+
+    /**
+     * @brief Gets a view of the inline part of a record, without touching
+     *    its overflow pages.
+     *
+     * @pre Same as getRecord.
+     * @post Same as HeapPage::getRecordView.
+     *
+     * @param page HeapPage of the record.
+     * @param slot_id SlotId of the record.
+     * @return View of the whole record if it is inline, or of its prefix.
+     *
+     * @throw InvalidSlotIdHeapPage If slot_id is not a valid slot.
+     */
+    RecordView getInline(HeapPage* page, SlotId slot_id);
+
+    /**
+     * @brief Getter for the header of a record.
+     *
+     * @pre Same as getRecord.
+     *
+     * @param page HeapPage of the record.
+     * @param slot_id SlotId of the record.
+     * @return The OverflowRecordHeader of the record.
+     *
+     * @throw InvalidSlotIdHeapPage If slot_id is not a valid slot.
+     */
+    OverflowRecordHeader getHeader(HeapPage* page, SlotId slot_id);
+
+    /**
+     * @brief Getter for the page source.
+     * @return source given to the constructor.
+     */
+    OverflowPageSource* getSource();
+
+  private:
+
+    /**
+     * @brief Writes bytes to a chain of new overflow pages.
+     *
+     * @post If an exception is thrown every page allocated is freed.
+     *
+     * @param bytes Bytes to write.
+     * @param length Number of bytes, more than 0.
+     * @return PageNum of the first page of the chain.
+     */
+    PageNum _writeChain(const char* bytes, std::uint32_t length);
+
+    /**
+     * @brief Frees a chain of overflow pages.
+     *
+     * @param first_page First page of the chain, or INVALID_PAGE_NUM.
+     */
+    void _freeChain(PageNum first_page);
+
+    /**
+     * Allocates, pins and frees the overflow pages.
+     */
+    OverflowPageSource* source;
+
+    /**
+     * Length of the prefix of a large record kept on its HeapPage.
+     */
+    std::uint32_t inline_length;
+
+    /**
+     * Length above which a record is moved to overflow pages.
+     */
+    std::uint32_t max_inline;
+};
+
+/**
+ * Streams a record written by OverflowRecords: first the inline bytes,
+ * then each overflow page in chain order, with at most one overflow page
+ * pinned at a time.
+ */
+class OverflowReader {
+
+  public:
+
+    /**
+     * @brief Constructor.
+     *
+     * @pre page is pinned, slot_id is a record written by records, and the
+     *    record is not changed or deleted while it is read.
+     * @post The reader is at the first byte of the record.
+     *
+     * @param records OverflowRecords that wrote the record.
+     * @param page HeapPage of the record.
+     * @param slot_id SlotId of the record.
+     *
+     * @throw InvalidSlotIdHeapPage If slot_id is not a valid slot.
+     */
+    OverflowReader(OverflowRecords* records, HeapPage* page,
+        SlotId slot_id);
+
+    /**
+     * @brief Destructor. Unpins the overflow page being read, if any.
+     */
+    ~OverflowReader();
+
+    /**
+     * @brief Copies the next bytes of the record.
+     *
+     * @pre buffer holds max_length bytes.
+     * @post The reader is past the bytes copied.
+     *
+     * @param buffer Buffer to copy to.
+     * @param max_length Most bytes to copy.
+     * @return Number of bytes copied: max_length, or fewer at the end of
+     *    the record, 0 once it is all read.
+     */
+    std::uint32_t read(char* buffer, std::uint32_t max_length);
+
+    /**
+     * @brief Getter for the length of the record.
+     * @return Length of the whole record in bytes.
+     */
+    std::uint32_t getLength();
+
+    /**
+     * @brief Getter for the number of bytes not read yet.
+     * @return Length minus the bytes returned by read so far.
+     */
+    std::uint32_t getRemaining();
+
+  private:
+
+    /**
+     * @brief Moves to the next overflow page of the chain, unpinning the
+     *    current one.
+     */
+    void _nextPage();
+
+    /**
+     * Pins and unpins the overflow pages.
+     */
+    OverflowPageSource* source;
+
+    /**
+     * PageNum of the pinned overflow page, or INVALID_PAGE_NUM while the
+     *    inline bytes are read.
+     */
+    PageNum current_page;
+
+    /**
+     * PageNum of the next overflow page to read, or INVALID_PAGE_NUM if
+     *    piece is the last one.
+     */
+    PageNum next_page;
+
+    /**
+     * Bytes of the current piece: the inline bytes or a chunk.
+     */
+    RecordView piece;
+
+    /**
+     * Bytes of piece already read.
+     */
+    std::uint32_t piece_offset;
+
+    /**
+     * Length of the whole record.
+     */
+    std::uint32_t length;
+
+    /**
+     * Bytes not read yet.
+     */
+    std::uint32_t remaining;
+};
+
+#endif
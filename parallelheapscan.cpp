@@ -0,0 +1,226 @@
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
+#include "parallelheapscan.h"
+#include "heappage.h"
+#include "heappagescanner.h"
+#include "heapfilescanner.h"
+
+/**
+ * @brief Constructor.
+ *
+ * @pre source is thread safe.
+ * @post The scan is ready to run with num_workers threads.
+ *
+ * @param source HeapPageSource of the pages.
+ * @param num_workers Number of worker threads, including the thread
+ *    calling run.
+ * @param morsel_pages Number of pages per morsel.
+ *
+ * @throw std::invalid_argument If num_workers or morsel_pages is 0.
+ */
+ParallelHeapScan::ParallelHeapScan(HeapPageSource* source,
+    std::uint32_t num_workers, std::uint32_t morsel_pages)
+  : queues(num_workers), stolen(0), aborted(false){
+  if (num_workers == 0 || morsel_pages == 0){
+    throw std::invalid_argument("ParallelHeapScan: no workers or morsels");
+  }
+  this->source = source;
+  this->num_workers = num_workers;
+  this->morsel_pages = morsel_pages;
+}
+
+/**
+ * @brief Destructor.
+ */
+ParallelHeapScan::~ParallelHeapScan(){}
+
+/**
+ * @brief Scans every valid slot of pages with all the workers.
+ *
+ * @pre No other run of this scan is in progress.
+ * @post visitor was called for every valid slot of every page not ruled
+ *    out by predicate, exactly once. Every page is unpinned.
+ *
+ * @param pages PageNums of the pages to scan.
+ * @param visitor Called with the slots found, from the worker threads.
+ * @param predicate If not NULL, pages whose synopsis rules it out are
+ *    skipped (see HeapPageScanner::resetFiltered).
+ *
+ * @throw Rethrows the first exception thrown by a worker (by the page
+ *    source or the visitor), after every worker stopped.
+ */
+void ParallelHeapScan::run(const std::vector<PageNum>& pages,
+    const Visitor& visitor, const SynopsisPredicate* predicate){
+  std::uint32_t num_morsels = (pages.size() + this->morsel_pages - 1)
+    / this->morsel_pages;
+
+  //give every worker a contiguous share of the morsels, so a worker that
+  //does not steal scans neighbouring pages
+  for (std::uint32_t w = 0; w < this->num_workers; w++){
+    std::uint32_t begin = (std::uint64_t) num_morsels * w / this->num_workers;
+    std::uint32_t end = (std::uint64_t) num_morsels * (w + 1)
+      / this->num_workers;
+    this->queues[w].morsels.clear();
+    for (std::uint32_t m = begin; m < end; m++){
+      this->queues[w].morsels.push_back(m);
+    }
+  }
+  this->stolen = 0;
+  this->aborted = false;
+  this->error = nullptr;
+
+  //the calling thread is worker 0
+  std::vector<std::thread> threads;
+  for (std::uint32_t w = 1; w < this->num_workers; w++){
+    threads.emplace_back(&ParallelHeapScan::_work, this, w, std::cref(pages),
+        std::cref(visitor), predicate);
+  }
+  this->_work(0, pages, visitor, predicate);
+  for (std::thread& thread : threads){
+    thread.join();
+  }
+
+  if (this->error != nullptr){
+    std::rethrow_exception(this->error);
+  }
+}
+
+/**
+ * @brief Returns the ids of every valid slot of pages, gathered in one
+ *    buffer per worker and merged.
+ *
+ * @pre Same as run.
+ * @post Same as run.
+ *
+ * @param pages PageNums of the pages to scan.
+ * @param predicate Same as run.
+ * @return The ids of every record, grouped by the worker that found
+ *    them; within a morsel records are in page and slot order.
+ */
+std::vector<ScanRecordId> ParallelHeapScan::collect(
+    const std::vector<PageNum>& pages, const SynopsisPredicate* predicate){
+  std::vector<std::vector<ScanRecordId>> buffers(this->num_workers);
+
+  this->run(pages, [&buffers](std::uint32_t worker, PageNum page_num,
+        HeapPage* page, const SlotId* slot_ids, std::uint32_t num_slots){
+      (void) page;
+      std::vector<ScanRecordId>& buffer = buffers[worker];
+      for (std::uint32_t i = 0; i < num_slots; i++){
+        buffer.push_back(ScanRecordId{page_num, slot_ids[i]});
+      }
+    }, predicate);
+
+  std::size_t total = 0;
+  for (const std::vector<ScanRecordId>& buffer : buffers){
+    total += buffer.size();
+  }
+  std::vector<ScanRecordId> merged;
+  merged.reserve(total);
+  for (const std::vector<ScanRecordId>& buffer : buffers){
+    merged.insert(merged.end(), buffer.begin(), buffer.end());
+  }
+  return merged;
+}
+
+/**
+ * @brief Getter for the number of worker threads.
+ * @return num_workers given to the constructor.
+ */
+std::uint32_t ParallelHeapScan::getNumWorkers(){
+  return this->num_workers;
+}
+
+/**
+ * @brief Getter for the number of morsels stolen by the last run.
+ * @return Number of morsels a worker took from another worker's queue.
+ */
+std::uint32_t ParallelHeapScan::getStolenMorsels(){
+  return this->stolen;
+}
+
+/**
+ * @brief Body of worker thread worker: scans morsels until every queue is
+ *    empty.
+ */
+void ParallelHeapScan::_work(std::uint32_t worker,
+    const std::vector<PageNum>& pages, const Visitor& visitor,
+    const SynopsisPredicate* predicate){
+  HeapPageScanner scanner(nullptr);
+  SlotId slot_ids[PARALLEL_SCAN_BATCH];
+  std::uint32_t morsel;
+
+  try {
+    while (!this->aborted && this->_takeMorsel(worker, &morsel)){
+      std::size_t begin = (std::size_t) morsel * this->morsel_pages;
+      std::size_t end = std::min(begin + this->morsel_pages, pages.size());
+      for (std::size_t i = begin; i < end && !this->aborted; i++){
+        PageNum page_num = pages[i];
+        HeapPage* page = this->source->pinPage(page_num);
+        try {
+          bool scan = true;
+          if (predicate != nullptr){
+            scan = scanner.resetFiltered(page, *predicate);
+          } else {
+            scanner.reset(page);
+          }
+          while (scan){
+            std::uint32_t num = scanner.getNextBatch(slot_ids,
+                PARALLEL_SCAN_BATCH);
+            if (num == 0){
+              break;
+            }
+            visitor(worker, page_num, page, slot_ids, num);
+            scan = num == PARALLEL_SCAN_BATCH;
+          }
+        } catch (...) {
+          this->source->unpinPage(page_num);
+          throw;
+        }
+        this->source->unpinPage(page_num);
+      }
+    }
+  } catch (...) {
+    std::lock_guard<std::mutex> guard(this->error_lock);
+    if (this->error == nullptr){
+      this->error = std::current_exception();
+    }
+    this->aborted = true;
+  }
+}
+
+/**
+ * @brief Takes the next morsel for worker, from its own queue or by
+ *    stealing.
+ *
+ * @param worker Worker asking for a morsel.
+ * @param morsel Set to the morsel index taken.
+ * @return false if every queue is empty.
+ */
+bool ParallelHeapScan::_takeMorsel(std::uint32_t worker,
+    std::uint32_t* morsel){
+  {
+    WorkerQueue& own = this->queues[worker];
+    std::lock_guard<std::mutex> guard(own.lock);
+    if (!own.morsels.empty()){
+      *morsel = own.morsels.front();
+      own.morsels.pop_front();
+      return true;
+    }
+  }
+
+  //no morsel is ever added during a run, so once every queue has been
+  //seen empty the scan is done for this worker
+  for (std::uint32_t i = 1; i < this->num_workers; i++){
+    WorkerQueue& victim = this->queues[(worker + i) % this->num_workers];
+    std::lock_guard<std::mutex> guard(victim.lock);
+    if (!victim.morsels.empty()){
+      *morsel = victim.morsels.back();
+      victim.morsels.pop_back();
+      this->stolen++;
+      return true;
+    }
+  }
+  return false;
+}
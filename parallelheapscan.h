@@ -0,0 +1,218 @@
+#ifndef  _SWATDB_PARALLELHEAPSCAN_H_
+#define  _SWATDB_PARALLELHEAPSCAN_H_
+
+
+/**
+ * \file
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include "swatdb_types.h"
+#include "heappage.h"
+#include "heapfilescanner.h"
+
+/**
+ * Default number of pages in one morsel of a ParallelHeapScan.
+ */
+const std::uint32_t PARALLEL_SCAN_MORSEL_PAGES = 16;
+
+/**
+ * Maximum number of slots ParallelHeapScan passes to one visitor call.
+ */
+const std::uint32_t PARALLEL_SCAN_BATCH = 256;
+
+/**
+ * Identifies a record returned by ParallelHeapScan::collect.
+ */
+struct ScanRecordId{
+
+  /**
+   * PageNum of the page of the record.
+   */
+  PageNum page_num;
+
+  /**
+   * SlotId of the record on its page.
+   */
+  SlotId slot_id;
+};
+
+/**
+ * Parallel scan of the records of a set of HeapPages.
+ *
+ * The pages are split into morsels of morsel_pages consecutive entries of
+ * the page list. Every worker thread starts with an equal share of the
+ * morsels in its own queue and takes them from the front; a worker whose
+ * queue is empty steals from the back of the other queues, so workers that
+ * get cheap pages help the ones that get expensive ones. Each worker scans
+ * its pages with its own HeapPageScanner and hands the valid slots of each
+ * page to the visitor together with its worker number, so the caller can
+ * keep one output buffer per worker and merge them after run returns.
+ *
+ * The HeapPageSource is called from every worker at once, so it must be
+ * thread safe.
+ */
+class ParallelHeapScan {
+
+  public:
+
+    /**
+     * Called by a worker with the valid slots of one page, in order. At
+     * most PARALLEL_SCAN_BATCH slots are passed per call; a page with more
+     * is passed in several calls. The page is pinned during the call.
+     */
+    typedef std::function<void(std::uint32_t worker, PageNum page_num,
+        HeapPage* page, const SlotId* slot_ids, std::uint32_t num_slots)>
+      Visitor;
+
+    /**
+     * @brief Constructor.
+     *
+     * @pre source is thread safe.
+     * @post The scan is ready to run with num_workers threads.
+     *
+     * @param source HeapPageSource of the pages.
+     * @param num_workers Number of worker threads, including the thread
+     *    calling run.
+     * @param morsel_pages Number of pages per morsel.
+     *
+     * @throw std::invalid_argument If num_workers or morsel_pages is 0.
+     */
+    ParallelHeapScan(HeapPageSource* source, std::uint32_t num_workers,
+        std::uint32_t morsel_pages = PARALLEL_SCAN_MORSEL_PAGES);
+
+    /**
+     * @brief Destructor.
+     */
+    ~ParallelHeapScan();
+
+    /**
+     * @brief Scans every valid slot of pages with all the workers.
+     *
+     * @pre No other run of this scan is in progress.
+     * @post visitor was called for every valid slot of every page not ruled
+     *    out by predicate, exactly once. Every page is unpinned.
+     *
+     * @param pages PageNums of the pages to scan.
+     * @param visitor Called with the slots found, from the worker threads.
+     * @param predicate If not NULL, pages whose synopsis rules it out are
+     *    skipped (see HeapPageScanner::resetFiltered).
+     *
+     * @throw Rethrows the first exception thrown by a worker (by the page
+     *    source or the visitor), after every worker stopped.
+     */
+    void run(const std::vector<PageNum>& pages, const Visitor& visitor,
+        const SynopsisPredicate* predicate = nullptr);
+
+    /**
+     * @brief Returns the ids of every valid slot of pages, gathered in one
+     *    buffer per worker and merged.
+     *
+     * @pre Same as run.
+     * @post Same as run.
+     *
+     * @param pages PageNums of the pages to scan.
+     * @param predicate Same as run.
+     * @return The ids of every record, grouped by the worker that found
+     *    them; within a morsel records are in page and slot order.
+     */
+    std::vector<ScanRecordId> collect(const std::vector<PageNum>& pages,
+        const SynopsisPredicate* predicate = nullptr);
+
+    /**
+     * @brief Getter for the number of worker threads.
+     * @return num_workers given to the constructor.
+     */
+    std::uint32_t getNumWorkers();
+
+    /**
+     * @brief Getter for the number of morsels stolen by the last run.
+     * @return Number of morsels a worker took from another worker's queue.
+     */
+    std::uint32_t getStolenMorsels();
+
+  private:
+
+    /**
+     * Morsel queue of one worker.
+     */
+    struct WorkerQueue{
+
+      /**
+       * Protects morsels.
+       */
+      std::mutex lock;
+
+      /**
+       * Indexes of the morsels left; the owner pops the front, thieves
+       * the back.
+       */
+      std::deque<std::uint32_t> morsels;
+    };
+
+    /**
+     * @brief Body of worker thread worker: scans morsels until every queue
+     *    is empty.
+     */
+    void _work(std::uint32_t worker, const std::vector<PageNum>& pages,
+        const Visitor& visitor, const SynopsisPredicate* predicate);
+
+    /**
+     * @brief Takes the next morsel for worker, from its own queue or by
+     *    stealing.
+     *
+     * @param worker Worker asking for a morsel.
+     * @param morsel Set to the morsel index taken.
+     * @return false if every queue is empty.
+     */
+    bool _takeMorsel(std::uint32_t worker, std::uint32_t* morsel);
+
+    /**
+     * Source of the pages.
+     */
+    HeapPageSource* source;
+
+    /**
+     * Number of worker threads.
+     */
+    std::uint32_t num_workers;
+
+    /**
+     * Number of pages per morsel.
+     */
+    std::uint32_t morsel_pages;
+
+    /**
+     * One queue per worker.
+     */
+    std::vector<WorkerQueue> queues;
+
+    /**
+     * Number of morsels stolen during the current or last run.
+     */
+    std::atomic<std::uint32_t> stolen;
+
+    /**
+     * Set when a worker throws, so the others stop taking morsels.
+     */
+    std::atomic<bool> aborted;
+
+    /**
+     * Protects error.
+     */
+    std::mutex error_lock;
+
+    /**
+     * First exception thrown by a worker in the current run, or NULL.
+     */
+    std::exception_ptr error;
+};
+
+#endif
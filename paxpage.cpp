@@ -0,0 +1,386 @@
+#include <cstring>
+#include <stdexcept>
+
+#include "swatdb_exceptions.h"
+#include "paxpage.h"
+#include "page.h"
+#include "data.h"
+
+/*
+ * Returns the number of bytes of a validity bitmap of capacity bits, in
+ * whole 64 bit words.
+ */
+static inline std::uint32_t bitmapBytes(std::uint32_t capacity){
+  return (capacity + 63) / 64 * sizeof(std::uint64_t);
+}
+
+/*
+ * Returns offset rounded up to a multiple of PAX_MINIPAGE_ALIGN.
+ */
+static inline std::uint32_t alignMinipage(std::uint32_t offset){
+  return (offset + PAX_MINIPAGE_ALIGN - 1) / PAX_MINIPAGE_ALIGN
+    * PAX_MINIPAGE_ALIGN;
+}
+
+/*
+ * Lays out the bitmap and the minipages of capacity slots for the schema
+ * widths, writing each minipage offset to offsets. Returns the number of
+ * bytes of the Page used.
+ */
+static std::uint32_t layoutMinipages(const std::uint16_t* widths,
+    std::uint16_t num_attributes, std::uint32_t capacity,
+    std::uint16_t* offsets){
+  std::uint32_t end = sizeof(PaxPageHeader) + bitmapBytes(capacity);
+  for (std::uint16_t a = 0; a < num_attributes; a++){
+    end = alignMinipage(end);
+    offsets[a] = end;
+    end += capacity * widths[a];
+  }
+  return end;
+}
+
+/**
+ * @brief Initializes the header and the minipages for a schema.
+ *
+ * @pre widths holds num_attributes entries.
+ * @post prev_page and next_page are INVALID_PAGE_NUM, the schema is
+ *    stored in the header, capacity is the largest number of slots
+ *    whose bitmap and aligned minipages fit on the Page, and every
+ *    slot is invalid.
+ *
+ * @param widths Width in bytes of every attribute.
+ * @param num_attributes Number of attributes.
+ *
+ * @throw std::invalid_argument If num_attributes is 0 or more than
+ *    PAX_MAX_ATTRIBUTES, a width is 0, or not even one record fits.
+ */
+void PaxPage::initializeHeader(const std::uint16_t* widths,
+    std::uint16_t num_attributes){
+  //throw exceptions
+  if (num_attributes == 0 || num_attributes > PAX_MAX_ATTRIBUTES){
+    throw std::invalid_argument("PaxPage: bad number of attributes");
+  }
+  std::uint32_t record_width = 0;
+  for (std::uint16_t a = 0; a < num_attributes; a++){
+    if (widths[a] == 0){
+      throw std::invalid_argument("PaxPage: attribute of width 0");
+    }
+    record_width += widths[a];
+  }
+
+  //start from the capacity ignoring alignment padding and step down until
+  //the padded layout fits
+  std::uint16_t offsets[PAX_MAX_ATTRIBUTES];
+  std::uint32_t capacity = (PAGE_SIZE - sizeof(PaxPageHeader)) * 8
+    / (record_width * 8 + 1);
+  while (capacity > 0 &&
+      layoutMinipages(widths, num_attributes, capacity, offsets)
+      > PAGE_SIZE){
+    capacity--;
+  }
+  if (capacity == 0){
+    throw std::invalid_argument("PaxPage: record does not fit on a page");
+  }
+
+  PaxPageHeader* header = this->_getPageHeader();
+  std::memset(this->data, 0, sizeof(PaxPageHeader) + bitmapBytes(capacity));
+  header->prev_page = INVALID_PAGE_NUM;
+  header->next_page = INVALID_PAGE_NUM;
+  header->num_attributes = num_attributes;
+  header->capacity = capacity;
+  header->size = 0;
+  header->record_width = record_width;
+  for (std::uint16_t a = 0; a < num_attributes; a++){
+    header->widths[a] = widths[a];
+    header->offsets[a] = offsets[a];
+  }
+}
+
+/**
+ * @brief Sets next_page to the given PageNum.
+ *
+ * @param page_num PageNum of the next Page.
+ */
+void PaxPage::setNext(PageNum page_num){
+  this->_getPageHeader()->next_page = page_num;
+}
+
+/**
+ * @brief Sets prev_page to the given PageNum.
+ *
+ * @param page_num PageNum of the previous Page.
+ */
+void PaxPage::setPrev(PageNum page_num){
+  this->_getPageHeader()->prev_page = page_num;
+}
+
+/**
+ * @brief Getter for next_page.
+ * @return PageNum of the next Page.
+ */
+PageNum PaxPage::getNext(){
+  return this->_getPageHeader()->next_page;
+}
+
+/**
+ * @brief Getter for prev_page.
+ * @return PageNum of the previous Page.
+ */
+PageNum PaxPage::getPrev(){
+  return this->_getPageHeader()->prev_page;
+}
+
+/**
+ * @brief Getter for the number of record slots.
+ * @return capacity of the Page.
+ */
+std::uint32_t PaxPage::getCapacity(){
+  return this->_getPageHeader()->capacity;
+}
+
+/**
+ * @brief Getter for the number of records on the Page.
+ * @return Number of valid slots.
+ */
+std::uint32_t PaxPage::getSize(){
+  return this->_getPageHeader()->size;
+}
+
+/**
+ * @brief bool function indicating whether the Page is full.
+ * @return true if every slot holds a record.
+ */
+bool PaxPage::isFull(){
+  PaxPageHeader* header = this->_getPageHeader();
+  return header->size == header->capacity;
+}
+
+/**
+ * @brief Getter for the width of a record in row format.
+ * @return Sum of the attribute widths.
+ */
+std::uint32_t PaxPage::getRecordWidth(){
+  return this->_getPageHeader()->record_width;
+}
+
+/**
+ * @brief Inserts a record into the first free slot, scattering its
+ *    values into the minipages.
+ *
+ * @pre A valid Data* of getRecordWidth() bytes is provided as input.
+ * @post The values of the record are copied into the minipages at the
+ *    first free slot, whose bit is set.
+ *
+ * @param record_data Data* of the record, in row format.
+ * @return SlotId of the inserted record.
+ *
+ * @throw EmptyDataHeapPage If the record is size 0.
+ * @throw InvalidSizeData If the record is not getRecordWidth() bytes.
+ * @throw InsufficientSpaceHeapPage If every slot holds a record.
+ */
+SlotId PaxPage::insertRecord(Data* record_data){
+  PaxPageHeader* header = this->_getPageHeader();
+  std::uint64_t* bitmap = this->_getBitmap();
+
+  //throw exceptions
+  this->_checkRecordSize(record_data);
+  if (header->size == header->capacity){
+    throw InsufficientSpaceHeapPage();
+  }
+
+  //first clear bit; some slot in range is free, so it is in range
+  std::uint32_t word = 0;
+  while (bitmap[word] == UINT64_MAX){
+    word++;
+  }
+  SlotId slot_id = word * 64 + __builtin_ctzll(~bitmap[word]);
+
+  bitmap[word] |= (std::uint64_t) 1 << (slot_id % 64);
+  this->_writeRecord(slot_id, record_data->getData());
+  header->size++;
+  return slot_id;
+}
+
+/**
+ * @brief Gets the record identified by its SlotId, gathering its values
+ *    from the minipages.
+ *
+ * @pre record_data has a capacity of at least getRecordWidth().
+ * @post record_data holds the record in row format.
+ *
+ * @param slot_id SlotId of the record to get.
+ * @param record_data Data* to copy the record into.
+ *
+ * @throw InvalidSlotIdHeapPage If slot_id is out of range or the slot
+ *    does not hold a record.
+ * @throw InvalidSizeData If record_data is too small.
+ */
+void PaxPage::getRecord(SlotId slot_id, Data* record_data){
+  PaxPageHeader* header = this->_getPageHeader();
+
+  //throw exceptions
+  if (!this->isValid(slot_id)){
+    throw InvalidSlotIdHeapPage(slot_id);
+  }
+  if (record_data->getCapacity() < header->record_width){
+    throw InvalidSizeData();
+  }
+
+  char* out = record_data->getData();
+  for (std::uint16_t a = 0; a < header->num_attributes; a++){
+    std::uint32_t width = header->widths[a];
+    std::memcpy(out, this->data + header->offsets[a] + slot_id * width,
+        width);
+    out += width;
+  }
+  record_data->setSize(header->record_width);
+}
+
+/**
+ * @brief Overwrites the record identified by its SlotId.
+ *
+ * @pre A valid Data* of getRecordWidth() bytes is provided as input.
+ * @post The values of the slot are replaced by those of record_data.
+ *
+ * @param slot_id SlotId of the record to update.
+ * @param record_data Data* of the new record, in row format.
+ *
+ * @throw InvalidSlotIdHeapPage If slot_id is out of range or the slot
+ *    does not hold a record.
+ * @throw EmptyDataHeapPage If the record is size 0.
+ * @throw InvalidSizeData If the record is not getRecordWidth() bytes.
+ */
+void PaxPage::updateRecord(SlotId slot_id, Data* record_data){
+  //throw exceptions
+  if (!this->isValid(slot_id)){
+    throw InvalidSlotIdHeapPage(slot_id);
+  }
+  this->_checkRecordSize(record_data);
+
+  this->_writeRecord(slot_id, record_data->getData());
+}
+
+/**
+ * @brief Deletes the record identified by its SlotId. No value moves.
+ *
+ * @pre None.
+ * @post The bit of the slot is cleared and the slot can be reused.
+ *
+ * @param slot_id SlotId of the record to delete.
+ *
+ * @throw InvalidSlotIdHeapPage If slot_id is out of range or the slot
+ *    does not hold a record.
+ */
+void PaxPage::deleteRecord(SlotId slot_id){
+  //throw exceptions
+  if (!this->isValid(slot_id)){
+    throw InvalidSlotIdHeapPage(slot_id);
+  }
+
+  this->_getBitmap()[slot_id / 64] &= ~((std::uint64_t) 1 << (slot_id % 64));
+  this->_getPageHeader()->size--;
+}
+
+/**
+ * @brief Returns the value of one attribute of a record.
+ *
+ * @pre The Page is pinned.
+ * @post The returned pointer stays valid until the record is updated or
+ *    deleted or the Page is unpinned.
+ *
+ * @param slot_id SlotId of the record.
+ * @param attribute Index of the attribute in the schema.
+ * @return Address of the getAttributeWidth(attribute) bytes of the
+ *    value in the Page.
+ *
+ * @throw InvalidSlotIdHeapPage If slot_id is out of range or the slot
+ *    does not hold a record.
+ * @throw std::out_of_range If attribute is not in the schema.
+ */
+const char* PaxPage::getAttribute(SlotId slot_id, std::uint16_t attribute){
+  PaxPageHeader* header = this->_getPageHeader();
+
+  //throw exceptions
+  this->_checkAttribute(attribute);
+  if (!this->isValid(slot_id)){
+    throw InvalidSlotIdHeapPage(slot_id);
+  }
+
+  return this->data + header->offsets[attribute]
+    + slot_id * header->widths[attribute];
+}
+
+/**
+ * @brief Getter for the width of an attribute.
+ *
+ * @param attribute Index of the attribute in the schema.
+ * @return Width in bytes of its values.
+ *
+ * @throw std::out_of_range If attribute is not in the schema.
+ */
+std::uint32_t PaxPage::getAttributeWidth(std::uint16_t attribute){
+  this->_checkAttribute(attribute);
+  return this->_getPageHeader()->widths[attribute];
+}
+
+/**
+ * @brief Checks whether a slot holds a record.
+ *
+ * @param slot_id SlotId to check.
+ * @return true if slot_id is in range and holds a record.
+ */
+bool PaxPage::isValid(SlotId slot_id){
+  return slot_id < this->_getPageHeader()->capacity &&
+    (this->_getBitmap()[slot_id / 64] >> (slot_id % 64) & 1);
+}
+
+/**
+ * @brief Getter for the Page header.
+ */
+PaxPageHeader* PaxPage::_getPageHeader(){
+  return (PaxPageHeader*) this->data;
+}
+
+/**
+ * @brief Getter for the validity bitmap, one bit per slot.
+ */
+std::uint64_t* PaxPage::_getBitmap(){
+  return (std::uint64_t*) (this->data + sizeof(PaxPageHeader));
+}
+
+/**
+ * @brief Throws EmptyDataHeapPage or InvalidSizeData unless record_data
+ *    is getRecordWidth() bytes.
+ */
+void PaxPage::_checkRecordSize(Data* record_data){
+  if (record_data->getSize() == 0){
+    throw EmptyDataHeapPage();
+  }
+  if (record_data->getSize() != this->_getPageHeader()->record_width){
+    throw InvalidSizeData();
+  }
+}
+
+/**
+ * @brief Scatters a record in row format into the minipages at
+ *    slot_id.
+ */
+void PaxPage::_writeRecord(SlotId slot_id, const char* record){
+  PaxPageHeader* header = this->_getPageHeader();
+
+  for (std::uint16_t a = 0; a < header->num_attributes; a++){
+    std::uint32_t width = header->widths[a];
+    std::memcpy(this->data + header->offsets[a] + slot_id * width, record,
+        width);
+    record += width;
+  }
+}
+
+/**
+ * @brief Throws std::out_of_range unless attribute is in the schema.
+ */
+void PaxPage::_checkAttribute(std::uint16_t attribute){
+  if (attribute >= this->_getPageHeader()->num_attributes){
+    throw std::out_of_range("PaxPage: attribute not in the schema");
+  }
+}
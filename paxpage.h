@@ -0,0 +1,306 @@
+#ifndef  _SWATDB_PAXPAGE_H_
+#define  _SWATDB_PAXPAGE_H_
+
+
+/**
+ * \file
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include "swatdb_types.h"
+#include "page.h"
+
+class Data;
+
+/**
+ * Maximum number of attributes of a PaxPage schema.
+ */
+const std::uint16_t PAX_MAX_ATTRIBUTES = 16;
+
+/**
+ * Alignment in bytes of the first value of every minipage, so that SIMD
+ * loads of a column start on a vector boundary relative to the Page.
+ */
+const std::uint32_t PAX_MINIPAGE_ALIGN = 32;
+
+/**
+ * Struct for the header metadata of PaxPage object. The schema is stored in
+ * the header, since a PaxPage is type casted over the Page data and has no
+ * other place to keep it.
+ */
+struct PaxPageHeader{
+
+  /**
+   * PageNum of the previous Page in the file.
+   */
+  PageNum prev_page;
+
+  /**
+   * PageNum of the next Page in the file.
+   */
+  PageNum next_page;
+
+  /**
+   * Number of attributes of the schema.
+   */
+  std::uint16_t num_attributes;
+
+  /**
+   * Number of record slots on the Page.
+   */
+  std::uint16_t capacity;
+
+  /**
+   * Number of records stored on the Page.
+   */
+  std::uint16_t size;
+
+  /**
+   * Width in bytes of a whole record (sum of the attribute widths).
+   */
+  std::uint16_t record_width;
+
+  /**
+   * Width in bytes of every attribute.
+   */
+  std::uint16_t widths[PAX_MAX_ATTRIBUTES];
+
+  /**
+   * Offset of the minipage of every attribute from the beginning of the
+   * Page. The value of attribute a for slot i is at
+   * offsets[a] + i * widths[a].
+   */
+  std::uint16_t offsets[PAX_MAX_ATTRIBUTES];
+};
+
+/**
+ * SwatDB PaxPage Class.
+ *
+ * A page for records of a fixed-width schema in the PAX layout: the Page is
+ * split into one minipage per attribute, and a minipage holds the values of
+ * its attribute for every slot, one after the other. A scan of one
+ * attribute reads only its minipage (see PaxColumnScanner). A bitmap with
+ * one bit per slot after the header tells which slots hold a record, so
+ * SlotIds never change and deletes move nothing.
+ *
+ * Records are passed in and out in row format: the values of all the
+ * attributes concatenated in schema order.
+ *
+ * Like HeapPage, a PaxPage pointer is type casted to a Page pointer
+ * returned by the BufferManager. It has no version latch, so concurrent
+ * writers and readers of one Page must be synchronized by the caller.
+ */
+class PaxPage : public Page {
+
+  friend class PaxColumnScanner;
+
+  public:
+
+    /**
+     * @brief Constructor. Never called, see HeapPage::HeapPage.
+     */
+    PaxPage() = delete;
+
+    /**
+     * Destructor: shouldn't do anything
+     */
+    ~PaxPage() {}
+
+    /**
+     * @brief Initializes the header and the minipages for a schema.
+     *
+     * @pre widths holds num_attributes entries.
+     * @post prev_page and next_page are INVALID_PAGE_NUM, the schema is
+     *    stored in the header, capacity is the largest number of slots
+     *    whose bitmap and aligned minipages fit on the Page, and every
+     *    slot is invalid.
+     *
+     * @param widths Width in bytes of every attribute.
+     * @param num_attributes Number of attributes.
+     *
+     * @throw std::invalid_argument If num_attributes is 0 or more than
+     *    PAX_MAX_ATTRIBUTES, a width is 0, or not even one record fits.
+     */
+    void initializeHeader(const std::uint16_t* widths,
+        std::uint16_t num_attributes);
+
+    /**
+     * @brief Sets next_page to the given PageNum.
+     *
+     * @param page_num PageNum of the next Page.
+     */
+    void setNext(PageNum page_num);
+
+    /**
+     * @brief Sets prev_page to the given PageNum.
+     *
+     * @param page_num PageNum of the previous Page.
+     */
+    void setPrev(PageNum page_num);
+
+    /**
+     * @brief Getter for next_page.
+     * @return PageNum of the next Page.
+     */
+    PageNum getNext();
+
+    /**
+     * @brief Getter for prev_page.
+     * @return PageNum of the previous Page.
+     */
+    PageNum getPrev();
+
+    /**
+     * @brief Getter for the number of record slots.
+     * @return capacity of the Page.
+     */
+    std::uint32_t getCapacity();
+
+    /**
+     * @brief Getter for the number of records on the Page.
+     * @return Number of valid slots.
+     */
+    std::uint32_t getSize();
+
+    /**
+     * @brief bool function indicating whether the Page is full.
+     * @return true if every slot holds a record.
+     */
+    bool isFull();
+
+    /**
+     * @brief Getter for the width of a record in row format.
+     * @return Sum of the attribute widths.
+     */
+    std::uint32_t getRecordWidth();
+
+    /**
+     * @brief Inserts a record into the first free slot, scattering its
+     *    values into the minipages.
+     *
+     * @pre A valid Data* of getRecordWidth() bytes is provided as input.
+     * @post The values of the record are copied into the minipages at the
+     *    first free slot, whose bit is set.
+     *
+     * @param record_data Data* of the record, in row format.
+     * @return SlotId of the inserted record.
+     *
+     * @throw EmptyDataHeapPage If the record is size 0.
+     * @throw InvalidSizeData If the record is not getRecordWidth() bytes.
+     * @throw InsufficientSpaceHeapPage If every slot holds a record.
+     */
+    SlotId insertRecord(Data* record_data);
+
+    /**
+     * @brief Gets the record identified by its SlotId, gathering its values
+     *    from the minipages.
+     *
+     * @pre record_data has a capacity of at least getRecordWidth().
+     * @post record_data holds the record in row format.
+     *
+     * @param slot_id SlotId of the record to get.
+     * @param record_data Data* to copy the record into.
+     *
+     * @throw InvalidSlotIdHeapPage If slot_id is out of range or the slot
+     *    does not hold a record.
+     * @throw InvalidSizeData If record_data is too small.
+     */
+    void getRecord(SlotId slot_id, Data* record_data);
+
+    /**
+     * @brief Overwrites the record identified by its SlotId.
+     *
+     * @pre A valid Data* of getRecordWidth() bytes is provided as input.
+     * @post The values of the slot are replaced by those of record_data.
+     *
+     * @param slot_id SlotId of the record to update.
+     * @param record_data Data* of the new record, in row format.
+     *
+     * @throw InvalidSlotIdHeapPage If slot_id is out of range or the slot
+     *    does not hold a record.
+     * @throw EmptyDataHeapPage If the record is size 0.
+     * @throw InvalidSizeData If the record is not getRecordWidth() bytes.
+     */
+    void updateRecord(SlotId slot_id, Data* record_data);
+
+    /**
+     * @brief Deletes the record identified by its SlotId. No value moves.
+     *
+     * @pre None.
+     * @post The bit of the slot is cleared and the slot can be reused.
+     *
+     * @param slot_id SlotId of the record to delete.
+     *
+     * @throw InvalidSlotIdHeapPage If slot_id is out of range or the slot
+     *    does not hold a record.
+     */
+    void deleteRecord(SlotId slot_id);
+
+    /**
+     * @brief Returns the value of one attribute of a record.
+     *
+     * @pre The Page is pinned.
+     * @post The returned pointer stays valid until the record is updated or
+     *    deleted or the Page is unpinned.
+     *
+     * @param slot_id SlotId of the record.
+     * @param attribute Index of the attribute in the schema.
+     * @return Address of the getAttributeWidth(attribute) bytes of the
+     *    value in the Page.
+     *
+     * @throw InvalidSlotIdHeapPage If slot_id is out of range or the slot
+     *    does not hold a record.
+     * @throw std::out_of_range If attribute is not in the schema.
+     */
+    const char* getAttribute(SlotId slot_id, std::uint16_t attribute);
+
+    /**
+     * @brief Getter for the width of an attribute.
+     *
+     * @param attribute Index of the attribute in the schema.
+     * @return Width in bytes of its values.
+     *
+     * @throw std::out_of_range If attribute is not in the schema.
+     */
+    std::uint32_t getAttributeWidth(std::uint16_t attribute);
+
+    /**
+     * @brief Checks whether a slot holds a record.
+     *
+     * @param slot_id SlotId to check.
+     * @return true if slot_id is in range and holds a record.
+     */
+    bool isValid(SlotId slot_id);
+
+  private:
+
+    /**
+     * @brief Getter for the Page header.
+     */
+    PaxPageHeader* _getPageHeader();
+
+    /**
+     * @brief Getter for the validity bitmap, one bit per slot.
+     */
+    std::uint64_t* _getBitmap();
+
+    /**
+     * @brief Throws EmptyDataHeapPage or InvalidSizeData unless record_data
+     *    is getRecordWidth() bytes.
+     */
+    void _checkRecordSize(Data* record_data);
+
+    /**
+     * @brief Scatters a record in row format into the minipages at
+     *    slot_id.
+     */
+    void _writeRecord(SlotId slot_id, const char* record);
+
+    /**
+     * @brief Throws std::out_of_range unless attribute is in the schema.
+     */
+    void _checkAttribute(std::uint16_t attribute);
+};
+
+#endif
@@ -0,0 +1,210 @@
+#include <cstring>
+#include <stdexcept>
+
+#include "swatdb_exceptions.h"
+#include "paxpage.h"
+#include "paxpagescanner.h"
+#include "page.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*
+ * Number of values compared at once by compareMask.
+ */
+static const std::uint32_t VALUE_BLOCK = 8;
+
+/*
+ * Combines the equal and greater-than bitmasks of a block into the bitmask
+ * of op.
+ */
+static inline std::uint32_t combineMask(PaxCompareOp op, std::uint32_t eq,
+    std::uint32_t gt){
+  switch (op){
+    case PAX_EQ: return eq;
+    case PAX_NE: return ~eq;
+    case PAX_LT: return ~(eq | gt);
+    case PAX_LE: return ~gt;
+    case PAX_GT: return gt;
+    case PAX_GE: return eq | gt;
+  }
+  return 0;
+}
+
+/*
+ * Returns a bitmask with bit i set if values[i] OP operand, for the
+ * VALUE_BLOCK values starting at values.
+ */
+static inline std::uint32_t compareMask(const char* values,
+    PaxCompareOp op, std::int32_t operand){
+  std::uint32_t eq;
+  std::uint32_t gt;
+#if defined(__AVX2__)
+  const __m256i rhs = _mm256_set1_epi32(operand);
+  __m256i v = _mm256_loadu_si256((const __m256i*) values);
+  eq = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(v, rhs)));
+  gt = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(v, rhs)));
+#elif defined(__SSE2__)
+  const __m128i rhs = _mm_set1_epi32(operand);
+  __m128i lo = _mm_loadu_si128((const __m128i*) values);
+  __m128i hi = _mm_loadu_si128((const __m128i*) (values + 16));
+  eq = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(lo, rhs)))
+    | _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(hi, rhs))) << 4;
+  gt = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(lo, rhs)))
+    | _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(hi, rhs))) << 4;
+#else
+  eq = 0;
+  gt = 0;
+  for (std::uint32_t i = 0; i < VALUE_BLOCK; i++){
+    std::int32_t value;
+    std::memcpy(&value, values + i * sizeof(std::int32_t), sizeof(value));
+    eq |= (std::uint32_t) (value == operand) << i;
+    gt |= (std::uint32_t) (value > operand) << i;
+  }
+#endif
+  return combineMask(op, eq, gt) & 0xFF;
+}
+
+/**
+ * @brief Constructor.
+ *
+ * @pre Valid PaxPage* is provided as input. The given Page is pinned.
+ * @post PaxColumnScanner is constructed before the first slot of the
+ *    attribute. page is still pinned.
+ *
+ * @param page PaxPage object to be scanned.
+ * @param attribute Index of the attribute to scan.
+ *
+ * @throw std::out_of_range If attribute is not in the schema of page.
+ */
+PaxColumnScanner::PaxColumnScanner(PaxPage* page, std::uint16_t attribute){
+  this->reset(page, attribute);
+}
+
+/**
+ * @brief Destructor.
+ */
+PaxColumnScanner::~PaxColumnScanner(){}
+
+/**
+ * @brief Returns SlotId of the next valid slot and its attribute value.
+ *
+ * @pre page is pinned. value is not NULL.
+ * @post If a valid slot is found, value points at its attribute value
+ *    in the minipage and the current slot is set to it. Otherwise value
+ *    is not modified. page is still pinned.
+ *
+ * @param value Set to the address of the getWidth() bytes of the value.
+ * @return Next valid SlotId. INVALID_SLOT_ID if the end of the Page is
+ *    reached.
+ */
+SlotId PaxColumnScanner::getNext(const char** value){
+  std::uint32_t capacity = this->page->getCapacity();
+  std::uint64_t* bitmap = this->page->_getBitmap();
+
+  if (this->cur_slot >= capacity){
+    return INVALID_SLOT_ID;
+  }
+  std::uint32_t word = this->cur_slot / 64;
+  //ignore the slots before cur_slot in its word
+  std::uint64_t bits = bitmap[word] & (UINT64_MAX << (this->cur_slot % 64));
+  while (bits == 0){
+    word++;
+    if (word * 64 >= capacity){
+      this->cur_slot = capacity;
+      return INVALID_SLOT_ID;
+    }
+    bits = bitmap[word];
+  }
+  SlotId slot_id = word * 64 + __builtin_ctzll(bits);
+
+  *value = this->column + slot_id * this->width;
+  this->cur_slot = slot_id + 1;
+  return slot_id;
+}
+
+/**
+ * @brief Evaluates value OP operand on every valid slot of the Page,
+ *    reading the attribute as native-endian 32 bit signed integers.
+ *
+ * @pre page is pinned. slot_ids has room for page->getSize() entries.
+ * @post slot_ids holds the matching SlotIds in increasing order. The
+ *    current slot of getNext is not changed.
+ *
+ * @param op Comparison to apply.
+ * @param operand Right hand side of the comparison.
+ * @param slot_ids Buffer to write the matching SlotIds to.
+ * @return Number of matching slots.
+ *
+ * @throw std::logic_error If the attribute is not 4 bytes wide.
+ */
+std::uint32_t PaxColumnScanner::filterInt32(PaxCompareOp op,
+    std::int32_t operand, SlotId* slot_ids){
+  if (this->width != sizeof(std::int32_t)){
+    throw std::logic_error("PaxColumnScanner: attribute is not 4 bytes");
+  }
+
+  std::uint32_t capacity = this->page->getCapacity();
+  const std::uint8_t* valid = (const std::uint8_t*) this->page->_getBitmap();
+  std::uint32_t num = 0;
+  SlotId slot_id = 0;
+
+  //VALUE_BLOCK slots are one byte of the bitmap; the last block may run
+  //past the minipage, so it is compared one value at a time
+  for (; slot_id + VALUE_BLOCK <= capacity; slot_id += VALUE_BLOCK){
+    std::uint32_t mask = valid[slot_id / VALUE_BLOCK];
+    if (mask == 0){
+      continue;
+    }
+    mask &= compareMask(this->column + slot_id * sizeof(std::int32_t), op,
+        operand);
+    while (mask != 0){
+      slot_ids[num++] = slot_id + __builtin_ctz(mask);
+      mask &= mask - 1;
+    }
+  }
+  for (; slot_id < capacity; slot_id++){
+    if (!(valid[slot_id / 8] >> (slot_id % 8) & 1)){
+      continue;
+    }
+    std::int32_t value;
+    std::memcpy(&value, this->column + slot_id * sizeof(std::int32_t),
+        sizeof(value));
+    std::uint32_t eq = value == operand;
+    std::uint32_t gt = value > operand;
+    if (combineMask(op, eq, gt) & 1){
+      slot_ids[num++] = slot_id;
+    }
+  }
+  return num;
+}
+
+/**
+ * @brief Getter for the width of the scanned attribute.
+ * @return Width in bytes of its values.
+ */
+std::uint32_t PaxColumnScanner::getWidth(){
+  return this->width;
+}
+
+/**
+ * @brief Resets the scanner to the beginning of an attribute of a Page.
+ *
+ * @pre Valid PaxPage* is provided as input and is pinned.
+ * @post The scanner is before the first slot of attribute on page.
+ *
+ * @param page PaxPage object to be scanned.
+ * @param attribute Index of the attribute to scan.
+ *
+ * @throw std::out_of_range If attribute is not in the schema of page.
+ */
+void PaxColumnScanner::reset(PaxPage* page, std::uint16_t attribute){
+  this->width = page->getAttributeWidth(attribute);
+  this->page = page;
+  this->attribute = attribute;
+  this->column = page->data + page->_getPageHeader()->offsets[attribute];
+  this->cur_slot = 0;
+}
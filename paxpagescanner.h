@@ -0,0 +1,139 @@
+#ifndef  _SWATDB_PAXPAGESCANNER_H_
+#define  _SWATDB_PAXPAGESCANNER_H_
+
+
+/**
+ * \file
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include "swatdb_types.h"
+#include "page.h"
+
+/**
+ * PaxPage class.
+ */
+class PaxPage;
+
+/**
+ * Comparison of a column value against an operand, value OP operand.
+ */
+enum PaxCompareOp{
+  PAX_EQ,
+  PAX_NE,
+  PAX_LT,
+  PAX_LE,
+  PAX_GT,
+  PAX_GE
+};
+
+/**
+ * Scanner class for scanning one attribute of a PaxPage. The values of the
+ * attribute are read from its minipage only, one after the other, and
+ * filterInt32 evaluates a predicate over a whole minipage of 32 bit
+ * integers with SIMD compares (AVX2 or SSE2 when compiled in).
+ */
+class PaxColumnScanner {
+
+  public:
+
+    /**
+     * @brief Constructor.
+     *
+     * @pre Valid PaxPage* is provided as input. The given Page is pinned.
+     * @post PaxColumnScanner is constructed before the first slot of the
+     *    attribute. page is still pinned.
+     *
+     * @param page PaxPage object to be scanned.
+     * @param attribute Index of the attribute to scan.
+     *
+     * @throw std::out_of_range If attribute is not in the schema of page.
+     */
+    PaxColumnScanner(PaxPage* page, std::uint16_t attribute);
+
+    /**
+     * @brief Destructor.
+     */
+    ~PaxColumnScanner();
+
+    /**
+     * @brief Returns SlotId of the next valid slot and its attribute value.
+     *
+     * @pre page is pinned. value is not NULL.
+     * @post If a valid slot is found, value points at its attribute value
+     *    in the minipage and the current slot is set to it. Otherwise value
+     *    is not modified. page is still pinned.
+     *
+     * @param value Set to the address of the getWidth() bytes of the value.
+     * @return Next valid SlotId. INVALID_SLOT_ID if the end of the Page is
+     *    reached.
+     */
+    SlotId getNext(const char** value);
+
+    /**
+     * @brief Evaluates value OP operand on every valid slot of the Page,
+     *    reading the attribute as native-endian 32 bit signed integers.
+     *
+     * @pre page is pinned. slot_ids has room for page->getSize() entries.
+     * @post slot_ids holds the matching SlotIds in increasing order. The
+     *    current slot of getNext is not changed.
+     *
+     * @param op Comparison to apply.
+     * @param operand Right hand side of the comparison.
+     * @param slot_ids Buffer to write the matching SlotIds to.
+     * @return Number of matching slots.
+     *
+     * @throw std::logic_error If the attribute is not 4 bytes wide.
+     */
+    std::uint32_t filterInt32(PaxCompareOp op, std::int32_t operand,
+        SlotId* slot_ids);
+
+    /**
+     * @brief Getter for the width of the scanned attribute.
+     * @return Width in bytes of its values.
+     */
+    std::uint32_t getWidth();
+
+    /**
+     * @brief Resets the scanner to the beginning of an attribute of a Page.
+     *
+     * @pre Valid PaxPage* is provided as input and is pinned.
+     * @post The scanner is before the first slot of attribute on page.
+     *
+     * @param page PaxPage object to be scanned.
+     * @param attribute Index of the attribute to scan.
+     *
+     * @throw std::out_of_range If attribute is not in the schema of page.
+     */
+    void reset(PaxPage* page, std::uint16_t attribute);
+
+  private:
+
+    /**
+     * PaxPage being scanned.
+     */
+    PaxPage* page;
+
+    /**
+     * Index of the scanned attribute.
+     */
+    std::uint16_t attribute;
+
+    /**
+     * First byte of the minipage of the attribute.
+     */
+    const char* column;
+
+    /**
+     * Width in bytes of the attribute.
+     */
+    std::uint32_t width;
+
+    /**
+     * Next slot getNext looks at.
+     */
+    SlotId cur_slot;
+};
+
+#endif
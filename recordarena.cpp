@@ -0,0 +1,122 @@
+#include <stdexcept>
+
+#include "recordarena.h"
+
+/**
+ * @brief Constructor. No memory is allocated until the first allocate.
+ *
+ * @pre None.
+ * @post The arena is empty.
+ *
+ * @param block_size Size of the blocks allocated; larger requests get a
+ *    block of their own size.
+ *
+ * @throw std::invalid_argument If block_size is 0.
+ */
+RecordArena::RecordArena(std::size_t block_size)
+  : current(0), used(0), bytes_used(0){
+  if (block_size == 0){
+    throw std::invalid_argument("RecordArena: empty blocks");
+  }
+  this->block_size = block_size;
+}
+
+/**
+ * @brief Destructor. Frees every block.
+ */
+RecordArena::~RecordArena(){}
+
+/**
+ * @brief Takes length bytes from the arena.
+ *
+ * @pre None.
+ * @post The bytes stay valid until reset, or rewind to a mark taken before
+ *    the call.
+ *
+ * @param length Number of bytes.
+ * @return Address of the bytes.
+ */
+char* RecordArena::allocate(std::size_t length){
+  //skip to the next block that is large enough, inserting one if none is
+  while (this->current >= this->blocks.size()
+      || this->blocks[this->current].size - this->used < length){
+    if (this->current < this->blocks.size()){
+      this->current++;
+      this->used = 0;
+    }
+    if (this->current == this->blocks.size()
+        || this->blocks[this->current].size < length){
+      Block block;
+      block.size = length > this->block_size ? length : this->block_size;
+      block.bytes.reset(new char[block.size]);
+      this->blocks.insert(this->blocks.begin() + this->current,
+          std::move(block));
+      this->used = 0;
+    }
+  }
+
+  char* bytes = this->blocks[this->current].bytes.get() + this->used;
+  this->used += length;
+  this->bytes_used += length;
+  return bytes;
+}
+
+/**
+ * @brief Gives back every allocation, keeping the blocks for reuse.
+ *
+ * @pre No pointer returned by allocate is used after the call.
+ * @post The arena is empty.
+ */
+void RecordArena::reset(){
+  this->current = 0;
+  this->used = 0;
+  this->bytes_used = 0;
+}
+
+/**
+ * @brief Getter for the current position.
+ * @return Mark that rewind can go back to.
+ */
+RecordArena::Mark RecordArena::getMark(){
+  Mark mark;
+  mark.block = this->current;
+  mark.used = this->used;
+  mark.bytes_used = this->bytes_used;
+  return mark;
+}
+
+/**
+ * @brief Gives back every allocation made after mark was taken.
+ *
+ * @pre mark was returned by getMark since the last reset, and no pointer
+ *    allocated after it is used after the call.
+ * @post The arena is at mark.
+ *
+ * @param mark Position to go back to.
+ */
+void RecordArena::rewind(const Mark& mark){
+  this->current = mark.block;
+  this->used = mark.used;
+  this->bytes_used = mark.bytes_used;
+}
+
+/**
+ * @brief Getter for the bytes handed out since the last reset.
+ * @return Total length of the allocations, not counting the unused end of
+ *    blocks that were skipped.
+ */
+std::size_t RecordArena::getBytesUsed(){
+  return this->bytes_used;
+}
+
+/**
+ * @brief Getter for the memory held.
+ * @return Total size of the blocks allocated.
+ */
+std::size_t RecordArena::getBytesReserved(){
+  std::size_t reserved = 0;
+  for (const Block& block : this->blocks){
+    reserved += block.size;
+  }
+  return reserved;
+}
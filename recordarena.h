@@ -0,0 +1,174 @@
+#ifndef  _SWATDB_RECORDARENA_H_
+#define  _SWATDB_RECORDARENA_H_
+
+
+/**
+ * \file
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "swatdb_types.h"
+
+/**
+ * Default size of the blocks of a RecordArena.
+ */
+const std::size_t RECORD_ARENA_BLOCK_SIZE = 16 * PAGE_SIZE;
+
+/**
+ * Bump allocator for copies of records, used by HeapPage::getRecords and
+ * HeapPageScanner::getNextRecords.
+ *
+ * Memory is taken from the front of large blocks and is only given back
+ * all at once by reset (or back to a mark by rewind), so materializing a
+ * batch of records costs no heap allocation once the arena has grown to
+ * the size of the batch, and each record takes exactly its length instead
+ * of a Data of PAGE_SIZE bytes. Blocks are kept across resets. Copies are
+ * byte aligned.
+ *
+ * A RecordArena is not thread safe; each thread uses its own.
+ */
+class RecordArena {
+
+  public:
+
+    /**
+     * Position in a RecordArena, for rewinding to.
+     */
+    struct Mark{
+
+      /**
+       * Index of the block in use.
+       */
+      std::size_t block;
+
+      /**
+       * Bytes used in that block.
+       */
+      std::size_t used;
+
+      /**
+       * Bytes handed out since the last reset.
+       */
+      std::size_t bytes_used;
+    };
+
+    /**
+     * @brief Constructor. No memory is allocated until the first
+     *    allocate.
+     *
+     * @pre None.
+     * @post The arena is empty.
+     *
+     * @param block_size Size of the blocks allocated; larger requests get a
+     *    block of their own size.
+     *
+     * @throw std::invalid_argument If block_size is 0.
+     */
+    RecordArena(std::size_t block_size = RECORD_ARENA_BLOCK_SIZE);
+
+    /**
+     * @brief Destructor. Frees every block.
+     */
+    ~RecordArena();
+
+    RecordArena(const RecordArena&) = delete;
+    RecordArena& operator=(const RecordArena&) = delete;
+
+    /**
+     * @brief Takes length bytes from the arena.
+     *
+     * @pre None.
+     * @post The bytes stay valid until reset, or rewind to a mark taken
+     *    before the call.
+     *
+     * @param length Number of bytes.
+     * @return Address of the bytes.
+     */
+    char* allocate(std::size_t length);
+
+    /**
+     * @brief Gives back every allocation, keeping the blocks for reuse.
+     *
+     * @pre No pointer returned by allocate is used after the call.
+     * @post The arena is empty.
+     */
+    void reset();
+
+    /**
+     * @brief Getter for the current position.
+     * @return Mark that rewind can go back to.
+     */
+    Mark getMark();
+
+    /**
+     * @brief Gives back every allocation made after mark was taken.
+     *
+     * @pre mark was returned by getMark since the last reset, and no
+     *    pointer allocated after it is used after the call.
+     * @post The arena is at mark.
+     *
+     * @param mark Position to go back to.
+     */
+    void rewind(const Mark& mark);
+
+    /**
+     * @brief Getter for the bytes handed out since the last reset.
+     * @return Total length of the allocations, not counting the unused end
+     *    of blocks that were skipped.
+     */
+    std::size_t getBytesUsed();
+
+    /**
+     * @brief Getter for the memory held.
+     * @return Total size of the blocks allocated.
+     */
+    std::size_t getBytesReserved();
+
+  private:
+
+    /**
+     * One block of memory.
+     */
+    struct Block{
+
+      /**
+       * Bytes of the block.
+       */
+      std::unique_ptr<char[]> bytes;
+
+      /**
+       * Size of the block.
+       */
+      std::size_t size;
+    };
+
+    /**
+     * Size of new blocks.
+     */
+    std::size_t block_size;
+
+    /**
+     * Every block allocated, in the order they are used.
+     */
+    std::vector<Block> blocks;
+
+    /**
+     * Index in blocks of the block in use.
+     */
+    std::size_t current;
+
+    /**
+     * Bytes used in the block in use.
+     */
+    std::size_t used;
+
+    /**
+     * Bytes handed out since the last reset.
+     */
+    std::size_t bytes_used;
+};
+
+#endif
@@ -0,0 +1,237 @@
+#include <cstring>
+
+#include "recordcodec.h"
+
+/*
+ * Number of bits of the match finder hash, so its table has
+ * 1 << HASH_BITS entries.
+ */
+static const std::uint32_t HASH_BITS = 12;
+
+/*
+ * Value of a match finder table entry that holds no position.
+ */
+static const std::uint32_t NO_POSITION = UINT32_MAX;
+
+/*
+ * Largest match offset the 2-byte offset field can hold.
+ */
+static const std::uint32_t MAX_OFFSET = UINT16_MAX;
+
+/*
+ * Reads 4 bytes with no alignment requirement.
+ */
+static inline std::uint32_t read32(const char* p){
+  std::uint32_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+/*
+ * Hashes 4 bytes to a match finder table index.
+ */
+static inline std::uint32_t hash4(std::uint32_t value){
+  return (value * 2654435761u) >> (32 - HASH_BITS);
+}
+
+/*
+ * Writes the extra length bytes of a length field of (at least) 15 and
+ * returns the new output position.
+ */
+static inline std::uint32_t writeLength(char* dst, std::uint32_t op,
+    std::uint32_t length){
+  while (length >= 255){
+    dst[op++] = (char) 255;
+    length -= 255;
+  }
+  dst[op++] = (char) length;
+  return op;
+}
+
+/*
+ * Writes one sequence of num_literals literals from literals followed by a
+ * match (if match_length is not 0). Returns the new output position, or 0
+ * if the sequence does not fit before dst_capacity.
+ */
+static std::uint32_t writeSequence(char* dst, std::uint32_t op,
+    std::uint32_t dst_capacity, const char* literals,
+    std::uint32_t num_literals, std::uint32_t offset,
+    std::uint32_t match_length){
+  //token, literals and offset plus the worst case of the length bytes
+  std::uint64_t worst = (std::uint64_t) op + 1 + num_literals / 255 + 1
+    + num_literals + 2 + match_length / 255 + 1;
+  if (worst > dst_capacity){
+    return 0;
+  }
+
+  std::uint32_t lit_code = num_literals < 15 ? num_literals : 15;
+  std::uint32_t match_code = 0;
+  if (match_length != 0){
+    std::uint32_t extra = match_length - CODEC_MIN_MATCH;
+    match_code = extra < 15 ? extra : 15;
+  }
+  dst[op++] = (char) ((lit_code << 4) | match_code);
+  if (lit_code == 15){
+    op = writeLength(dst, op, num_literals - 15);
+  }
+  std::memcpy(dst + op, literals, num_literals);
+  op += num_literals;
+
+  if (match_length != 0){
+    dst[op++] = (char) (offset & 0xFF);
+    dst[op++] = (char) (offset >> 8);
+    if (match_code == 15){
+      op = writeLength(dst, op, match_length - CODEC_MIN_MATCH - 15);
+    }
+  }
+  return op;
+}
+
+/**
+ * @brief Compresses src into dst.
+ *
+ * @pre src holds src_length bytes and dst holds dst_capacity bytes.
+ * @post If the compressed data is shorter than src_length and fits in
+ *    dst_capacity bytes, it is written to dst.
+ *
+ * @param src Bytes to compress.
+ * @param src_length Number of bytes to compress.
+ * @param dst Buffer for the compressed data.
+ * @param dst_capacity Size of dst in bytes.
+ *
+ * @return Length of the compressed data, or 0 if src does not compress to
+ *    fewer than min(src_length, dst_capacity + 1) bytes.
+ */
+std::uint32_t codecCompress(const char* src, std::uint32_t src_length,
+    char* dst, std::uint32_t dst_capacity){
+  if (src_length <= CODEC_MIN_MATCH){
+    return 0;
+  }
+  //not worth more than the uncompressed length
+  if (dst_capacity >= src_length){
+    dst_capacity = src_length - 1;
+  }
+
+  std::uint32_t table[1 << HASH_BITS];
+  for (std::uint32_t i = 0; i < (1u << HASH_BITS); i++){
+    table[i] = NO_POSITION;
+  }
+
+  std::uint32_t ip = 0;
+  std::uint32_t anchor = 0;
+  std::uint32_t op = 0;
+  while (ip + CODEC_MIN_MATCH <= src_length){
+    std::uint32_t value = read32(src + ip);
+    std::uint32_t h = hash4(value);
+    std::uint32_t ref = table[h];
+    table[h] = ip;
+
+    if (ref == NO_POSITION || ip - ref > MAX_OFFSET
+        || read32(src + ref) != value){
+      ip++;
+      continue;
+    }
+
+    std::uint32_t match_length = CODEC_MIN_MATCH;
+    while (ip + match_length < src_length
+        && src[ref + match_length] == src[ip + match_length]){
+      match_length++;
+    }
+    op = writeSequence(dst, op, dst_capacity, src + anchor, ip - anchor,
+        ip - ref, match_length);
+    if (op == 0){
+      return 0;
+    }
+    ip += match_length;
+    anchor = ip;
+  }
+
+  //last literals
+  op = writeSequence(dst, op, dst_capacity, src + anchor,
+      src_length - anchor, 0, 0);
+  return op;
+}
+
+/**
+ * @brief Decompresses src into dst.
+ *
+ * Every read and write is bounds checked, so corrupt or torn input never
+ * accesses memory outside src and dst.
+ *
+ * @pre src holds src_length bytes and dst holds dst_length bytes.
+ * @post If src is valid compressed data of exactly dst_length bytes, dst
+ *    holds the uncompressed bytes.
+ *
+ * @param src Compressed data.
+ * @param src_length Length of the compressed data.
+ * @param dst Buffer for the uncompressed bytes.
+ * @param dst_length Length of the uncompressed bytes.
+ *
+ * @return true if src decompressed to exactly dst_length bytes.
+ */
+bool codecDecompress(const char* src, std::uint32_t src_length, char* dst,
+    std::uint32_t dst_length){
+  std::uint32_t ip = 0;
+  std::uint32_t op = 0;
+
+  while (ip < src_length){
+    std::uint32_t token = (unsigned char) src[ip++];
+
+    //literals
+    std::uint32_t num_literals = token >> 4;
+    if (num_literals == 15){
+      std::uint32_t byte;
+      do {
+        if (ip >= src_length){
+          return false;
+        }
+        byte = (unsigned char) src[ip++];
+        num_literals += byte;
+      } while (byte == 255);
+    }
+    if (num_literals > src_length - ip || num_literals > dst_length - op){
+      return false;
+    }
+    std::memcpy(dst + op, src + ip, num_literals);
+    ip += num_literals;
+    op += num_literals;
+
+    //the last sequence has no match
+    if (ip == src_length){
+      break;
+    }
+
+    //match
+    if (src_length - ip < 2){
+      return false;
+    }
+    std::uint32_t offset = (unsigned char) src[ip]
+      | ((std::uint32_t) (unsigned char) src[ip + 1] << 8);
+    ip += 2;
+    if (offset == 0 || offset > op){
+      return false;
+    }
+    std::uint32_t match_length = (token & 0xF) + CODEC_MIN_MATCH;
+    if ((token & 0xF) == 15){
+      std::uint32_t byte;
+      do {
+        if (ip >= src_length){
+          return false;
+        }
+        byte = (unsigned char) src[ip++];
+        match_length += byte;
+      } while (byte == 255);
+    }
+    if (match_length > dst_length - op){
+      return false;
+    }
+    //byte by byte, since the match may overlap the bytes it produces
+    const char* ref = dst + op - offset;
+    for (std::uint32_t i = 0; i < match_length; i++){
+      dst[op + i] = ref[i];
+    }
+    op += match_length;
+  }
+
+  return op == dst_length;
+}
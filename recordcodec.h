@@ -0,0 +1,69 @@
+#ifndef  _SWATDB_RECORDCODEC_H_
+#define  _SWATDB_RECORDCODEC_H_
+
+
+/**
+ * \file 
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Fast LZ77 codec for the records of compressed HeapPages.
+ *
+ * The compressed format is an LZ4-style token/literal/offset format. It
+ * does not follow the LZ4 end of block rules (last literals, minimum
+ * distance of the last match from the end), so it is not for a real LZ4
+ * decoder. A sequence is a token byte (number of literals in the high 4
+ * bits, match length - 4 in the low 4 bits, 15 meaning more length bytes
+ * follow), the literals, a 2-byte little endian match offset and the extra
+ * match length bytes. The last sequence only has literals. The compressed
+ * data does not store the uncompressed length; compressed HeapPages store
+ * it in front of it.
+ */
+
+/**
+ * Shortest match the codec encodes.
+ */
+const std::uint32_t CODEC_MIN_MATCH = 4;
+
+/**
+ * @brief Compresses src into dst.
+ *
+ * @pre src holds src_length bytes and dst holds dst_capacity bytes.
+ * @post If the compressed data is shorter than src_length and fits in
+ *    dst_capacity bytes, it is written to dst.
+ *
+ * @param src Bytes to compress.
+ * @param src_length Number of bytes to compress.
+ * @param dst Buffer for the compressed data.
+ * @param dst_capacity Size of dst in bytes.
+ *
+ * @return Length of the compressed data, or 0 if src does not compress to
+ *    fewer than min(src_length, dst_capacity + 1) bytes.
+ */
+std::uint32_t codecCompress(const char* src, std::uint32_t src_length,
+    char* dst, std::uint32_t dst_capacity);
+
+/**
+ * @brief Decompresses src into dst.
+ *
+ * Every read and write is bounds checked, so corrupt or torn input never
+ * accesses memory outside src and dst.
+ *
+ * @pre src holds src_length bytes and dst holds dst_length bytes.
+ * @post If src is valid compressed data of exactly dst_length bytes, dst
+ *    holds the uncompressed bytes.
+ *
+ * @param src Compressed data.
+ * @param src_length Length of the compressed data.
+ * @param dst Buffer for the uncompressed bytes.
+ * @param dst_length Length of the uncompressed bytes.
+ *
+ * @return true if src decompressed to exactly dst_length bytes.
+ */
+bool codecDecompress(const char* src, std::uint32_t src_length, char* dst,
+    std::uint32_t dst_length);
+
+#endif
@@ -0,0 +1,426 @@
+#include <string>
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+#include <chrono>
+#include <vector>
+
+#include "swatdb_exceptions.h"
+#include "heappage.h"
+#include "heappagestats.h"
+#include "data.h"
+#include "record.h"
+
+/*
+ * Replays a trace of page operations on HeapPages, for sizing page and
+ * record settings against real traffic.
+ *
+ * A trace is a binary file: the 4 bytes "HPTR", a little endian uint32
+ * version (1), then one 12 byte TraceOp per operation. Trace records are
+ * named by a record number given by the trace: an insert puts a new
+ * record of the given size with that number on the given page, and later
+ * deletes, updates (to the given size) and gets of the number go to
+ * wherever the insert put it. An insert that does not fit (and an update
+ * that does not fit) fails with InsufficientSpaceHeapPage and is counted;
+ * later operations on a record that was never stored are skipped. Record
+ * bytes are made up: half random letters, half zeros.
+ *
+ * Every layout mode given with -m replays the whole trace on fresh pages
+ * and prints one JSON object per line:
+ *
+ *   {"trace":"t.bin","mode":"deferred","ops":...,"ops_per_sec":...,
+ *    "pages":...,"records":...,"fill_factor":...,"used_fraction":...,
+ *    "fragmented_bytes":...,"fragmentation":...,"invalid_slots":...,
+ *    "compactions":...,"compaction_bytes":...,"insufficient_space":...,
+ *    "first_insufficient_space_step":...,"skipped":...,"prunes":...}
+ *
+ * fill_factor is live record bytes (as sized by the trace, so above 1 when
+ * compression pays off) over the bytes of every page;
+ * used_fraction is one minus free space over page bytes, so it includes
+ * headers, slots and MVCC versions. fragmentation is the part of the free
+ * space that deleted records still hold until a compaction. compactions
+ * counts full compactions only; compaction_bytes also has the bytes slid
+ * to close the gap of every delete or shrink on pages without deferred
+ * compaction, so those show compaction bytes with no compactions.
+ *
+ * An mvcc page keeps old versions until they are pruned. The replay has
+ * no readers, so when an operation on an mvcc page runs out of space it
+ * prunes every old version of the page (prunes counts these) and tries
+ * again; only a second failure is counted.
+ * first_insufficient_space_step is the 0-based index of the first failed
+ * operation, -1 if none failed. Compaction counters need the HeapPage
+ * sources built with -DHEAPPAGE_STATS, as the Makefile target does.
+ *
+ * With -g the tool writes a random trace instead, for trying it out: 40%
+ * inserts, 30% deletes, 15% updates and 15% gets, so the pages slowly fill.
+ */
+
+/* Operations of a trace */
+enum TraceOpType{
+  TRACE_INSERT = 1,
+  TRACE_DELETE = 2,
+  TRACE_UPDATE = 3,
+  TRACE_GET = 4
+};
+
+/* One operation of a trace, as stored in the file */
+struct TraceOp{
+  std::uint8_t op;
+  std::uint8_t reserved;
+  std::uint16_t page;
+  std::uint32_t record;
+  std::uint32_t size;
+};
+
+static_assert(sizeof(TraceOp) == 12, "TraceOp is stored as 12 bytes");
+
+static const char TRACE_MAGIC[4] = {'H', 'P', 'T', 'R'};
+static const std::uint32_t TRACE_VERSION = 1;
+
+/* Where a trace record is stored */
+struct RecordLocation{
+  std::uint16_t page;
+  SlotId slot_id;
+  std::uint32_t size;
+  bool stored;
+};
+
+/* Layout mode names accepted by -m and their header flags */
+struct ModeName{
+  const char *name;
+  std::uint16_t flags;
+};
+
+static const ModeName mode_names[] = {
+  {"plain", 0},
+  {"deferred", HEAP_PAGE_DEFERRED_COMPACTION},
+  {"compression", HEAP_PAGE_COMPRESSION},
+  {"compact_slots", HEAP_PAGE_COMPACT_SLOTS},
+  {"synopsis", HEAP_PAGE_SYNOPSIS},
+  {"checksum", HEAP_PAGE_CHECKSUM},
+  {"lsn", HEAP_PAGE_LSN},
+  {"mvcc", HEAP_PAGE_MVCC}
+};
+
+typedef std::chrono::steady_clock Clock;
+
+/*************************************
+ * Parses a mode such as "deferred+compact_slots" into header flags.
+ * Returns false if a name is unknown.
+ */
+bool parseMode(const std::string &mode, std::uint16_t *flags){
+  *flags = 0;
+  std::size_t begin = 0;
+  while(begin <= mode.size()){
+    std::size_t end = mode.find('+', begin);
+    if(end == std::string::npos){
+      end = mode.size();
+    }
+    std::string name = mode.substr(begin, end - begin);
+    bool found = false;
+    for(const ModeName &m : mode_names){
+      if(name == m.name){
+        *flags |= m.flags;
+        found = true;
+      }
+    }
+    if(!found){
+      return false;
+    }
+    begin = end + 1;
+  }
+  return true;
+}
+
+/*************************************
+ * Reads a trace file. Exits with a message if it is not a valid trace.
+ */
+std::vector<TraceOp> readTrace(const char *path){
+  FILE *file = fopen(path, "rb");
+  if(file == nullptr){
+    fprintf(stderr, "replay: cannot open %s\n", path);
+    exit(1);
+  }
+  char magic[4];
+  std::uint32_t version;
+  if(fread(magic, 1, 4, file) != 4 || memcmp(magic, TRACE_MAGIC, 4) != 0
+      || fread(&version, sizeof(version), 1, file) != 1
+      || version != TRACE_VERSION){
+    fprintf(stderr, "replay: %s is not a version %u trace\n", path,
+        TRACE_VERSION);
+    exit(1);
+  }
+
+  std::vector<TraceOp> ops;
+  TraceOp op;
+  while(fread(&op, sizeof(op), 1, file) == 1){
+    bool sized = op.op == TRACE_INSERT || op.op == TRACE_UPDATE;
+    if(op.op < TRACE_INSERT || op.op > TRACE_GET
+        || (sized && (op.size == 0 || op.size > PAGE_SIZE))){
+      fprintf(stderr, "replay: bad operation %zu in %s\n", ops.size(), path);
+      exit(1);
+    }
+    ops.push_back(op);
+  }
+  fclose(file);
+  return ops;
+}
+
+/*************************************
+ * Writes a random trace of num_ops operations over num_pages pages with
+ * record sizes around record_size.
+ */
+void writeTrace(const char *path, std::uint32_t num_ops,
+    std::uint32_t num_pages, std::uint32_t record_size){
+  FILE *file = fopen(path, "wb");
+  if(file == nullptr){
+    fprintf(stderr, "replay: cannot create %s\n", path);
+    exit(1);
+  }
+  fwrite(TRACE_MAGIC, 1, 4, file);
+  fwrite(&TRACE_VERSION, sizeof(TRACE_VERSION), 1, file);
+
+  std::vector<std::uint32_t> live;
+  std::uint32_t next_record = 0;
+  srand(1);
+  for(std::uint32_t i = 0; i < num_ops; i++){
+    TraceOp op = TraceOp();
+    std::uint32_t dice = rand() % 100;
+    op.size = record_size / 2 + rand() % (record_size + 1);
+    if(live.empty() || dice < 40){
+      op.op = TRACE_INSERT;
+      op.page = rand() % num_pages;
+      op.record = next_record++;
+      live.push_back(op.record);
+    }else{
+      std::uint32_t index = rand() % live.size();
+      op.record = live[index];
+      if(dice < 70){
+        op.op = TRACE_DELETE;
+        live[index] = live.back();
+        live.pop_back();
+      }else{
+        op.op = dice < 85 ? TRACE_UPDATE : TRACE_GET;
+      }
+    }
+    fwrite(&op, sizeof(op), 1, file);
+  }
+  fclose(file);
+}
+
+/*************************************
+ * Fills the first size bytes of record_data with made up record bytes.
+ */
+void makeRecord(Data *record_data, std::uint32_t record,
+    std::uint32_t size){
+  std::uint32_t state = record * 2654435761u + 1;
+  char *bytes = record_data->getData();
+  for(std::uint32_t i = 0; i < size; i++){
+    state = state * 1103515245u + 12345u;
+    bytes[i] = i < size / 2 ? 'a' + (state >> 16) % 26 : 0;
+  }
+  record_data->setSize(size);
+}
+
+/*************************************
+ * Applies op to page, where the record of op is or goes, and updates
+ * location.
+ */
+void applyOp(HeapPage *page, const TraceOp &op, RecordLocation *location,
+    Data *record_data){
+  switch(op.op){
+    case TRACE_INSERT:
+      makeRecord(record_data, op.record, op.size);
+      location->slot_id = page->insertRecord(record_data);
+      location->page = op.page;
+      location->size = op.size;
+      location->stored = true;
+      break;
+    case TRACE_DELETE:
+      page->deleteRecord(location->slot_id);
+      location->stored = false;
+      break;
+    case TRACE_UPDATE:
+      makeRecord(record_data, op.record, op.size);
+      page->updateRecord(location->slot_id, record_data);
+      location->size = op.size;
+      break;
+    default:
+      page->getRecord(location->slot_id, record_data);
+      break;
+  }
+}
+
+/*************************************
+ * Replays ops on fresh pages initialized with flags and prints the result.
+ */
+void replay(const char *path, const std::vector<TraceOp> &ops,
+    const std::string &mode, std::uint16_t flags){
+  std::uint32_t num_pages = 1;
+  std::uint32_t num_records = 0;
+  for(const TraceOp &op : ops){
+    num_pages = op.page + 1u > num_pages ? op.page + 1u : num_pages;
+    num_records = op.record + 1 > num_records ? op.record + 1 : num_records;
+  }
+  std::vector<HeapPage*> pages;
+  for(std::uint32_t p = 0; p < num_pages; p++){
+    HeapPage *page = (HeapPage *) new Page();
+    page->initializeHeader(flags);
+    pages.push_back(page);
+  }
+  std::vector<RecordLocation> records(num_records, RecordLocation());
+  Data record_data(PAGE_SIZE);
+  std::uint64_t insufficient = 0;
+  std::uint64_t skipped = 0;
+  std::uint64_t prunes = 0;
+  long long first_insufficient = -1;
+
+  HeapPageStats before = getHeapPageStats();
+  Clock::time_point start = Clock::now();
+  for(std::size_t step = 0; step < ops.size(); step++){
+    const TraceOp &op = ops[step];
+    RecordLocation &location = records[op.record];
+    if(op.op != TRACE_INSERT && !location.stored){
+      skipped++;
+      continue;
+    }
+    if(op.op == TRACE_INSERT && location.stored){
+      skipped++;
+      continue;
+    }
+    HeapPage *page = pages[op.op == TRACE_INSERT ? op.page : location.page];
+    try {
+      try {
+        applyOp(page, op, &location, &record_data);
+      } catch (InsufficientSpaceHeapPage &e){
+        //there are no readers, so every old version can go before giving up
+        if(!(flags & HEAP_PAGE_MVCC)){
+          throw;
+        }
+        prunes++;
+        page->prune(HeapPage::takeSnapshot());
+        applyOp(page, op, &location, &record_data);
+      }
+    } catch (InsufficientSpaceHeapPage &e){
+      insufficient++;
+      if(first_insufficient < 0){
+        first_insufficient = step;
+      }
+    }
+  }
+  double seconds = std::chrono::duration<double>(Clock::now() - start)
+    .count();
+  HeapPageStats after = getHeapPageStats();
+
+  std::uint64_t live_bytes = 0;
+  std::uint64_t live_records = 0;
+  for(const RecordLocation &location : records){
+    if(location.stored){
+      live_bytes += location.size;
+      live_records++;
+    }
+  }
+  std::uint64_t free_bytes = 0;
+  std::uint64_t fragmented = 0;
+  std::uint64_t invalid_slots = 0;
+  for(HeapPage *page : pages){
+    HeapPageState state = page->getPageState();
+    free_bytes += state.free_space;
+    fragmented += state.fragmented_bytes;
+    invalid_slots += state.invalid_slots;
+    delete page;
+  }
+  double page_bytes = (double) num_pages * PAGE_SIZE;
+
+  printf("{\"trace\":\"%s\",\"mode\":\"%s\",\"ops\":%zu,"
+      "\"ops_per_sec\":%.0f,\"pages\":%u,\"records\":%llu,"
+      "\"fill_factor\":%.4f,\"used_fraction\":%.4f,"
+      "\"fragmented_bytes\":%llu,\"fragmentation\":%.4f,"
+      "\"invalid_slots\":%llu,\"compactions\":%llu,"
+      "\"compaction_bytes\":%llu,\"insufficient_space\":%llu,"
+      "\"first_insufficient_space_step\":%lld,\"skipped\":%llu,"
+      "\"prunes\":%llu}\n",
+      path, mode.c_str(), ops.size(), seconds > 0 ? ops.size() / seconds : 0,
+      num_pages, (unsigned long long) live_records, live_bytes / page_bytes,
+      1 - free_bytes / page_bytes, (unsigned long long) fragmented,
+      free_bytes == 0 ? 0.0 : (double) fragmented / free_bytes,
+      (unsigned long long) invalid_slots,
+      (unsigned long long) (after.counters[HEAP_PAGE_STAT_COMPACTIONS]
+        - before.counters[HEAP_PAGE_STAT_COMPACTIONS]),
+      (unsigned long long) (after.counters[HEAP_PAGE_STAT_COMPACTION_BYTES]
+        - before.counters[HEAP_PAGE_STAT_COMPACTION_BYTES]),
+      (unsigned long long) insufficient, first_insufficient,
+      (unsigned long long) skipped, (unsigned long long) prunes);
+}
+
+/*
+ * Prints usage
+ */
+void usage(){
+  std::cout << "Usage: ./replay [-m <mode>]... <trace file>\n"
+      << "       ./replay -g <ops> [-p <pages>] [-r <record size>] "
+      << "<trace file>\n";
+  std::cout << "Replays a trace once per -m mode (default plain) and prints "
+      << "one JSON result per line.\nA mode is names joined by +: plain, "
+      << "deferred, compression, compact_slots,\nsynopsis, checksum, lsn, "
+      << "mvcc. -g writes a random trace of <ops> operations instead."
+      << std::endl;
+}
+
+int main(int argc, char** argv){
+  int c;
+  std::vector<std::string> modes;
+  std::uint32_t generate = 0;
+  std::uint32_t num_pages = 16;
+  std::uint32_t record_size = 100;
+
+  while ((c = getopt (argc, argv, "hm:g:p:r:")) != -1){
+    switch(c) {
+      case 'h': usage();
+                exit(1);
+      case 'm': modes.push_back(optarg);
+                break;
+      case 'g': generate = atoi(optarg);
+                break;
+      case 'p': num_pages = atoi(optarg);
+                break;
+      case 'r': record_size = atoi(optarg);
+                break;
+      default: usage();
+               exit(1);
+    }
+  }
+  if (optind != argc - 1 || num_pages == 0 || num_pages > 65536
+      || record_size == 0 || record_size > PAGE_SIZE / 2){
+    usage();
+    exit(1);
+  }
+  const char *path = argv[optind];
+
+  if (generate > 0){
+    writeTrace(path, generate, num_pages, record_size);
+    return 0;
+  }
+  if (modes.empty()){
+    modes.push_back("plain");
+  }
+  std::vector<TraceOp> ops = readTrace(path);
+  for(const std::string &mode : modes){
+    std::uint16_t flags;
+    if(!parseMode(mode, &flags)){
+      fprintf(stderr, "replay: unknown mode %s\n", mode.c_str());
+      exit(1);
+    }
+    try {
+      replay(path, ops, mode, flags);
+    } catch (std::invalid_argument &e){
+      //e.g. mvcc+compression
+      fprintf(stderr, "replay: mode %s: %s\n", mode.c_str(), e.what());
+      exit(1);
+    }
+  }
+
+  return 0;
+}
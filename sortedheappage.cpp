@@ -0,0 +1,277 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "sortedheappage.h"
+#include "heappage.h"
+#include "heappagescanner.h"
+#include "data.h"
+
+/**
+ * @brief Default key comparator of SortedHeapPage: compares bytes as
+ *    unsigned, a key that is a prefix of the other being smaller.
+ *
+ * @param a First key.
+ * @param a_length Length of a.
+ * @param b Second key.
+ * @param b_length Length of b.
+ * @return Less than 0, 0 or more than 0 if a is less than, equal to or
+ *    greater than b.
+ */
+int compareKeyBytes(const char* a, std::uint32_t a_length, const char* b,
+    std::uint32_t b_length){
+  int result = std::memcmp(a, b, std::min(a_length, b_length));
+  if (result != 0){
+    return result;
+  }
+  return a_length < b_length ? -1 : (a_length > b_length ? 1 : 0);
+}
+
+/**
+ * @brief Constructor. Builds the slot order array of page.
+ *
+ * @pre page is pinned and not compressed.
+ * @post Every valid slot of page is in the slot order array.
+ *
+ * @param page HeapPage to give sorted access to.
+ * @param extractor Key extractor, or an empty function for whole records.
+ * @param comparator Key comparator, or an empty function for
+ *    compareKeyBytes.
+ *
+ * @throw std::logic_error If page is compressed.
+ */
+SortedHeapPage::SortedHeapPage(HeapPage* page, const KeyExtractor& extractor,
+    const KeyComparator& comparator)
+  : extractor(extractor), comparator(comparator){
+  if (page->isCompressed()){
+    throw std::logic_error("records of a compressed HeapPage have no view");
+  }
+  if (!this->comparator){
+    this->comparator = compareKeyBytes;
+  }
+  this->page = page;
+  this->rebuild();
+}
+
+/**
+ * @brief Rebuilds the slot order array from the records of the Page.
+ *
+ * @pre The Page is pinned.
+ * @post Every valid slot of the Page is in the slot order array.
+ */
+void SortedHeapPage::rebuild(){
+  this->order.clear();
+  HeapPageScanner scanner(this->page);
+  for (SlotId slot_id = scanner.getNext(); slot_id != INVALID_SLOT_ID;
+      slot_id = scanner.getNext()){
+    this->order.push_back(slot_id);
+  }
+
+  //stable, so equal keys stay in SlotId order
+  std::stable_sort(this->order.begin(), this->order.end(),
+      [this](SlotId a, SlotId b){
+        RecordView key = this->_getKey(b);
+        return this->_compare(a, key.data, key.length) < 0;
+      });
+}
+
+/**
+ * @brief Inserts a record on the Page, keeping the order.
+ *
+ * @pre Same as HeapPage::insertRecord.
+ * @post Same as HeapPage::insertRecord. The record is after every record
+ *    with an equal key in the order.
+ *
+ * @param record_data Record to insert.
+ * @return SlotId of the record.
+ *
+ * @throw Same as HeapPage::insertRecord.
+ */
+SlotId SortedHeapPage::insertRecord(Data* record_data){
+  SlotId slot_id = this->page->insertRecord(record_data);
+  RecordView key = this->_getKey(slot_id);
+  std::uint32_t position = this->upperBound(key.data, key.length);
+  this->order.insert(this->order.begin() + position, slot_id);
+  return slot_id;
+}
+
+/**
+ * @brief Deletes a record of the Page, keeping the order.
+ *
+ * @pre Same as HeapPage::deleteRecord.
+ * @post Same as HeapPage::deleteRecord.
+ *
+ * @param slot_id SlotId of the record.
+ *
+ * @throw InvalidSlotIdHeapPage If slot_id is not a valid slot.
+ */
+void SortedHeapPage::deleteRecord(SlotId slot_id){
+  std::uint32_t position = this->_position(slot_id);
+  this->page->deleteRecord(slot_id);
+  this->order.erase(this->order.begin() + position);
+}
+
+/**
+ * @brief Updates a record of the Page, keeping the order.
+ *
+ * @pre Same as HeapPage::updateRecord.
+ * @post Same as HeapPage::updateRecord. If the key changed the record moves
+ *    to its new place in the order.
+ *
+ * @param slot_id SlotId of the record.
+ * @param record_data New content of the record.
+ *
+ * @throw Same as HeapPage::updateRecord. The order is unchanged if it
+ *    throws.
+ */
+void SortedHeapPage::updateRecord(SlotId slot_id, Data* record_data){
+  std::uint32_t position = this->_position(slot_id);
+  this->page->updateRecord(slot_id, record_data);
+  this->order.erase(this->order.begin() + position);
+
+  RecordView key = this->_getKey(slot_id);
+  position = this->upperBound(key.data, key.length);
+  this->order.insert(this->order.begin() + position, slot_id);
+}
+
+/**
+ * @brief Finds a record by key.
+ *
+ * @pre The Page is pinned.
+ *
+ * @param key Key to look for.
+ * @param length Length of key.
+ * @return SlotId of the first record with an equal key, or INVALID_SLOT_ID
+ *    if there is none.
+ */
+SlotId SortedHeapPage::find(const char* key, std::uint32_t length){
+  std::uint32_t position = this->lowerBound(key, length);
+  if (position == this->order.size()
+      || this->_compare(this->order[position], key, length) != 0){
+    return INVALID_SLOT_ID;
+  }
+  return this->order[position];
+}
+
+/**
+ * @brief Position in the order of the first record whose key is not less
+ *    than key.
+ *
+ * @pre The Page is pinned.
+ *
+ * @param key Key to look for.
+ * @param length Length of key.
+ * @return Position, getSize() if every key is less than key.
+ */
+std::uint32_t SortedHeapPage::lowerBound(const char* key,
+    std::uint32_t length){
+  std::uint32_t low = 0;
+  std::uint32_t high = this->order.size();
+  while (low < high){
+    std::uint32_t middle = low + (high - low) / 2;
+    if (this->_compare(this->order[middle], key, length) < 0){
+      low = middle + 1;
+    }else{
+      high = middle;
+    }
+  }
+  return low;
+}
+
+/**
+ * @brief Position in the order of the first record whose key is greater
+ *    than key.
+ *
+ * @pre The Page is pinned.
+ *
+ * @param key Key to look for.
+ * @param length Length of key.
+ * @return Position, getSize() if no key is greater than key.
+ */
+std::uint32_t SortedHeapPage::upperBound(const char* key,
+    std::uint32_t length){
+  std::uint32_t low = 0;
+  std::uint32_t high = this->order.size();
+  while (low < high){
+    std::uint32_t middle = low + (high - low) / 2;
+    if (this->_compare(this->order[middle], key, length) <= 0){
+      low = middle + 1;
+    }else{
+      high = middle;
+    }
+  }
+  return low;
+}
+
+/**
+ * @brief Getter for the record at a position of the order. Records in a
+ *    key range [lo, hi) are at positions lowerBound(lo) to lowerBound(hi)
+ *    - 1.
+ *
+ * @pre position is less than getSize().
+ *
+ * @param position Position in the order.
+ * @return SlotId of the record.
+ */
+SlotId SortedHeapPage::getSlotAt(std::uint32_t position){
+  return this->order[position];
+}
+
+/**
+ * @brief Getter for the number of records in the order.
+ * @return Number of records of the Page.
+ */
+std::uint32_t SortedHeapPage::getSize(){
+  return this->order.size();
+}
+
+/**
+ * @brief Getter for the Page.
+ * @return page given to the constructor.
+ */
+HeapPage* SortedHeapPage::getPage(){
+  return this->page;
+}
+
+/**
+ * @brief Gets the key of the record in slot_id.
+ */
+RecordView SortedHeapPage::_getKey(SlotId slot_id){
+  RecordView record = this->page->getRecordView(slot_id);
+  if (this->extractor){
+    return this->extractor(record);
+  }
+  return record;
+}
+
+/**
+ * @brief Compares the key of the record in slot_id to key.
+ *
+ * @return Same as compareKeyBytes(key of slot_id, key).
+ */
+int SortedHeapPage::_compare(SlotId slot_id, const char* key,
+    std::uint32_t length){
+  RecordView slot_key = this->_getKey(slot_id);
+  return this->comparator(slot_key.data, slot_key.length, key, length);
+}
+
+/**
+ * @brief Position of slot_id in the order.
+ *
+ * @pre slot_id is a valid slot in the order.
+ *
+ * @throw std::logic_error If slot_id is valid but not in the order, since
+ *    the Page was changed without the SortedHeapPage.
+ */
+std::uint32_t SortedHeapPage::_position(SlotId slot_id){
+  //throws InvalidSlotIdHeapPage for a slot that is not valid
+  RecordView key = this->_getKey(slot_id);
+  std::uint32_t position = this->lowerBound(key.data, key.length);
+  while (position < this->order.size() && this->order[position] != slot_id){
+    position++;
+  }
+  if (position == this->order.size()){
+    throw std::logic_error("slot is not in the SortedHeapPage order");
+  }
+  return position;
+}
@@ -0,0 +1,239 @@
+#ifndef  _SWATDB_SORTEDHEAPPAGE_H_
+#define  _SWATDB_SORTEDHEAPPAGE_H_
+
+
+/**
+ * \file
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "swatdb_types.h"
+#include "heappage.h"
+
+class Data;
+
+/**
+ * @brief Default key comparator of SortedHeapPage: compares bytes as
+ *    unsigned, a key that is a prefix of the other being smaller.
+ *
+ * @param a First key.
+ * @param a_length Length of a.
+ * @param b Second key.
+ * @param b_length Length of b.
+ * @return Less than 0, 0 or more than 0 if a is less than, equal to or
+ *    greater than b.
+ */
+int compareKeyBytes(const char* a, std::uint32_t a_length, const char* b,
+    std::uint32_t b_length);
+
+/**
+ * Sorted access to the records of a HeapPage, for clustered tables.
+ *
+ * Keeps the SlotIds of the records of the Page in a slot order array
+ * sorted by key, so find and range lookups are binary searches reading
+ * O(log n) records in place with HeapPage::getRecordView, instead of a
+ * scan plus a copy of every record. The key of a record is given by a key
+ * extractor (the whole record by default) and keys are ordered by a key
+ * comparator (compareKeyBytes by default). Records with equal keys are
+ * kept in the order they were inserted, and in SlotId order after a
+ * rebuild.
+ *
+ * The array lives in memory, not on the Page: it is built when the
+ * SortedHeapPage is made for a pinned Page, and kept up to date by the
+ * insertRecord, deleteRecord and updateRecord of the SortedHeapPage.
+ * Changes made to the Page by other means need a rebuild. The Page must
+ * not be compressed, since its records have no views. A SortedHeapPage is
+ * not thread safe; concurrent writers of the Page must be synchronized by
+ * the caller.
+ */
+class SortedHeapPage {
+
+  public:
+
+    /**
+     * Returns the key of a record, as a view into the record.
+     */
+    typedef std::function<RecordView(const RecordView& record)>
+      KeyExtractor;
+
+    /**
+     * Compares two keys like compareKeyBytes.
+     */
+    typedef std::function<int(const char* a, std::uint32_t a_length,
+        const char* b, std::uint32_t b_length)> KeyComparator;
+
+    /**
+     * @brief Constructor. Builds the slot order array of page.
+     *
+     * @pre page is pinned and not compressed.
+     * @post Every valid slot of page is in the slot order array.
+     *
+     * @param page HeapPage to give sorted access to.
+     * @param extractor Key extractor, or an empty function for whole
+     *    records.
+     * @param comparator Key comparator, or an empty function for
+     *    compareKeyBytes.
+     *
+     * @throw std::logic_error If page is compressed.
+     */
+    SortedHeapPage(HeapPage* page, const KeyExtractor& extractor = nullptr,
+        const KeyComparator& comparator = nullptr);
+
+    /**
+     * @brief Rebuilds the slot order array from the records of the Page.
+     *
+     * @pre The Page is pinned.
+     * @post Every valid slot of the Page is in the slot order array.
+     */
+    void rebuild();
+
+    /**
+     * @brief Inserts a record on the Page, keeping the order.
+     *
+     * @pre Same as HeapPage::insertRecord.
+     * @post Same as HeapPage::insertRecord. The record is after every
+     *    record with an equal key in the order.
+     *
+     * @param record_data Record to insert.
+     * @return SlotId of the record.
+     *
+     * @throw Same as HeapPage::insertRecord.
+     */
+    SlotId insertRecord(Data* record_data);
+
+    /**
+     * @brief Deletes a record of the Page, keeping the order.
+     *
+     * @pre Same as HeapPage::deleteRecord.
+     * @post Same as HeapPage::deleteRecord.
+     *
+     * @param slot_id SlotId of the record.
+     *
+     * @throw InvalidSlotIdHeapPage If slot_id is not a valid slot.
+     */
+    void deleteRecord(SlotId slot_id);
+
+    /**
+     * @brief Updates a record of the Page, keeping the order.
+     *
+     * @pre Same as HeapPage::updateRecord.
+     * @post Same as HeapPage::updateRecord. If the key changed the record
+     *    moves to its new place in the order.
+     *
+     * @param slot_id SlotId of the record.
+     * @param record_data New content of the record.
+     *
+     * @throw Same as HeapPage::updateRecord. The order is unchanged if it
+     *    throws.
+     */
+    void updateRecord(SlotId slot_id, Data* record_data);
+
+    /**
+     * @brief Finds a record by key.
+     *
+     * @pre The Page is pinned.
+     *
+     * @param key Key to look for.
+     * @param length Length of key.
+     * @return SlotId of the first record with an equal key, or
+     *    INVALID_SLOT_ID if there is none.
+     */
+    SlotId find(const char* key, std::uint32_t length);
+
+    /**
+     * @brief Position in the order of the first record whose key is not
+     *    less than key.
+     *
+     * @pre The Page is pinned.
+     *
+     * @param key Key to look for.
+     * @param length Length of key.
+     * @return Position, getSize() if every key is less than key.
+     */
+    std::uint32_t lowerBound(const char* key, std::uint32_t length);
+
+    /**
+     * @brief Position in the order of the first record whose key is
+     *    greater than key.
+     *
+     * @pre The Page is pinned.
+     *
+     * @param key Key to look for.
+     * @param length Length of key.
+     * @return Position, getSize() if no key is greater than key.
+     */
+    std::uint32_t upperBound(const char* key, std::uint32_t length);
+
+    /**
+     * @brief Getter for the record at a position of the order. Records in
+     *    a key range [lo, hi) are at positions lowerBound(lo) to
+     *    lowerBound(hi) - 1.
+     *
+     * @pre position is less than getSize().
+     *
+     * @param position Position in the order.
+     * @return SlotId of the record.
+     */
+    SlotId getSlotAt(std::uint32_t position);
+
+    /**
+     * @brief Getter for the number of records in the order.
+     * @return Number of records of the Page.
+     */
+    std::uint32_t getSize();
+
+    /**
+     * @brief Getter for the Page.
+     * @return page given to the constructor.
+     */
+    HeapPage* getPage();
+
+  private:
+
+    /**
+     * @brief Gets the key of the record in slot_id.
+     */
+    RecordView _getKey(SlotId slot_id);
+
+    /**
+     * @brief Compares the key of the record in slot_id to key.
+     *
+     * @return Same as compareKeyBytes(key of slot_id, key).
+     */
+    int _compare(SlotId slot_id, const char* key, std::uint32_t length);
+
+    /**
+     * @brief Position of slot_id in the order.
+     *
+     * @pre slot_id is a valid slot in the order.
+     *
+     * @throw std::logic_error If slot_id is valid but not in the order,
+     *    since the Page was changed without the SortedHeapPage.
+     */
+    std::uint32_t _position(SlotId slot_id);
+
+    /**
+     * HeapPage the order is of.
+     */
+    HeapPage* page;
+
+    /**
+     * Key extractor; empty for whole records.
+     */
+    KeyExtractor extractor;
+
+    /**
+     * Key comparator.
+     */
+    KeyComparator comparator;
+
+    /**
+     * SlotIds of the records, sorted by key.
+     */
+    std::vector<SlotId> order;
+};
+
+#endif
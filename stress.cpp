@@ -0,0 +1,449 @@
+#include <string>
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <vector>
+
+#include "swatdb_exceptions.h"
+#include "heappage.h"
+#include "heappagescanner.h"
+#include "heappagestats.h"
+#include "data.h"
+#include "record.h"
+
+/*
+ * Concurrency stress benchmark for HeapPage and HeapPageScanner.
+ *
+ * For every thread count, a fresh set of pages half filled with records is
+ * shared by all the threads, which run a mixed workload on random pages
+ * for a fixed time:
+ *
+ *   - writes (write_pct percent of the operations) are inserts, updates
+ *     and deletes in equal parts; an insert into a full page deletes a
+ *     record instead, so pages stay around half full;
+ *   - reads are optimistic point reads through getRecordView, validated
+ *     with readBegin/readValidate and retried if a writer got in, and (for
+ *     scan_pct percent of them) full HeapPageScanner passes validated the
+ *     same way.
+ *
+ * Each run prints one JSON object per line:
+ *
+ *   {"threads":4,"pages":64,"record_size":64,"write_pct":20,"scan_pct":10,
+ *    "duration_ms":1000,"ops":...,"ops_per_sec":...,
+ *    "ops_by_type":{"insert":...,"update":...,"delete":...,"get":...,
+ *    "scan":...},"latency_ns":{"p50":...,"p99":...,"p999":...,"max":...},
+ *    "read_retries":...,"retry_rate":...,"invalid_slot_hits":...,
+ *    "latch_acquires":...,"latch_contended":...,"latch_spins":...,
+ *    "conflict_rate":...}
+ *
+ * retry_rate is read retries per read. invalid_slot_hits counts operations
+ * whose random slot was not valid, whether another thread deleted it or
+ * it was a hole in the directory all along, so it is not a measure of
+ * contention. That is conflict_rate: the share of write latch
+ * acquisitions that had to wait for another writer, from the HeapPage
+ * latch counters (the Makefile builds stress with -DHEAPPAGE_STATS;
+ * without it they read 0). Latencies include the clock reads around every
+ * operation.
+ */
+
+/* Thread counts, set with -t */
+static std::vector<std::uint32_t> thread_counts = {1, 2, 4, 8};
+
+/* Number of pages shared by the threads, set with -p */
+static std::uint32_t num_pages = 64;
+
+/* Record size in bytes, set with -r */
+static std::uint32_t record_size = 64;
+
+/* Percent of writes, set with -w */
+static std::uint32_t write_pct = 20;
+
+/* Percent of reads that are scans, set with -s */
+static std::uint32_t scan_pct = 10;
+
+/* Run time per thread count in milliseconds, set with -d */
+static std::uint32_t duration_ms = 1000;
+
+/* Keeps the compiler from dropping reads that are only timed */
+static std::atomic<std::uint64_t> sink(0);
+
+typedef std::chrono::steady_clock Clock;
+
+/* Operation types, indexes of ThreadResult::ops */
+enum OpType{ OP_INSERT, OP_UPDATE, OP_DELETE, OP_GET, OP_SCAN, NUM_OPS };
+
+static const char *op_names[NUM_OPS] = {"insert", "update", "delete", "get",
+  "scan"};
+
+/*************************************
+ * Log-linear latency histogram: 32 buckets per power of two of
+ * nanoseconds, so percentiles are within about 3%.
+ */
+struct LatencyHistogram{
+  static const std::uint32_t SUB_BUCKETS = 32;
+  static const std::uint32_t NUM_BUCKETS = 64 * SUB_BUCKETS;
+
+  std::vector<std::uint64_t> counts;
+  std::uint64_t total;
+  std::uint64_t max;
+
+  LatencyHistogram() : counts(NUM_BUCKETS, 0), total(0), max(0) {}
+
+  static std::uint32_t bucket(std::uint64_t ns){
+    if(ns < SUB_BUCKETS){
+      return ns;
+    }
+    std::uint32_t log = 63 - __builtin_clzll(ns);
+    std::uint32_t sub = (ns >> (log - 5)) & (SUB_BUCKETS - 1);
+    return (log - 4) * SUB_BUCKETS + sub;
+  }
+
+  //smallest latency of a bucket
+  static std::uint64_t lowest(std::uint32_t index){
+    if(index < SUB_BUCKETS){
+      return index;
+    }
+    std::uint32_t log = index / SUB_BUCKETS + 4;
+    std::uint64_t sub = index % SUB_BUCKETS;
+    return (std::uint64_t) (SUB_BUCKETS + sub) << (log - 5);
+  }
+
+  void record(std::uint64_t ns){
+    counts[bucket(ns)]++;
+    total++;
+    max = ns > max ? ns : max;
+  }
+
+  void merge(const LatencyHistogram &other){
+    for(std::uint32_t i = 0; i < NUM_BUCKETS; i++){
+      counts[i] += other.counts[i];
+    }
+    total += other.total;
+    max = other.max > max ? other.max : max;
+  }
+
+  std::uint64_t percentile(double q){
+    std::uint64_t rank = (std::uint64_t) (q * total);
+    std::uint64_t seen = 0;
+    for(std::uint32_t i = 0; i < NUM_BUCKETS; i++){
+      seen += counts[i];
+      if(seen > rank){
+        return lowest(i);
+      }
+    }
+    return max;
+  }
+};
+
+/*************************************
+ * Counters of one thread, merged after the run.
+ */
+struct ThreadResult{
+  std::uint64_t ops[NUM_OPS];
+  std::uint64_t read_retries;
+  std::uint64_t invalid_slot_hits;
+  LatencyHistogram latency;
+
+  ThreadResult() : ops(), read_retries(0), invalid_slot_hits(0) {}
+};
+
+/*************************************
+ * xorshift64 random numbers, one generator per thread.
+ */
+struct Random{
+  std::uint64_t state;
+
+  Random(std::uint64_t seed) : state(seed * 0x9E3779B97F4A7C15ull + 1) {}
+
+  std::uint64_t next(){
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+  }
+
+  std::uint32_t below(std::uint32_t n){
+    return next() % n;
+  }
+};
+
+/*************************************
+ * Returns a random SlotId of page, valid or not. Only reads the capacity,
+ * so it stays cheap next to the operations being timed.
+ */
+SlotId randomSlot(HeapPage *page, Random *random){
+  std::uint32_t capacity;
+  std::uint16_t version;
+  do {
+    version = page->readBegin();
+    capacity = page->getCapacity();
+  } while(!page->readValidate(version));
+  return capacity == 0 ? 0 : random->below(capacity);
+}
+
+/*************************************
+ * Optimistic point read of a random slot through a RecordView. Returns
+ * false if the slot was not valid.
+ */
+bool readRecord(HeapPage *page, SlotId slot_id, char *buffer,
+    ThreadResult *result){
+  const char *first = (const char *) page;
+  while(true){
+    std::uint16_t version = page->readBegin();
+    try {
+      RecordView view = page->getRecordView(slot_id);
+      //a torn view can point past the page; readValidate then fails
+      if(view.data >= first && view.data + view.length <= first + PAGE_SIZE){
+        std::memcpy(buffer, view.data, view.length);
+        if(page->readValidate(version)){
+          sink.fetch_add(buffer[0], std::memory_order_relaxed);
+          return true;
+        }
+      }
+    } catch (InvalidSlotIdHeapPage &e){
+      if(page->readValidate(version)){
+        return false;
+      }
+    }
+    result->read_retries++;
+  }
+}
+
+/*************************************
+ * Scans every record of page, retrying the pass if a writer got in.
+ */
+void scanPage(HeapPage *page, ThreadResult *result){
+  HeapPageScanner scanner(page);
+  RecordView view;
+  while(true){
+    std::uint16_t version = page->readBegin();
+    std::uint64_t sum = 0;
+    scanner.reset(page);
+    while(scanner.getNext(&view) != INVALID_SLOT_ID){
+      sum += view.data[0];
+    }
+    if(page->readValidate(version)){
+      sink.fetch_add(sum, std::memory_order_relaxed);
+      return;
+    }
+    result->read_retries++;
+  }
+}
+
+/*************************************
+ * Body of one thread: runs random operations on pages until stop is set.
+ */
+void worker(std::uint32_t id, std::vector<HeapPage*> *pages,
+    std::atomic<bool> *stop, ThreadResult *result){
+  Random random(id + 1);
+  Data record_data(record_size);
+  std::vector<char> buffer(PAGE_SIZE);
+
+  memset(record_data.getData(), 'a' + id % 26, record_size);
+  record_data.setSize(record_size);
+  while(!stop->load(std::memory_order_relaxed)){
+    HeapPage *page = (*pages)[random.below(pages->size())];
+    std::uint32_t dice = random.below(100);
+    OpType op;
+    if(dice < write_pct){
+      op = (OpType) (OP_INSERT + random.below(3));
+    }else{
+      op = random.below(100) < scan_pct ? OP_SCAN : OP_GET;
+    }
+    //picked before the clock starts, so it is not part of the latency
+    SlotId slot_id = randomSlot(page, &random);
+
+    Clock::time_point start = Clock::now();
+    try {
+      switch(op){
+        case OP_INSERT:
+          try {
+            page->insertRecord(&record_data);
+          } catch (InsufficientSpaceHeapPage &e){
+            page->deleteRecord(slot_id);
+          }
+          break;
+        case OP_UPDATE:
+          page->updateRecord(slot_id, &record_data);
+          break;
+        case OP_DELETE:
+          page->deleteRecord(slot_id);
+          break;
+        case OP_GET:
+          if(!readRecord(page, slot_id, buffer.data(), result)){
+            result->invalid_slot_hits++;
+          }
+          break;
+        default:
+          scanPage(page, result);
+          break;
+      }
+    } catch (InvalidSlotIdHeapPage &e){
+      result->invalid_slot_hits++;
+    }
+    result->latency.record(std::chrono::duration_cast<
+        std::chrono::nanoseconds>(Clock::now() - start).count());
+    result->ops[op]++;
+  }
+}
+
+/*************************************
+ * Runs the workload with num_threads threads and prints the result.
+ */
+void runStress(std::uint32_t num_threads){
+  std::vector<HeapPage*> pages;
+  Data record_data(record_size);
+  memset(record_data.getData(), 'f', record_size);
+  record_data.setSize(record_size);
+  for(std::uint32_t p = 0; p < num_pages; p++){
+    HeapPage *page = (HeapPage *) new Page();
+    page->initializeHeader();
+    while(page->getFreeSpace() > PAGE_SIZE / 2){
+      page->insertRecord(&record_data);
+    }
+    pages.push_back(page);
+  }
+
+  std::atomic<bool> stop(false);
+  std::vector<ThreadResult> results(num_threads);
+  HeapPageStats before = getHeapPageStats();
+  std::vector<std::thread> threads;
+  Clock::time_point start = Clock::now();
+  for(std::uint32_t t = 0; t < num_threads; t++){
+    threads.emplace_back(worker, t, &pages, &stop, &results[t]);
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(duration_ms));
+  stop = true;
+  for(std::thread &thread : threads){
+    thread.join();
+  }
+  double seconds = std::chrono::duration<double>(Clock::now() - start)
+    .count();
+  HeapPageStats after = getHeapPageStats();
+  std::uint64_t acquires = after.counters[HEAP_PAGE_STAT_LATCH_ACQUIRES]
+    - before.counters[HEAP_PAGE_STAT_LATCH_ACQUIRES];
+  std::uint64_t contended = after.counters[HEAP_PAGE_STAT_LATCH_CONTENDED]
+    - before.counters[HEAP_PAGE_STAT_LATCH_CONTENDED];
+  std::uint64_t spins = after.counters[HEAP_PAGE_STAT_LATCH_SPINS]
+    - before.counters[HEAP_PAGE_STAT_LATCH_SPINS];
+
+  ThreadResult total;
+  for(ThreadResult &result : results){
+    for(std::uint32_t op = 0; op < NUM_OPS; op++){
+      total.ops[op] += result.ops[op];
+    }
+    total.read_retries += result.read_retries;
+    total.invalid_slot_hits += result.invalid_slot_hits;
+    total.latency.merge(result.latency);
+  }
+  std::uint64_t ops = total.latency.total;
+  std::uint64_t reads = total.ops[OP_GET] + total.ops[OP_SCAN];
+
+  printf("{\"threads\":%u,\"pages\":%u,\"record_size\":%u,"
+      "\"write_pct\":%u,\"scan_pct\":%u,\"duration_ms\":%u,"
+      "\"ops\":%llu,\"ops_per_sec\":%.0f,\"ops_by_type\":{",
+      num_threads, num_pages, record_size, write_pct, scan_pct, duration_ms,
+      (unsigned long long) ops, ops / seconds);
+  for(std::uint32_t op = 0; op < NUM_OPS; op++){
+    printf("%s\"%s\":%llu", op == 0 ? "" : ",", op_names[op],
+        (unsigned long long) total.ops[op]);
+  }
+  printf("},\"latency_ns\":{\"p50\":%llu,\"p99\":%llu,\"p999\":%llu,"
+      "\"max\":%llu},\"read_retries\":%llu,\"retry_rate\":%.6f,"
+      "\"invalid_slot_hits\":%llu,\"latch_acquires\":%llu,"
+      "\"latch_contended\":%llu,\"latch_spins\":%llu,"
+      "\"conflict_rate\":%.6f}\n",
+      (unsigned long long) total.latency.percentile(0.5),
+      (unsigned long long) total.latency.percentile(0.99),
+      (unsigned long long) total.latency.percentile(0.999),
+      (unsigned long long) total.latency.max,
+      (unsigned long long) total.read_retries,
+      reads == 0 ? 0.0 : (double) total.read_retries / reads,
+      (unsigned long long) total.invalid_slot_hits,
+      (unsigned long long) acquires, (unsigned long long) contended,
+      (unsigned long long) spins,
+      acquires == 0 ? 0.0 : (double) contended / acquires);
+  fflush(stdout);
+
+  for(HeapPage *page : pages){
+    delete page;
+  }
+}
+
+/*************************************
+ * Parses a comma separated list of thread counts. Returns false if it is
+ * empty or has a 0.
+ */
+bool parseThreadCounts(const char *list){
+  thread_counts.clear();
+  std::string counts(list);
+  std::size_t begin = 0;
+  while(begin <= counts.size()){
+    std::size_t end = counts.find(',', begin);
+    if(end == std::string::npos){
+      end = counts.size();
+    }
+    std::uint32_t count = atoi(counts.substr(begin, end - begin).c_str());
+    if(count == 0){
+      return false;
+    }
+    thread_counts.push_back(count);
+    begin = end + 1;
+  }
+  return !thread_counts.empty();
+}
+
+/*
+ * Prints usage
+ */
+void usage(){
+  std::cout << "Usage: ./stress -t <threads,...> -p <pages> -r <record size>"
+      << " -w <write %> -s <scan % of reads> -d <ms per run> -h help\n";
+  std::cout << "Runs a mixed insert/update/delete/get/scan workload over "
+      << "shared pages for each\nthread count (default 1,2,4,8) and prints "
+      << "one JSON result per line." << std::endl;
+}
+
+int main(int argc, char** argv){
+  int c;
+
+  while ((c = getopt (argc, argv, "ht:p:r:w:s:d:")) != -1){
+    switch(c) {
+      case 'h': usage();
+                exit(1);
+      case 't': if (!parseThreadCounts(optarg)){
+                  usage();
+                  exit(1);
+                }
+                break;
+      case 'p': num_pages = atoi(optarg);
+                break;
+      case 'r': record_size = atoi(optarg);
+                break;
+      case 'w': write_pct = atoi(optarg);
+                break;
+      case 's': scan_pct = atoi(optarg);
+                break;
+      case 'd': duration_ms = atoi(optarg);
+                break;
+      default: usage();
+               exit(1);
+    }
+  }
+  if (num_pages == 0 || record_size == 0 || record_size > PAGE_SIZE / 4
+      || write_pct > 100 || scan_pct > 100 || duration_ms == 0){
+    usage();
+    exit(1);
+  }
+
+  for(std::uint32_t num_threads : thread_counts){
+    runStress(num_threads);
+  }
+
+  return 0;
+}
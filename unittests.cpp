@@ -4,6 +4,10 @@
 #include <cstring>
 #include <unistd.h>
 #include <vector>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <stdexcept>
 #include <UnitTest++/UnitTest++.h>
 #include <UnitTest++/TestReporterStdout.h>
 #include <UnitTest++/TestRunner.h>
@@ -11,6 +15,20 @@
 #include "swatdb_exceptions.h"
 #include "heappage.h"
 #include "heappagescanner.h"
+#include "freespacemap.h"
+#include "recordcodec.h"
+#include "fixedheappage.h"
+#include "paxpage.h"
+#include "paxpagescanner.h"
+#include "heapfilescanner.h"
+#include "parallelheapscan.h"
+#include "heappagestats.h"
+#include "crc32c.h"
+#include "heappagevacuum.h"
+#include "overflowrecords.h"
+#include "recordarena.h"
+#include "sortedheappage.h"
+#include "mappedheapfile.h"
 #include "data.h"
 #include "record.h"
 
@@ -772,6 +790,2648 @@ SUITE(evenMoreTests){
   }
 }
 
+/*
+ * Tests deferred compaction mode and compact()
+ */
+SUITE(deferredCompaction){
+
+  /*
+   * Deletes a middle record in deferred mode and checks that the page is
+   * not compacted until compact() is called.
+   */
+  TEST_FIXTURE(TestFixture, deferredCompaction1){
+    std::cout << " deferredCompaction1 test" << std::endl;
+
+    Data recA(10);
+    Data recB(15);
+    Data recC(20);
+    setRecData( &recA, 'A', 10 );
+    setRecData( &recB, 'B', 15 );
+    setRecData( &recC, 'C', 20 );
+
+    page->setDeferredCompaction( true );
+    CHECK( page->isDeferredCompaction() );
+    SlotId a = page->insertRecord( &recA );
+    SlotId b = page->insertRecord( &recB );
+    SlotId c = page->insertRecord( &recC );
+    std::uint32_t old_free_space = page->getFreeSpace();
+
+    // the hole stays where it is and is only counted
+    page->deleteRecord( b );
+    checkHeader( 3, 2, sizeof(HeapPageHeader) + 3*sizeof(SlotInfo),
+        PAGE_SIZE - 45 );
+    CHECK_EQUAL( 15, page_header->fragmented_bytes );
+    // the freed slot can be reused, so no SlotInfo is reserved any more
+    CHECK_EQUAL( old_free_space + 15 + sizeof(SlotInfo), page->getFreeSpace() );
+    CHECK_EQUAL( PAGE_SIZE - 45, slot_directory[c].offset );
+
+    page->getRecord( a, record_data );
+    CHECK( compareRecRec( &recA, record_data ) );
+    page->getRecord( c, record_data );
+    CHECK( compareRecRec( &recC, record_data ) );
+
+    // compact() produces the same layout as an eager delete
+    page->compact();
+    checkHeader( 3, 2, sizeof(HeapPageHeader) + 3*sizeof(SlotInfo),
+        PAGE_SIZE - 30 );
+    CHECK_EQUAL( 0, page_header->fragmented_bytes );
+    CHECK_EQUAL( PAGE_SIZE - 30, slot_directory[c].offset );
+    page->getRecord( a, record_data );
+    CHECK( compareRecRec( &recA, record_data ) );
+    page->getRecord( c, record_data );
+    CHECK( compareRecRec( &recC, record_data ) );
+
+    page->setDeferredCompaction( false );
+    CHECK( !page->isDeferredCompaction() );
+  }
+
+  /*
+   * Fills the page, deletes every other record in deferred mode and checks
+   * that an insert needing the fragmented space compacts the page.
+   */
+  TEST_FIXTURE(TestFixture, deferredCompaction2){
+    std::cout << " deferredCompaction2 test" << std::endl;
+
+    std::vector<SlotId> sids;
+    page->setDeferredCompaction( true );
+    for(std::uint32_t i = 0; i < data_num; i++){
+      setRecData( record_data, i%128, data_size );
+      sids.push_back( page->insertRecord( record_data ) );
+    }
+    for(std::uint32_t i = 0; i < data_num; i += 2){
+      page->deleteRecord( sids[i] );
+    }
+    CHECK_EQUAL( (data_num/2)*data_size, page_header->fragmented_bytes );
+
+    // a record twice the size only fits once the holes are merged
+    setRecData( record_data, 'X', 2*data_size );
+    SlotId big = page->insertRecord( record_data );
+    CHECK_EQUAL( 0, page_header->fragmented_bytes );
+
+    Data *record_data2 = new Data(PAGE_SIZE);
+    page->getRecord( big, record_data2 );
+    CHECK( compareRecRec( record_data, record_data2 ) );
+    for(std::uint32_t i = 1; i < data_num; i += 2){
+      setRecData( record_data, i%128, data_size );
+      page->getRecord( sids[i], record_data2 );
+      CHECK( compareRecRec( record_data, record_data2 ) );
+    }
+    delete record_data2;
+  }
+}
+
+/*
+ * Tests reuse of invalid slots through the free slot list
+ */
+SUITE(freeSlotList){
+
+  /*
+   * Deletes two middle records and checks that inserts reuse their slots
+   * before growing the slot directory.
+   */
+  TEST_FIXTURE(TestFixture, freeSlotList1){
+    std::cout << " freeSlotList1 test" << std::endl;
+
+    std::vector<SlotId> sids;
+    for(int i = 0; i < 5; i++){
+      setRecData( record_data, 'A' + i, 10 );
+      sids.push_back( page->insertRecord( record_data ) );
+    }
+    page->deleteRecord( sids[1] );
+    page->deleteRecord( sids[3] );
+    CHECK_EQUAL( sids[3], page_header->free_slot_head );
+
+    // the most recently freed slot is reused first
+    setRecData( record_data, 'X', 10 );
+    CHECK_EQUAL( sids[3], page->insertRecord( record_data ) );
+    CHECK_EQUAL( sids[1], page->insertRecord( record_data ) );
+    CHECK_EQUAL( FREE_SLOT_LIST_END, page_header->free_slot_head );
+    CHECK_EQUAL( 5, page->insertRecord( record_data ) );
+    checkHeader( 6, 6, sizeof(HeapPageHeader) + 6*sizeof(SlotInfo),
+        PAGE_SIZE - 60 );
+  }
+
+  /*
+   * Frees slots in the middle and then the tail of the directory, and
+   * checks that shrinking the directory drops the trimmed slots from the
+   * free slot list.
+   */
+  TEST_FIXTURE(TestFixture, freeSlotList2){
+    std::cout << " freeSlotList2 test" << std::endl;
+
+    std::vector<SlotId> sids;
+    for(int i = 0; i < 5; i++){
+      setRecData( record_data, 'A' + i, 10 );
+      sids.push_back( page->insertRecord( record_data ) );
+    }
+    page->deleteRecord( sids[1] );
+    page->deleteRecord( sids[3] );
+    // deleting the tail trims slots 3 and 4, only slot 1 stays free
+    page->deleteRecord( sids[4] );
+    checkHeader( 3, 2, sizeof(HeapPageHeader) + 3*sizeof(SlotInfo),
+        PAGE_SIZE - 20 );
+    CHECK_EQUAL( sids[1], page_header->free_slot_head );
+    CHECK_EQUAL( FREE_SLOT_LIST_END, slot_directory[sids[1]].length );
+
+    setRecData( record_data, 'X', 10 );
+    CHECK_EQUAL( sids[1], page->insertRecord( record_data ) );
+    CHECK_EQUAL( 3, page->insertRecord( record_data ) );
+    checkHeader( 4, 4, sizeof(HeapPageHeader) + 4*sizeof(SlotInfo),
+        PAGE_SIZE - 40 );
+  }
+}
+
+/*
+ * Tests zero-copy record views
+ */
+SUITE(recordView){
+
+  /*
+   * Inserts and deletes some records and checks that views returned by the
+   * page and by the scanner point at the stored record bytes.
+   */
+  TEST_FIXTURE(TestFixture, recordView1){
+    std::cout << " recordView1 test" << std::endl;
+
+    std::vector<Data *> records(4);
+    std::vector<SlotId> sids;
+    for(int i = 0; i < 4; i++){
+      records[i] = new Data(10 + i);
+      setRecData( records[i], 'a' + i, 10 + i );
+      sids.push_back( page->insertRecord( records[i] ) );
+    }
+    page->deleteRecord( sids[1] );
+
+    RecordView view = page->getRecordView( sids[2] );
+    CHECK_EQUAL( page->getData() + slot_directory[sids[2]].offset,
+        view.data );
+    CHECK_EQUAL( records[2]->getSize(), view.length );
+    CHECK( compareRecMem( records[2], (char *)view.data ) );
+    CHECK_THROW( page->getRecordView( sids[1] ), InvalidSlotIdHeapPage );
+    CHECK_THROW( page->getRecordView( 99 ), InvalidSlotIdHeapPage );
+
+    HeapPageScanner scanner(page);
+    std::vector<int> expected = {0, 2, 3};
+    for(int i : expected){
+      CHECK_EQUAL( sids[i], scanner.getNext( &view ) );
+      CHECK_EQUAL( records[i]->getSize(), view.length );
+      CHECK( compareRecMem( records[i], (char *)view.data ) );
+    }
+    CHECK_EQUAL( INVALID_SLOT_ID, scanner.getNext( &view ) );
+
+    for(int i = 0; i < 4; i++){
+      delete records[i];
+    }
+  }
+}
+
+/*
+ * Tests insertRecords
+ */
+SUITE(insertRecords){
+
+  /*
+   * Inserts a batch into a page with one free slot and checks that the
+   * page matches what one-at-a-time inserts would produce.
+   */
+  TEST_FIXTURE(TestFixture, insertRecords1){
+    std::cout << " insertRecords1 test" << std::endl;
+
+    std::vector<Data *> records(4);
+    SlotId sids[4];
+    setRecData( record_data, 'z', 10 );
+    page->insertRecord( record_data );
+    page->insertRecord( record_data );
+    page->deleteRecord( 0 );
+
+    for(int i = 0; i < 4; i++){
+      records[i] = new Data(5 + i);
+      setRecData( records[i], 'a' + i, 5 + i );
+    }
+    CHECK_EQUAL( 4, page->insertRecords( records.data(), 4, sids ) );
+    // the free slot is reused first, then the directory grows
+    CHECK_EQUAL( 0, sids[0] );
+    CHECK_EQUAL( 2, sids[1] );
+    CHECK_EQUAL( 3, sids[2] );
+    CHECK_EQUAL( 4, sids[3] );
+    checkHeader( 5, 5, sizeof(HeapPageHeader) + 5*sizeof(SlotInfo),
+        PAGE_SIZE - 10 - 26 );
+    CHECK_EQUAL( PAGE_SIZE - 15, slot_directory[sids[0]].offset );
+    CHECK_EQUAL( PAGE_SIZE - 36, slot_directory[sids[3]].offset );
+    for(int i = 0; i < 4; i++){
+      page->getRecord( sids[i], record_data );
+      CHECK( compareRecRec( records[i], record_data ) );
+    }
+    for(int i = 0; i < 4; i++){
+      delete records[i];
+    }
+  }
+
+  /*
+   * Inserts a batch that does not fit and checks that only the records
+   * that fit are accepted, and that empty records are rejected up front.
+   */
+  TEST_FIXTURE(TestFixture, insertRecords2){
+    std::cout << " insertRecords2 test" << std::endl;
+
+    std::vector<Data *> records(data_num + 1);
+    std::vector<SlotId> sids(data_num + 1);
+    for(std::uint32_t i = 0; i <= data_num; i++){
+      records[i] = new Data(data_size);
+      setRecData( records[i], i%128, data_size );
+    }
+    CHECK_EQUAL( data_num,
+        page->insertRecords( records.data(), data_num + 1, sids.data() ) );
+    CHECK_EQUAL( 0, page->insertRecords( &records[data_num], 1, sids.data() ) );
+    checkHeader( data_num, data_num,
+        sizeof(HeapPageHeader) + data_num*sizeof(SlotInfo),
+        PAGE_SIZE - data_num*data_size );
+
+    page->deleteRecord( sids[1] );
+    Data empty_data(0);
+    Data *first = records[0];
+    records[0] = &empty_data;
+    CHECK_THROW( page->insertRecords( records.data(), 2, sids.data() ),
+        EmptyDataHeapPage );
+    CHECK_EQUAL( data_num - 1, page_header->size );
+    records[0] = first;
+
+    for(std::uint32_t i = 0; i <= data_num; i++){
+      delete records[i];
+    }
+  }
+}
+
+/*
+ * Tests deleteRecords
+ */
+SUITE(deleteRecords){
+
+  /*
+   * Deletes a range of records in one call and checks that the page is
+   * compacted and the slot directory shrunk as with single deletes.
+   */
+  TEST_FIXTURE(TestFixture, deleteRecords1){
+    std::cout << " deleteRecords1 test" << std::endl;
+
+    std::vector<SlotId> sids;
+    for(std::uint32_t i = 0; i < 10; i++){
+      setRecData( record_data, 'a' + i, 10 + i );
+      sids.push_back( page->insertRecord( record_data ) );
+    }
+    // records 1, 4, 8 and 9 are deleted; 8 and 9 shrink the directory
+    SlotId victims[4] = { sids[8], sids[1], sids[9], sids[4] };
+    page->deleteRecords( victims, 4 );
+
+    std::uint32_t total_size = 0;
+    for(std::uint32_t i = 0; i < 8; i++){
+      if( i != 1 && i != 4 ){
+        total_size += 10 + i;
+      }
+    }
+    checkHeader( 8, 6, sizeof(HeapPageHeader) + 8*sizeof(SlotInfo),
+        PAGE_SIZE - total_size );
+    CHECK_EQUAL( 0, page_header->fragmented_bytes );
+
+    Data *record_data2 = new Data(PAGE_SIZE);
+    for(std::uint32_t i = 0; i < 8; i++){
+      if( i == 1 || i == 4 ){
+        CHECK_THROW( page->getRecord( sids[i], record_data ),
+            InvalidSlotIdHeapPage );
+        continue;
+      }
+      setRecData( record_data, 'a' + i, 10 + i );
+      page->getRecord( sids[i], record_data2 );
+      CHECK( compareRecRec( record_data, record_data2 ) );
+    }
+    delete record_data2;
+
+    // freed slots are reused before the directory grows again
+    setRecData( record_data, 'x', 10 );
+    SlotId reused = page->insertRecord( record_data );
+    CHECK( reused == sids[1] || reused == sids[4] );
+  }
+
+  /*
+   * Passes invalid and repeated SlotIds and checks that nothing is deleted.
+   */
+  TEST_FIXTURE(TestFixture, deleteRecords2){
+    std::cout << " deleteRecords2 test" << std::endl;
+
+    for(std::uint32_t i = 0; i < 3; i++){
+      setRecData( record_data, 'a' + i, 10 );
+      page->insertRecord( record_data );
+    }
+    SlotId repeated[3] = { 0, 2, 0 };
+    CHECK_THROW( page->deleteRecords( repeated, 3 ), InvalidSlotIdHeapPage );
+    SlotId out_of_range[2] = { 1, 7 };
+    CHECK_THROW( page->deleteRecords( out_of_range, 2 ),
+        InvalidSlotIdHeapPage );
+    checkHeader( 3, 3, sizeof(HeapPageHeader) + 3*sizeof(SlotInfo),
+        PAGE_SIZE - 30 );
+
+    // deferred mode only counts the holes
+    page->setDeferredCompaction( true );
+    SlotId victims[2] = { 0, 1 };
+    page->deleteRecords( victims, 2 );
+    checkHeader( 3, 1, sizeof(HeapPageHeader) + 3*sizeof(SlotInfo),
+        PAGE_SIZE - 30 );
+    CHECK_EQUAL( 20, page_header->fragmented_bytes );
+  }
+}
+
+/*
+ * Tests the in-place paths of updateRecord
+ */
+SUITE(updateInPlace){
+
+  /*
+   * Updates records to values of the same size and checks that they stay
+   * at the same offset.
+   */
+  TEST_FIXTURE(TestFixture, updateInPlace1){
+    std::cout << " updateInPlace1 test" << std::endl;
+
+    std::vector<SlotId> sids;
+    for(int i = 0; i < 3; i++){
+      setRecData( record_data, 'a' + i, 8 );
+      sids.push_back( page->insertRecord( record_data ) );
+    }
+    std::uint32_t old_offset = slot_directory[sids[1]].offset;
+    setRecData( record_data, 'Z', 8 );
+    page->updateRecord( sids[1], record_data );
+    CHECK_EQUAL( old_offset, slot_directory[sids[1]].offset );
+    checkHeader( 3, 3, sizeof(HeapPageHeader) + 3*sizeof(SlotInfo),
+        PAGE_SIZE - 24 );
+
+    Data *record_data2 = new Data(PAGE_SIZE);
+    page->getRecord( sids[1], record_data2 );
+    CHECK( compareRecRec( record_data, record_data2 ) );
+    delete record_data2;
+  }
+
+  /*
+   * Shrinks a middle record and checks that the page stays compacted and
+   * that the records behind it are not moved.
+   */
+  TEST_FIXTURE(TestFixture, updateInPlace2){
+    std::cout << " updateInPlace2 test" << std::endl;
+
+    std::vector<Data *> records(3);
+    std::vector<SlotId> sids;
+    for(int i = 0; i < 3; i++){
+      records[i] = new Data(20);
+      setRecData( records[i], 'a' + i, 20 );
+      sids.push_back( page->insertRecord( records[i] ) );
+    }
+    setRecData( records[1], 'Y', 12 );
+    page->updateRecord( sids[1], records[1] );
+
+    checkHeader( 3, 3, sizeof(HeapPageHeader) + 3*sizeof(SlotInfo),
+        PAGE_SIZE - 52 );
+    CHECK_EQUAL( PAGE_SIZE - 20, slot_directory[sids[0]].offset );
+    CHECK_EQUAL( PAGE_SIZE - 32, slot_directory[sids[1]].offset );
+    CHECK_EQUAL( PAGE_SIZE - 52, slot_directory[sids[2]].offset );
+    for(int i = 0; i < 3; i++){
+      page->getRecord( sids[i], record_data );
+      CHECK( compareRecRec( records[i], record_data ) );
+    }
+
+    // deferred mode leaves the freed bytes as a hole
+    page->setDeferredCompaction( true );
+    setRecData( records[0], 'X', 15 );
+    page->updateRecord( sids[0], records[0] );
+    CHECK_EQUAL( PAGE_SIZE - 20, slot_directory[sids[0]].offset );
+    CHECK_EQUAL( 5, page_header->fragmented_bytes );
+    page->compact();
+    checkHeader( 3, 3, sizeof(HeapPageHeader) + 3*sizeof(SlotInfo),
+        PAGE_SIZE - 47 );
+    for(int i = 0; i < 3; i++){
+      page->getRecord( sids[i], record_data );
+      CHECK( compareRecRec( records[i], record_data ) );
+    }
+
+    for(int i = 0; i < 3; i++){
+      delete records[i];
+    }
+  }
+}
+
+/*
+ * Tests scanning sparse slot directories
+ */
+SUITE(sparseScan){
+
+  /*
+   * Deletes most records of a page with a long slot directory and checks
+   * that the scanner returns exactly the remaining slots, in order.
+   */
+  TEST_FIXTURE(TestFixture, sparseScan1){
+    std::cout << " sparseScan1 test" << std::endl;
+
+    const std::uint32_t num = 45;
+    std::vector<SlotId> kept = {0, 7, 8, 9, 16, 31, 32, 44};
+    std::vector<SlotId> victims;
+    for(std::uint32_t i = 0; i < num; i++){
+      setRecData( record_data, i%128, 4 );
+      page->insertRecord( record_data );
+      if( std::find( kept.begin(), kept.end(), i ) == kept.end() ){
+        victims.push_back( i );
+      }
+    }
+    page->deleteRecords( victims.data(), victims.size() );
+
+    HeapPageScanner scanner(page);
+    for(int pass = 0; pass < 2; pass++){
+      for(SlotId expected : kept){
+        CHECK_EQUAL( expected, scanner.getNext() );
+      }
+      CHECK_EQUAL( INVALID_SLOT_ID, scanner.getNext() );
+      CHECK_EQUAL( INVALID_SLOT_ID, scanner.getNext() );
+      scanner.reset( page );
+    }
+  }
+}
+
+/*
+ * Tests HeapPageScanner::getNextBatch
+ */
+SUITE(scanBatch){
+
+  /*
+   * Reads a sparse page in small batches and checks that the batches add
+   * up to what getNext returns, and that views match the records.
+   */
+  TEST_FIXTURE(TestFixture, scanBatch1){
+    std::cout << " scanBatch1 test" << std::endl;
+
+    const std::uint32_t num = 30;
+    std::vector<SlotId> victims;
+    for(std::uint32_t i = 0; i < num; i++){
+      setRecData( record_data, i%128, 1 + i%5 );
+      page->insertRecord( record_data );
+      if( i % 3 == 1 ){
+        victims.push_back( i );
+      }
+    }
+    page->deleteRecords( victims.data(), victims.size() );
+
+    std::vector<SlotId> expected;
+    HeapPageScanner scanner(page);
+    SlotId next;
+    while( ( next = scanner.getNext() ) != INVALID_SLOT_ID ){
+      expected.push_back( next );
+    }
+
+    scanner.reset( page );
+    std::vector<SlotId> batched;
+    SlotId buf[3];
+    RecordView views[3];
+    std::uint32_t n;
+    while( ( n = scanner.getNextBatch( buf, 3, views ) ) > 0 ){
+      for(std::uint32_t i = 0; i < n; i++){
+        batched.push_back( buf[i] );
+        RecordView view = page->getRecordView( buf[i] );
+        CHECK_EQUAL( view.data, views[i].data );
+        CHECK_EQUAL( view.length, views[i].length );
+      }
+    }
+    CHECK( expected == batched );
+    CHECK_EQUAL( num - victims.size(), batched.size() );
+
+    // a buffer larger than the page returns everything in one call
+    std::vector<SlotId> all(num);
+    scanner.reset( page );
+    CHECK_EQUAL( expected.size(), scanner.getNextBatch( all.data(), num ) );
+    CHECK_EQUAL( 0, scanner.getNextBatch( all.data(), num ) );
+  }
+}
+
+SUITE(versionLatch){
+
+  /*
+   * Checks that every write advances the version by two and invalidates
+   * reads started before it.
+   */
+  TEST_FIXTURE(TestFixture, versionLatch1){
+    std::cout << " versionLatch1 test" << std::endl;
+
+    CHECK_EQUAL( 0, page_header->version );
+    std::uint16_t version = page->readBegin();
+    CHECK( page->readValidate( version ) );
+
+    setRecData( record_data, 'v', 10 );
+    SlotId slot_id = page->insertRecord( record_data );
+    CHECK( !page->readValidate( version ) );
+    CHECK_EQUAL( version + 2, page_header->version );
+
+    version = page->readBegin();
+    page->getRecord( slot_id, record_data );
+    HeapPageScanner scanner(page);
+    scanner.getNext();
+    CHECK( page->readValidate( version ) );
+
+    // a failing write still releases the latch
+    setRecData( record_data, 'v', 0 );
+    CHECK_THROW( page->updateRecord( slot_id, record_data ),
+        EmptyDataHeapPage );
+    CHECK_EQUAL( 0, page_header->version % 2 );
+  }
+
+  /*
+   * Updates a record between two values in one thread while another thread
+   * reads it, and checks that the reader never sees a mix of the two.
+   */
+  TEST_FIXTURE(TestFixture, versionLatch2){
+    std::cout << " versionLatch2 test" << std::endl;
+
+    const std::uint32_t num_updates = 20000;
+    Data short_rec(10);
+    Data long_rec(200);
+    setRecData( &short_rec, 's', 10 );
+    setRecData( &long_rec, 'l', 200 );
+    for(std::uint32_t i = 0; i < 10; i++){
+      page->insertRecord( &short_rec );
+    }
+
+    std::atomic<bool> done(false);
+    std::uint32_t torn = 0;
+    std::thread reader([&](){
+      Data read_rec(PAGE_SIZE);
+      HeapPageScanner scanner(page);
+      while( !done.load() ){
+        page->getRecord( 5, &read_rec );
+        char expected = read_rec.getSize() == 10 ? 's' : 'l';
+        if( read_rec.getSize() != 10 && read_rec.getSize() != 200 ){
+          torn++;
+        }
+        for(std::uint32_t i = 0; i < read_rec.getSize(); i++){
+          if( read_rec.getData()[i] != expected ){
+            torn++;
+            break;
+          }
+        }
+        scanner.reset( page );
+        std::uint32_t count = 0;
+        while( scanner.getNext() != INVALID_SLOT_ID ){
+          count++;
+        }
+        if( count != 10 ){
+          torn++;
+        }
+      }
+    });
+
+    for(std::uint32_t i = 0; i < num_updates; i++){
+      page->updateRecord( 5, i % 2 == 0 ? &long_rec : &short_rec );
+    }
+    done.store( true );
+    reader.join();
+
+    CHECK_EQUAL( 0, torn );
+    CHECK_EQUAL( 0, page_header->version % 2 );
+  }
+
+  /*
+   * Checks that a slot pointing outside the Page, on a Page no writer is
+   * changing, is reported as corrupt instead of retried forever.
+   */
+  TEST_FIXTURE(TestFixture, versionLatch3){
+    std::cout << " versionLatch3 test" << std::endl;
+
+    setRecData( record_data, 'c', 10 );
+    SlotId slot_id = page->insertRecord( record_data );
+    slot_directory[slot_id].length = PAGE_SIZE;
+    CHECK_THROW( page->getRecord( slot_id, record_data ),
+        std::runtime_error );
+
+    RecordArena arena;
+    RecordView records[1];
+    std::uint64_t used = arena.getBytesUsed();
+    CHECK_THROW( page->getRecords( &slot_id, 1, &arena, records ),
+        std::runtime_error );
+    CHECK_EQUAL( used, arena.getBytesUsed() );
+
+    slot_directory[slot_id].offset = PAGE_SIZE + 1;
+    slot_directory[slot_id].length = 10;
+    CHECK_THROW( page->getRecord( slot_id, record_data ),
+        std::runtime_error );
+    CHECK_EQUAL( 0, page_header->version % 2 );
+  }
+
+  /*
+   * Checks that resetLatch releases a latch left in the bytes of a Page,
+   * as when a Page flushed mid-write is read back.
+   */
+  TEST_FIXTURE(TestFixture, versionLatch4){
+    std::cout << " versionLatch4 test" << std::endl;
+
+    setRecData( record_data, 'r', 10 );
+    SlotId slot_id = page->insertRecord( record_data );
+    std::uint16_t version = page_header->version;
+    page->resetLatch();
+    CHECK_EQUAL( version, page_header->version );
+
+    page_header->version = version + 1;
+    page->resetLatch();
+    CHECK_EQUAL( version + 2, page_header->version );
+    page->getRecord( slot_id, record_data );
+    CHECK_EQUAL( 10, record_data->getSize() );
+    page->deleteRecord( slot_id );
+    CHECK_EQUAL( 0, page_header->version % 2 );
+  }
+
+  /*
+   * Checks that a capacity reaching past the Page, on a Page no writer is
+   * changing, is reported as corrupt by getPageState.
+   */
+  TEST_FIXTURE(TestFixture, versionLatch5){
+    std::cout << " versionLatch5 test" << std::endl;
+
+    page_header->capacity = 60000;
+    CHECK_THROW( page->getPageState(), std::runtime_error );
+    page_header->capacity = 0;
+    CHECK_EQUAL( 0u, page->getPageState().capacity );
+    CHECK_EQUAL( 0u, page->getCapacity() );
+
+    //the synopsis region counts against the room for the directory
+    page->initializeHeader( HEAP_PAGE_SYNOPSIS );
+    page_header->capacity = (PAGE_SIZE - sizeof(HeapPageHeader))
+      / sizeof(SlotInfo);
+    CHECK_THROW( page->getPageState(), std::runtime_error );
+    page->initializeHeader();
+  }
+}
+
+SUITE(freeSpaceMap){
+
+  /*
+   * Checks the free space class of a page and that findPage picks the
+   * first page with enough room.
+   */
+  TEST_FIXTURE(TestFixture, freeSpaceMap1){
+    std::cout << " freeSpaceMap1 test" << std::endl;
+
+    CHECK_EQUAL( page->getFreeSpace() / FREE_SPACE_CLASS_BYTES,
+        page->getFreeSpaceClass() );
+
+    HeapPage *full = (HeapPage *) new Page();
+    full->initializeHeader();
+    setRecData( record_data, 'f', full->getFreeSpace() );
+    full->insertRecord( record_data );
+    CHECK_EQUAL( 0, full->getFreeSpaceClass() );
+
+    FreeSpaceMap map;
+    map.update( 0, full );
+    map.update( 200, page );
+    CHECK_EQUAL( 0, map.getFreeSpaceClass( 0 ) );
+    CHECK_EQUAL( page->getFreeSpaceClass(), map.getFreeSpaceClass( 200 ) );
+    CHECK_EQUAL( 0, map.getFreeSpaceClass( 100 ) );
+    CHECK_EQUAL( 0, map.getFreeSpaceClass( 5000 ) );
+
+    CHECK_EQUAL( 200, map.findPage( 1 ) );
+    CHECK_EQUAL( 200, map.findPage( page->getFreeSpace() ) );
+    CHECK_EQUAL( INVALID_PAGE_NUM, map.findPage( PAGE_SIZE ) );
+
+    map.remove( 200 );
+    CHECK_EQUAL( INVALID_PAGE_NUM, map.findPage( 1 ) );
+    delete full;
+  }
+
+  /*
+   * Checks that inserts and deletes on an attached page update the map,
+   * and that a detached page no longer does.
+   */
+  TEST_FIXTURE(TestFixture, freeSpaceMap2){
+    std::cout << " freeSpaceMap2 test" << std::endl;
+
+    FreeSpaceMap map;
+    map.attach( 7, page );
+    CHECK_EQUAL( 7, map.findPage( 100 ) );
+
+    setRecData( record_data, 'a', page->getFreeSpace() - 50 );
+    SlotId slot_id = page->insertRecord( record_data );
+    CHECK_EQUAL( page->getFreeSpaceClass(), map.getFreeSpaceClass( 7 ) );
+    CHECK_EQUAL( INVALID_PAGE_NUM, map.findPage( 100 ) );
+
+    page->deleteRecord( slot_id );
+    CHECK_EQUAL( page->getFreeSpaceClass(), map.getFreeSpaceClass( 7 ) );
+    CHECK_EQUAL( 7, map.findPage( 100 ) );
+
+    map.detach( page );
+    page->insertRecord( record_data );
+    CHECK_EQUAL( 7, map.findPage( 100 ) );
+  }
+
+  /*
+   * Checks that the maps of two files each follow their own pages, and
+   * that destroying a map detaches its pages.
+   */
+  TEST_FIXTURE(TestFixture, freeSpaceMap3){
+    std::cout << " freeSpaceMap3 test" << std::endl;
+
+    HeapPage *other = (HeapPage *) new Page();
+    other->initializeHeader();
+    {
+      FreeSpaceMap first;
+      FreeSpaceMap second;
+      first.attach( 1, page );
+      second.attach( 2, other );
+
+      setRecData( record_data, 'a', page->getFreeSpace() - 50 );
+      page->insertRecord( record_data );
+      CHECK_EQUAL( page->getFreeSpaceClass(), first.getFreeSpaceClass( 1 ) );
+      CHECK_EQUAL( 0, second.getFreeSpaceClass( 1 ) );
+      CHECK_EQUAL( 2, second.findPage( 100 ) );
+      CHECK_EQUAL( INVALID_PAGE_NUM, first.findPage( 100 ) );
+
+      setRecData( record_data, 'b', other->getFreeSpace() );
+      other->insertRecord( record_data );
+      CHECK_EQUAL( 0, second.getFreeSpaceClass( 2 ) );
+      CHECK_EQUAL( INVALID_PAGE_NUM, second.findPage( 1 ) );
+    }
+
+    //the destroyed maps detached their pages, so writes do not reach them
+    FreeSpaceMap third;
+    third.update( 1, page );
+    setRecData( record_data, 'c', 10 );
+    page->insertRecord( record_data );
+    CHECK( third.getFreeSpaceClass( 1 ) != page->getFreeSpaceClass() );
+    delete other;
+  }
+}
+
+SUITE(compression){
+
+  /*
+   * Stores redundant and random records on a compressed page and checks
+   * that they read back unchanged and that more of them fit than on a raw
+   * page.
+   */
+  TEST_FIXTURE(TestFixture, compression1){
+    std::cout << " compression1 test" << std::endl;
+
+    page->setCompression( true );
+    CHECK( page->isCompressed() );
+
+    const char *json = "{\"name\":\"swatdb\",\"type\":\"heap\",\"page\":1}";
+    std::uint32_t json_len = strlen( json );
+    Data rec( 400 );
+    for(std::uint32_t i = 0; i < 10; i++){
+      memcpy( rec.getData() + i*json_len, json, json_len );
+    }
+    rec.setSize( 10*json_len );
+
+    std::uint32_t free_before = page->getFreeSpace();
+    SlotId redundant = page->insertRecord( &rec );
+    CHECK( free_before - page->getFreeSpace() < rec.getSize() / 2 );
+
+    Data random_rec( 100 );
+    srand( 13 );
+    for(std::uint32_t i = 0; i < 100; i++){
+      random_rec.getData()[i] = (char) rand();
+    }
+    random_rec.setSize( 100 );
+    SlotId random = page->insertRecord( &random_rec );
+
+    page->getRecord( redundant, record_data );
+    CHECK_EQUAL( rec.getSize(), record_data->getSize() );
+    CHECK( memcmp( rec.getData(), record_data->getData(), rec.getSize() )
+        == 0 );
+    page->getRecord( random, record_data );
+    CHECK_EQUAL( 100, record_data->getSize() );
+    CHECK( memcmp( random_rec.getData(), record_data->getData(), 100 ) == 0 );
+
+    // grow the random record to the redundant one and back
+    page->updateRecord( random, &rec );
+    page->getRecord( random, record_data );
+    CHECK_EQUAL( rec.getSize(), record_data->getSize() );
+    page->updateRecord( random, &random_rec );
+    page->getRecord( random, record_data );
+    CHECK( memcmp( random_rec.getData(), record_data->getData(), 100 ) == 0 );
+
+    // more records fit than raw ones
+    std::uint32_t num = 2;
+    while( page->getFreeSpace() > rec.getSize() ){
+      page->insertRecord( &rec );
+      num++;
+    }
+    CHECK( num > PAGE_SIZE / rec.getSize() );
+
+    CHECK_THROW( page->getRecordView( redundant ), std::logic_error );
+    CHECK_THROW( page->setCompression( false ), std::logic_error );
+    HeapPageScanner scanner( page );
+    RecordView view;
+    CHECK_THROW( scanner.getNext( &view ), std::logic_error );
+  }
+
+  /*
+   * Round trips inputs of many lengths and shapes through the codec, and
+   * checks that truncated input is rejected.
+   */
+  TEST(compression2){
+    std::cout << " compression2 test" << std::endl;
+
+    std::vector<char> src( 3000 );
+    std::vector<char> packed( 3000 );
+    std::vector<char> unpacked( 3000 );
+    srand( 7 );
+    for(std::uint32_t length = 5; length < src.size(); length = length*3/2){
+      for(std::uint32_t i = 0; i < length; i++){
+        // runs, repeats and noise
+        src[i] = ( i % 300 < 100 ) ? 'r' : ( i % 300 < 200 )
+          ? (char) ( 'a' + i % 7 ) : (char) rand();
+      }
+      std::uint32_t packed_len = codecCompress( src.data(), length,
+          packed.data(), packed.size() );
+      if( packed_len == 0 ){
+        continue;
+      }
+      CHECK( packed_len < length );
+      CHECK( codecDecompress( packed.data(), packed_len, unpacked.data(),
+            length ) );
+      CHECK( memcmp( src.data(), unpacked.data(), length ) == 0 );
+      CHECK( !codecDecompress( packed.data(), packed_len, unpacked.data(),
+            length - 1 ) );
+      CHECK( !codecDecompress( packed.data(), packed_len / 2,
+            unpacked.data(), length ) );
+    }
+  }
+}
+
+SUITE(compactSlots){
+
+  /*
+   * Fills a compact slot page and a regular page with tiny records and
+   * checks that the compact one holds more, with the same contents.
+   */
+  TEST_FIXTURE(TestFixture, compactSlots1){
+    std::cout << " compactSlots1 test" << std::endl;
+
+    HeapPage *compact = (HeapPage *) new Page();
+    compact->initializeHeader( HEAP_PAGE_COMPACT_SLOTS );
+    HeapPageHeader *compact_header = (HeapPageHeader *) compact->getData();
+    CHECK_EQUAL( HEAP_PAGE_COMPACT_SLOTS, compact_header->flags );
+
+    std::uint32_t regular_num = 0;
+    std::uint32_t compact_num = 0;
+    setRecData( record_data, 't', 4 );
+    while( page->getFreeSpace() >= 4 ){
+      page->insertRecord( record_data );
+      regular_num++;
+    }
+    while( compact->getFreeSpace() >= 4 ){
+      setRecData( record_data, compact_num % 128, 4 );
+      compact->insertRecord( record_data );
+      compact_num++;
+    }
+    CHECK_EQUAL( (PAGE_SIZE - sizeof(HeapPageHeader)) / (4 + sizeof(SlotInfo)),
+        regular_num );
+    CHECK_EQUAL( (PAGE_SIZE - sizeof(HeapPageHeader))
+        / (4 + sizeof(CompactSlotInfo)), compact_num );
+    CHECK_EQUAL( sizeof(HeapPageHeader) + compact_num*sizeof(CompactSlotInfo),
+        compact_header->free_space_begin );
+
+    for(SlotId i = 0; i < compact_num; i++){
+      compact->getRecord( i, record_data );
+      CHECK_EQUAL( 4, record_data->getSize() );
+      CHECK_EQUAL( (char) ( i % 128 ), record_data->getData()[3] );
+    }
+
+    // deleted slots read as invalid and are reused
+    compact->deleteRecord( 10 );
+    CHECK_EQUAL( INVALID_SLOT_OFFSET, compact->getSlotInfo( 10 ).offset );
+    CHECK_THROW( compact->getRecord( 10, record_data ),
+        InvalidSlotIdHeapPage );
+    setRecData( record_data, 'n', 4 );
+    CHECK_EQUAL( 10, compact->insertRecord( record_data ) );
+
+    // deleting the last slots shrinks the compact directory
+    compact->deleteRecord( compact_num - 1 );
+    CHECK_EQUAL( compact_num - 1, compact_header->capacity );
+    CHECK_EQUAL( sizeof(HeapPageHeader)
+        + (compact_num - 1)*sizeof(CompactSlotInfo),
+        compact_header->free_space_begin );
+    delete compact;
+  }
+
+  /*
+   * Scans, updates and compacts a sparse compact slot page in deferred
+   * compaction mode.
+   */
+  TEST_FIXTURE(TestFixture, compactSlots2){
+    std::cout << " compactSlots2 test" << std::endl;
+
+    page->initializeHeader( HEAP_PAGE_COMPACT_SLOTS
+        | HEAP_PAGE_DEFERRED_COMPACTION );
+    const std::uint32_t num = 40;
+    std::vector<SlotId> victims;
+    for(std::uint32_t i = 0; i < num; i++){
+      setRecData( record_data, 'a' + i % 26, 1 + i % 9 );
+      page->insertRecord( record_data );
+      if( i % 4 == 2 ){
+        victims.push_back( i );
+      }
+    }
+    page->deleteRecords( victims.data(), victims.size() );
+    CHECK( page_header->fragmented_bytes > 0 );
+
+    std::vector<SlotId> expected;
+    for(SlotId i = 0; i < num; i++){
+      if( i % 4 != 2 ){
+        expected.push_back( i );
+      }
+    }
+    HeapPageScanner scanner(page);
+    std::vector<SlotId> scanned;
+    SlotId next;
+    while( ( next = scanner.getNext() ) != INVALID_SLOT_ID ){
+      scanned.push_back( next );
+    }
+    CHECK( expected == scanned );
+
+    scanner.reset( page );
+    SlotId buf[7];
+    RecordView views[7];
+    std::vector<SlotId> batched;
+    std::uint32_t n;
+    while( ( n = scanner.getNextBatch( buf, 7, views ) ) > 0 ){
+      for(std::uint32_t i = 0; i < n; i++){
+        batched.push_back( buf[i] );
+        CHECK_EQUAL( 1 + buf[i] % 9, views[i].length );
+        CHECK_EQUAL( (char) ( 'a' + buf[i] % 26 ), views[i].data[0] );
+      }
+    }
+    CHECK( expected == batched );
+
+    // grow a record, then compact and check every record survived
+    setRecData( record_data, 'G', 30 );
+    page->updateRecord( 5, record_data );
+    page->compact();
+    CHECK_EQUAL( 0, page_header->fragmented_bytes );
+    for(SlotId i : expected){
+      page->getRecord( i, record_data );
+      if( i == 5 ){
+        CHECK_EQUAL( 30, record_data->getSize() );
+        CHECK_EQUAL( 'G', record_data->getData()[29] );
+      } else {
+        CHECK_EQUAL( 1 + i % 9, record_data->getSize() );
+        CHECK_EQUAL( (char) ( 'a' + i % 26 ), record_data->getData()[0] );
+      }
+    }
+  }
+}
+
+SUITE(fixedHeapPage){
+
+  /*
+   * Fills a FixedHeapPage, checks its capacity and records, and that
+   * deleted slots are reused lowest first.
+   */
+  TEST_FIXTURE(TestFixture, fixedHeapPage1){
+    std::cout << " fixedHeapPage1 test" << std::endl;
+
+    typedef FixedHeapPage<16> Page16;
+    Page16 *fixed = (Page16 *) new Page();
+    fixed->initializeHeader();
+    CHECK( sizeof(FixedHeapPageHeader) + (Page16::capacity() + 63) / 64 * 8
+        + Page16::capacity() * 16 <= PAGE_SIZE );
+    CHECK( sizeof(FixedHeapPageHeader) + (Page16::capacity() + 64) / 64 * 8
+        + (Page16::capacity() + 1) * 16 > PAGE_SIZE );
+
+    Data rec( 16 );
+    for(std::uint32_t i = 0; i < Page16::capacity(); i++){
+      memset( rec.getData(), i % 128, 16 );
+      rec.setSize( 16 );
+      CHECK_EQUAL( i, fixed->insertRecord( &rec ) );
+    }
+    CHECK( fixed->isFull() );
+    CHECK_EQUAL( 0, fixed->getFreeSpace() );
+    CHECK_THROW( fixed->insertRecord( &rec ), InsufficientSpaceHeapPage );
+
+    Data out( 16 );
+    fixed->getRecord( 100, &out );
+    CHECK_EQUAL( 16, out.getSize() );
+    CHECK_EQUAL( 100, out.getData()[15] );
+
+    fixed->deleteRecord( 70 );
+    fixed->deleteRecord( 3 );
+    CHECK_THROW( fixed->getRecord( 3, &out ), InvalidSlotIdHeapPage );
+    CHECK_THROW( fixed->deleteRecord( 3 ), InvalidSlotIdHeapPage );
+    CHECK_EQUAL( 2*16, fixed->getFreeSpace() );
+    CHECK_EQUAL( 3, fixed->insertRecord( &rec ) );
+    CHECK_EQUAL( 70, fixed->insertRecord( &rec ) );
+
+    Data wrong( 8 );
+    setRecData( &wrong, 'w', 8 );
+    CHECK_THROW( fixed->updateRecord( 0, &wrong ), InvalidSizeData );
+    setRecData( &wrong, 'w', 0 );
+    CHECK_THROW( fixed->insertRecord( &wrong ), EmptyDataHeapPage );
+    delete fixed;
+  }
+
+  /*
+   * Scans a sparse FixedHeapPage with getNextValid and checks views and
+   * updates.
+   */
+  TEST_FIXTURE(TestFixture, fixedHeapPage2){
+    std::cout << " fixedHeapPage2 test" << std::endl;
+
+    typedef FixedHeapPage<100> Page100;
+    Page100 *fixed = (Page100 *) new Page();
+    fixed->initializeHeader();
+    CHECK_EQUAL( INVALID_SLOT_ID, fixed->getNextValid( 0 ) );
+
+    Data rec( 100 );
+    for(std::uint32_t i = 0; i < Page100::capacity(); i++){
+      memset( rec.getData(), 'a' + i % 26, 100 );
+      rec.setSize( 100 );
+      fixed->insertRecord( &rec );
+    }
+    std::vector<SlotId> expected;
+    for(SlotId i = 0; i < Page100::capacity(); i++){
+      if( i % 3 == 0 ){
+        fixed->deleteRecord( i );
+      } else {
+        expected.push_back( i );
+      }
+    }
+
+    std::vector<SlotId> scanned;
+    for(SlotId i = fixed->getNextValid( 0 ); i != INVALID_SLOT_ID;
+        i = fixed->getNextValid( i + 1 )){
+      scanned.push_back( i );
+      RecordView view = fixed->getRecordView( i );
+      CHECK_EQUAL( 100, view.length );
+      CHECK_EQUAL( (char) ( 'a' + i % 26 ), view.data[99] );
+    }
+    CHECK( expected == scanned );
+
+    memset( rec.getData(), 'U', 100 );
+    fixed->updateRecord( 1, &rec );
+    CHECK_EQUAL( 'U', fixed->getRecordView( 1 ).data[0] );
+    CHECK_THROW( fixed->updateRecord( 0, &rec ), InvalidSlotIdHeapPage );
+    delete fixed;
+  }
+}
+
+SUITE(paxPage){
+
+  /*
+   * Fills a PaxPage of a three attribute schema and checks its layout,
+   * that records come back in row format and that deleted slots are
+   * reused.
+   */
+  TEST_FIXTURE(TestFixture, paxPage1){
+    std::cout << " paxPage1 test" << std::endl;
+
+    const std::uint16_t widths[3] = {4, 10, 2};
+    PaxPage *pax = (PaxPage *) new Page();
+    CHECK_THROW( pax->initializeHeader( widths, 0 ), std::invalid_argument );
+    pax->initializeHeader( widths, 3 );
+    CHECK_EQUAL( 16, pax->getRecordWidth() );
+    std::uint32_t capacity = pax->getCapacity();
+    CHECK( capacity * 16 + sizeof(PaxPageHeader) <= PAGE_SIZE );
+    CHECK( capacity * 16 + sizeof(PaxPageHeader) + 3 * PAX_MINIPAGE_ALIGN
+        + (capacity + 63) / 64 * 8 > PAGE_SIZE - 16 );
+
+    Data rec( 16 );
+    for(std::uint32_t i = 0; i < capacity; i++){
+      std::int32_t key = i;
+      memcpy( rec.getData(), &key, 4 );
+      memset( rec.getData() + 4, 'a' + i % 26, 10 );
+      memset( rec.getData() + 14, i % 128, 2 );
+      rec.setSize( 16 );
+      CHECK_EQUAL( i, pax->insertRecord( &rec ) );
+    }
+    CHECK( pax->isFull() );
+    CHECK_THROW( pax->insertRecord( &rec ), InsufficientSpaceHeapPage );
+
+    //values of one attribute are contiguous
+    const char *first = pax->getAttribute( 0, 1 );
+    CHECK_EQUAL( first + 10 * 5, pax->getAttribute( 5, 1 ) );
+    CHECK_EQUAL( 'f', pax->getAttribute( 5, 1 )[9] );
+    CHECK_THROW( pax->getAttribute( 5, 3 ), std::out_of_range );
+
+    Data out( 16 );
+    pax->getRecord( 30, &out );
+    CHECK_EQUAL( 16, out.getSize() );
+    std::int32_t key;
+    memcpy( &key, out.getData(), 4 );
+    CHECK_EQUAL( 30, key );
+    CHECK_EQUAL( 'e', out.getData()[13] );
+    CHECK_EQUAL( 30, out.getData()[15] );
+
+    pax->deleteRecord( 30 );
+    CHECK_THROW( pax->getRecord( 30, &out ), InvalidSlotIdHeapPage );
+    CHECK_EQUAL( capacity - 1, pax->getSize() );
+    CHECK_EQUAL( 30, pax->insertRecord( &rec ) );
+
+    Data wrong( 8 );
+    setRecData( &wrong, 'w', 8 );
+    CHECK_THROW( pax->updateRecord( 0, &wrong ), InvalidSizeData );
+    delete pax;
+  }
+
+  /*
+   * Checks filterInt32 against a scalar evaluation for every comparison on
+   * a sparse PaxPage, and a column scan with getNext.
+   */
+  TEST_FIXTURE(TestFixture, paxPage2){
+    std::cout << " paxPage2 test" << std::endl;
+
+    const std::uint16_t widths[2] = {4, 20};
+    PaxPage *pax = (PaxPage *) new Page();
+    pax->initializeHeader( widths, 2 );
+    std::uint32_t capacity = pax->getCapacity();
+
+    Data rec( 24 );
+    for(std::uint32_t i = 0; i < capacity; i++){
+      std::int32_t key = (std::int32_t) ( i * 37 % 101 ) - 50;
+      memcpy( rec.getData(), &key, 4 );
+      memset( rec.getData() + 4, 'p', 20 );
+      rec.setSize( 24 );
+      pax->insertRecord( &rec );
+    }
+    for(SlotId i = 0; i < capacity; i += 3){
+      pax->deleteRecord( i );
+    }
+
+    PaxColumnScanner scanner( pax, 0 );
+    CHECK_EQUAL( 4, scanner.getWidth() );
+    std::vector<SlotId> ids( capacity );
+    const PaxCompareOp ops[6] = {PAX_EQ, PAX_NE, PAX_LT, PAX_LE, PAX_GT,
+      PAX_GE};
+    for(PaxCompareOp op : ops){
+      std::vector<SlotId> expected;
+      for(SlotId i = 0; i < capacity; i++){
+        if( !pax->isValid( i ) ){
+          continue;
+        }
+        std::int32_t v;
+        memcpy( &v, pax->getAttribute( i, 0 ), 4 );
+        bool match = op == PAX_EQ ? v == 7 : op == PAX_NE ? v != 7 :
+          op == PAX_LT ? v < 7 : op == PAX_LE ? v <= 7 :
+          op == PAX_GT ? v > 7 : v >= 7;
+        if( match ){
+          expected.push_back( i );
+        }
+      }
+      std::uint32_t num = scanner.filterInt32( op, 7, ids.data() );
+      CHECK( expected == std::vector<SlotId>( ids.begin(),
+            ids.begin() + num ) );
+    }
+
+    std::uint32_t count = 0;
+    const char *value;
+    SlotId prev = INVALID_SLOT_ID;
+    for(SlotId i = scanner.getNext( &value ); i != INVALID_SLOT_ID;
+        i = scanner.getNext( &value )){
+      CHECK( i % 3 != 0 );
+      CHECK( prev == INVALID_SLOT_ID || i > prev );
+      CHECK_EQUAL( pax->getAttribute( i, 0 ), value );
+      prev = i;
+      count++;
+    }
+    CHECK_EQUAL( pax->getSize(), count );
+
+    PaxColumnScanner text( pax, 1 );
+    CHECK_THROW( text.filterInt32( PAX_EQ, 0, ids.data() ),
+        std::logic_error );
+    delete pax;
+  }
+}
+
+
+SUITE(pageSynopsis){
+
+  /*
+   * Checks that a synopsis page keeps its region before the slot directory
+   * and rules out keys outside the inserted range and most absent keys.
+   */
+  TEST_FIXTURE(TestFixture, pageSynopsis1){
+    std::cout << " pageSynopsis1 test" << std::endl;
+
+    HeapPage *syn_page = (HeapPage *) new Page();
+    syn_page->initializeHeader( HEAP_PAGE_SYNOPSIS );
+    CHECK( syn_page->hasSynopsis() );
+    CHECK_EQUAL( sizeof(HeapPageHeader) + sizeof(PageSynopsis),
+        syn_page->getHeader().free_space_begin );
+    CHECK_THROW( syn_page->setSynopsisKeyLength( 0 ),
+        std::invalid_argument );
+    syn_page->setSynopsisKeyLength( 4 );
+
+    SynopsisPredicate any = {SYNOPSIS_KEY_RANGE, nullptr, 0, nullptr, 0};
+    CHECK( !syn_page->synopsisMayMatch( any ) );
+
+    //keys are the first 4 bytes, 1000 to 1198 in steps of 2
+    Data rec( 32 );
+    char key[5];
+    for(int i = 0; i < 100; i++){
+      snprintf( key, sizeof(key), "%04d", 1000 + 2 * i );
+      memset( rec.getData(), 'v', 32 );
+      memcpy( rec.getData(), key, 4 );
+      rec.setSize( 32 );
+      syn_page->insertRecord( &rec );
+    }
+    CHECK_THROW( syn_page->setSynopsisKeyLength( 8 ), std::logic_error );
+    Data out( 32 );
+    syn_page->getRecord( 99, &out );
+    CHECK_EQUAL( 0, memcmp( out.getData(), "1198", 4 ) );
+
+    SynopsisPredicate eq = {SYNOPSIS_KEY_EQUAL, "1100", 4, nullptr, 0};
+    CHECK( syn_page->synopsisMayMatch( eq ) );
+    //the key is only the first 4 bytes of the operand
+    eq.low = "1100xyz";
+    eq.low_length = 7;
+    CHECK( syn_page->synopsisMayMatch( eq ) );
+    eq.low = "0999";
+    eq.low_length = 4;
+    CHECK( !syn_page->synopsisMayMatch( eq ) );
+    eq.low = "1200";
+    CHECK( !syn_page->synopsisMayMatch( eq ) );
+
+    //odd keys are inside the range but absent; the bloom filter rules out
+    //most of them
+    int passed = 0;
+    for(int i = 0; i < 99; i++){
+      snprintf( key, sizeof(key), "%04d", 1001 + 2 * i );
+      eq.low = key;
+      passed += syn_page->synopsisMayMatch( eq );
+    }
+    CHECK( passed < 50 );
+
+    SynopsisPredicate range = {SYNOPSIS_KEY_RANGE, "0500", 4, "0999", 4};
+    CHECK( !syn_page->synopsisMayMatch( range ) );
+    range.high = "1000";
+    CHECK( syn_page->synopsisMayMatch( range ) );
+    range.low = "1199";
+    range.high = nullptr;
+    CHECK( !syn_page->synopsisMayMatch( range ) );
+    range.low = "1198";
+    CHECK( syn_page->synopsisMayMatch( range ) );
+
+    //pages without a synopsis never rule anything out
+    page->initializeHeader();
+    CHECK( !page->hasSynopsis() );
+    CHECK( page->synopsisMayMatch( range ) );
+    CHECK_THROW( page->setSynopsisKeyLength( 4 ), std::logic_error );
+    delete syn_page;
+  }
+
+  /*
+   * Checks that deletes leave the synopsis wide until it is rebuilt, on a
+   * compressed page with compact slots, and that resetFiltered skips
+   * pages that are ruled out.
+   */
+  TEST_FIXTURE(TestFixture, pageSynopsis2){
+    std::cout << " pageSynopsis2 test" << std::endl;
+
+    HeapPage *syn_page = (HeapPage *) new Page();
+    syn_page->initializeHeader( HEAP_PAGE_SYNOPSIS | HEAP_PAGE_COMPACT_SLOTS
+        | HEAP_PAGE_COMPRESSION );
+    Data rec( 64 );
+    for(char c = 'a'; c <= 'z'; c++){
+      setRecData( &rec, c, 64 );
+      syn_page->insertRecord( &rec );
+    }
+    Data out( 64 );
+    syn_page->getRecord( 25, &out );
+    CHECK_EQUAL( 'z', out.getData()[63] );
+
+    SynopsisPredicate low_keys = {SYNOPSIS_KEY_RANGE, nullptr, 0, "b", 1};
+    CHECK( syn_page->synopsisMayMatch( low_keys ) );
+    syn_page->deleteRecord( 0 );
+    syn_page->deleteRecord( 1 );
+    CHECK( syn_page->synopsisMayMatch( low_keys ) );
+    syn_page->rebuildSynopsis();
+    CHECK( !syn_page->synopsisMayMatch( low_keys ) );
+
+    //an updated key widens the synopsis again
+    setRecData( &rec, 'A', 64 );
+    syn_page->updateRecord( 2, &rec );
+    CHECK( syn_page->synopsisMayMatch( low_keys ) );
+
+    HeapPageScanner scanner( syn_page );
+    SynopsisPredicate high_keys = {SYNOPSIS_KEY_RANGE, "{", 1, nullptr, 0};
+    CHECK( !scanner.resetFiltered( syn_page, high_keys ) );
+    CHECK_EQUAL( INVALID_SLOT_ID, scanner.getNext() );
+    high_keys.low = "z";
+    CHECK( scanner.resetFiltered( syn_page, high_keys ) );
+    std::uint32_t count = 0;
+    while( scanner.getNext() != INVALID_SLOT_ID ){
+      count++;
+    }
+    CHECK_EQUAL( 24, count );
+    delete syn_page;
+  }
+}
+
+
+/*
+ * HeapPageSource over pages in memory, counting pins and prefetches.
+ */
+class MemoryPageSource : public HeapPageSource {
+  public:
+    std::vector<Page*> pages;
+    std::vector<PageNum> prefetched;
+    std::uint32_t pinned = 0;
+    std::uint32_t max_pinned = 0;
+
+    HeapPage* pinPage(PageNum page_num){
+      pinned++;
+      max_pinned = std::max(max_pinned, pinned);
+      return (HeapPage *) pages[page_num];
+    }
+    void unpinPage(PageNum page_num){
+      (void) page_num;
+      pinned--;
+    }
+    void prefetchPage(PageNum page_num){
+      prefetched.push_back(page_num);
+    }
+};
+
+SUITE(heapFileScanner){
+
+  /*
+   * Scans a chain of five pages with a window of two and checks every
+   * record is returned once, with at most two pages pinned and every page
+   * after the window prefetched once.
+   */
+  TEST_FIXTURE(TestFixture, heapFileScanner1){
+    std::cout << " heapFileScanner1 test" << std::endl;
+
+    MemoryPageSource source;
+    Data rec( 16 );
+    //chain 0 -> 3 -> 1 -> 4 -> 2, page p holds p+1 records
+    const PageNum order[5] = {0, 3, 1, 4, 2};
+    for(PageNum p = 0; p < 5; p++){
+      HeapPage *heap_page = (HeapPage *) new Page();
+      heap_page->initializeHeader();
+      for(PageNum r = 0; r <= p; r++){
+        setRecData( &rec, 'a' + p, 16 );
+        heap_page->insertRecord( &rec );
+      }
+      source.pages.push_back( heap_page );
+    }
+    for(int i = 0; i < 5; i++){
+      ((HeapPage *) source.pages[order[i]])->setNext(
+          i < 4 ? order[i + 1] : INVALID_PAGE_NUM );
+    }
+
+    std::vector<PageNum> seen;
+    {
+      HeapFileScanner scanner( &source, 0, 2 );
+      CHECK_EQUAL( 2, source.pinned );
+      PageNum page_num;
+      Data out( 16 );
+      for(SlotId s = scanner.getNext( &page_num ); s != INVALID_SLOT_ID;
+          s = scanner.getNext( &page_num )){
+        seen.push_back( page_num );
+        scanner.getCurrentPage()->getRecord( s, &out );
+        CHECK_EQUAL( (char) ( 'a' + page_num ), out.getData()[0] );
+      }
+      CHECK( scanner.getCurrentPage() == nullptr );
+      CHECK_EQUAL( 0, source.pinned );
+    }
+    CHECK_EQUAL( 15, seen.size() );
+    std::vector<PageNum> expected;
+    for(PageNum p : order){
+      expected.insert( expected.end(), p + 1, p );
+    }
+    CHECK( expected == seen );
+    CHECK_EQUAL( 2, source.max_pinned );
+    std::vector<PageNum> prefetch_order( order + 2, order + 5 );
+    CHECK( prefetch_order == source.prefetched );
+
+    for(Page *p : source.pages){
+      delete p;
+    }
+  }
+
+  /*
+   * Checks that pages ruled out by their synopsis are skipped and
+   * unpinned, and the empty file and window size 0 cases.
+   */
+  TEST_FIXTURE(TestFixture, heapFileScanner2){
+    std::cout << " heapFileScanner2 test" << std::endl;
+
+    MemoryPageSource source;
+    Data rec( 16 );
+    for(PageNum p = 0; p < 6; p++){
+      HeapPage *heap_page = (HeapPage *) new Page();
+      heap_page->initializeHeader( HEAP_PAGE_SYNOPSIS );
+      heap_page->setNext( p < 5 ? p + 1 : INVALID_PAGE_NUM );
+      for(int r = 0; r < 3; r++){
+        setRecData( &rec, 'a' + p, 16 );
+        heap_page->insertRecord( &rec );
+      }
+      source.pages.push_back( heap_page );
+    }
+
+    SynopsisPredicate eq = {SYNOPSIS_KEY_EQUAL, "dddddddd", 8, nullptr, 0};
+    HeapFileScanner scanner( &source, 0, 3, &eq );
+    PageNum page_num;
+    std::uint32_t count = 0;
+    while( scanner.getNext( &page_num ) != INVALID_SLOT_ID ){
+      CHECK_EQUAL( 3, page_num );
+      count++;
+    }
+    CHECK_EQUAL( 3, count );
+    CHECK_EQUAL( 0, source.pinned );
+
+    scanner.reset( INVALID_PAGE_NUM );
+    CHECK_EQUAL( INVALID_SLOT_ID, scanner.getNext( &page_num ) );
+    CHECK_THROW( HeapFileScanner( &source, 0, 0 ), std::invalid_argument );
+    CHECK_EQUAL( 0, source.pinned );
+
+    for(Page *p : source.pages){
+      delete p;
+    }
+  }
+}
+
+
+/*
+ * Thread safe HeapPageSource over pages in memory.
+ */
+class SharedPageSource : public HeapPageSource {
+  public:
+    std::vector<Page*> pages;
+    std::atomic<std::uint32_t> pinned{0};
+
+    HeapPage* pinPage(PageNum page_num){
+      pinned++;
+      return (HeapPage *) pages[page_num];
+    }
+    void unpinPage(PageNum page_num){
+      (void) page_num;
+      pinned--;
+    }
+};
+
+SUITE(parallelHeapScan){
+
+  /*
+   * Scans 100 pages with 4 workers and checks every record is collected
+   * exactly once, and that pages ruled out by their synopsis are skipped.
+   */
+  TEST_FIXTURE(TestFixture, parallelHeapScan1){
+    std::cout << " parallelHeapScan1 test" << std::endl;
+
+    SharedPageSource source;
+    std::vector<PageNum> page_nums;
+    Data rec( 8 );
+    for(PageNum p = 0; p < 100; p++){
+      HeapPage *heap_page = (HeapPage *) new Page();
+      heap_page->initializeHeader( HEAP_PAGE_SYNOPSIS );
+      //page p holds p % 7 records, some pages are empty
+      for(PageNum r = 0; r < p % 7; r++){
+        setRecData( &rec, 'a' + p % 7, 8 );
+        heap_page->insertRecord( &rec );
+      }
+      source.pages.push_back( heap_page );
+      page_nums.push_back( p );
+    }
+
+    ParallelHeapScan scan( &source, 4, 8 );
+    CHECK_EQUAL( 4, scan.getNumWorkers() );
+    std::vector<ScanRecordId> ids = scan.collect( page_nums );
+    CHECK_EQUAL( 0, source.pinned );
+    std::vector<std::uint32_t> per_page( 100, 0 );
+    for(ScanRecordId id : ids){
+      CHECK( id.slot_id < id.page_num % 7 );
+      per_page[id.page_num]++;
+    }
+    for(PageNum p = 0; p < 100; p++){
+      CHECK_EQUAL( p % 7, per_page[p] );
+    }
+
+    SynopsisPredicate eq = {SYNOPSIS_KEY_EQUAL, "cccccccc", 8, nullptr, 0};
+    ids = scan.collect( page_nums, &eq );
+    CHECK_EQUAL( 14 * 2, ids.size() );
+    for(ScanRecordId id : ids){
+      CHECK_EQUAL( 2, id.page_num % 7 );
+    }
+
+    CHECK_THROW( ParallelHeapScan( &source, 0 ), std::invalid_argument );
+    for(Page *p : source.pages){
+      delete p;
+    }
+  }
+
+  /*
+   * Checks that idle workers steal from a slow one, that batches are
+   * split at PARALLEL_SCAN_BATCH slots, and that a visitor exception stops
+   * the scan and is rethrown with every page unpinned.
+   */
+  TEST_FIXTURE(TestFixture, parallelHeapScan2){
+    std::cout << " parallelHeapScan2 test" << std::endl;
+
+    SharedPageSource source;
+    std::vector<PageNum> page_nums;
+    Data rec( 1 );
+    for(PageNum p = 0; p < 32; p++){
+      HeapPage *heap_page = (HeapPage *) new Page();
+      heap_page->initializeHeader( HEAP_PAGE_COMPACT_SLOTS );
+      std::uint32_t num = p == 0 ? PARALLEL_SCAN_BATCH + 10 : 1;
+      for(std::uint32_t r = 0; r < num; r++){
+        setRecData( &rec, 'x', 1 );
+        heap_page->insertRecord( &rec );
+      }
+      source.pages.push_back( heap_page );
+      page_nums.push_back( p );
+    }
+
+    //worker 0 owns the first half and is slow, so the others steal from it
+    ParallelHeapScan scan( &source, 2, 1 );
+    std::atomic<std::uint32_t> calls( 0 );
+    std::atomic<std::uint32_t> slots( 0 );
+    scan.run( page_nums, [&](std::uint32_t worker, PageNum page_num,
+          HeapPage *heap_page, const SlotId *slot_ids, std::uint32_t num){
+        (void) page_num; (void) heap_page; (void) slot_ids;
+        if( worker == 0 ){
+          std::this_thread::sleep_for( std::chrono::milliseconds( 2 ) );
+        }
+        CHECK( num <= PARALLEL_SCAN_BATCH );
+        calls++;
+        slots += num;
+      });
+    CHECK_EQUAL( 32 + 1, calls );
+    CHECK_EQUAL( PARALLEL_SCAN_BATCH + 10 + 31, slots );
+    CHECK( scan.getStolenMorsels() > 0 );
+    CHECK_EQUAL( 0, source.pinned );
+
+    CHECK_THROW( scan.run( page_nums, [](std::uint32_t, PageNum page_num,
+            HeapPage *, const SlotId *, std::uint32_t){
+          if( page_num == 20 ){
+            throw std::runtime_error( "visitor failed" );
+          }
+        }), std::runtime_error );
+    CHECK_EQUAL( 0, source.pinned );
+    for(Page *p : source.pages){
+      delete p;
+    }
+  }
+}
+
+
+/*
+ * Returns how much counter stat grew from before to after.
+ */
+static std::uint64_t statDelta(const HeapPageStats& before,
+    const HeapPageStats& after, HeapPageStat stat){
+  return after.counters[stat] - before.counters[stat];
+}
+
+SUITE(heapPageStats){
+
+  /*
+   * Checks getPageState against the header after inserts, a deferred
+   * delete and an update.
+   */
+  TEST_FIXTURE(TestFixture, heapPageStats1){
+    std::cout << " heapPageStats1 test" << std::endl;
+
+    page->initializeHeader( HEAP_PAGE_DEFERRED_COMPACTION );
+    Data rec( 100 );
+    for(int i = 0; i < 4; i++){
+      setRecData( &rec, 'a' + i, 100 );
+      page->insertRecord( &rec );
+    }
+    page->deleteRecord( 1 );
+    setRecData( &rec, 'u', 60 );
+    page->updateRecord( 2, &rec );
+
+    HeapPageState state = page->getPageState();
+    HeapPageHeader header = page->getHeader();
+    CHECK_EQUAL( 4, state.capacity );
+    CHECK_EQUAL( 3, state.size );
+    CHECK_EQUAL( 1, state.invalid_slots );
+    CHECK_EQUAL( header.free_space_begin, state.free_space_begin );
+    CHECK_EQUAL( header.free_space_end, state.free_space_end );
+    CHECK_EQUAL( page->getFreeSpace(), state.free_space );
+    CHECK_EQUAL( 100 + 40, state.fragmented_bytes );
+    CHECK_EQUAL( HEAP_PAGE_DEFERRED_COMPACTION, state.flags );
+    CHECK_EQUAL( header.version, state.version );
+    CHECK_EQUAL( 0, state.version % 2 );
+  }
+
+  /*
+   * Checks every counter against a known sequence of operations, including
+   * ones made by a thread that has exited. Without HEAPPAGE_STATS every
+   * counter stays 0.
+   */
+  TEST_FIXTURE(TestFixture, heapPageStats2){
+    std::cout << " heapPageStats2 test" << std::endl;
+
+    CHECK_EQUAL( std::string( "compaction_bytes" ),
+        heapPageStatName( HEAP_PAGE_STAT_COMPACTION_BYTES ) );
+    CHECK_EQUAL( std::string( "insufficient_space" ),
+        heapPageStatName( HEAP_PAGE_STAT_INSUFFICIENT_SPACE ) );
+
+    HeapPageStats before = getHeapPageStats();
+    page->initializeHeader();
+    Data rec( 300 );
+    for(int i = 0; i < 3; i++){
+      setRecData( &rec, 'a' + i, 200 );
+      page->insertRecord( &rec );
+    }
+    //slides the 2 records in front of it
+    page->deleteRecord( 0 );
+    page->insertRecord( &rec );
+    //slides 200 bytes, and one shrink removing one slot
+    page->deleteRecord( 2 );
+    page->updateRecord( 1, &rec );
+    //relocating slides the other 200 byte record
+    setRecData( &rec, 'g', 300 );
+    page->updateRecord( 1, &rec );
+    Data big( PAGE_SIZE );
+    setRecData( &big, 'B', PAGE_SIZE - 100 );
+    CHECK_THROW( page->insertRecord( &big ), InsufficientSpaceHeapPage );
+
+    std::thread inserter([](){
+      Page *thread_page = new Page();
+      ((HeapPage *) thread_page)->initializeHeader();
+      Data thread_rec( 8 );
+      memset( thread_rec.getData(), 't', 8 );
+      thread_rec.setSize( 8 );
+      for(int i = 0; i < 5; i++){
+        ((HeapPage *) thread_page)->insertRecord( &thread_rec );
+      }
+      delete thread_page;
+    });
+    inserter.join();
+    HeapPageStats after = getHeapPageStats();
+
+#ifdef HEAPPAGE_STATS
+    CHECK_EQUAL( 400 + 200 + 200,
+        statDelta( before, after, HEAP_PAGE_STAT_COMPACTION_BYTES ) );
+    CHECK_EQUAL( 3 + 5,
+        statDelta( before, after, HEAP_PAGE_STAT_INSERT_SLOT_APPENDED ) );
+    CHECK_EQUAL( 1,
+        statDelta( before, after, HEAP_PAGE_STAT_INSERT_SLOT_REUSED ) );
+    CHECK_EQUAL( 1,
+        statDelta( before, after, HEAP_PAGE_STAT_DIRECTORY_SHRINKS ) );
+    CHECK_EQUAL( 1,
+        statDelta( before, after, HEAP_PAGE_STAT_DIRECTORY_SLOTS_REMOVED ) );
+    CHECK_EQUAL( 1,
+        statDelta( before, after, HEAP_PAGE_STAT_UPDATE_IN_PLACE ) );
+    CHECK_EQUAL( 1,
+        statDelta( before, after, HEAP_PAGE_STAT_UPDATE_RELOCATED ) );
+    CHECK_EQUAL( 1,
+        statDelta( before, after, HEAP_PAGE_STAT_INSUFFICIENT_SPACE ) );
+    CHECK( statDelta( before, after, HEAP_PAGE_STAT_SLOT_SCAN_LENGTH ) > 0 );
+    //one latch per write, the failed insert included; nothing ran alongside
+    CHECK( statDelta( before, after, HEAP_PAGE_STAT_LATCH_ACQUIRES ) >= 14 );
+    CHECK_EQUAL( 0,
+        statDelta( before, after, HEAP_PAGE_STAT_LATCH_CONTENDED ) );
+#else
+    for(std::uint32_t i = 0; i < HEAP_PAGE_NUM_STATS; i++){
+      CHECK_EQUAL( 0, statDelta( before, after, (HeapPageStat) i ) );
+    }
+#endif
+  }
+}
+
+
+SUITE(pageChecksum){
+
+  /*
+   * Checks crc32c against the standard check value, piecewise checksums
+   * against whole ones, and the build's crc32c against the table version.
+   */
+  TEST_FIXTURE(TestFixture, pageChecksum1){
+    std::cout << " pageChecksum1 test" << std::endl;
+
+    const char* check = "123456789";
+    CHECK_EQUAL( 0xE3069283u, crc32c( 0, check, 9 ) );
+    CHECK_EQUAL( 0xE3069283u, crc32cPortable( 0, check, 9 ) );
+    CHECK_EQUAL( 0xE3069283u, crc32c( crc32c( 0, check, 4 ), check + 4, 5 ) );
+    CHECK_EQUAL( 0u, crc32c( 0, check, 0 ) );
+
+    char buffer[1000];
+    for(int i = 0; i < 1000; i++){
+      buffer[i] = (char) (i * 31 + 7);
+    }
+    for(int length = 0; length < 40; length++){
+      CHECK_EQUAL( crc32cPortable( 0, buffer + 3, length ),
+          crc32c( 0, buffer + 3, length ) );
+    }
+    CHECK_EQUAL( crc32cPortable( 0, buffer, 1000 ),
+        crc32c( 0, buffer, 1000 ) );
+  }
+
+  /*
+   * Checks that the checksum region leaves room after the synopsis, that
+   * updateChecksum makes verifyChecksum pass, and that a flipped byte in a
+   * record or in the header makes it fail. Version changes alone do not.
+   */
+  TEST_FIXTURE(TestFixture, pageChecksum2){
+    std::cout << " pageChecksum2 test" << std::endl;
+
+    page->initializeHeader( HEAP_PAGE_SYNOPSIS | HEAP_PAGE_CHECKSUM );
+    CHECK( page->hasChecksum() );
+    CHECK( page->verifyChecksum( true ) );
+    CHECK_EQUAL( sizeof(HeapPageHeader) + sizeof(PageSynopsis)
+        + sizeof(PageChecksum), page->getHeader().free_space_begin );
+
+    Data rec( 100 );
+    std::vector<SlotId> sids;
+    for(int i = 0; i < 4; i++){
+      setRecData( &rec, 'a' + i, 100 );
+      sids.push_back( page->insertRecord( &rec ) );
+    }
+    CHECK( !page->verifyChecksum( true ) );
+    page->updateChecksum();
+    CHECK( page->verifyChecksum( true ) );
+    CHECK( page->synopsisMayMatch(
+          SynopsisPredicate{ SYNOPSIS_KEY_EQUAL, "cccccccc", 8, nullptr, 0 } ) );
+
+    //nothing to compact, so only the version changes
+    page->compact();
+    page->updateChecksum();
+    CHECK( page->verifyChecksum( true ) );
+
+    char* stored = (char *) page->getRecordView( sids[2] ).data;
+    stored[50] ^= 0x10;
+    CHECK( !page->verifyChecksum( true ) );
+    stored[50] ^= 0x10;
+    CHECK( page->verifyChecksum( true ) );
+
+    page->getData()[offsetof( HeapPageHeader, size )] ^= 0x01;
+    CHECK( !page->verifyChecksum( true ) );
+    page->getData()[offsetof( HeapPageHeader, size )] ^= 0x01;
+    CHECK( page->verifyChecksum( true ) );
+
+    //pages without the flag verify only where no checksum is expected
+    page->initializeHeader();
+    CHECK( !page->hasChecksum() );
+    page->insertRecord( &rec );
+    CHECK( page->verifyChecksum( false ) );
+    CHECK( !page->verifyChecksum( true ) );
+  }
+
+  /*
+   * Checks that a bit flip in the HEAP_PAGE_CHECKSUM flag itself is caught:
+   * whether a checksum is expected comes from the caller, not the Page.
+   */
+  TEST_FIXTURE(TestFixture, pageChecksum3){
+    std::cout << " pageChecksum3 test" << std::endl;
+
+    page->initializeHeader( HEAP_PAGE_CHECKSUM );
+    Data rec( 100 );
+    setRecData( &rec, 'f', 100 );
+    page->insertRecord( &rec );
+    page->updateChecksum();
+    CHECK( page->verifyChecksum( true ) );
+    CHECK( !page->verifyChecksum( false ) );
+
+    page_header->flags ^= HEAP_PAGE_CHECKSUM;
+    CHECK( !page->hasChecksum() );
+    CHECK( !page->verifyChecksum( true ) );
+    page_header->flags ^= HEAP_PAGE_CHECKSUM;
+    CHECK( page->verifyChecksum( true ) );
+  }
+}
+
+/*
+ * HeapPageLogSink keeping a copy of every record, numbered from 1.
+ */
+class VectorLogSink : public HeapPageLogSink {
+  public:
+    std::vector<HeapPageLogRecord> records;
+    std::vector<std::string> bytes;
+
+    std::uint64_t logRecord(HeapPage* page, const HeapPageLogRecord& record){
+      (void) page;
+      records.push_back(record);
+      records.back().lsn = records.size();
+      bytes.push_back(std::string(record.bytes == nullptr ? "" : record.bytes,
+            record.length));
+      return records.size();
+    }
+
+    /*
+     * Returns record i with bytes pointing at the kept copy.
+     */
+    HeapPageLogRecord get(std::size_t i){
+      HeapPageLogRecord record = records[i];
+      record.bytes = bytes[i].data();
+      return record;
+    }
+};
+
+SUITE(pageLog){
+
+  /*
+   * Logs a mix of changes, checks the records are small, and redoes them
+   * on a second page, which must end up with the same records, layout and
+   * LSN.
+   */
+  TEST_FIXTURE(TestFixture, pageLog1){
+    std::cout << " pageLog1 test" << std::endl;
+
+    VectorLogSink sink;
+    HeapPage::setLogSink( &sink );
+    page->initializeHeader( HEAP_PAGE_LSN | HEAP_PAGE_CHECKSUM );
+    page->setNext( 7 );
+    Data rec( 200 );
+    for(int i = 0; i < 6; i++){
+      setRecData( &rec, 'a' + i, 50 + 10 * i );
+      page->insertRecord( &rec );
+    }
+    page->deleteRecord( 1 );
+    setRecData( &rec, 'u', 150 );
+    page->updateRecord( 3, &rec );
+    page->setDeferredCompaction( true );
+    SlotId doomed[2] = {0, 4};
+    page->deleteRecords( doomed, 2 );
+    Data* batch[2] = { &rec, &rec };
+    SlotId batch_ids[2];
+    CHECK_EQUAL( 2u, page->insertRecords( batch, 2, batch_ids ) );
+    page->compact();
+    HeapPage::setLogSink( nullptr );
+
+    //1 init, 1 link, 6 inserts, delete, update, mode, delete many, 2
+    //inserts, compact
+    CHECK_EQUAL( 15u, sink.records.size() );
+    CHECK_EQUAL( HEAP_PAGE_LOG_UPDATE, sink.records[9].type );
+    CHECK_EQUAL( 3, sink.records[9].slot_id );
+    CHECK_EQUAL( 150u, sink.records[9].length );
+    CHECK_EQUAL( HEAP_PAGE_LOG_DELETE, sink.records[8].type );
+    CHECK_EQUAL( 0u, sink.records[8].length );
+    CHECK_EQUAL( 15u, page->getPageLsn() );
+
+    HeapPage *copy = (HeapPage *) new Page();
+    for(std::size_t i = 0; i < sink.records.size(); i++){
+      CHECK( copy->redo( sink.get( i ) ) );
+    }
+    CHECK_EQUAL( 15u, copy->getPageLsn() );
+    CHECK_EQUAL( 7u, copy->getNext() );
+    HeapPageState expected = page->getPageState();
+    HeapPageState actual = copy->getPageState();
+    CHECK_EQUAL( expected.capacity, actual.capacity );
+    CHECK_EQUAL( expected.size, actual.size );
+    CHECK_EQUAL( expected.free_space_begin, actual.free_space_begin );
+    CHECK_EQUAL( expected.free_space_end, actual.free_space_end );
+    CHECK_EQUAL( expected.fragmented_bytes, actual.fragmented_bytes );
+    CHECK_EQUAL( expected.flags, actual.flags );
+    Data got( 200 );
+    for(SlotId i = 0; i < expected.capacity; i++){
+      CHECK_EQUAL( page->getSlotInfo( i ).offset,
+          copy->getSlotInfo( i ).offset );
+      if( page->getSlotInfo( i ).offset != INVALID_SLOT_OFFSET ){
+        page->getRecord( i, record_data );
+        copy->getRecord( i, &got );
+        CHECK_EQUAL( record_data->getSize(), got.getSize() );
+        CHECK( std::memcmp( record_data->getData(), got.getData(),
+              got.getSize() ) == 0 );
+      }
+    }
+    copy->updateChecksum();
+    CHECK( copy->verifyChecksum( true ) );
+    delete copy;
+  }
+
+  /*
+   * Checks that redo skips records the Page already has, rejects a record
+   * applied to the wrong state, and that nothing is logged without a sink.
+   */
+  TEST_FIXTURE(TestFixture, pageLog2){
+    std::cout << " pageLog2 test" << std::endl;
+
+    VectorLogSink sink;
+    HeapPage::setLogSink( &sink );
+    page->initializeHeader( HEAP_PAGE_LSN | HEAP_PAGE_COMPRESSION );
+    Data rec( 100 );
+    setRecData( &rec, 'a', 100 );
+    page->insertRecord( &rec );
+    setRecData( &rec, 'b', 40 );
+    page->insertRecord( &rec );
+    HeapPage::setLogSink( nullptr );
+    CHECK_EQUAL( 3u, sink.records.size() );
+    //compressed pages log the record as given
+    CHECK_EQUAL( 100u, sink.records[1].length );
+
+    for(std::size_t i = 1; i < sink.records.size(); i++){
+      CHECK( !page->redo( sink.get( i ) ) );
+    }
+    CHECK_EQUAL( 2, page->getNumRecs() );
+    CHECK_EQUAL( 3u, page->getPageLsn() );
+
+    HeapPageLogRecord second = sink.get( 2 );
+    second.lsn = 10;
+    CHECK_THROW( page->redo( second ), std::runtime_error );
+
+    HeapPageLogRecord bad = sink.get( 1 );
+    bad.type = (HeapPageLogType) 99;
+    bad.lsn = 20;
+    CHECK_THROW( page->redo( bad ), std::invalid_argument );
+
+    std::uint64_t lsn = page->getPageLsn();
+    page->deleteRecord( 0 );
+    CHECK_EQUAL( lsn, page->getPageLsn() );
+    CHECK_EQUAL( 3u, sink.records.size() );
+  }
+}
+
+SUITE(mvcc){
+
+  /*
+   * Updates and deletes records and reads them back as of snapshots taken
+   * before and after, through getRecord and the scanner.
+   */
+  TEST_FIXTURE(TestFixture, mvcc1){
+    std::cout << " mvcc1 test" << std::endl;
+
+    page->initializeHeader( HEAP_PAGE_MVCC );
+    Data rec( 100 );
+    setRecData( &rec, 'a', 40 );
+    SlotId a = page->insertRecord( &rec );
+    setRecData( &rec, 'b', 30 );
+    SlotId b = page->insertRecord( &rec );
+    std::uint64_t before = HeapPage::takeSnapshot();
+
+    setRecData( &rec, 'A', 60 );
+    page->updateRecord( a, &rec );
+    page->deleteRecord( b );
+    std::uint64_t after = HeapPage::takeSnapshot();
+    CHECK( after > before );
+    CHECK_THROW( page->deleteRecord( b ), InvalidSlotIdHeapPage );
+    CHECK_THROW( page->updateRecord( b, &rec ), InvalidSlotIdHeapPage );
+
+    //latest versions
+    page->getRecord( a, record_data );
+    CHECK_EQUAL( 60, record_data->getSize() );
+    CHECK( compareRecMem( &rec, record_data->getData() ) );
+    CHECK_THROW( page->getRecord( b, record_data ), InvalidSlotIdHeapPage );
+
+    //as of the snapshots
+    Data old_a( 100 );
+    setRecData( &old_a, 'a', 40 );
+    CHECK( page->getRecord( a, record_data, before ) );
+    CHECK_EQUAL( 40, record_data->getSize() );
+    CHECK( compareRecMem( &old_a, record_data->getData() ) );
+    CHECK( page->getRecord( b, record_data, before ) );
+    CHECK_EQUAL( 30, record_data->getSize() );
+    CHECK( page->getRecord( a, record_data, after ) );
+    CHECK_EQUAL( 60, record_data->getSize() );
+    CHECK( !page->getRecord( b, record_data, after ) );
+
+    HeapPageScanner scanner( page );
+    RecordView view;
+    CHECK_EQUAL( a, scanner.getNext( &view ) );
+    CHECK_EQUAL( 60u, view.length );
+    CHECK_EQUAL( INVALID_SLOT_ID, scanner.getNext( &view ) );
+
+    scanner.setSnapshot( before );
+    scanner.reset( page );
+    SlotId ids[8];
+    RecordView views[8];
+    CHECK_EQUAL( 2u, scanner.getNextBatch( ids, 8, views ) );
+    CHECK_EQUAL( a, ids[0] );
+    CHECK_EQUAL( 40u, views[0].length );
+    CHECK( compareRecMem( &old_a, (char *) views[0].data ) );
+    CHECK_EQUAL( b, ids[1] );
+    CHECK_EQUAL( 30u, views[1].length );
+
+    CHECK_THROW( page->setCompression( true ), std::logic_error );
+    CHECK_THROW( page->initializeHeader( HEAP_PAGE_MVCC
+          | HEAP_PAGE_COMPRESSION ), std::invalid_argument );
+  }
+
+  /*
+   * Checks that prune only reclaims versions invisible to the horizon and
+   * gives their space back.
+   */
+  TEST_FIXTURE(TestFixture, mvcc2){
+    std::cout << " mvcc2 test" << std::endl;
+
+    page->initializeHeader( HEAP_PAGE_MVCC );
+    Data rec( 100 );
+    setRecData( &rec, 'a', 50 );
+    SlotId a = page->insertRecord( &rec );
+    setRecData( &rec, 'b', 50 );
+    SlotId b = page->insertRecord( &rec );
+    std::uint32_t free_space = page->getFreeSpace();
+
+    std::uint64_t first = HeapPage::takeSnapshot();
+    setRecData( &rec, 'c', 50 );
+    page->updateRecord( a, &rec );
+    std::uint64_t second = HeapPage::takeSnapshot();
+    setRecData( &rec, 'd', 50 );
+    page->updateRecord( a, &rec );
+    page->deleteRecord( b );
+    //a has three versions, b one deleted version
+    CHECK_EQUAL( 4, page->getNumRecs() );
+
+    CHECK_EQUAL( 0u, page->prune( first ) );
+    CHECK( page->getRecord( a, record_data, first ) );
+    CHECK_EQUAL( 'a', record_data->getData()[0] );
+
+    //only the first version of a is invisible from second on
+    CHECK_EQUAL( 1u, page->prune( second ) );
+    CHECK_EQUAL( 3, page->getNumRecs() );
+    CHECK( page->getRecord( a, record_data, second ) );
+    CHECK_EQUAL( 'c', record_data->getData()[0] );
+    CHECK( page->getRecord( b, record_data, second ) );
+
+    CHECK_EQUAL( 2u, page->prune( HeapPage::takeSnapshot() ) );
+    CHECK_EQUAL( 1, page->getNumRecs() );
+    page->getRecord( a, record_data );
+    CHECK_EQUAL( 'd', record_data->getData()[0] );
+    CHECK( !page->getRecord( a, record_data, second ) );
+    //b and its slot are gone, and the directory shrank back to one slot
+    CHECK_EQUAL( free_space + 50 + sizeof(RecordVersion) + sizeof(SlotInfo),
+        page->getFreeSpace() );
+    CHECK_EQUAL( 0u, page->prune( HeapPage::takeSnapshot() ) );
+  }
+}
+
+SUITE(pageVacuum){
+
+  /*
+   * Packs a slot directory with two holes and checks the last record moved
+   * into the first hole, the directory shrank and packing again does
+   * nothing.
+   */
+  TEST_FIXTURE(TestFixture, pageVacuum1){
+    std::cout << " pageVacuum1 test" << std::endl;
+
+    Data rec( 16 );
+    for(int i = 0; i < 5; i++){
+      setRecData( &rec, 'a' + i, 16 );
+      page->insertRecord( &rec );
+    }
+    page->deleteRecord( 1 );
+    page->deleteRecord( 3 );
+    std::uint32_t free_space = page->getFreeSpace();
+
+    std::vector<SlotMove> moves = page->packSlotDirectory();
+    CHECK_EQUAL( 1, moves.size() );
+    CHECK_EQUAL( 4, moves[0].from );
+    CHECK_EQUAL( 1, moves[0].to );
+    CHECK_EQUAL( 3, page->getNumRecs() );
+    CHECK_EQUAL( 0u, page->getInvalidNum() );
+    //two slots freed, one of them now counted for the next insert
+    CHECK_EQUAL( free_space + sizeof(SlotInfo), page->getFreeSpace() );
+    const char expected[3] = {'a', 'e', 'c'};
+    for(SlotId s = 0; s < 3; s++){
+      page->getRecord( s, record_data );
+      CHECK_EQUAL( expected[s], record_data->getData()[0] );
+    }
+    CHECK_THROW( page->getRecord( 3, record_data ), InvalidSlotIdHeapPage );
+
+    CHECK( page->packSlotDirectory().empty() );
+    //a new record takes the next slot rather than an old hole
+    CHECK_EQUAL( 3, page->insertRecord( &rec ) );
+  }
+
+  /*
+   * Runs a HeapPageVacuum over a deferred page with deleted records and a
+   * page with a sparse slot directory: the first is compacted at once, the
+   * second only packed once a slot move listener is set.
+   */
+  TEST_FIXTURE(TestFixture, pageVacuum2){
+    std::cout << " pageVacuum2 test" << std::endl;
+
+    MemoryPageSource source;
+    Data rec( 100 );
+    HeapPage *deferred = (HeapPage *) new Page();
+    deferred->initializeHeader( HEAP_PAGE_DEFERRED_COMPACTION );
+    for(int i = 0; i < 4; i++){
+      setRecData( &rec, 'a' + i, 100 );
+      deferred->insertRecord( &rec );
+    }
+    deferred->deleteRecord( 0 );
+    deferred->deleteRecord( 2 );
+    HeapPage *sparse = (HeapPage *) new Page();
+    sparse->initializeHeader();
+    for(int i = 0; i < 10; i++){
+      setRecData( &rec, 'a' + i, 16 );
+      sparse->insertRecord( &rec );
+    }
+    for(SlotId s = 0; s < 9; s++){
+      sparse->deleteRecord( s );
+    }
+    source.pages.push_back( deferred );
+    source.pages.push_back( sparse );
+    std::uint32_t free_space = deferred->getFreeSpace();
+
+    CHECK_THROW( HeapPageVacuum( &source, 0 ), std::invalid_argument );
+    HeapPageVacuum vacuum( &source );
+    vacuum.setPages( std::vector<PageNum>{0, 1} );
+    vacuum.setThresholds( 100, 8 );
+    CHECK_EQUAL( 1u, vacuum.runOnce() );
+    CHECK_EQUAL( 0, source.pinned );
+    CHECK_EQUAL( 0u, deferred->getPageState().fragmented_bytes );
+    //fragmented bytes already count as free space
+    CHECK_EQUAL( free_space, deferred->getFreeSpace() );
+    CHECK_EQUAL( 9u, sparse->getInvalidNum() );
+
+    std::vector<SlotMove> seen;
+    vacuum.setSlotMoveListener(
+        [&seen, &source](PageNum page_num, const SlotMove *moves,
+            std::uint32_t num_moves){
+          CHECK_EQUAL( 1, page_num );
+          CHECK_EQUAL( 1, source.pinned );
+          seen.insert( seen.end(), moves, moves + num_moves );
+        });
+    CHECK_EQUAL( 1u, vacuum.runOnce() );
+    CHECK_EQUAL( 1, seen.size() );
+    CHECK_EQUAL( 9, seen[0].from );
+    CHECK_EQUAL( 0, seen[0].to );
+    sparse->getRecord( 0, record_data );
+    CHECK_EQUAL( 'j', record_data->getData()[0] );
+    CHECK_EQUAL( 0u, vacuum.runOnce() );
+
+    HeapPageVacuumStats stats = vacuum.getStats();
+    CHECK_EQUAL( 6u, stats.sampled_pages );
+    CHECK_EQUAL( 2u, stats.vacuumed_pages );
+    CHECK_EQUAL( 1u, stats.compactions );
+    CHECK_EQUAL( 1u, stats.moved_slots );
+
+    vacuum.start( std::chrono::milliseconds( 1 ) );
+    CHECK_THROW( vacuum.start( std::chrono::milliseconds( 1 ) ),
+        std::logic_error );
+    vacuum.stop();
+    vacuum.stop();
+    CHECK_EQUAL( 0, source.pinned );
+
+    for(Page *p : source.pages){
+      delete p;
+    }
+  }
+}
+
+/*
+ * OverflowPageSource over pages in memory, reusing freed pages and
+ * counting pins.
+ */
+class MemoryOverflowSource : public OverflowPageSource {
+  public:
+    std::vector<Page*> pages;
+    std::vector<PageNum> free_pages;
+    std::int32_t pinned = 0;
+    std::int32_t max_pinned = 0;
+
+    ~MemoryOverflowSource(){
+      for(Page *p : pages){
+        delete p;
+      }
+    }
+    HeapPage* pinPage(PageNum page_num){
+      pinned++;
+      max_pinned = std::max(max_pinned, pinned);
+      return (HeapPage *) pages[page_num];
+    }
+    void unpinPage(PageNum page_num){
+      (void) page_num;
+      pinned--;
+    }
+    HeapPage* allocatePage(PageNum *page_num){
+      if(free_pages.empty()){
+        pages.push_back( new Page() );
+        *page_num = pages.size() - 1;
+      }else{
+        *page_num = free_pages.back();
+        free_pages.pop_back();
+      }
+      return pinPage( *page_num );
+    }
+    void freePage(PageNum page_num){
+      free_pages.push_back( page_num );
+    }
+    std::uint32_t allocated(){
+      return pages.size() - free_pages.size();
+    }
+};
+
+SUITE(overflowRecords){
+
+  /*
+   * Inserts a small record and one spanning three overflow pages, reads
+   * them back whole and through the inline view, then deletes the large
+   * one and checks its pages were freed.
+   */
+  TEST_FIXTURE(TestFixture, overflowRecords1){
+    std::cout << " overflowRecords1 test" << std::endl;
+
+    MemoryOverflowSource source;
+    OverflowRecords records( &source );
+    CHECK_THROW( OverflowRecords( &source, 100, 50 ), std::invalid_argument );
+
+    std::uint32_t large_length = 2 * PAGE_SIZE + 100;
+    Data large( large_length );
+    for(std::uint32_t i = 0; i < large_length; i++){
+      large.getData()[i] = 'a' + i % 26;
+    }
+    SlotId small_id = records.insertRecord( page, "hello", 5 );
+    SlotId large_id = records.insertRecord( page, large.getData(),
+        large_length );
+    CHECK_EQUAL( 3u, source.allocated() );
+    CHECK_EQUAL( 0, source.pinned );
+    CHECK_THROW( records.insertRecord( page, "", 0 ), EmptyDataHeapPage );
+
+    //the large record only takes its prefix on the page
+    CHECK_EQUAL( 2u, page->getNumRecs() );
+    CHECK( page->getFreeSpace() > PAGE_SIZE / 2 );
+    CHECK_EQUAL( INVALID_PAGE_NUM,
+        records.getHeader( page, small_id ).first_page );
+    RecordView view = records.getInline( page, small_id );
+    CHECK_EQUAL( 5u, view.length );
+    CHECK( std::memcmp( view.data, "hello", 5 ) == 0 );
+    view = records.getInline( page, large_id );
+    CHECK_EQUAL( OVERFLOW_INLINE_LENGTH, view.length );
+    CHECK( std::memcmp( view.data, large.getData(), view.length ) == 0 );
+
+    //writing the chain pins two pages at a time, reading it one
+    CHECK_EQUAL( 2, source.max_pinned );
+    source.max_pinned = 0;
+    Data out( large_length );
+    records.getRecord( page, large_id, &out );
+    CHECK_EQUAL( large_length, out.getSize() );
+    CHECK( std::memcmp( out.getData(), large.getData(), large_length ) == 0 );
+    CHECK_EQUAL( 1, source.max_pinned );
+    Data small_out( 10 );
+    CHECK_THROW( records.getRecord( page, large_id, &small_out ),
+        InvalidSizeData );
+    records.getRecord( page, small_id, &small_out );
+    CHECK_EQUAL( 5u, small_out.getSize() );
+
+    records.deleteRecord( page, large_id );
+    CHECK_EQUAL( 0u, source.allocated() );
+    CHECK_EQUAL( 1u, page->getNumRecs() );
+    CHECK_EQUAL( 0, source.pinned );
+  }
+
+  /*
+   * Streams a large record in small reads, and checks an insert that does
+   * not fit on the page leaves no overflow page allocated.
+   */
+  TEST_FIXTURE(TestFixture, overflowRecords2){
+    std::cout << " overflowRecords2 test" << std::endl;
+
+    MemoryOverflowSource source;
+    OverflowRecords records( &source, 16, 32 );
+    std::uint32_t length = PAGE_SIZE + 7;
+    Data large( length );
+    for(std::uint32_t i = 0; i < length; i++){
+      large.getData()[i] = (char) ( i * 7 );
+    }
+    SlotId slot_id = records.insertRecord( page, large.getData(), length );
+
+    {
+      OverflowReader reader( &records, page, slot_id );
+      CHECK_EQUAL( length, reader.getLength() );
+      std::vector<char> streamed;
+      char buffer[100];
+      std::uint32_t count;
+      while( ( count = reader.read( buffer, sizeof(buffer) ) ) > 0 ){
+        streamed.insert( streamed.end(), buffer, buffer + count );
+        CHECK( source.pinned <= 1 );
+      }
+      CHECK_EQUAL( 0u, reader.getRemaining() );
+      CHECK_EQUAL( length, streamed.size() );
+      CHECK( std::memcmp( streamed.data(), large.getData(), length ) == 0 );
+    }
+    CHECK_EQUAL( 0, source.pinned );
+
+    //fill the page so the next inline part cannot fit
+    Data filler( 100 );
+    setRecData( &filler, 'x', 100 );
+    while( page->getFreeSpace() >= 100 ){
+      page->insertRecord( &filler );
+    }
+    if( page->getFreeSpace() > 0 ){
+      filler.setSize( page->getFreeSpace() );
+      page->insertRecord( &filler );
+    }
+    std::uint32_t allocated = source.allocated();
+    CHECK_THROW( records.insertRecord( page, large.getData(), length ),
+        InsufficientSpaceHeapPage );
+    CHECK_EQUAL( allocated, source.allocated() );
+    CHECK_EQUAL( 0, source.pinned );
+  }
+}
+
+SUITE(recordArena){
+
+  /*
+   * Allocates from a small arena across blocks, then checks reset and
+   * rewind reuse the blocks without allocating more.
+   */
+  TEST_FIXTURE(TestFixture, recordArena1){
+    std::cout << " recordArena1 test" << std::endl;
+
+    CHECK_THROW( RecordArena( 0 ), std::invalid_argument );
+    RecordArena arena( 100 );
+    CHECK_EQUAL( 0u, arena.getBytesReserved() );
+    char *a = arena.allocate( 60 );
+    char *b = arena.allocate( 30 );
+    CHECK( b == a + 60 );
+    //does not fit in the rest of the first block
+    char *c = arena.allocate( 20 );
+    CHECK( c != b + 30 );
+    //larger than a block: gets its own
+    arena.allocate( 250 );
+    CHECK_EQUAL( 360u, arena.getBytesUsed() );
+    CHECK_EQUAL( 450u, arena.getBytesReserved() );
+
+    RecordArena::Mark mark = arena.getMark();
+    arena.allocate( 50 );
+    arena.rewind( mark );
+    CHECK_EQUAL( 360u, arena.getBytesUsed() );
+    //the block taken after the mark is kept
+    CHECK_EQUAL( 550u, arena.getBytesReserved() );
+
+    arena.reset();
+    CHECK_EQUAL( 0u, arena.getBytesUsed() );
+    CHECK( arena.allocate( 60 ) == a );
+    arena.allocate( 100 );
+    arena.allocate( 200 );
+    arena.allocate( 100 );
+    CHECK_EQUAL( 550u, arena.getBytesReserved() );
+  }
+
+  /*
+   * Copies every record of a plain and of a compressed page into an
+   * arena with getRecords and getNextRecords, and checks an invalid slot
+   * leaves the arena unchanged.
+   */
+  TEST_FIXTURE(TestFixture, recordArena2){
+    std::cout << " recordArena2 test" << std::endl;
+
+    const std::uint16_t modes[2] = {0, HEAP_PAGE_COMPRESSION};
+    for(std::uint16_t mode : modes){
+      page->initializeHeader( mode );
+      Data rec( 200 );
+      SlotId slot_ids[10];
+      for(int i = 0; i < 10; i++){
+        setRecData( &rec, 'a' + i, 20 + 10 * i );
+        slot_ids[i] = page->insertRecord( &rec );
+      }
+      page->deleteRecord( slot_ids[4] );
+
+      RecordArena arena;
+      RecordView records[10];
+      SlotId some[3] = {slot_ids[9], slot_ids[0], slot_ids[5]};
+      page->getRecords( some, 3, &arena, records );
+      CHECK_EQUAL( 110u, records[0].length );
+      CHECK_EQUAL( 'j', records[0].data[0] );
+      CHECK_EQUAL( 20u, records[1].length );
+      CHECK_EQUAL( 70u, records[2].length );
+      CHECK_EQUAL( 'f', records[2].data[69] );
+      CHECK_EQUAL( 200u, arena.getBytesUsed() );
+
+      SlotId bad[2] = {slot_ids[0], slot_ids[4]};
+      CHECK_THROW( page->getRecords( bad, 2, &arena, records ),
+          InvalidSlotIdHeapPage );
+      CHECK_EQUAL( 200u, arena.getBytesUsed() );
+
+      arena.reset();
+      HeapPageScanner scanner( page );
+      SlotId found[10];
+      std::uint32_t num = scanner.getNextRecords( found, 10, &arena,
+          records );
+      CHECK_EQUAL( 9u, num );
+      for(std::uint32_t i = 0; i < num; i++){
+        page->getRecord( found[i], record_data );
+        CHECK_EQUAL( record_data->getSize(), records[i].length );
+        CHECK( std::memcmp( record_data->getData(), records[i].data,
+              records[i].length ) == 0 );
+      }
+      CHECK_EQUAL( 0u, scanner.getNextRecords( found, 10, &arena,
+            records ) );
+    }
+  }
+}
+
+SUITE(sortedHeapPage){
+
+  /*
+   * Inserts records out of key order on a page that already has some,
+   * then checks find, the order, and that deletes and updates keep it.
+   */
+  TEST_FIXTURE(TestFixture, sortedHeapPage1){
+    std::cout << " sortedHeapPage1 test" << std::endl;
+
+    Data rec( 16 );
+    setRecData( &rec, 'm', 16 );
+    page->insertRecord( &rec );
+    setRecData( &rec, 'c', 16 );
+    page->insertRecord( &rec );
+    //key is the first 4 bytes
+    SortedHeapPage sorted( page, [](const RecordView &record){
+        RecordView key = {record.data, 4};
+        return key;
+      });
+    CHECK_EQUAL( 2u, sorted.getSize() );
+    CHECK_EQUAL( 1, sorted.getSlotAt( 0 ) );
+
+    const char keys[6] = {'q', 'a', 'x', 'e', 'c', 'k'};
+    for(char key : keys){
+      setRecData( &rec, key, 16 );
+      sorted.insertRecord( &rec );
+    }
+    CHECK_EQUAL( 8u, sorted.getSize() );
+    const char expected[8] = {'a', 'c', 'c', 'e', 'k', 'm', 'q', 'x'};
+    for(std::uint32_t i = 0; i < 8; i++){
+      CHECK_EQUAL( expected[i],
+          page->getRecordView( sorted.getSlotAt( i ) ).data[0] );
+    }
+    //equal keys keep their insertion order
+    CHECK_EQUAL( 1, sorted.getSlotAt( 1 ) );
+    CHECK_EQUAL( 6, sorted.getSlotAt( 2 ) );
+
+    CHECK_EQUAL( 2, sorted.find( "qqqq", 4 ) );
+    CHECK_EQUAL( INVALID_SLOT_ID, sorted.find( "bbbb", 4 ) );
+    CHECK_EQUAL( 1u, sorted.lowerBound( "cccc", 4 ) );
+    CHECK_EQUAL( 3u, sorted.upperBound( "cccc", 4 ) );
+    CHECK_EQUAL( 8u, sorted.lowerBound( "zzzz", 4 ) );
+
+    sorted.deleteRecord( 2 );
+    CHECK_EQUAL( INVALID_SLOT_ID, sorted.find( "qqqq", 4 ) );
+    CHECK_THROW( sorted.deleteRecord( 2 ), InvalidSlotIdHeapPage );
+    setRecData( &rec, 'b', 16 );
+    sorted.updateRecord( 0, &rec );
+    CHECK_EQUAL( 0, sorted.getSlotAt( 1 ) );
+    CHECK_EQUAL( 0, sorted.find( "bbbb", 4 ) );
+    CHECK_EQUAL( INVALID_SLOT_ID, sorted.find( "mmmm", 4 ) );
+    CHECK_EQUAL( 7u, sorted.getSize() );
+  }
+
+  /*
+   * Orders records by a little endian integer key with a custom
+   * comparator and walks a key range.
+   */
+  TEST_FIXTURE(TestFixture, sortedHeapPage2){
+    std::cout << " sortedHeapPage2 test" << std::endl;
+
+    SortedHeapPage sorted( page, nullptr,
+        [](const char *a, std::uint32_t a_length, const char *b,
+            std::uint32_t b_length){
+          (void) a_length;
+          (void) b_length;
+          std::uint32_t x, y;
+          std::memcpy( &x, a, sizeof(x) );
+          std::memcpy( &y, b, sizeof(y) );
+          return x < y ? -1 : ( x > y ? 1 : 0 );
+        });
+    CHECK_EQUAL( 0u, sorted.getSize() );
+    CHECK_EQUAL( INVALID_SLOT_ID, sorted.find( "\0\0\0\0", 4 ) );
+
+    Data rec( sizeof(std::uint32_t) );
+    for(std::uint32_t i = 0; i < 50; i++){
+      //keys 0, 7, 14, ... inserted in a scrambled order
+      std::uint32_t key = ( i * 17 % 50 ) * 7;
+      std::memcpy( rec.getData(), &key, sizeof(key) );
+      rec.setSize( sizeof(key) );
+      sorted.insertRecord( &rec );
+    }
+    std::uint32_t lo = 100, hi = 200;
+    std::uint32_t begin = sorted.lowerBound( (char *) &lo, sizeof(lo) );
+    std::uint32_t end = sorted.lowerBound( (char *) &hi, sizeof(hi) );
+    //105 to 196
+    CHECK_EQUAL( 14u, end - begin );
+    std::uint32_t previous = 0;
+    for(std::uint32_t p = begin; p < end; p++){
+      std::uint32_t key;
+      std::memcpy( &key, page->getRecordView( sorted.getSlotAt( p ) ).data,
+          sizeof(key) );
+      CHECK( key >= lo && key < hi && key > previous );
+      previous = key;
+    }
+
+    sorted.rebuild();
+    CHECK_EQUAL( 50u, sorted.getSize() );
+    CHECK_EQUAL( begin, sorted.lowerBound( (char *) &lo, sizeof(lo) ) );
+    HeapPage *compressed = (HeapPage *) new Page();
+    compressed->initializeHeader( HEAP_PAGE_COMPRESSION );
+    CHECK_THROW( SortedHeapPage sorted_compressed( compressed ),
+        std::logic_error );
+    delete compressed;
+  }
+}
+
+/*
+ * Writes pages to a new temporary file and returns its path.
+ */
+static std::string writePageFile(const std::vector<Page*> &pages){
+  char path[] = "/tmp/heappageXXXXXX";
+  int fd = mkstemp( path );
+  for(Page *p : pages){
+    CHECK_EQUAL( (ssize_t) PAGE_SIZE, write( fd, p->getData(), PAGE_SIZE ) );
+  }
+  close( fd );
+  return path;
+}
+
+SUITE(mappedHeapFile){
+
+  /*
+   * Maps a file of three chained pages and scans it with HeapFileScanner,
+   * checking the records are read in place from the mapping.
+   */
+  TEST_FIXTURE(TestFixture, mappedHeapFile1){
+    std::cout << " mappedHeapFile1 test" << std::endl;
+
+    std::vector<Page*> pages;
+    Data rec( 32 );
+    for(PageNum p = 0; p < 3; p++){
+      HeapPage *heap_page = (HeapPage *) new Page();
+      heap_page->initializeHeader();
+      heap_page->setNext( p < 2 ? p + 1 : INVALID_PAGE_NUM );
+      for(int r = 0; r < 10; r++){
+        setRecData( &rec, 'a' + p, 32 );
+        heap_page->insertRecord( &rec );
+      }
+      pages.push_back( heap_page );
+    }
+    std::string path = writePageFile( pages );
+    for(Page *p : pages){
+      delete p;
+    }
+
+    {
+      MappedHeapFile file( path );
+      CHECK_EQUAL( 3u, file.getNumPages() );
+      CHECK_THROW( file.pinPage( 3 ), std::out_of_range );
+      HeapFileScanner scanner( &file, 0, 2 );
+      PageNum page_num;
+      std::uint32_t count = 0;
+      for(SlotId s = scanner.getNext( &page_num ); s != INVALID_SLOT_ID;
+          s = scanner.getNext( &page_num )){
+        RecordView view = scanner.getCurrentPage()->getRecordView( s );
+        CHECK_EQUAL( 32u, view.length );
+        CHECK_EQUAL( (char) ( 'a' + page_num ), view.data[0] );
+        //zero copy: the view points into the mapping
+        const char *first = (const char *) file.pinPage( 0 );
+        CHECK( view.data >= first && view.data < first + 3 * PAGE_SIZE );
+        count++;
+      }
+      CHECK_EQUAL( 30u, count );
+      file.pinPage( 1 )->getRecord( 9, record_data );
+      CHECK_EQUAL( 'b', record_data->getData()[31] );
+    }
+    unlink( path.c_str() );
+  }
+
+  /*
+   * Checks the errors of opening a missing file and a file that is not a
+   * whole number of pages, and the hints on an empty file.
+   */
+  TEST_FIXTURE(TestFixture, mappedHeapFile2){
+    std::cout << " mappedHeapFile2 test" << std::endl;
+
+    CHECK_THROW( MappedHeapFile file( "/nonexistent/heapfile" ),
+        std::runtime_error );
+
+    std::string path = writePageFile( std::vector<Page*>() );
+    {
+      MappedHeapFile file( path, MAPPED_ACCESS_RANDOM );
+      CHECK_EQUAL( 0u, file.getNumPages() );
+      file.advise( MAPPED_ACCESS_NORMAL );
+      file.prefetchPage( 0 );
+      CHECK_THROW( file.pinPage( 0 ), std::out_of_range );
+    }
+    FILE *f = std::fopen( path.c_str(), "w" );
+    std::fputs( "not a page", f );
+    std::fclose( f );
+    CHECK_THROW( MappedHeapFile file( path ), std::runtime_error );
+    unlink( path.c_str() );
+  }
+
+  /*
+   * Checks that a page written while latched is rejected by pinPage, since
+   * the latch of a read only mapping can never be released.
+   */
+  TEST_FIXTURE(TestFixture, mappedHeapFile3){
+    std::cout << " mappedHeapFile3 test" << std::endl;
+
+    std::vector<Page*> pages;
+    for(int p = 0; p < 2; p++){
+      HeapPage *heap_page = (HeapPage *) new Page();
+      heap_page->initializeHeader();
+      pages.push_back( heap_page );
+    }
+    ((HeapPageHeader *) pages[1]->getData())->version = 3;
+    std::string path = writePageFile( pages );
+    for(Page *p : pages){
+      delete p;
+    }
+
+    {
+      MappedHeapFile file( path );
+      CHECK( file.pinPage( 0 ) != nullptr );
+      CHECK_THROW( file.pinPage( 1 ), std::runtime_error );
+    }
+    unlink( path.c_str() );
+  }
+}
+
 /*
  * Prints usage
  */
@@ -779,7 +3439,10 @@ void usage(){
   std::cout << "Usage: ./unittests -s <suite_name> -h help\n";
   std::cout << "Available Suites: " <<
       "insertRecord, getRecord, updateRecord, heapScanner\n" <<
-      "variousMethods, studentTests, moreStudentTests" << std::endl;
+      "variousMethods, studentTests, moreStudentTests\n" <<
+      "deferredCompaction, freeSlotList, recordView, insertRecords\n" <<
+      "deleteRecords, updateInPlace, sparseScan, scanBatch, versionLatch\n" <<
+      "freeSpaceMap, compression, compactSlots, fixedHeapPage, paxPage, pageSynopsis, heapFileScanner, parallelHeapScan, heapPageStats, pageChecksum, pageLog, mvcc, pageVacuum, overflowRecords, recordArena, sortedHeapPage, mappedHeapFile" << std::endl;
 }
 
 /*